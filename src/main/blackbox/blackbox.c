@@ -21,6 +21,7 @@
 
 #include "platform.h"
 #include "version.h"
+#include "debug.h"
 
 #ifdef BLACKBOX
 
@@ -47,6 +48,7 @@
 #include "sensors/acceleration.h"
 #include "sensors/barometer.h"
 #include "sensors/gyro.h"
+#include "sensors/gyronoise.h"
 #include "sensors/battery.h"
 
 #include "io/beeper.h"
@@ -248,6 +250,17 @@ static const blackboxDeltaFieldDefinition_t blackboxMainFields[] = {
     {"navDebug",   2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
     {"navDebug",   3, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
 #endif
+
+    /* Contents of debug[], only logged while a feature that reports through it is enabled */
+    {"debug",      0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(DEBUG_VALUES)},
+    {"debug",      1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(DEBUG_VALUES)},
+    {"debug",      2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(DEBUG_VALUES)},
+    {"debug",      3, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(DEBUG_VALUES)},
+
+    /* Cutoff of the gyro low pass per axis while it follows the measured noise */
+    {"gyroLpfHz",  0, UNSIGNED, .Ipredict = PREDICT(0),       .Iencode = ENCODING(UNSIGNED_VB), .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(GYRO_DYNAMIC_LPF)},
+    {"gyroLpfHz",  1, UNSIGNED, .Ipredict = PREDICT(0),       .Iencode = ENCODING(UNSIGNED_VB), .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(GYRO_DYNAMIC_LPF)},
+    {"gyroLpfHz",  2, UNSIGNED, .Ipredict = PREDICT(0),       .Iencode = ENCODING(UNSIGNED_VB), .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(GYRO_DYNAMIC_LPF)},
 };
 
 #ifdef GPS
@@ -338,6 +351,8 @@ typedef struct blackboxMainState_s {
     int16_t navTargetSurface;
     int16_t navDebug[4];
 #endif
+    int16_t debug[DEBUG16_VALUE_COUNT];
+    uint8_t gyroLpfHz[XYZ_AXIS_COUNT];
 } blackboxMainState_t;
 
 typedef struct blackboxGpsState_s {
@@ -464,6 +479,20 @@ static bool testBlackboxConditionUncached(FlightLogFieldCondition condition)
         case FLIGHT_LOG_FIELD_CONDITION_RSSI:
             return masterConfig.rxConfig.rssi_channel > 0 || feature(FEATURE_RSSI_ADC);
 
+        case FLIGHT_LOG_FIELD_CONDITION_DEBUG_VALUES:
+#ifdef USE_GYRO_DYNAMIC_NOTCH
+            return masterConfig.gyroConfig.gyroDynamicNotch;
+#else
+            return false;
+#endif
+
+        case FLIGHT_LOG_FIELD_CONDITION_GYRO_DYNAMIC_LPF:
+#ifdef USE_GYRO_DYNAMIC_LPF
+            return masterConfig.gyroConfig.gyroDynamicLpf;
+#else
+            return false;
+#endif
+
         case FLIGHT_LOG_FIELD_CONDITION_NOT_LOGGING_EVERY_FRAME:
             return masterConfig.blackbox_rate_num < masterConfig.blackbox_rate_denom;
 
@@ -637,6 +666,16 @@ static void writeIntraframe(void)
     }
 #endif
 
+    if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_DEBUG_VALUES)) {
+        blackboxWriteSigned16VBArray(blackboxCurrent->debug, DEBUG16_VALUE_COUNT);
+    }
+
+    if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_GYRO_DYNAMIC_LPF)) {
+        for (x = 0; x < XYZ_AXIS_COUNT; x++) {
+            blackboxWriteUnsignedVB(blackboxCurrent->gyroLpfHz[x]);
+        }
+    }
+
     //Rotate our history buffers:
 
     //The current state becomes the new "before" state
@@ -788,6 +827,18 @@ static void writeInterframe(void)
     }
 #endif
 
+    if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_DEBUG_VALUES)) {
+        for (x = 0; x < DEBUG16_VALUE_COUNT; x++) {
+            blackboxWriteSignedVB(blackboxCurrent->debug[x] - blackboxLast->debug[x]);
+        }
+    }
+
+    if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_GYRO_DYNAMIC_LPF)) {
+        for (x = 0; x < XYZ_AXIS_COUNT; x++) {
+            blackboxWriteSignedVB(blackboxCurrent->gyroLpfHz[x] - blackboxLast->gyroLpfHz[x]);
+        }
+    }
+
     //Rotate our history buffers
     blackboxHistory[2] = blackboxHistory[1];
     blackboxHistory[1] = blackboxHistory[0];
@@ -1085,6 +1136,16 @@ static void loadMainState(void)
         blackboxCurrent->navDebug[i] = navDebug[i];
     }
 #endif
+
+    for (i = 0; i < DEBUG16_VALUE_COUNT; i++) {
+        blackboxCurrent->debug[i] = debug[i];
+    }
+
+#ifdef USE_GYRO_DYNAMIC_LPF
+    for (i = 0; i < XYZ_AXIS_COUNT; i++) {
+        blackboxCurrent->gyroLpfHz[i] = gyroDynamicLpfGetCutoffHz(i);
+    }
+#endif
 }
 
 /**
@@ -44,6 +44,9 @@ typedef enum FlightLogFieldCondition {
 
     FLIGHT_LOG_FIELD_CONDITION_NOT_LOGGING_EVERY_FRAME,
 
+    FLIGHT_LOG_FIELD_CONDITION_DEBUG_VALUES,
+    FLIGHT_LOG_FIELD_CONDITION_GYRO_DYNAMIC_LPF,
+
     FLIGHT_LOG_FIELD_CONDITION_NEVER,
 
     FLIGHT_LOG_FIELD_CONDITION_FIRST = FLIGHT_LOG_FIELD_CONDITION_ALWAYS,
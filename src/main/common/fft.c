@@ -0,0 +1,98 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "common/maths.h"
+#include "common/fft.h"
+
+// cos(2*pi*k/FFT_SIZE) and sin(2*pi*k/FFT_SIZE) for k < FFT_SIZE/2, shared by the butterflies and the window
+static float twiddleCos[FFT_SIZE / 2];
+static float twiddleSin[FFT_SIZE / 2];
+
+void fftInit(void)
+{
+    for (int k = 0; k < FFT_SIZE / 2; k++) {
+        const float angle = 2 * M_PIf * k / FFT_SIZE;
+        sincos_approx(angle, &twiddleSin[k], &twiddleCos[k]);
+    }
+}
+
+static uint8_t bitReverse(uint8_t index)
+{
+    uint8_t reversed = 0;
+    for (int bit = 0; bit < FFT_SIZE_LOG2; bit++) {
+        reversed = (reversed << 1) | (index & 1);
+        index >>= 1;
+    }
+    return reversed;
+}
+
+/*
+ * Loads FFT_SIZE real samples from the circular buffer samples[] starting at firstSample, applies a Hann window
+ * and stores them in bit reversed order, ready for the butterfly stages.
+ */
+void fftLoadWindowedReal(fftData_t *data, const float *samples, uint8_t firstSample)
+{
+    for (int i = 0; i < FFT_SIZE; i++) {
+        // cos(2*pi*i/N) is symmetric around N/2, so the half size table covers the whole window
+        const float windowCos = (i < FFT_SIZE / 2) ? twiddleCos[i] : -twiddleCos[i - FFT_SIZE / 2];
+        const float window = 0.5f - 0.5f * windowCos;
+        const uint8_t target = bitReverse(i);
+
+        data->re[target] = samples[(firstSample + i) & (FFT_SIZE - 1)] * window;
+        data->im[target] = 0;
+    }
+}
+
+/* decimation in time butterflies of one stage, stage 0 combines pairs, stage FFT_SIZE_LOG2-1 produces the result */
+void fftButterflyStage(fftData_t *data, uint8_t stage)
+{
+    const int half = 1 << stage;
+    const int twiddleStep = FFT_SIZE / (2 * half);
+
+    for (int group = 0; group < FFT_SIZE; group += 2 * half) {
+        for (int k = 0; k < half; k++) {
+            const float wr = twiddleCos[k * twiddleStep];
+            const float wi = -twiddleSin[k * twiddleStep];
+            const int top = group + k;
+            const int bottom = top + half;
+
+            const float tr = wr * data->re[bottom] - wi * data->im[bottom];
+            const float ti = wr * data->im[bottom] + wi * data->re[bottom];
+
+            data->re[bottom] = data->re[top] - tr;
+            data->im[bottom] = data->im[top] - ti;
+            data->re[top] += tr;
+            data->im[top] += ti;
+        }
+    }
+}
+
+void fftCalculate(fftData_t *data)
+{
+    for (int stage = 0; stage < FFT_SIZE_LOG2; stage++) {
+        fftButterflyStage(data, stage);
+    }
+}
+
+float fftBinPower(const fftData_t *data, uint8_t bin)
+{
+    return data->re[bin] * data->re[bin] + data->im[bin] * data->im[bin];
+}
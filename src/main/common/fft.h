@@ -0,0 +1,34 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#define FFT_SIZE_LOG2       6
+#define FFT_SIZE            (1 << FFT_SIZE_LOG2)
+#define FFT_BIN_COUNT       (FFT_SIZE / 2)      // bins 0..FFT_BIN_COUNT-1 of a real input, bin FFT_BIN_COUNT (Nyquist) is not used
+
+/* in place radix-2 FFT of FFT_SIZE points, split in steps so callers can spread the work over several loops */
+typedef struct fftData_s {
+    float re[FFT_SIZE];
+    float im[FFT_SIZE];
+} fftData_t;
+
+void fftInit(void);
+void fftLoadWindowedReal(fftData_t *data, const float *samples, uint8_t firstSample);
+void fftButterflyStage(fftData_t *data, uint8_t stage);
+void fftCalculate(fftData_t *data);
+float fftBinPower(const fftData_t *data, uint8_t bin);
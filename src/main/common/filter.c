@@ -18,8 +18,11 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
+#include "platform.h"
+
 #include "common/axis.h"
 #include "common/filter.h"
 #include "common/maths.h"
@@ -30,6 +33,12 @@
 
 /* sets up a biquad Filter */
 void filterInitBiQuad(uint8_t filterCutFreq, biquad_t *newState, int16_t samplingRate)
+{
+    filterInitBiQuadOfType(newState, FILTER_BIQUAD_LPF, filterCutFreq, BIQUAD_Q, samplingRate);
+}
+
+/* sets up a low-pass, notch or band-pass biquad (RBJ audio EQ cookbook), notch and band-pass fail if filterFreq is not below Nyquist */
+bool filterInitBiQuadOfType(biquad_t *newState, biquadFilterType_e filterType, uint16_t filterFreq, float Q, int16_t samplingRate)
 {
     float omega, sn, cs, alpha;
     float a0, a1, a2, b0, b1, b2;
@@ -39,15 +48,34 @@ void filterInitBiQuad(uint8_t filterCutFreq, biquad_t *newState, int16_t samplin
         samplingRate = 1000000 / targetLooptime;
     }
 
+    /* low-pass keeps its historic behaviour above Nyquist, a notch or band-pass there would be meaningless */
+    if (filterType != FILTER_BIQUAD_LPF && filterFreq >= samplingRate / 2) {
+        return false;
+    }
+
     /* setup variables */
-    omega = 2 * M_PIf * (float)filterCutFreq / (float)samplingRate;
-    sn = sin_approx(omega);
-    cs = cos_approx(omega);
-    alpha = sn / (2 * BIQUAD_Q);
-
-    b0 = (1 - cs) / 2;
-    b1 = 1 - cs;
-    b2 = (1 - cs) / 2;
+    omega = 2 * M_PIf * (float)filterFreq / (float)samplingRate;
+    sincos_approx(omega, &sn, &cs);
+    alpha = sn / (2 * Q);
+
+    switch (filterType) {
+    case FILTER_BIQUAD_NOTCH:
+        b0 = 1;
+        b1 = -2 * cs;
+        b2 = 1;
+        break;
+    case FILTER_BIQUAD_BPF:     /* constant 0 dB peak gain */
+        b0 = alpha;
+        b1 = 0;
+        b2 = -alpha;
+        break;
+    case FILTER_BIQUAD_LPF:
+    default:
+        b0 = (1 - cs) / 2;
+        b1 = 1 - cs;
+        b2 = (1 - cs) / 2;
+        break;
+    }
     a0 = 1 + alpha;
     a1 = -2 * cs;
     a2 = 1 - alpha;
@@ -61,6 +89,8 @@ void filterInitBiQuad(uint8_t filterCutFreq, biquad_t *newState, int16_t samplin
 
     /* zero initial samples */
     newState->d1 = newState->d2 = 1;
+
+    return true;
 }
 
 /* Computes a biquad_t filter on a sample */
@@ -75,6 +105,86 @@ float filterApplyBiQuad(float sample, biquad_t *state)
     return result;
 }
 
+/* sets up an empty biquad bank, stages are added with filterBiQuadBankAddStage() */
+void filterInitBiQuadBank(biquadBank_t *bank)
+{
+    bank->stageCount = 0;
+#ifdef USE_FIXED_POINT_MATH
+    filterInitBiQuadFixedBank(&bank->fixed);
+#endif
+}
+
+/* appends a stage using the coefficients and initial state of an initialised biquad_t, for all axes */
+bool filterBiQuadBankAddStage(biquadBank_t *bank, const biquad_t *stage)
+{
+    if (bank->stageCount >= BIQUAD_BANK_MAX_STAGES) {
+        return false;
+    }
+
+    const int n = bank->stageCount;
+    bank->b0[n] = stage->b0;
+    bank->b1[n] = stage->b1;
+    bank->b2[n] = stage->b2;
+    bank->a1[n] = stage->a1;
+    bank->a2[n] = stage->a2;
+    for (int axis = 0; axis < BIQUAD_BANK_AXIS_COUNT; axis++) {
+        bank->d1[n][axis] = stage->d1;
+        bank->d2[n][axis] = stage->d2;
+    }
+#ifdef USE_FIXED_POINT_MATH
+    filterBiQuadFixedBankAddStage(&bank->fixed, stage);
+#endif
+
+    bank->stageCount++;
+    return true;
+}
+
+/* filters one sample per axis in place through all stages */
+void filterApplyBiQuadBank(biquadBank_t *bank, float *samples)
+{
+    for (int n = 0; n < bank->stageCount; n++) {
+        // Coefficients stay in registers while all axes go through the stage
+        const float b0 = bank->b0[n];
+        const float b1 = bank->b1[n];
+        const float b2 = bank->b2[n];
+        const float a1 = bank->a1[n];
+        const float a2 = bank->a2[n];
+        float *d1 = bank->d1[n];
+        float *d2 = bank->d2[n];
+
+        for (int axis = 0; axis < BIQUAD_BANK_AXIS_COUNT; axis++) {
+            const float sample = samples[axis];
+            const float result = b0 * sample + d1[axis];
+            d1[axis] = b1 * sample - a1 * result + d2[axis];
+            d2[axis] = b2 * sample - a2 * result;
+            samples[axis] = result;
+        }
+    }
+}
+
+/*
+ * same as filterApplyBiQuadBank() for integer sensor data, converted to float once for the whole cascade.
+ * Without FPU the fixed-point copy of the stages is used instead.
+ */
+void filterApplyBiQuadBankInt32(biquadBank_t *bank, int32_t *samples)
+{
+#ifdef USE_FIXED_POINT_MATH
+    filterApplyBiQuadFixedBank(&bank->fixed, samples);
+#else
+    float values[BIQUAD_BANK_AXIS_COUNT];
+
+    for (int axis = 0; axis < BIQUAD_BANK_AXIS_COUNT; axis++) {
+        values[axis] = (float)samples[axis];
+    }
+
+    filterApplyBiQuadBank(bank, values);
+
+    for (int axis = 0; axis < BIQUAD_BANK_AXIS_COUNT; axis++) {
+        samples[axis] = lrintf(values[axis]);
+    }
+#endif
+}
+
 // PT1 Low Pass filter (when no dT specified it will be calculated from the cycleTime)
 float filterApplyPt1(float input, filterStatePt1_t *filter, float f_cut, float dT)
 {
@@ -109,21 +219,172 @@ void filterResetPt1(filterStatePt1_t *filter, float input)
     filter->state = input;
 }
 
-void filterUpdateFIR(int filterLength, float *shiftBuf, float newSample)
+/* sets up a FIR filter with an empty (zero) history, coeffs must stay valid while the filter is used */
+void firFilterInit(firFilter_t *filter, const float *coeffs, uint8_t length, uint8_t channelCount)
 {
-    // Shift history buffer and push new sample
-    for (int i = filterLength - 1; i > 0; i--)
-        shiftBuf[i] = shiftBuf[i - 1];
-
-    shiftBuf[0] = newSample;
+    filter->coeffs = coeffs;
+    filter->length = MIN(length, FIR_MAX_LENGTH);
+    filter->channelCount = MIN(channelCount, FIR_MAX_CHANNELS);
+    memset(filter->index, 0, sizeof(filter->index));
+    memset(filter->history, 0, sizeof(filter->history));
 }
 
-float filterApplyFIR(int filterLength, const float *shiftBuf, const float *coeffBuf, float commonMultiplier)
+/* pushes a new sample into the history of a channel and returns the filtered value, without shifting the history */
+float firFilterApply(firFilter_t *filter, uint8_t channel, float newSample)
 {
+    const int length = filter->length;
+    int index = filter->index[channel];
+
+    // Newest sample goes below the previous one, mirrored copy keeps the window contiguous across the wrap
+    index = (index == 0) ? length - 1 : index - 1;
+    filter->index[channel] = index;
+
+    float *history = &filter->history[channel][index];
+    history[0] = newSample;
+    history[length] = newSample;
+
     float accum = 0;
+    for (int i = 0; i < length; i++)
+        accum += history[i] * filter->coeffs[i];
+
+    return accum;
+}
+
+#define MEDIAN_HEAP(filter, i)      ((filter)->heap[(i) + (filter)->windowSize / 2])
+
+// while the window fills up the lower half takes the extra sample, so an even count gives the upper median
+static int medianFilterLowerCount(const medianFilter_t *filter)
+{
+    return filter->count / 2;
+}
 
-    for (int i = 0; i < filterLength; i++)
-        accum += shiftBuf[i] * coeffBuf[i];
+static int medianFilterUpperCount(const medianFilter_t *filter)
+{
+    return (filter->count - 1) / 2;
+}
+
+static bool medianFilterLess(const medianFilter_t *filter, int i, int j)
+{
+    return filter->data[MEDIAN_HEAP(filter, i)] < filter->data[MEDIAN_HEAP(filter, j)];
+}
+
+// swaps heap positions i and j if the sample at i is smaller, returns true if they were swapped
+static bool medianFilterOrder(medianFilter_t *filter, int i, int j)
+{
+    if (!medianFilterLess(filter, i, j)) {
+        return false;
+    }
+
+    const int8_t sampleI = MEDIAN_HEAP(filter, i);
+    const int8_t sampleJ = MEDIAN_HEAP(filter, j);
+    MEDIAN_HEAP(filter, i) = sampleJ;
+    MEDIAN_HEAP(filter, j) = sampleI;
+    filter->pos[sampleJ] = i;
+    filter->pos[sampleI] = j;
+    return true;
+}
+
+static void medianFilterUpperSortDown(medianFilter_t *filter, int i)
+{
+    for (; i <= medianFilterUpperCount(filter); i *= 2) {
+        if (i > 1 && i < medianFilterUpperCount(filter) && medianFilterLess(filter, i + 1, i)) {
+            i++;
+        }
+        if (!medianFilterOrder(filter, i, i / 2)) {
+            break;
+        }
+    }
+}
+
+static void medianFilterLowerSortDown(medianFilter_t *filter, int i)
+{
+    for (; i >= -medianFilterLowerCount(filter); i *= 2) {
+        if (i < -1 && i > -medianFilterLowerCount(filter) && medianFilterLess(filter, i, i - 1)) {
+            i--;
+        }
+        if (!medianFilterOrder(filter, i / 2, i)) {
+            break;
+        }
+    }
+}
+
+// returns true if the sample reached the median position
+static bool medianFilterUpperSortUp(medianFilter_t *filter, int i)
+{
+    while (i > 0 && medianFilterOrder(filter, i, i / 2)) {
+        i /= 2;
+    }
+    return i == 0;
+}
 
-    return accum * commonMultiplier;
+static bool medianFilterLowerSortUp(medianFilter_t *filter, int i)
+{
+    while (i < 0 && medianFilterOrder(filter, i / 2, i)) {
+        i /= 2;
+    }
+    return i == 0;
+}
+
+/* window is made odd and limited to MEDIAN_FILTER_MAX_WINDOW, the median is defined from the first sample on */
+void medianFilterInit(medianFilter_t *filter, uint8_t windowSize)
+{
+    windowSize = constrain(windowSize | 1, 1, MEDIAN_FILTER_MAX_WINDOW);
+
+    filter->windowSize = windowSize;
+    filter->index = 0;
+    filter->count = 0;
+
+    // Samples are placed alternately around the median so that a partly filled window is still two valid heaps
+    for (int i = 0; i < windowSize; i++) {
+        filter->data[i] = 0;
+        filter->pos[i] = ((i + 1) / 2) * ((i & 1) ? -1 : 1);
+        MEDIAN_HEAP(filter, filter->pos[i]) = i;
+    }
+}
+
+/* replaces the oldest sample with newSample and returns the median of the window */
+int32_t medianFilterApply(medianFilter_t *filter, int32_t newSample)
+{
+    const bool isNew = filter->count < filter->windowSize;
+    const int p = filter->pos[filter->index];
+    const int32_t oldSample = filter->data[filter->index];
+
+    filter->data[filter->index] = newSample;
+    filter->index = (filter->index + 1 == filter->windowSize) ? 0 : filter->index + 1;
+    if (isNew) {
+        filter->count++;
+    }
+
+    if (p > 0) {
+        if (!isNew && oldSample < newSample) {
+            medianFilterUpperSortDown(filter, p * 2);
+        } else if (medianFilterUpperSortUp(filter, p)) {
+            medianFilterLowerSortDown(filter, -1);
+        }
+    } else if (p < 0) {
+        if (!isNew && newSample < oldSample) {
+            medianFilterLowerSortDown(filter, p * 2);
+        } else if (medianFilterLowerSortUp(filter, p)) {
+            medianFilterUpperSortDown(filter, 1);
+        }
+    } else {
+        if (medianFilterLowerCount(filter)) {
+            medianFilterLowerSortDown(filter, -1);
+        }
+        if (medianFilterUpperCount(filter)) {
+            medianFilterUpperSortDown(filter, 1);
+        }
+    }
+
+    return medianFilterGet(filter);
+}
+
+int32_t medianFilterGet(const medianFilter_t *filter)
+{
+    return filter->data[MEDIAN_HEAP(filter, 0)];
+}
+
+bool medianFilterIsFull(const medianFilter_t *filter)
+{
+    return filter->count == filter->windowSize;
 }
@@ -17,24 +17,92 @@
 
 #pragma once
 
+#include "common/fixedpoint.h"
+
 typedef struct filterStatePt1_s {
 	float state;
 	float RC;
 	float constdT;
 } filterStatePt1_t;
 
+typedef enum {
+    FILTER_BIQUAD_LPF = 0,
+    FILTER_BIQUAD_NOTCH,
+    FILTER_BIQUAD_BPF
+} biquadFilterType_e;
+
 /* this holds the data required to update samples thru a filter */
 typedef struct biquad_s {
     float b0, b1, b2, a1, a2;
     float d1, d2;
 } biquad_t;
 
+#define BIQUAD_BANK_AXIS_COUNT  3
+#define BIQUAD_BANK_MAX_STAGES  3
+
+/* cascade of biquads applied to all axes in one call, shared coefficients and per axis state kept in separate arrays */
+typedef struct biquadBank_s {
+    uint8_t stageCount;
+    float b0[BIQUAD_BANK_MAX_STAGES];
+    float b1[BIQUAD_BANK_MAX_STAGES];
+    float b2[BIQUAD_BANK_MAX_STAGES];
+    float a1[BIQUAD_BANK_MAX_STAGES];
+    float a2[BIQUAD_BANK_MAX_STAGES];
+    float d1[BIQUAD_BANK_MAX_STAGES][BIQUAD_BANK_AXIS_COUNT];
+    float d2[BIQUAD_BANK_MAX_STAGES][BIQUAD_BANK_AXIS_COUNT];
+#ifdef USE_FIXED_POINT_MATH
+    biquadFixedBank_t fixed;    // same stages, used by filterApplyBiQuadBankInt32()
+#endif
+} biquadBank_t;
+
+#define FIR_MAX_LENGTH      16
+#define FIR_MAX_CHANNELS    3
+
+/*
+ * FIR filter for several channels sharing one set of coefficients, coeffs[0] applies to the newest sample.
+ * Every sample is stored twice, length apart, so the newest length samples are always contiguous from index[channel].
+ */
+typedef struct firFilter_s {
+    const float *coeffs;
+    uint8_t length;
+    uint8_t channelCount;
+    uint8_t index[FIR_MAX_CHANNELS];
+    float history[FIR_MAX_CHANNELS][2 * FIR_MAX_LENGTH];
+} firFilter_t;
+
+#define MEDIAN_FILTER_MAX_WINDOW    15
+
+/*
+ * Sliding window median, O(log n) per sample. The window is kept as a max-heap of the lower half and a min-heap of the
+ * upper half sharing one array with the median in the middle, so replacing the oldest sample only moves it up or down
+ * its own heap (S. Hardieck's "mediator").
+ */
+typedef struct medianFilter_s {
+    int32_t data[MEDIAN_FILTER_MAX_WINDOW];     // samples in arrival order, circular
+    int8_t pos[MEDIAN_FILTER_MAX_WINDOW];       // heap position of every sample, < 0 lower half, 0 median, > 0 upper half
+    int8_t heap[MEDIAN_FILTER_MAX_WINDOW];      // sample index at every heap position, offset by windowSize / 2
+    uint8_t windowSize;
+    uint8_t index;                              // oldest sample, replaced next
+    uint8_t count;
+} medianFilter_t;
+
 float filterApplyPt1(float input, filterStatePt1_t *filter, float f_cut, float dt);
 float filterApplyPt1WithRateLimit(float input, filterStatePt1_t *filter, float f_cut, float rate_limit, float dT);
 void filterResetPt1(filterStatePt1_t *filter, float input);
 
 void filterInitBiQuad(uint8_t filterCutFreq, biquad_t *newState, int16_t samplingRate);
+bool filterInitBiQuadOfType(biquad_t *newState, biquadFilterType_e filterType, uint16_t filterFreq, float Q, int16_t samplingRate);
 float filterApplyBiQuad(float sample, biquad_t *state);
 
-void filterUpdateFIR(int filterLength, float *shiftBuf, float newSample);
-float filterApplyFIR(int filterLength, const float *shiftBuf, const float *coeffBuf, float commonMultiplier);
\ No newline at end of file
+void filterInitBiQuadBank(biquadBank_t *bank);
+bool filterBiQuadBankAddStage(biquadBank_t *bank, const biquad_t *stage);
+void filterApplyBiQuadBank(biquadBank_t *bank, float *samples);
+void filterApplyBiQuadBankInt32(biquadBank_t *bank, int32_t *samples);
+
+void medianFilterInit(medianFilter_t *filter, uint8_t windowSize);
+int32_t medianFilterApply(medianFilter_t *filter, int32_t newSample);
+int32_t medianFilterGet(const medianFilter_t *filter);
+bool medianFilterIsFull(const medianFilter_t *filter);
+
+void firFilterInit(firFilter_t *filter, const float *coeffs, uint8_t length, uint8_t channelCount);
+float firFilterApply(firFilter_t *filter, uint8_t channel, float newSample);
\ No newline at end of file
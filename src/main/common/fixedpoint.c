@@ -0,0 +1,239 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "platform.h"
+
+#include "common/filter.h"
+#include "common/maths.h"
+#include "common/fixedpoint.h"
+
+static int32_t floatToFixed(float value, float scale, int32_t min, int32_t max)
+{
+    const float scaled = value * scale;
+
+    if (scaled >= (float)max) {
+        return max;
+    }
+    if (scaled <= (float)min) {
+        return min;
+    }
+    return lrintf(scaled);
+}
+
+q15_t floatToQ15(float value)
+{
+    return floatToFixed(value, 32768.0f, Q15_MIN, Q15_MAX);
+}
+
+q31_t floatToQ31(float value)
+{
+    return floatToFixed(value, 2147483648.0f, Q31_MIN, Q31_MAX);
+}
+
+q31_t floatToQ30(float value)
+{
+    return floatToFixed(value, (float)Q30_ONE, Q31_MIN, Q31_MAX);
+}
+
+float q15ToFloat(q15_t value)
+{
+    return value / 32768.0f;
+}
+
+float q31ToFloat(q31_t value)
+{
+    return value / 2147483648.0f;
+}
+
+// Conversions above are also used by the sensor alignment on every target, the rest only where floats are avoided
+#ifdef USE_FIXED_POINT_MATH
+/*
+ * 1 / sqrt(value) from an exponent halving first guess and two Newton iterations, relative error below 5e-6.
+ * Costs a few multiplies instead of a software sqrtf() and division.
+ */
+float fastInvSqrtf(float value)
+{
+    union {
+        float f;
+        int32_t i;
+    } conversion = { .f = value };
+
+    conversion.i = 0x5f3759df - (conversion.i >> 1);
+
+    const float halfValue = 0.5f * value;
+    float result = conversion.f;
+    result = result * (1.5f - halfValue * result * result);
+    result = result * (1.5f - halfValue * result * result);
+
+    return result;
+}
+
+/* copies the coefficients of a biquad designed in float, history starts at zero */
+void filterInitBiQuadFixed(biquadFixed_t *filter, const biquad_t *design)
+{
+    filter->b0 = floatToQ30(design->b0);
+    filter->b1 = floatToQ30(design->b1);
+    filter->b2 = floatToQ30(design->b2);
+    filter->a1 = floatToQ30(design->a1);
+    filter->a2 = floatToQ30(design->a2);
+    filter->x1 = filter->x2 = 0;
+    filter->y1 = filter->y2 = 0;
+}
+
+int32_t filterApplyBiQuadFixed(int32_t sample, biquadFixed_t *filter)
+{
+    const int32_t x0 = sample * (1 << FIXED_SAMPLE_SHIFT);
+
+    int64_t accumulator = 0;
+    accumulator = q31Mac(accumulator, filter->b0, x0);
+    accumulator = q31Mac(accumulator, filter->b1, filter->x1);
+    accumulator = q31Mac(accumulator, filter->b2, filter->x2);
+    accumulator = q31Mac(accumulator, -filter->a1, filter->y1);
+    accumulator = q31Mac(accumulator, -filter->a2, filter->y2);
+
+    const int32_t y0 = q31SatAccumulator(accumulator, Q30_SHIFT);
+
+    filter->x2 = filter->x1;
+    filter->x1 = x0;
+    filter->y2 = filter->y1;
+    filter->y1 = y0;
+
+    return (y0 + (1 << (FIXED_SAMPLE_SHIFT - 1))) >> FIXED_SAMPLE_SHIFT;
+}
+
+void filterInitBiQuadFixedBank(biquadFixedBank_t *bank)
+{
+    bank->stageCount = 0;
+}
+
+bool filterBiQuadFixedBankAddStage(biquadFixedBank_t *bank, const biquad_t *design)
+{
+    if (bank->stageCount >= BIQUAD_FIXED_BANK_MAX_STAGES) {
+        return false;
+    }
+
+    const int n = bank->stageCount;
+    bank->b0[n] = floatToQ30(design->b0);
+    bank->b1[n] = floatToQ30(design->b1);
+    bank->b2[n] = floatToQ30(design->b2);
+    bank->a1[n] = floatToQ30(design->a1);
+    bank->a2[n] = floatToQ30(design->a2);
+    for (int axis = 0; axis < BIQUAD_FIXED_BANK_AXIS_COUNT; axis++) {
+        bank->x1[n][axis] = bank->x2[n][axis] = 0;
+        bank->y1[n][axis] = bank->y2[n][axis] = 0;
+    }
+
+    bank->stageCount++;
+    return true;
+}
+
+/* filters one sample per axis in place through all stages, fraction bits are kept between stages */
+void filterApplyBiQuadFixedBank(biquadFixedBank_t *bank, int32_t *samples)
+{
+    int32_t values[BIQUAD_FIXED_BANK_AXIS_COUNT];
+
+    for (int axis = 0; axis < BIQUAD_FIXED_BANK_AXIS_COUNT; axis++) {
+        values[axis] = samples[axis] * (1 << FIXED_SAMPLE_SHIFT);
+    }
+
+    for (int n = 0; n < bank->stageCount; n++) {
+        const q31_t b0 = bank->b0[n];
+        const q31_t b1 = bank->b1[n];
+        const q31_t b2 = bank->b2[n];
+        const q31_t a1 = bank->a1[n];
+        const q31_t a2 = bank->a2[n];
+
+        for (int axis = 0; axis < BIQUAD_FIXED_BANK_AXIS_COUNT; axis++) {
+            const int32_t x0 = values[axis];
+
+            int64_t accumulator = 0;
+            accumulator = q31Mac(accumulator, b0, x0);
+            accumulator = q31Mac(accumulator, b1, bank->x1[n][axis]);
+            accumulator = q31Mac(accumulator, b2, bank->x2[n][axis]);
+            accumulator = q31Mac(accumulator, -a1, bank->y1[n][axis]);
+            accumulator = q31Mac(accumulator, -a2, bank->y2[n][axis]);
+
+            const int32_t y0 = q31SatAccumulator(accumulator, Q30_SHIFT);
+
+            bank->x2[n][axis] = bank->x1[n][axis];
+            bank->x1[n][axis] = x0;
+            bank->y2[n][axis] = bank->y1[n][axis];
+            bank->y1[n][axis] = y0;
+
+            values[axis] = y0;
+        }
+    }
+
+    for (int axis = 0; axis < BIQUAD_FIXED_BANK_AXIS_COUNT; axis++) {
+        samples[axis] = (values[axis] + (1 << (FIXED_SAMPLE_SHIFT - 1))) >> FIXED_SAMPLE_SHIFT;
+    }
+}
+
+/* gain is calculated once here, unlike filterApplyPt1() which divides on every sample */
+void filterInitPt1Fixed(pt1FilterFixed_t *filter, float f_cut, float dT)
+{
+    const float RC = 1.0f / (2.0f * M_PIf * f_cut);
+
+    filter->k = floatToQ31(dT / (RC + dT));
+    filter->state = 0;
+}
+
+int32_t filterApplyPt1Fixed(int32_t sample, pt1FilterFixed_t *filter)
+{
+    const int32_t error = q31SatSub(sample * (1 << FIXED_SAMPLE_SHIFT), filter->state);
+
+    filter->state = q31SatAdd(filter->state, q31Mul(error, filter->k));
+
+    return (filter->state + (1 << (FIXED_SAMPLE_SHIFT - 1))) >> FIXED_SAMPLE_SHIFT;
+}
+
+/* sets up a FIR filter with an empty (zero) history, coeffs must stay valid while the filter is used */
+void firFilterFixedInit(firFilterFixed_t *filter, const int16_t *coeffs, uint8_t length, uint8_t channelCount)
+{
+    filter->coeffs = coeffs;
+    filter->length = MIN(length, FIR_FIXED_MAX_LENGTH);
+    filter->channelCount = MIN(channelCount, FIR_FIXED_MAX_CHANNELS);
+    memset(filter->index, 0, sizeof(filter->index));
+    memset(filter->history, 0, sizeof(filter->history));
+}
+
+/* integer counterpart of firFilterApply(), the sum saturates instead of wrapping */
+int32_t firFilterFixedApply(firFilterFixed_t *filter, uint8_t channel, int32_t newSample)
+{
+    const int length = filter->length;
+    int index = filter->index[channel];
+
+    index = (index == 0) ? length - 1 : index - 1;
+    filter->index[channel] = index;
+
+    int32_t *history = &filter->history[channel][index];
+    history[0] = newSample;
+    history[length] = newSample;
+
+    int64_t accumulator = 0;
+    for (int i = 0; i < length; i++) {
+        accumulator = q31Mac(accumulator, history[i], filter->coeffs[i]);
+    }
+
+    return satInt32(accumulator);
+}
+#endif
@@ -0,0 +1,156 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * Fixed-point math for targets without FPU, where every float operation is a library call.
+ * q15_t and q31_t are signed fractions in [-1; 1), filter coefficients use Q30 so that they can reach +/-2.
+ * Floats are only used to design filters, never per sample.
+ */
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+#define Q15_MAX         INT16_MAX
+#define Q15_MIN         INT16_MIN
+#define Q31_MAX         INT32_MAX
+#define Q31_MIN         INT32_MIN
+
+#define Q30_SHIFT       30
+#define Q30_ONE         (1 << Q30_SHIFT)
+
+// Integer samples carry this many fraction bits inside fixed-point filters
+#define FIXED_SAMPLE_SHIFT  8
+
+static inline int32_t satInt32(int64_t value)
+{
+    if (value > INT32_MAX) {
+        return INT32_MAX;
+    }
+    if (value < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (int32_t)value;
+}
+
+static inline q15_t q15SatAdd(q15_t a, q15_t b)
+{
+    const int32_t sum = (int32_t)a + b;
+    return (sum > Q15_MAX) ? Q15_MAX : ((sum < Q15_MIN) ? Q15_MIN : sum);
+}
+
+static inline q31_t q31SatAdd(q31_t a, q31_t b)
+{
+    return satInt32((int64_t)a + b);
+}
+
+static inline q31_t q31SatSub(q31_t a, q31_t b)
+{
+    return satInt32((int64_t)a - b);
+}
+
+// Rounded product, -1 * -1 saturates to the largest positive value
+static inline q15_t q15Mul(q15_t a, q15_t b)
+{
+    const int32_t product = ((int32_t)a * b + (1 << 14)) >> 15;
+    return (product > Q15_MAX) ? Q15_MAX : product;
+}
+
+static inline q31_t q31Mul(q31_t a, q31_t b)
+{
+    return satInt32(((int64_t)a * b + (1LL << 30)) >> 31);
+}
+
+// Multiply-accumulate into a 64 bit accumulator, M3 does this in one SMLAL
+static inline int64_t q31Mac(int64_t accumulator, int32_t a, int32_t b)
+{
+    return accumulator + (int64_t)a * b;
+}
+
+// Rounds a 64 bit accumulator down by shift bits and saturates it to 32 bits
+static inline int32_t q31SatAccumulator(int64_t accumulator, uint8_t shift)
+{
+    return satInt32((accumulator + (1LL << (shift - 1))) >> shift);
+}
+
+q15_t floatToQ15(float value);
+q31_t floatToQ31(float value);
+q31_t floatToQ30(float value);
+float q15ToFloat(q15_t value);
+float q31ToFloat(q31_t value);
+
+#ifdef USE_FIXED_POINT_MATH
+float fastInvSqrtf(float value);
+#endif
+
+struct biquad_s;
+
+// Direct form I biquad on integer samples, Q30 coefficients and a 64 bit accumulator keep low cutoffs stable
+typedef struct biquadFixed_s {
+    q31_t b0, b1, b2, a1, a2;
+    int32_t x1, x2;             // previous inputs, FIXED_SAMPLE_SHIFT fraction bits
+    int32_t y1, y2;             // previous outputs, FIXED_SAMPLE_SHIFT fraction bits
+} biquadFixed_t;
+
+#define BIQUAD_FIXED_BANK_AXIS_COUNT    3
+#define BIQUAD_FIXED_BANK_MAX_STAGES    3
+
+typedef struct biquadFixedBank_s {
+    uint8_t stageCount;
+    q31_t b0[BIQUAD_FIXED_BANK_MAX_STAGES];
+    q31_t b1[BIQUAD_FIXED_BANK_MAX_STAGES];
+    q31_t b2[BIQUAD_FIXED_BANK_MAX_STAGES];
+    q31_t a1[BIQUAD_FIXED_BANK_MAX_STAGES];
+    q31_t a2[BIQUAD_FIXED_BANK_MAX_STAGES];
+    int32_t x1[BIQUAD_FIXED_BANK_MAX_STAGES][BIQUAD_FIXED_BANK_AXIS_COUNT];
+    int32_t x2[BIQUAD_FIXED_BANK_MAX_STAGES][BIQUAD_FIXED_BANK_AXIS_COUNT];
+    int32_t y1[BIQUAD_FIXED_BANK_MAX_STAGES][BIQUAD_FIXED_BANK_AXIS_COUNT];
+    int32_t y2[BIQUAD_FIXED_BANK_MAX_STAGES][BIQUAD_FIXED_BANK_AXIS_COUNT];
+} biquadFixedBank_t;
+
+// PT1 on integer samples, k = dT / (RC + dT) in Q31
+typedef struct pt1FilterFixed_s {
+    q31_t k;
+    int32_t state;              // FIXED_SAMPLE_SHIFT fraction bits
+} pt1FilterFixed_t;
+
+#define FIR_FIXED_MAX_LENGTH    16
+#define FIR_FIXED_MAX_CHANNELS  3
+
+// Integer coefficient FIR, same mirrored history as firFilter_t
+typedef struct firFilterFixed_s {
+    const int16_t *coeffs;
+    uint8_t length;
+    uint8_t channelCount;
+    uint8_t index[FIR_FIXED_MAX_CHANNELS];
+    int32_t history[FIR_FIXED_MAX_CHANNELS][2 * FIR_FIXED_MAX_LENGTH];
+} firFilterFixed_t;
+
+#ifdef USE_FIXED_POINT_MATH
+void filterInitBiQuadFixed(biquadFixed_t *filter, const struct biquad_s *design);
+int32_t filterApplyBiQuadFixed(int32_t sample, biquadFixed_t *filter);
+
+void filterInitBiQuadFixedBank(biquadFixedBank_t *bank);
+bool filterBiQuadFixedBankAddStage(biquadFixedBank_t *bank, const struct biquad_s *design);
+void filterApplyBiQuadFixedBank(biquadFixedBank_t *bank, int32_t *samples);
+
+void filterInitPt1Fixed(pt1FilterFixed_t *filter, float f_cut, float dT);
+int32_t filterApplyPt1Fixed(int32_t sample, pt1FilterFixed_t *filter);
+
+void firFilterFixedInit(firFilterFixed_t *filter, const int16_t *coeffs, uint8_t length, uint8_t channelCount);
+int32_t firFilterFixedApply(firFilterFixed_t *filter, uint8_t channel, int32_t newSample);
+#endif
@@ -25,6 +25,7 @@
 // Chebyshev http://stackoverflow.com/questions/345085/how-do-trigonometric-functions-work/345117#345117
 // Thanks for ledvinap for making such accuracy possible! See: https://github.com/cleanflight/cleanflight/issues/940#issuecomment-110323384
 // https://github.com/Crashpilot1000/HarakiriWebstore1/blob/master/src/mw.c#L1235
+// Max absolute error for |x| <= 2 * PI: 2.6e-7 with FAST_MATH
 #if defined(FAST_MATH) || defined(VERY_FAST_MATH)
 #if defined(VERY_FAST_MATH)
 #define sinPolyCoef3 -1.666568107e-1f
@@ -58,7 +59,7 @@ float cos_approx(float x)
 // https://github.com/Crashpilot1000/HarakiriWebstore1/blob/396715f73c6fcf859e0db0f34e12fe44bace6483/src/mw.c#L1292
 // http://http.developer.nvidia.com/Cg/atan2.html (not working correctly!)
 // Poly coefficients by @ledvinap (https://github.com/cleanflight/cleanflight/pull/1107)
-// Max absolute error 0,000027 degree
+// Max absolute error 6.7e-7 rad (0.000039 degree) for float inputs
 float atan2_approx(float y, float x)
 {
     #define atanPolyCoef1  3.14551665884836e-07f
@@ -85,7 +86,7 @@ float atan2_approx(float y, float x)
 // http://http.developer.nvidia.com/Cg/acos.html
 // Handbook of Mathematical Functions
 // M. Abramowitz and I.A. Stegun, Ed.
-// Absolute error <= 6.7e-5
+// Absolute error <= 6.8e-5 in float
 float acos_approx(float x)
 {
     float xa = fabsf(x);
@@ -97,6 +98,85 @@ float acos_approx(float x)
 }
 #endif
 
+// 2 * PI / SIN_TABLE_SIZE split in two, HI has 16 significant bits so that multiples up to 256 steps are exact
+#define SIN_TABLE_STEP_HI   0.0490875244140625f
+#define SIN_TABLE_STEP_LO   -1.3920172198256253e-07f
+
+// sin() at SIN_TABLE_SIZE points per turn, followed by a quarter turn more so that cos() reads the same table
+const float sinTable[SIN_TABLE_SIZE + SIN_TABLE_SIZE / 4] = {
+    0.000000000f, 0.049067674f, 0.098017140f, 0.146730474f, 0.195090322f, 0.242980180f, 0.290284677f, 0.336889853f,
+    0.382683432f, 0.427555093f, 0.471396737f, 0.514102744f, 0.555570233f, 0.595699304f, 0.634393284f, 0.671558955f,
+    0.707106781f, 0.740951125f, 0.773010453f, 0.803207531f, 0.831469612f, 0.857728610f, 0.881921264f, 0.903989293f,
+    0.923879533f, 0.941544065f, 0.956940336f, 0.970031253f, 0.980785280f, 0.989176510f, 0.995184727f, 0.998795456f,
+    1.000000000f, 0.998795456f, 0.995184727f, 0.989176510f, 0.980785280f, 0.970031253f, 0.956940336f, 0.941544065f,
+    0.923879533f, 0.903989293f, 0.881921264f, 0.857728610f, 0.831469612f, 0.803207531f, 0.773010453f, 0.740951125f,
+    0.707106781f, 0.671558955f, 0.634393284f, 0.595699304f, 0.555570233f, 0.514102744f, 0.471396737f, 0.427555093f,
+    0.382683432f, 0.336889853f, 0.290284677f, 0.242980180f, 0.195090322f, 0.146730474f, 0.098017140f, 0.049067674f,
+    0.000000000f,-0.049067674f,-0.098017140f,-0.146730474f,-0.195090322f,-0.242980180f,-0.290284677f,-0.336889853f,
+   -0.382683432f,-0.427555093f,-0.471396737f,-0.514102744f,-0.555570233f,-0.595699304f,-0.634393284f,-0.671558955f,
+   -0.707106781f,-0.740951125f,-0.773010453f,-0.803207531f,-0.831469612f,-0.857728610f,-0.881921264f,-0.903989293f,
+   -0.923879533f,-0.941544065f,-0.956940336f,-0.970031253f,-0.980785280f,-0.989176510f,-0.995184727f,-0.998795456f,
+   -1.000000000f,-0.998795456f,-0.995184727f,-0.989176510f,-0.980785280f,-0.970031253f,-0.956940336f,-0.941544065f,
+   -0.923879533f,-0.903989293f,-0.881921264f,-0.857728610f,-0.831469612f,-0.803207531f,-0.773010453f,-0.740951125f,
+   -0.707106781f,-0.671558955f,-0.634393284f,-0.595699304f,-0.555570233f,-0.514102744f,-0.471396737f,-0.427555093f,
+   -0.382683432f,-0.336889853f,-0.290284677f,-0.242980180f,-0.195090322f,-0.146730474f,-0.098017140f,-0.049067674f,
+    0.000000000f, 0.049067674f, 0.098017140f, 0.146730474f, 0.195090322f, 0.242980180f, 0.290284677f, 0.336889853f,
+    0.382683432f, 0.427555093f, 0.471396737f, 0.514102744f, 0.555570233f, 0.595699304f, 0.634393284f, 0.671558955f,
+    0.707106781f, 0.740951125f, 0.773010453f, 0.803207531f, 0.831469612f, 0.857728610f, 0.881921264f, 0.903989293f,
+    0.923879533f, 0.941544065f, 0.956940336f, 0.970031253f, 0.980785280f, 0.989176510f, 0.995184727f, 0.998795456f,
+};
+
+/*
+ * sin and cos from the nearest table entry and the angle addition formulas,
+ * sin(a + d) = sin(a) cos(d) + cos(a) sin(d), with short series for the small remainder |d| <= PI / SIN_TABLE_SIZE.
+ * Accuracy only picks the length of these series, see TRIG_ACCURACY_* for the error bounds.
+ */
+void sincos_table(float x, float *sinx, float *cosx, trigAccuracy_e accuracy)
+{
+    const float t = x * (SIN_TABLE_SIZE / (2.0f * M_PIf));
+    const int32_t nearest = (int32_t)(t + ((t >= 0.0f) ? 0.5f : -0.5f));
+    // Table step split in two constants, the remainder keeps full float precision
+    const float d = (x - nearest * SIN_TABLE_STEP_HI) - nearest * SIN_TABLE_STEP_LO;
+    const int index = nearest & (SIN_TABLE_SIZE - 1);
+
+    const float sinA = sinTable[index];
+    const float cosA = sinTable[index + SIN_TABLE_SIZE / 4];
+    const float d2 = d * d;
+
+    float sinD, cosD;
+    switch (accuracy) {
+    case TRIG_ACCURACY_LOW:
+        sinD = d;
+        cosD = 1.0f;
+        break;
+    case TRIG_ACCURACY_MEDIUM:
+        sinD = d;
+        cosD = 1.0f - 0.5f * d2;
+        break;
+    case TRIG_ACCURACY_HIGH:
+    default:
+        sinD = d * (1.0f - d2 * (1.0f / 6.0f));
+        cosD = 1.0f - 0.5f * d2;
+        break;
+    }
+
+    *sinx = sinA * cosD + cosA * sinD;
+    *cosx = cosA * cosD - sinA * sinD;
+}
+
+void sincos_approx(float x, float *sinx, float *cosx)
+{
+    sincos_table(x, sinx, cosx, TRIG_ACCURACY);
+}
+
+// Three angles at once, e.g. roll, pitch and yaw of a rotation
+void sincos_approx3(const float x[3], float sinx[3], float cosx[3])
+{
+    for (int i = 0; i < 3; i++) {
+        sincos_table(x[i], &sinx[i], &cosx[i], TRIG_ACCURACY);
+    }
+}
+
 int32_t wrap_18000(int32_t angle)
 {
     if (angle > 18000)
@@ -202,15 +282,17 @@ void normalizeV(struct fp_vector *src, struct fp_vector *dest)
 
 void buildRotationMatrix(fp_angles_t *delta, float matrix[3][3])
 {
+    float sinAngles[3], cosAngles[3];
     float cosx, sinx, cosy, siny, cosz, sinz;
     float coszcosx, sinzcosx, coszsinx, sinzsinx;
 
-    cosx = cos_approx(delta->angles.roll);
-    sinx = sin_approx(delta->angles.roll);
-    cosy = cos_approx(delta->angles.pitch);
-    siny = sin_approx(delta->angles.pitch);
-    cosz = cos_approx(delta->angles.yaw);
-    sinz = sin_approx(delta->angles.yaw);
+    sincos_approx3(delta->raw, sinAngles, cosAngles);
+    cosx = cosAngles[0];
+    sinx = sinAngles[0];
+    cosy = cosAngles[1];
+    siny = sinAngles[1];
+    cosz = cosAngles[2];
+    sinz = sinAngles[2];
 
     coszcosx = cosz * cosx;
     sinzcosx = sinz * cosx;
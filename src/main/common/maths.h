@@ -167,4 +167,26 @@ float acos_approx(float x);
 #define tan_approx(x)       tanf(x)
 #endif
 
+/*
+ * Table driven sin/cos, usable with or without FAST_MATH. Worst case absolute error for |x| <= 2 * PI,
+ * accuracy of larger angles is limited by the float resolution of x itself.
+ */
+typedef enum {
+    TRIG_ACCURACY_LOW = 0,      // 3.1e-4, table and one multiply-add per result
+    TRIG_ACCURACY_MEDIUM,       // 2.5e-6
+    TRIG_ACCURACY_HIGH          // 1.5e-7, float rounding, half the error of sin_approx()
+} trigAccuracy_e;
+
+#ifndef TRIG_ACCURACY
+#define TRIG_ACCURACY       TRIG_ACCURACY_HIGH
+#endif
+
+#define SIN_TABLE_SIZE      128
+
+extern const float sinTable[SIN_TABLE_SIZE + SIN_TABLE_SIZE / 4];
+
+void sincos_table(float x, float *sinx, float *cosx, trigAccuracy_e accuracy);
+void sincos_approx(float x, float *sinx, float *cosx);
+void sincos_approx3(const float x[3], float sinx[3], float cosx[3]);
+
 void arraySubInt32(int32_t *dest, int32_t *array1, int32_t *array2, int count);
@@ -66,8 +66,11 @@
 #include "flight/failsafe.h"
 #include "flight/navigation_rewrite.h"
 
+#include "scheduler/scheduler.h"
+
 #include "config/runtime_config.h"
 #include "config/config.h"
+#include "config/config_eeprom.h"
 
 #include "config/config_profile.h"
 #include "config/config_master.h"
@@ -77,56 +80,6 @@
 
 void useRcControlsConfig(modeActivationCondition_t *modeActivationConditions, escAndServoConfig_t *escAndServoConfigToUse, pidProfile_t *pidProfileToUse);
 
-#if !defined(FLASH_SIZE)
-#error "Flash size not defined for target. (specify in KB)"
-#endif
-
-
-#ifndef FLASH_PAGE_SIZE
-    #ifdef STM32F303xC
-        #define FLASH_PAGE_SIZE                 ((uint16_t)0x800)
-    #endif
-
-    #ifdef STM32F10X_MD
-        #define FLASH_PAGE_SIZE                 ((uint16_t)0x400)
-    #endif
-
-    #ifdef STM32F10X_HD
-        #define FLASH_PAGE_SIZE                 ((uint16_t)0x800)
-    #endif
-#endif
-
-#if !defined(FLASH_SIZE) && !defined(FLASH_PAGE_COUNT)
-    #ifdef STM32F10X_MD
-        #define FLASH_PAGE_COUNT 128
-    #endif
-
-    #ifdef STM32F10X_HD
-        #define FLASH_PAGE_COUNT 128
-    #endif
-#endif
-
-#if defined(FLASH_SIZE)
-#define FLASH_PAGE_COUNT ((FLASH_SIZE * 0x400) / FLASH_PAGE_SIZE)
-#endif
-
-#if !defined(FLASH_PAGE_SIZE)
-#error "Flash page size not defined for target."
-#endif
-
-#if !defined(FLASH_PAGE_COUNT)
-#error "Flash page count not defined for target."
-#endif
-
-#if FLASH_SIZE <= 128
-#define FLASH_TO_RESERVE_FOR_CONFIG 0x800
-#else
-#define FLASH_TO_RESERVE_FOR_CONFIG 0x1000
-#endif
-
-// use the last flash pages for storage
-#define CONFIG_START_FLASH_ADDRESS (0x08000000 + (uint32_t)((FLASH_PAGE_SIZE * FLASH_PAGE_COUNT) - FLASH_TO_RESERVE_FOR_CONFIG))
-
 master_t masterConfig;                 // master config struct with data independent from profiles
 profile_t *currentProfile;
 static uint32_t activeFeaturesLatch = 0;
@@ -134,7 +87,7 @@ static uint32_t activeFeaturesLatch = 0;
 static uint8_t currentControlRateProfileIndex = 0;
 controlRateConfig_t *currentControlRateProfile;
 
-static const uint8_t EEPROM_CONF_VERSION = 119;
+static const uint8_t EEPROM_CONF_VERSION = 131;
 
 static void resetAccelerometerTrims(flightDynamicsTrims_t * accZero, flightDynamicsTrims_t * accGain)
 {
@@ -181,6 +134,8 @@ void resetPidProfile(pidProfile_t *pidProfile)
     pidProfile->acc_soft_lpf_hz = 15;
     pidProfile->gyro_soft_lpf_hz = 60;
     pidProfile->dterm_lpf_hz = 40;
+    pidProfile->dterm_notch_hz = 0;
+    pidProfile->dterm_notch_q = 200;
     pidProfile->yaw_lpf_hz = 30;
 
     pidProfile->yaw_p_limit = YAW_P_LIMIT_MAX;
@@ -206,9 +161,11 @@ void resetNavConfig(navConfig_t * navConfig)
     navConfig->inav.automatic_mag_declination = 1;
 #endif
     navConfig->inav.gps_min_sats = 6;
-    navConfig->inav.gps_delay_ms = 200;
+    navConfig->inav.gps_delay_ms = 100;
     navConfig->inav.accz_unarmed_cal = 1;
     navConfig->inav.use_gps_velned = 0;         // "Disabled" is mandatory with gps_nav_model = LOW_G
+    navConfig->inav.estimator = NAV_POS_ESTIMATOR_COMPLEMENTARY;
+    navConfig->inav.update_rate_hz = 100;
 
     navConfig->inav.w_z_baro_p = 0.35f;
 
@@ -227,6 +184,7 @@ void resetNavConfig(navConfig_t * navConfig)
     navConfig->inav.baro_epv = 100.0f;
 
     // General navigation parameters
+    navConfig->update_rate_hz = 50;
     navConfig->pos_failure_timeout = 5;     // 5 sec
     navConfig->waypoint_radius = 100;       // 2m diameter
     navConfig->max_speed = 300;             // 3 m/s = 10.8 km/h
@@ -442,6 +400,8 @@ static void resetConf(void)
     masterConfig.dcm_ki_acc = 50;               // 0.005 * 10000
     masterConfig.dcm_kp_mag = 10000;            // 1.00 * 10000
     masterConfig.dcm_ki_mag = 0;                // 0.00 * 10000
+    masterConfig.imu_correction_hz = 0;         // correct on every loop
+    masterConfig.imu_estimator = IMU_ESTIMATOR_MAHONY;
     masterConfig.gyro_lpf = 3;                  // INV_FILTER_42HZ, In case of ST gyro, will default to 32Hz instead
 
     resetAccelerometerTrims(&masterConfig.accZero, &masterConfig.accGain);
@@ -453,6 +413,17 @@ static void resetConf(void)
     masterConfig.boardAlignment.yawDeciDegrees = 0;
     masterConfig.acc_hardware = ACC_DEFAULT;     // default/autodetect
     masterConfig.gyroConfig.gyroMovementCalibrationThreshold = 32;
+    for (int i = 0; i < GYRO_NOTCH_COUNT; i++) {
+        masterConfig.gyroConfig.gyroNotchHz[i] = 0;
+        masterConfig.gyroConfig.gyroNotchQ[i] = 200;
+    }
+    masterConfig.gyroConfig.gyroDynamicNotch = 0;
+    masterConfig.gyroConfig.gyroDynamicNotchMinHz = 80;
+    masterConfig.gyroConfig.gyroDynamicNotchQ = 300;
+    masterConfig.gyroConfig.gyroDynamicLpf = 0;
+    masterConfig.gyroConfig.gyroDynamicLpfMinHz = 30;
+    masterConfig.gyroConfig.gyroDynamicLpfMaxHz = 120;
+    masterConfig.gyroConfig.gyroCalibrationMinCycles = 200;
 
     masterConfig.mag_hardware = MAG_DEFAULT;     // default/autodetect
     masterConfig.baro_hardware = BARO_DEFAULT;   // default/autodetect
@@ -521,6 +492,9 @@ static void resetConf(void)
     masterConfig.i2c_overclock = 0;
     masterConfig.gyroSync = 0;
     masterConfig.gyroSyncDenominator = 2;
+    masterConfig.gyroSyncOversampling = 0;
+    masterConfig.schedulerPolicy = SCHEDULER_POLICY_DYNAMIC_PRIORITY;
+    masterConfig.looptimeGovernor = 0;
 
     resetPidProfile(&currentProfile->pidProfile);
 
@@ -774,6 +748,8 @@ void activateConfig(void)
     imuRuntimeConfig.dcm_kp_mag = masterConfig.dcm_kp_mag / 10000.0f;
     imuRuntimeConfig.dcm_ki_mag = masterConfig.dcm_ki_mag / 10000.0f;
     imuRuntimeConfig.small_angle = masterConfig.small_angle;
+    imuRuntimeConfig.correction_interval = masterConfig.imu_correction_hz ? 1000000 / masterConfig.imu_correction_hz : 0;
+    imuRuntimeConfig.estimator = masterConfig.imu_estimator;
 
     imuConfigure(&imuRuntimeConfig, &currentProfile->pidProfile);
 
@@ -31,6 +31,9 @@ typedef struct master_t {
     uint8_t i2c_overclock;                  // Overclock i2c Bus for faster IMU readings
     uint8_t gyroSync;                       // Enable interrupt based loop
     uint8_t gyroSyncDenominator;            // Gyro sync Denominator
+    uint8_t gyroSyncOversampling;           // Sample the gyro at full rate and average gyroSyncDenominator samples per loop
+    uint8_t schedulerPolicy;                // Task selection algorithm, see schedulerPolicy_e
+    uint8_t looptimeGovernor;               // Slow down the PID loop while disarmed if the CPU is overloaded
 
     motorMixer_t customMotorMixer[MAX_SUPPORTED_MOTORS];
 #ifdef USE_SERVOS
@@ -54,6 +57,8 @@ typedef struct master_t {
     uint16_t dcm_ki_acc;                    // DCM filter integral gain ( x 10000) for accelerometer
     uint16_t dcm_kp_mag;                    // DCM filter proportional gain ( x 10000) for magnetometer and GPS heading
     uint16_t dcm_ki_mag;                    // DCM filter integral gain ( x 10000) for magnetometer and GPS heading
+    uint16_t imu_correction_hz;             // rate of attitude correction from accelerometer and magnetometer, 0 = every loop
+    uint8_t imu_estimator;                  // attitude estimator, see imuEstimator_e
 
     uint8_t gyro_lpf;                       // gyro LPF setting - values are driver specific, in case of invalid number, a reasonable default ~30-40HZ is chosen.
 
@@ -24,6 +24,7 @@
 #include "build_config.h"
 #include "debug.h"
 
+#include "common/axis.h"
 #include "common/maths.h"
 
 #include "nvic.h"
@@ -52,6 +53,35 @@ static void mpu6050FindRevision(void);
 
 static volatile bool mpuDataReady;
 
+// Accelerometer, temperature and gyro registers are contiguous, one burst read serves both sensors
+#define MPU_BURST_READ_LENGTH       14      // ACCEL_XOUT_H to GYRO_ZOUT_L
+
+typedef struct mpuSampleCache_s {
+    int16_t acc[XYZ_AXIS_COUNT];
+    int16_t temperature;
+    int16_t gyro[XYZ_AXIS_COUNT];
+    uint32_t sampledAt;             // micros() at the burst read, shared by all values
+    bool gyroUnread;                // gyro values were not consumed by mpuGyroRead() yet
+} mpuSampleCache_t;
+
+static mpuSampleCache_t mpuSampleCache;
+
+#ifdef USE_GYRO_OVERSAMPLING
+#define MPU_GYRO_SAMPLE_BUFFER_SIZE     16      // must be a power of 2 no larger than 256
+#define MPU_GYRO_SAMPLE_BUFFER_MASK     (MPU_GYRO_SAMPLE_BUFFER_SIZE - 1)
+
+// Samples captured by the data ready interrupt at the full sensor rate, averaged by mpuGyroRead()
+static int16_t mpuGyroSampleBuffer[MPU_GYRO_SAMPLE_BUFFER_SIZE][XYZ_AXIS_COUNT];
+static volatile uint8_t mpuGyroSampleHead;
+static uint8_t mpuGyroSampleTail;
+
+static uint8_t mpuOversamplingDenominator;      // data ready is reported to gyro sync every this many samples, 0 if not oversampling
+static uint8_t mpuOversamplingCount;
+static volatile bool mpuOversamplingActive;     // set once the sensor is configured
+static volatile bool mpuBusBusy;                // main loop is talking to the sensor, interrupt must not use the bus
+static volatile bool mpuGyroSamplePending;      // sample arrived while the bus was busy
+#endif
+
 #ifdef USE_SPI
 static bool detectSPISensorsAndUpdateDetectionResult(void);
 #endif
@@ -185,6 +215,85 @@ static void mpu6050FindRevision(void)
     }
 }
 
+#ifdef USE_GYRO_OVERSAMPLING
+static void mpuGyroCaptureSample(void)
+{
+    uint8_t data[6];
+
+    if (!mpuConfiguration.read(mpuConfiguration.gyroReadXRegister, 6, data)) {
+        return;
+    }
+
+    const uint8_t head = mpuGyroSampleHead;
+    int16_t *sample = mpuGyroSampleBuffer[head & MPU_GYRO_SAMPLE_BUFFER_MASK];
+    sample[0] = (int16_t)((data[0] << 8) | data[1]);
+    sample[1] = (int16_t)((data[2] << 8) | data[3]);
+    sample[2] = (int16_t)((data[4] << 8) | data[5]);
+    mpuGyroSampleHead = head + 1;
+}
+
+static bool mpuReadRegisterShared(uint8_t reg, uint8_t length, uint8_t* data)
+{
+    if (!mpuOversamplingActive) {
+        return mpuConfiguration.read(reg, length, data);
+    }
+
+    mpuBusBusy = true;
+    bool ack = mpuConfiguration.read(reg, length, data);
+    mpuBusBusy = false;
+
+    // Pick up any sample the interrupt had to skip while the bus was in use
+    while (mpuGyroSamplePending) {
+        mpuBusBusy = true;
+        mpuGyroSamplePending = false;
+        mpuGyroCaptureSample();
+        mpuBusBusy = false;
+    }
+
+    return ack;
+}
+
+static bool mpuGyroReadOversampled(int16_t *gyroADC)
+{
+    const uint8_t head = mpuGyroSampleHead;
+    uint8_t count = head - mpuGyroSampleTail;
+
+    if (count == 0) {
+        return false;
+    }
+
+    // Older samples have been overwritten, the slot at head may be in the middle of being written
+    if (count > MPU_GYRO_SAMPLE_BUFFER_SIZE - 1) {
+        count = MPU_GYRO_SAMPLE_BUFFER_SIZE - 1;
+    }
+
+    int32_t sum[XYZ_AXIS_COUNT] = { 0, 0, 0 };
+    for (uint8_t i = 0; i < count; i++) {
+        const int16_t *sample = mpuGyroSampleBuffer[(uint8_t)(head - count + i) & MPU_GYRO_SAMPLE_BUFFER_MASK];
+        sum[X] += sample[X];
+        sum[Y] += sample[Y];
+        sum[Z] += sample[Z];
+    }
+
+    mpuGyroSampleTail = head;
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        gyroADC[axis] = sum[axis] / count;
+    }
+
+    return true;
+}
+#endif
+
+bool mpuGyroIsOversampling(void)
+{
+#ifdef USE_GYRO_OVERSAMPLING
+    return mpuOversamplingDenominator != 0;
+#else
+    return false;
+#endif
+}
+
 void MPU_DATA_READY_EXTI_Handler(void)
 {
     if (EXTI_GetITStatus(mpuIntExtiConfig->exti_line) == RESET) {
@@ -193,6 +302,21 @@ void MPU_DATA_READY_EXTI_Handler(void)
 
     EXTI_ClearITPendingBit(mpuIntExtiConfig->exti_line);
 
+#ifdef USE_GYRO_OVERSAMPLING
+    if (mpuOversamplingActive) {
+        if (mpuBusBusy) {
+            mpuGyroSamplePending = true;
+        } else {
+            mpuGyroCaptureSample();
+        }
+
+        if (++mpuOversamplingCount < mpuOversamplingDenominator) {
+            return;
+        }
+        mpuOversamplingCount = 0;
+    }
+#endif
+
     mpuDataReady = true;
 
 #ifdef DEBUG_MPU_DATA_READY_INTERRUPT
@@ -285,6 +409,13 @@ void mpuIntExtiInit(void)
     gpio.mode = Mode_IN_FLOATING;
     gpioInit(mpuIntExtiConfig->gpioPort, &gpio);
 
+#ifdef USE_GYRO_OVERSAMPLING
+    // Reading the sensor from the interrupt is only safe on SPI, the I2C driver relies on its own interrupts
+    if (mpuDetectionResult.sensor == MPU_60x0_SPI || mpuDetectionResult.sensor == MPU_65xx_SPI) {
+        mpuOversamplingDenominator = gyroSyncGetOversamplingDenominator();
+    }
+#endif
+
     configureMPUDataReadyInterruptHandling();
 
     mpuExtiInitDone = true;
@@ -302,12 +433,12 @@ static bool mpuWriteRegisterI2C(uint8_t reg, uint8_t data)
     return ack;
 }
 
-bool mpuAccRead(int16_t *accData)
+#ifdef USE_GYRO_OVERSAMPLING
+static bool mpuAccReadShared(int16_t *accData)
 {
     uint8_t data[6];
 
-    bool ack = mpuConfiguration.read(MPU_RA_ACCEL_XOUT_H, 6, data);
-    if (!ack) {
+    if (!mpuReadRegisterShared(MPU_RA_ACCEL_XOUT_H, 6, data)) {
         return false;
     }
 
@@ -317,8 +448,71 @@ bool mpuAccRead(int16_t *accData)
 
     return true;
 }
+#endif
 
-bool mpuGyroRead(int16_t *gyroADC)
+static bool mpuBurstRead(void)
+{
+    uint8_t data[MPU_BURST_READ_LENGTH];
+
+    const uint32_t sampledAt = micros();
+    if (!mpuConfiguration.read(MPU_RA_ACCEL_XOUT_H, MPU_BURST_READ_LENGTH, data)) {
+        return false;
+    }
+
+    mpuSampleCache.acc[0] = (int16_t)((data[0] << 8) | data[1]);
+    mpuSampleCache.acc[1] = (int16_t)((data[2] << 8) | data[3]);
+    mpuSampleCache.acc[2] = (int16_t)((data[4] << 8) | data[5]);
+    mpuSampleCache.temperature = (int16_t)((data[6] << 8) | data[7]);
+    mpuSampleCache.gyro[0] = (int16_t)((data[8] << 8) | data[9]);
+    mpuSampleCache.gyro[1] = (int16_t)((data[10] << 8) | data[11]);
+    mpuSampleCache.gyro[2] = (int16_t)((data[12] << 8) | data[13]);
+    mpuSampleCache.sampledAt = sampledAt;
+    mpuSampleCache.gyroUnread = true;
+
+    return true;
+}
+
+/*
+ * Accelerometer is read first in the loop, it fetches the gyro and temperature in the same transaction and
+ * leaves them for mpuGyroRead(), so both sensors see the same sample instant for half the bus time.
+ */
+bool mpuAccRead(int16_t *accData)
+{
+#ifdef USE_GYRO_OVERSAMPLING
+    // The interrupt owns gyro sampling, only the accelerometer is read here
+    if (mpuOversamplingActive) {
+        return mpuAccReadShared(accData);
+    }
+#endif
+
+    if (!mpuBurstRead()) {
+        return false;
+    }
+
+    accData[0] = mpuSampleCache.acc[0];
+    accData[1] = mpuSampleCache.acc[1];
+    accData[2] = mpuSampleCache.acc[2];
+
+    return true;
+}
+
+static bool mpuGyroReadCached(int16_t *gyroADC)
+{
+    // A sample left over from an earlier loop is older than the one the sensor holds now
+    if (!mpuSampleCache.gyroUnread || micros() - mpuSampleCache.sampledAt > targetLooptime / 2) {
+        return false;
+    }
+
+    mpuSampleCache.gyroUnread = false;
+
+    gyroADC[0] = mpuSampleCache.gyro[0];
+    gyroADC[1] = mpuSampleCache.gyro[1];
+    gyroADC[2] = mpuSampleCache.gyro[2];
+
+    return true;
+}
+
+static bool mpuGyroReadDirect(int16_t *gyroADC)
 {
     uint8_t data[6];
 
@@ -334,6 +528,29 @@ bool mpuGyroRead(int16_t *gyroADC)
     return true;
 }
 
+bool mpuGyroRead(int16_t *gyroADC)
+{
+#ifdef USE_GYRO_OVERSAMPLING
+    if (mpuOversamplingActive) {
+        return mpuGyroReadOversampled(gyroADC);
+    }
+#endif
+
+    if (!mpuGyroReadCached(gyroADC) && !mpuGyroReadDirect(gyroADC)) {
+        return false;
+    }
+
+#ifdef USE_GYRO_OVERSAMPLING
+    // First read happens once the sensor is configured, from now on the interrupt owns gyro sampling
+    if (mpuOversamplingDenominator) {
+        mpuGyroSampleTail = mpuGyroSampleHead;
+        mpuOversamplingActive = true;
+    }
+#endif
+
+    return true;
+}
+
 void checkMPUDataReady(bool *mpuDataReadyPtr) {
     if (mpuDataReady) {
         *mpuDataReadyPtr = true;
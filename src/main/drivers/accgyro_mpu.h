@@ -184,3 +184,4 @@ bool mpuAccRead(int16_t *accData);
 bool mpuGyroRead(int16_t *gyroADC);
 mpuDetectionResult_t *detectMpu(const extiConfig_t *configToUse);
 void checkMPUDataReady(bool *mpuDataReadyPtr);
+bool mpuGyroIsOversampling(void);
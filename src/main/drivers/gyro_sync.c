@@ -26,6 +26,8 @@
 
 #include "drivers/sensor.h"
 #include "drivers/accgyro.h"
+#include "drivers/exti.h"
+#include "drivers/accgyro_mpu.h"
 #include "drivers/gyro_sync.h"
 
 #include "config/runtime_config.h"
@@ -35,6 +37,7 @@ extern gyro_t gyro;
 
 uint32_t targetLooptime;
 static uint8_t mpuDividerDrops;
+static uint8_t gyroOversamplingDenominator;
 
 bool getMpuDataStatus(gyro_t *gyro)
 {
@@ -49,8 +52,10 @@ bool gyroSyncCheckUpdate(void)
     return getMpuDataStatus(&gyro);
 }
 
-void gyroSetSampleRate(uint32_t looptime, uint8_t lpf, uint8_t gyroSync, uint8_t gyroSyncDenominator)
+void gyroSetSampleRate(uint32_t looptime, uint8_t lpf, uint8_t gyroSync, uint8_t gyroSyncDenominator, uint8_t gyroOversampling)
 {
+    gyroOversamplingDenominator = 0;
+
     if (gyroSync) {
         int gyroSamplePeriod;
         if (lpf == 0) {
@@ -62,6 +67,10 @@ void gyroSetSampleRate(uint32_t looptime, uint8_t lpf, uint8_t gyroSync, uint8_t
 
         mpuDividerDrops  = gyroSyncDenominator - 1;
         targetLooptime = gyroSyncDenominator * gyroSamplePeriod;
+
+        if (gyroOversampling) {
+            gyroOversamplingDenominator = gyroSyncDenominator;
+        }
     } else {
         mpuDividerDrops = 0;
         targetLooptime = looptime;
@@ -70,5 +79,11 @@ void gyroSetSampleRate(uint32_t looptime, uint8_t lpf, uint8_t gyroSync, uint8_t
 
 uint8_t gyroMPU6xxxCalculateDivider(void)
 {
-    return mpuDividerDrops;
+    // When oversampling the sensor runs at full rate and the data ready interrupt does the decimation
+    return mpuGyroIsOversampling() ? 0 : mpuDividerDrops;
+}
+
+uint8_t gyroSyncGetOversamplingDenominator(void)
+{
+    return gyroOversamplingDenominator;
 }
@@ -35,6 +35,11 @@ uint32_t serialGetBaudRate(serialPort_t *instance)
     return instance->baudRate;
 }
 
+void serialSetIdleCallback(serialPort_t *instance, serialIdleCallbackPtr callback)
+{
+    instance->idleCallback = callback;
+}
+
 void serialWrite(serialPort_t *instance, uint8_t ch)
 {
     instance->vTable->serialWrite(instance, ch);
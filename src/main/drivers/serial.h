@@ -35,6 +35,7 @@ typedef enum portOptions_t {
 } portOptions_t;
 
 typedef void (*serialReceiveCallbackPtr)(uint16_t data);   // used by serial drivers to return frames to app
+typedef void (*serialIdleCallbackPtr)(void);    // called from ISR when RX line goes idle after a burst of data
 
 typedef struct serialPort_s {
 
@@ -57,6 +58,7 @@ typedef struct serialPort_s {
 
     // FIXME rename member to rxCallback
     serialReceiveCallbackPtr callback;
+    serialIdleCallbackPtr idleCallback;     // only supported by IRQ-driven UARTs, other ports never call it
 } serialPort_t;
 
 struct serialPortVTable {
@@ -90,6 +92,7 @@ void serialSetMode(serialPort_t *instance, portMode_t mode);
 bool isSerialTransmitBufferEmpty(serialPort_t *instance);
 void serialPrint(serialPort_t *instance, const char *str);
 uint32_t serialGetBaudRate(serialPort_t *instance);
+void serialSetIdleCallback(serialPort_t *instance, serialIdleCallbackPtr callback);
 
 // A shim that adapts the bufWriter API to the serialWriteBuf() API.
 void serialWriteBufShim(void *instance, uint8_t *data, int count);
@@ -203,6 +203,7 @@ serialPort_t *openSoftSerial(softSerialPortIndex_e portIndex, serialReceiveCallb
     softSerial->port.mode = MODE_RXTX;
     softSerial->port.options = options;
     softSerial->port.callback = callback;
+    softSerial->port.idleCallback = NULL;
 
     resetBuffers(softSerial);
 
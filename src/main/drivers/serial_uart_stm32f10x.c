@@ -55,20 +55,39 @@ static uartPort_t uartPort3;
 #undef USE_USART1_RX_DMA
 #endif
 
+static void usartReceiveByte(uartPort_t *s)
+{
+    // If we registered a callback, pass crap there
+    if (s->port.callback) {
+        s->port.callback(s->USARTx->DR);
+    } else {
+        s->port.rxBuffer[s->port.rxBufferHead++] = s->USARTx->DR;
+        if (s->port.rxBufferHead >= s->port.rxBufferSize) {
+            s->port.rxBufferHead = 0;
+        }
+    }
+}
+
 void usartIrqCallback(uartPort_t *s)
 {
     uint16_t SR = s->USARTx->SR;
 
     if (SR & USART_FLAG_RXNE && !s->rxDMAChannel) {
-        // If we registered a callback, pass crap there
-        if (s->port.callback) {
-            s->port.callback(s->USARTx->DR);
-        } else {
-            s->port.rxBuffer[s->port.rxBufferHead++] = s->USARTx->DR;
-            if (s->port.rxBufferHead >= s->port.rxBufferSize) {
-                s->port.rxBufferHead = 0;
+        usartReceiveByte(s);
+    }
+    if (SR & USART_FLAG_IDLE && !s->rxDMAChannel) {
+        // IDLE is cleared by reading SR followed by DR. If a byte was read above this already happened,
+        // otherwise read SR again so a byte received since is taken into the buffer instead of dropped.
+        if (!(SR & USART_FLAG_RXNE)) {
+            if (s->USARTx->SR & USART_FLAG_RXNE) {
+                usartReceiveByte(s);
+            } else {
+                (void)s->USARTx->DR;
             }
         }
+        if (s->port.idleCallback) {
+            s->port.idleCallback();
+        }
     }
     if (SR & USART_FLAG_TXE) {
         if (s->port.txBufferTail != s->port.txBufferHead) {
@@ -381,6 +381,13 @@ void usartIrqHandler(uartPort_t *s)
         }
     }
 
+    if (!s->rxDMAChannel && (ISR & USART_FLAG_IDLE)) {
+        USART_ClearITPendingBit(s->USARTx, USART_IT_IDLE);
+        if (s->port.idleCallback) {
+            s->port.idleCallback();
+        }
+    }
+
     if (!s->txDMAChannel && (ISR & USART_FLAG_TXE)) {
         if (s->port.txBufferTail != s->port.txBufferHead) {
             USART_SendData(s->USARTx, s->port.txBuffer[s->port.txBufferTail++]);
@@ -46,6 +46,7 @@
 #include "flight/mixer.h"
 #include "flight/pid.h"
 #include "flight/imu.h"
+#include "flight/imu_ekf.h"
 #include "flight/hil.h"
 
 #include "io/gps.h"
@@ -90,6 +91,22 @@ static float gyroScale;
 
 static bool gpsHeadingInitialized = false;
 
+// Rate feedback of the last correction step, rad/s in body frame
+static t_fp_vector imuCorrectionRateBF;
+
+// Sensor data averaged between correction steps
+static t_fp_vector imuAccelSum;
+static t_fp_vector imuGravitySum;
+static t_fp_vector imuMagSum;
+static uint16_t imuSampleCount;
+static float imuCorrectionDeltaTime;
+
+#if defined(NAV)
+// Acceleration averaged until the position estimator task reads it
+static t_fp_vector imuAccelNavSum;
+static uint16_t imuAccelNavSampleCount;
+#endif
+
 STATIC_UNIT_TESTED void imuComputeRotationMatrix(void)
 {
     float q1q1 = q1 * q1;
@@ -133,6 +150,10 @@ void imuInit(void)
         imuAccelInBodyFrame.A[axis] = 0;
     }
 
+#ifdef USE_IMU_EKF
+    imuEkfInit();
+#endif
+
     imuComputeRotationMatrix();
 }
 
@@ -168,7 +189,11 @@ void imuTransformVectorEarthToBody(t_fp_vector * v)
 
 static float invSqrt(float x)
 {
+#ifdef USE_FIXED_POINT_MATH
+    return fastInvSqrtf(x);
+#else
     return 1.0f / sqrtf(x);
+#endif
 }
 
 STATIC_UNIT_TESTED void imuComputeQuaternionFromRPY(int16_t initialRoll, int16_t initialPitch, int16_t initialYaw)
@@ -177,14 +202,22 @@ STATIC_UNIT_TESTED void imuComputeQuaternionFromRPY(int16_t initialRoll, int16_t
     if (initialPitch > 1800) initialPitch -= 3600;
     if (initialYaw > 1800) initialYaw -= 3600;
 
-    float cosRoll = cos_approx(DECIDEGREES_TO_RADIANS(initialRoll) * 0.5f);
-    float sinRoll = sin_approx(DECIDEGREES_TO_RADIANS(initialRoll) * 0.5f);
+    const float halfAngles[3] = {
+        DECIDEGREES_TO_RADIANS(initialRoll) * 0.5f,
+        DECIDEGREES_TO_RADIANS(initialPitch) * 0.5f,
+        DECIDEGREES_TO_RADIANS(-initialYaw) * 0.5f
+    };
+    float sinHalf[3], cosHalf[3];
+    sincos_approx3(halfAngles, sinHalf, cosHalf);
+
+    float cosRoll = cosHalf[0];
+    float sinRoll = sinHalf[0];
 
-    float cosPitch = cos_approx(DECIDEGREES_TO_RADIANS(initialPitch) * 0.5f);
-    float sinPitch = sin_approx(DECIDEGREES_TO_RADIANS(initialPitch) * 0.5f);
+    float cosPitch = cosHalf[1];
+    float sinPitch = sinHalf[1];
 
-    float cosYaw = cos_approx(DECIDEGREES_TO_RADIANS(-initialYaw) * 0.5f);
-    float sinYaw = sin_approx(DECIDEGREES_TO_RADIANS(-initialYaw) * 0.5f);
+    float cosYaw = cosHalf[2];
+    float sinYaw = sinHalf[2];
 
     q0 = cosRoll * cosPitch * cosYaw + sinRoll * sinPitch * sinYaw;
     q1 = sinRoll * cosPitch * cosYaw - cosRoll * sinPitch * sinYaw;
@@ -209,20 +242,29 @@ static float imuGetPGainScaleFactor(void)
     }
 }
 
-static void imuMahonyAHRSupdate(float dt, float gx, float gy, float gz,
-                                int accWeight, float ax, float ay, float az,
-                                bool useMag, float mx, float my, float mz,
-                                bool useCOG, float courseOverGround)
+/*
+ * Correction part of the Mahony filter, runs at imu_correction_hz: compares the attitude with the averaged
+ * accelerometer and magnetometer (or GPS course) and sets the rate feedback applied by imuMahonyAHRSPropagate()
+ * until the next correction. dt is the time since the previous correction.
+ */
+static void imuMahonyAHRSCorrect(float dt, float gx, float gy, float gz,
+                                 int accWeight, float ax, float ay, float az,
+                                 bool useMag, float mx, float my, float mz,
+                                 bool useCOG, float courseOverGround)
 {
     static float integralAccX = 0.0f,  integralAccY = 0.0f, integralAccZ = 0.0f;    // integral error terms scaled by Ki
     static float integralMagX = 0.0f,  integralMagY = 0.0f, integralMagZ = 0.0f;    // integral error terms scaled by Ki
     float recipNorm;
     float ex, ey, ez;
-    float qa, qb, qc;
 
     /* Calculate general spin rate (rad/s) */
     float spin_rate_sq = sq(gx) + sq(gy) + sq(gz);
 
+    // Feedback is held and added to the gyro rates by every propagation until the next correction
+    imuCorrectionRateBF.V.X = 0;
+    imuCorrectionRateBF.V.Y = 0;
+    imuCorrectionRateBF.V.Z = 0;
+
     /* Step 1: Yaw correction */
     // Use measured magnetic field vector
     if (useMag || useCOG) {
@@ -262,7 +304,9 @@ static void imuMahonyAHRSupdate(float dt, float gx, float gy, float gz,
             // (Rxx; Ryx) - measured (estimated) heading vector (EF)
             // (cos(COG), sin(COG)) - reference heading vector (EF)
             // error is cross product between reference heading and estimated heading (calculated in EF)
-            float ez_ef = - sin_approx(courseOverGround) * rMat[0][0] - cos_approx(courseOverGround) * rMat[1][0];
+            float sinCOG, cosCOG;
+            sincos_approx(courseOverGround, &sinCOG, &cosCOG);
+            float ez_ef = - sinCOG * rMat[0][0] - cosCOG * rMat[1][0];
 
             ex = rMat[2][0] * ez_ef;
             ey = rMat[2][1] * ez_ef;
@@ -282,16 +326,16 @@ static void imuMahonyAHRSupdate(float dt, float gx, float gy, float gz,
                 integralMagY += imuRuntimeConfig->dcm_ki_mag * ey * dt;
                 integralMagZ += imuRuntimeConfig->dcm_ki_mag * ez * dt;
 
-                gx += integralMagX;
-                gy += integralMagY;
-                gz += integralMagZ;
+                imuCorrectionRateBF.V.X += integralMagX;
+                imuCorrectionRateBF.V.Y += integralMagY;
+                imuCorrectionRateBF.V.Z += integralMagZ;
             }
         }
 
         // Calculate kP gain and apply proportional feedback
-        gx += kpMag * ex;
-        gy += kpMag * ey;
-        gz += kpMag * ez;
+        imuCorrectionRateBF.V.X += kpMag * ex;
+        imuCorrectionRateBF.V.Y += kpMag * ey;
+        imuCorrectionRateBF.V.Z += kpMag * ez;
     }
 
 
@@ -324,17 +368,28 @@ static void imuMahonyAHRSupdate(float dt, float gx, float gy, float gz,
                 integralAccY += imuRuntimeConfig->dcm_ki_acc * ey * dt;
                 integralAccZ += imuRuntimeConfig->dcm_ki_acc * ez * dt;
 
-                gx += integralAccX;
-                gy += integralAccY;
-                gz += integralAccZ;
+                imuCorrectionRateBF.V.X += integralAccX;
+                imuCorrectionRateBF.V.Y += integralAccY;
+                imuCorrectionRateBF.V.Z += integralAccZ;
             }
         }
 
         // Calculate kP gain and apply proportional feedback
-        gx += kpAcc * ex;
-        gy += kpAcc * ey;
-        gz += kpAcc * ez;
+        imuCorrectionRateBF.V.X += kpAcc * ex;
+        imuCorrectionRateBF.V.Y += kpAcc * ey;
+        imuCorrectionRateBF.V.Z += kpAcc * ez;
     }
+}
+
+/* Propagation part of the Mahony filter, integrates gyro rates plus the last correction feedback every loop */
+static void imuMahonyAHRSPropagate(float dt, float gx, float gy, float gz)
+{
+    float recipNorm;
+    float qa, qb, qc;
+
+    gx += imuCorrectionRateBF.V.X;
+    gy += imuCorrectionRateBF.V.Y;
+    gz += imuCorrectionRateBF.V.Z;
 
     // Integrate rate of change of quaternion
     gx *= (0.5f * dt);
@@ -360,12 +415,80 @@ static void imuMahonyAHRSupdate(float dt, float gx, float gy, float gz,
     imuComputeRotationMatrix();
 }
 
+#ifdef USE_IMU_EKF
+static bool imuUseEkf(void)
+{
+    return imuRuntimeConfig->estimator == IMU_ESTIMATOR_EKF;
+}
+
+/* Heading error as rotation about earth Z axis, in the same sense as the error the Mahony filter feeds back */
+static float imuCalculateHeadingError(bool useMag, float mx, float my, float mz, float courseOverGround)
+{
+    if (useMag) {
+        float hx = rMat[0][0] * mx + rMat[0][1] * my + rMat[0][2] * mz;
+        float hy = rMat[1][0] * mx + rMat[1][1] * my + rMat[1][2] * mz;
+
+        return atan2_approx(-hy, hx);
+    }
+    else {
+        float cosCOG, sinCOG;
+        sincos_approx(courseOverGround, &sinCOG, &cosCOG);
+
+        return atan2_approx(-sinCOG * rMat[0][0] - cosCOG * rMat[1][0], cosCOG * rMat[0][0] - sinCOG * rMat[1][0]);
+    }
+}
+
+/* EKF counterpart of imuMahonyAHRSCorrect(), the estimate is corrected directly instead of through rate feedback */
+static void imuEkfAHRSCorrect(float dt, float gx, float gy, float gz,
+                              int accWeight, float ax, float ay, float az,
+                              bool useMag, float mx, float my, float mz,
+                              bool useCOG, float courseOverGround)
+{
+    float q[4] = { q0, q1, q2, q3 };
+    const float gravity[XYZ_AXIS_COUNT] = { ax, ay, az };
+
+    // Gyro bias is not learned while spinning beyond the limit, like the Mahony integral terms
+    const bool updateBias = (sq(gx) + sq(gy) + sq(gz)) < sq(DEGREES_TO_RADIANS(SPIN_RATE_LIMIT));
+
+    if ((useMag && (sq(mx) + sq(my) + sq(mz)) > 0.01f) || useCOG) {
+        imuEkfCorrectHeading(q, imuCalculateHeadingError(useMag, mx, my, mz, courseOverGround), dt, updateBias);
+    }
+
+    if (accWeight > 0) {
+        imuEkfCorrectGravity(q, gravity, accWeight / (float)MAX_ACC_SQ_NEARNESS, dt, updateBias);
+    }
+
+    q0 = q[0];
+    q1 = q[1];
+    q2 = q[2];
+    q3 = q[3];
+
+    imuComputeRotationMatrix();
+}
+
+static void imuEkfAHRSPropagate(float dt, float gx, float gy, float gz)
+{
+    float q[4] = { q0, q1, q2, q3 };
+    const float gyroRate[XYZ_AXIS_COUNT] = { gx, gy, gz };
+
+    // Gain grows with the square root of process noise, this gives the same speed up as the Mahony fast gains
+    imuEkfPredict(q, gyroRate, dt, sq(imuGetPGainScaleFactor()));
+
+    q0 = q[0];
+    q1 = q[1];
+    q2 = q[2];
+    q3 = q[3];
+
+    imuComputeRotationMatrix();
+}
+#endif
+
 STATIC_UNIT_TESTED void imuUpdateEulerAngles(void)
 {
-    /* Compute pitch/roll angles */
-    attitude.values.roll = RADIANS_TO_DECIDEGREES(atan2_approx(rMat[2][1], rMat[2][2]));
-    attitude.values.pitch = RADIANS_TO_DECIDEGREES((0.5f * M_PIf) - acos_approx(-rMat[2][0]));
-    attitude.values.yaw = RADIANS_TO_DECIDEGREES(-atan2_approx(rMat[1][0], rMat[0][0])) + magneticDeclination;
+    /* Compute pitch/roll angles, rounded as truncating would bias them towards zero */
+    attitude.values.roll = lrintf(RADIANS_TO_DECIDEGREES(atan2_approx(rMat[2][1], rMat[2][2])));
+    attitude.values.pitch = lrintf(RADIANS_TO_DECIDEGREES((0.5f * M_PIf) - acos_approx(-rMat[2][0])));
+    attitude.values.yaw = lrintf(RADIANS_TO_DECIDEGREES(-atan2_approx(rMat[1][0], rMat[0][0]))) + magneticDeclination;
 
     if (attitude.values.yaw < 0)
         attitude.values.yaw += 3600;
@@ -379,17 +502,10 @@ STATIC_UNIT_TESTED void imuUpdateEulerAngles(void)
 }
 
 // Idea by MasterZap
-static int imuCalculateAccelerometerConfidence(void)
+static int imuCalculateAccelerometerConfidence(const t_fp_vector *accel)
 {
-    int32_t axis;
-    int32_t accMagnitude = 0;
-
-    for (axis = 0; axis < 3; axis++) {
-        accMagnitude += (int32_t)accADC[axis] * accADC[axis];
-    }
-
     // Magnitude^2 in percent of G^2
-    accMagnitude = accMagnitude * 100 / ((int32_t)acc.acc_1G * acc.acc_1G);
+    int32_t accMagnitude = (sq(accel->V.X) + sq(accel->V.Y) + sq(accel->V.Z)) * 100 / sq(GRAVITY_CMSS);
 
     int32_t nearness = ABS(100 - accMagnitude);
 
@@ -401,7 +517,18 @@ static bool isMagnetometerHealthy(void)
     return (magADC[X] != 0) && (magADC[Y] != 0) && (magADC[Z] != 0);
 }
 
-static void imuCalculateEstimatedAttitude(float dT)
+static void imuResetSensorSums(void)
+{
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        imuAccelSum.A[axis] = 0;
+        imuGravitySum.A[axis] = 0;
+        imuMagSum.A[axis] = 0;
+    }
+    imuSampleCount = 0;
+    imuCorrectionDeltaTime = 0;
+}
+
+static void imuCorrectEstimatedAttitude(void)
 {
     float courseOverGround = 0;
 
@@ -409,7 +536,13 @@ static void imuCalculateEstimatedAttitude(float dT)
     bool useMag = false;
     bool useCOG = false;
 
-    accWeight = imuCalculateAccelerometerConfidence();
+    // Sums become averages, the magnetometer vector is normalised later so its scale doesn't matter
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        imuAccelSum.A[axis] /= imuSampleCount;
+        imuGravitySum.A[axis] /= imuSampleCount;
+    }
+
+    accWeight = imuCalculateAccelerometerConfidence(&imuAccelSum);
 
     if (sensors(SENSOR_MAG) && isMagnetometerHealthy()) {
         useMag = true;
@@ -429,11 +562,63 @@ static void imuCalculateEstimatedAttitude(float dT)
     }
 #endif
 
-    imuMahonyAHRSupdate(dT,     imuMeasuredRotationBF.A[X], imuMeasuredRotationBF.A[Y], imuMeasuredRotationBF.A[Z],
-                        accWeight, imuMeasuredGravityBF.A[X], imuMeasuredGravityBF.A[Y], imuMeasuredGravityBF.A[Z],
-                        useMag, magADC[X], magADC[Y], magADC[Z],
+#ifdef USE_IMU_EKF
+    if (imuUseEkf()) {
+        imuEkfAHRSCorrect(imuCorrectionDeltaTime, imuMeasuredRotationBF.A[X], imuMeasuredRotationBF.A[Y], imuMeasuredRotationBF.A[Z],
+                            accWeight, imuGravitySum.A[X], imuGravitySum.A[Y], imuGravitySum.A[Z],
+                            useMag, imuMagSum.A[X], imuMagSum.A[Y], imuMagSum.A[Z],
+                            useCOG, courseOverGround);
+        imuResetSensorSums();
+        return;
+    }
+#endif
+
+    imuMahonyAHRSCorrect(imuCorrectionDeltaTime, imuMeasuredRotationBF.A[X], imuMeasuredRotationBF.A[Y], imuMeasuredRotationBF.A[Z],
+                        accWeight, imuGravitySum.A[X], imuGravitySum.A[Y], imuGravitySum.A[Z],
+                        useMag, imuMagSum.A[X], imuMagSum.A[Y], imuMagSum.A[Z],
                         useCOG, courseOverGround);
 
+    imuResetSensorSums();
+}
+
+static void imuAccumulateSensors(float dT)
+{
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        imuAccelSum.A[axis] += imuAccelInBodyFrame.A[axis];
+        imuGravitySum.A[axis] += imuMeasuredGravityBF.A[axis];
+        imuMagSum.A[axis] += magADC[axis];
+    }
+    imuSampleCount++;
+    imuCorrectionDeltaTime += dT;
+}
+
+static bool imuIsCorrectionDue(void)
+{
+    return imuCorrectionDeltaTime * 1e6f >= imuRuntimeConfig->correction_interval;
+}
+
+static void imuPropagateEstimatedAttitude(float dT)
+{
+#ifdef USE_IMU_EKF
+    if (imuUseEkf()) {
+        imuEkfAHRSPropagate(dT, imuMeasuredRotationBF.A[X], imuMeasuredRotationBF.A[Y], imuMeasuredRotationBF.A[Z]);
+        return;
+    }
+#endif
+
+    imuMahonyAHRSPropagate(dT, imuMeasuredRotationBF.A[X], imuMeasuredRotationBF.A[Y], imuMeasuredRotationBF.A[Z]);
+}
+
+static void imuCalculateEstimatedAttitude(float dT)
+{
+    imuAccumulateSensors(dT);
+
+    if (imuIsCorrectionDue()) {
+        imuCorrectEstimatedAttitude();
+    }
+
+    imuPropagateEstimatedAttitude(dT);
+
     imuUpdateEulerAngles();
 }
 
@@ -456,8 +641,15 @@ static void imuUpdateMeasuredAcceleration(void)
     for (axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
         imuAccelInBodyFrame.A[axis] = accADC[axis] * (GRAVITY_CMSS / acc.acc_1G);
         imuMeasuredGravityBF.A[axis] = imuAccelInBodyFrame.A[axis];
+#if defined(NAV)
+        imuAccelNavSum.A[axis] += imuAccelInBodyFrame.A[axis];
+#endif
     }
 
+#if defined(NAV)
+    imuAccelNavSampleCount++;
+#endif
+
 #ifdef GPS
     /** Centrifugal force compensation on a fixed-wing aircraft
       * a_c_body = omega x vel_tangential_body
@@ -538,6 +730,32 @@ void imuUpdateGyroAndAttitude(void)
     }
 }
 
+#if defined(NAV)
+/* Mean acceleration in body frame since the previous call, the position estimator runs slower than the gyro loop */
+void imuGetAverageAccelInBodyFrame(t_fp_vector * accel)
+{
+    if (imuAccelNavSampleCount == 0) {
+        *accel = imuAccelInBodyFrame;
+        return;
+    }
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        accel->A[axis] = imuAccelNavSum.A[axis] / imuAccelNavSampleCount;
+        imuAccelNavSum.A[axis] = 0;
+    }
+    imuAccelNavSampleCount = 0;
+}
+
+/* Drops the samples summed so far, called while they aren't read so the sample count can't wrap */
+void imuResetAverageAccelInBodyFrame(void)
+{
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        imuAccelNavSum.A[axis] = 0;
+    }
+    imuAccelNavSampleCount = 0;
+}
+#endif
+
 bool isImuReady(void)
 {
     return sensors(SENSOR_ACC) && isGyroCalibrationComplete();
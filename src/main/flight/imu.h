@@ -40,12 +40,19 @@ typedef union {
 
 extern attitudeEulerAngles_t attitude;
 
+typedef enum {
+    IMU_ESTIMATOR_MAHONY = 0,
+    IMU_ESTIMATOR_EKF,                      // needs USE_IMU_EKF, Mahony is used otherwise
+} imuEstimator_e;
+
 typedef struct imuRuntimeConfig_s {
     float dcm_kp_acc;
     float dcm_ki_acc;
     float dcm_kp_mag;
     float dcm_ki_mag;
     uint8_t small_angle;
+    uint32_t correction_interval;           // us between accelerometer/magnetometer corrections, 0 = every loop
+    uint8_t estimator;                      // see imuEstimator_e
 } imuRuntimeConfig_t;
 
 void imuConfigure(imuRuntimeConfig_t *initialImuRuntimeConfig, pidProfile_t *initialPidProfile);
@@ -55,6 +62,8 @@ void imuUpdateAccelerometer(void);
 float calculateThrottleTiltCompensationFactor(uint8_t throttleTiltCompensationStrength);
 float calculateCosTiltAngle(void);
 bool isImuReady(void);
+void imuGetAverageAccelInBodyFrame(t_fp_vector * accel);
+void imuResetAverageAccelInBodyFrame(void);
 bool isImuHeadingValid(void);
 
 void imuTransformVectorBodyToEarth(t_fp_vector * v);
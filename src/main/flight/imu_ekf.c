@@ -0,0 +1,379 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Error-state Kalman filter for attitude and gyro bias
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "platform.h"
+
+#ifdef USE_IMU_EKF
+
+#include "common/axis.h"
+#include "common/maths.h"
+
+#include "flight/imu_ekf.h"
+
+/*
+ * The attitude quaternion q is owned by the caller, the filter estimates the error of q as a small rotation
+ * in body frame (3 states) together with the gyro bias (3 states), and folds the error back into q after every
+ * correction. All measurements depend on the attitude error only, so the 6x6 covariance is kept as three 3x3
+ * blocks and the bias columns of H are never multiplied:
+ *      P = | Paa  Pab |
+ *          | Pab' Pbb |
+ */
+typedef float ekfMatrix3_t[3][3];
+
+static ekfMatrix3_t Paa;
+static ekfMatrix3_t Pab;
+static ekfMatrix3_t Pbb;
+
+static float gyroBias[XYZ_AXIS_COUNT];
+static float bodyRateSq;                // of the last prediction, gyro bias removed
+
+// Error state estimated by the correction in progress
+static float errorAttitude[XYZ_AXIS_COUNT];
+static float errorBias[XYZ_AXIS_COUNT];
+
+static float rejectedTime;
+static imuEkfStatus_t ekfStatus;
+
+static void ekfMat3Mul(ekfMatrix3_t out, ekfMatrix3_t a, ekfMatrix3_t b)
+{
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            out[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j];
+        }
+    }
+}
+
+// out = a * b'
+static void ekfMat3MulTransposed(ekfMatrix3_t out, ekfMatrix3_t a, ekfMatrix3_t b)
+{
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            out[i][j] = a[i][0] * b[j][0] + a[i][1] * b[j][1] + a[i][2] * b[j][2];
+        }
+    }
+}
+
+static void ekfMat3Symmetrize(ekfMatrix3_t m)
+{
+    for (int i = 0; i < 3; i++) {
+        for (int j = i + 1; j < 3; j++) {
+            m[i][j] = m[j][i] = 0.5f * (m[i][j] + m[j][i]);
+        }
+    }
+}
+
+static void ekfMat3SetDiagonal(ekfMatrix3_t m, float value)
+{
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            m[i][j] = (i == j) ? value : 0.0f;
+        }
+    }
+}
+
+static void ekfResetAttitudeCovariance(void)
+{
+    ekfMat3SetDiagonal(Paa, sq(IMU_EKF_ATTITUDE_INITIAL_SD));
+    ekfMat3SetDiagonal(Pab, 0.0f);
+    rejectedTime = 0;
+    ekfStatus.covarianceResets++;
+}
+
+static void ekfInitCovariance(void)
+{
+    ekfMat3SetDiagonal(Paa, sq(IMU_EKF_ATTITUDE_INITIAL_SD));
+    ekfMat3SetDiagonal(Pab, 0.0f);
+    ekfMat3SetDiagonal(Pbb, sq(IMU_EKF_GYRO_BIAS_INITIAL_SD));
+    rejectedTime = 0;
+}
+
+void imuEkfInit(void)
+{
+    ekfInitCovariance();
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        gyroBias[axis] = 0;
+    }
+    bodyRateSq = 0;
+
+    ekfStatus.gravityInnovationRatio = 0;
+    ekfStatus.rejectedCorrections = 0;
+    ekfStatus.covarianceResets = 0;
+}
+
+/*
+ * Starts the covariance over if rounding broke it. An attitude axis that no sensor observes (yaw without
+ * magnetometer) is left to grow, gyro noise adds less than 0.01 rad^2 per hour to it.
+ */
+static void ekfCheckCovariance(void)
+{
+    for (int i = 0; i < 3; i++) {
+        if (!(Paa[i][i] > 0.0f && Paa[i][i] < IMU_EKF_COVARIANCE_MAX) || !(Pbb[i][i] > 0.0f && Pbb[i][i] < IMU_EKF_COVARIANCE_MAX)) {
+            ekfInitCovariance();
+            ekfStatus.covarianceResets++;
+            return;
+        }
+    }
+}
+
+void imuEkfPredict(float q[4], const float gyroRate[XYZ_AXIS_COUNT], float dt, float processNoiseScale)
+{
+    const float wx = gyroRate[X] - gyroBias[X];
+    const float wy = gyroRate[Y] - gyroBias[Y];
+    const float wz = gyroRate[Z] - gyroBias[Z];
+
+    bodyRateSq = sq(wx) + sq(wy) + sq(wz);
+
+    // Integrate rate of change of quaternion, same as the Mahony filter
+    const float gx = wx * (0.5f * dt);
+    const float gy = wy * (0.5f * dt);
+    const float gz = wz * (0.5f * dt);
+
+    const float qa = q[0];
+    const float qb = q[1];
+    const float qc = q[2];
+    q[0] += (-qb * gx - qc * gy - q[3] * gz);
+    q[1] += (qa * gx + qc * gz - q[3] * gy);
+    q[2] += (qa * gy - qb * gz + q[3] * gx);
+    q[3] += (qa * gz + qb * gy - qc * gx);
+
+    const float recipNorm = 1.0f / sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    q[0] *= recipNorm;
+    q[1] *= recipNorm;
+    q[2] *= recipNorm;
+    q[3] *= recipNorm;
+
+    /*
+     * Error dynamics: attitude error is rotated by the body rate and grows with the bias error
+     *      F = | I - dt*[w]x   -dt*I |
+     *          |     0           I   |
+     * P = F * P * F' + Q is expanded per block, Phi = I - dt*[w]x
+     */
+    ekfMatrix3_t phi = {
+        {  1.0f,     dt * wz, -dt * wy },
+        { -dt * wz,  1.0f,     dt * wx },
+        {  dt * wy, -dt * wx,  1.0f    }
+    };
+    ekfMatrix3_t phiPaa;
+    ekfMatrix3_t phiPab;
+
+    ekfMat3Mul(phiPaa, phi, Paa);
+    ekfMat3Mul(phiPab, phi, Pab);
+    ekfMat3MulTransposed(Paa, phiPaa, phi);
+
+    const float gyroNoise = sq(IMU_EKF_GYRO_NOISE) * dt * processNoiseScale;
+    const float biasNoise = sq(IMU_EKF_GYRO_BIAS_NOISE) * dt * processNoiseScale;
+
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            Paa[i][j] += sq(dt) * Pbb[i][j] - dt * (phiPab[i][j] + phiPab[j][i]);
+            Pab[i][j] = phiPab[i][j] - dt * Pbb[i][j];
+        }
+        Paa[i][i] += gyroNoise;
+        Pbb[i][i] += biasNoise;
+    }
+
+    ekfMat3Symmetrize(Paa);
+    ekfCheckCovariance();
+}
+
+static void ekfBeginCorrection(void)
+{
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        errorAttitude[axis] = 0;
+        errorBias[axis] = 0;
+    }
+}
+
+/*
+ * Scalar measurement update with H = [h 0], measurements are processed one at a time so no matrix is inverted.
+ * Without updateBias the bias is only considered (Schmidt update), it is not corrected and its covariance is kept.
+ * Returns the squared innovation over its variance, the measurement is rejected above IMU_EKF_INNOVATION_GATE.
+ */
+static float ekfScalarUpdate(const float h[3], float residual, float variance, bool updateBias)
+{
+    float pa[3];
+    float pb[3];
+
+    for (int i = 0; i < 3; i++) {
+        pa[i] = Paa[i][0] * h[0] + Paa[i][1] * h[1] + Paa[i][2] * h[2];
+        pb[i] = Pab[0][i] * h[0] + Pab[1][i] * h[1] + Pab[2][i] * h[2];
+    }
+
+    const float innovationVariance = h[0] * pa[0] + h[1] * pa[1] + h[2] * pa[2] + variance;
+
+    // Part of the residual already explained by earlier measurements of this correction
+    const float innovation = residual - (h[0] * errorAttitude[0] + h[1] * errorAttitude[1] + h[2] * errorAttitude[2]);
+    const float innovationRatio = sq(innovation) / innovationVariance;
+
+    if (innovationRatio > IMU_EKF_INNOVATION_GATE) {
+        return innovationRatio;
+    }
+
+    const float gain = innovation / innovationVariance;
+    const float recipVariance = 1.0f / innovationVariance;
+
+    for (int i = 0; i < 3; i++) {
+        errorAttitude[i] += pa[i] * gain;
+        if (updateBias) {
+            errorBias[i] += pb[i] * gain;
+        }
+
+        for (int j = 0; j < 3; j++) {
+            Paa[i][j] -= pa[i] * pa[j] * recipVariance;
+            Pab[i][j] -= pa[i] * pb[j] * recipVariance;
+            if (updateBias) {
+                Pbb[i][j] -= pb[i] * pb[j] * recipVariance;
+            }
+        }
+    }
+
+    return innovationRatio;
+}
+
+// Folds the estimated error into the quaternion and the gyro bias
+static void ekfEndCorrection(float q[4])
+{
+    const float hx = 0.5f * errorAttitude[X];
+    const float hy = 0.5f * errorAttitude[Y];
+    const float hz = 0.5f * errorAttitude[Z];
+
+    const float qa = q[0];
+    const float qb = q[1];
+    const float qc = q[2];
+    q[0] += (-qb * hx - qc * hy - q[3] * hz);
+    q[1] += (qa * hx + qc * hz - q[3] * hy);
+    q[2] += (qa * hy - qb * hz + q[3] * hx);
+    q[3] += (qa * hz + qb * hy - qc * hx);
+
+    const float recipNorm = 1.0f / sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    q[0] *= recipNorm;
+    q[1] *= recipNorm;
+    q[2] *= recipNorm;
+    q[3] *= recipNorm;
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        gyroBias[axis] = constrainf(gyroBias[axis] + errorBias[axis], -IMU_EKF_GYRO_BIAS_MAX, IMU_EKF_GYRO_BIAS_MAX);
+    }
+
+    ekfMat3Symmetrize(Paa);
+    ekfMat3Symmetrize(Pbb);
+}
+
+/*
+ * accel is the measured acceleration in body frame in any unit, only its direction is used. accelWeight in (0; 1]
+ * scales the measurement noise up when the acceleration magnitude is away from 1G. A sustained turn barely changes
+ * the magnitude but tilts the acceleration by the turn's bank angle, so the noise also grows with body rate.
+ */
+void imuEkfCorrectGravity(float q[4], const float accel[XYZ_AXIS_COUNT], float accelWeight, float dt, bool updateBias)
+{
+    const float accelNorm = sqrtf(sq(accel[X]) + sq(accel[Y]) + sq(accel[Z]));
+    if (accelNorm < 0.01f || accelWeight <= 0.0f || dt <= 0.0f) {
+        return;
+    }
+
+    const float ax = accel[X] / accelNorm;
+    const float ay = accel[Y] / accelNorm;
+    const float az = accel[Z] / accelNorm;
+
+    // Estimated direction of gravity in body frame, the last row of the rotation matrix
+    const float vx = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+    const float vy = 2.0f * (q[2] * q[3] + q[0] * q[1]);
+    const float vz = 1.0f - 2.0f * (q[1] * q[1] + q[2] * q[2]);
+
+    // Rotating the body by a small error e changes the measured gravity by v x e, H is the skew matrix of v
+    const float h[3][3] = {
+        {  0.0f, -vz,    vy   },
+        {  vz,    0.0f, -vx   },
+        { -vy,    vx,    0.0f }
+    };
+    const float residual[3] = { ax - vx, ay - vy, az - vz };
+    const float variance = sq(IMU_EKF_ACC_NOISE) * (1.0f + bodyRateSq / sq(IMU_EKF_ACC_NOISE_RATE)) / (dt * accelWeight);
+
+    // While turning the acceleration error would be learned as gyro bias, mostly on the unobserved yaw axis
+    updateBias = updateBias && bodyRateSq < sq(IMU_EKF_BIAS_LEARNING_RATE);
+
+    bool rejected = false;
+    float maxInnovationRatio = 0;
+
+    ekfBeginCorrection();
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        const float innovationRatio = ekfScalarUpdate(h[axis], residual[axis], variance, updateBias);
+        if (innovationRatio > IMU_EKF_INNOVATION_GATE) {
+            rejected = true;
+        }
+        maxInnovationRatio = MAX(maxInnovationRatio, innovationRatio);
+    }
+    ekfEndCorrection(q);
+
+    ekfStatus.gravityInnovationRatio = maxInnovationRatio;
+
+    // A filter which keeps rejecting gravity is more likely wrong than the accelerometer
+    if (rejected) {
+        ekfStatus.rejectedCorrections++;
+        rejectedTime += dt;
+        if (rejectedTime > IMU_EKF_REJECT_RESET_TIME) {
+            ekfResetAttitudeCovariance();
+        }
+    }
+    else {
+        rejectedTime = 0;
+    }
+}
+
+/*
+ * headingError is the rotation about the earth Z axis (rad) that aligns the estimated heading with the
+ * magnetometer or GPS course, in the same sense as the Mahony filter heading error.
+ */
+void imuEkfCorrectHeading(float q[4], float headingError, float dt, bool updateBias)
+{
+    if (dt <= 0.0f) {
+        return;
+    }
+
+    // Earth Z axis in body frame
+    const float h[3] = {
+        2.0f * (q[1] * q[3] - q[0] * q[2]),
+        2.0f * (q[2] * q[3] + q[0] * q[1]),
+        1.0f - 2.0f * (q[1] * q[1] + q[2] * q[2])
+    };
+
+    ekfBeginCorrection();
+    if (ekfScalarUpdate(h, headingError, sq(IMU_EKF_HEADING_NOISE) / dt, updateBias) > IMU_EKF_INNOVATION_GATE) {
+        ekfStatus.rejectedCorrections++;
+    }
+    ekfEndCorrection(q);
+}
+
+const imuEkfStatus_t *imuEkfGetStatus(void)
+{
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        ekfStatus.attitudeStdDev[axis] = sqrtf(Paa[axis][axis]);
+        ekfStatus.gyroBias[axis] = gyroBias[axis];
+        ekfStatus.gyroBiasStdDev[axis] = sqrtf(Pbb[axis][axis]);
+    }
+
+    return &ekfStatus;
+}
+
+#endif
@@ -0,0 +1,48 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// Noise densities, measurement variances are divided by the time since the previous correction
+#define IMU_EKF_GYRO_NOISE              0.0006f     // rad/s/sqrt(Hz), includes vibration
+#define IMU_EKF_GYRO_BIAS_NOISE         0.00002f    // rad/s/sqrt(s), gyro bias random walk
+#define IMU_EKF_ACC_NOISE               0.003f      // rad/sqrt(Hz), direction of gravity from the accelerometer
+#define IMU_EKF_HEADING_NOISE           0.003f      // rad/sqrt(Hz), magnetometer or GPS course heading
+#define IMU_EKF_ACC_NOISE_RATE          0.02f       // rad/s, accelerometer variance grows with (body rate / this)^2, turns are centripetal acceleration
+
+#define IMU_EKF_ATTITUDE_INITIAL_SD     0.5f        // rad
+#define IMU_EKF_GYRO_BIAS_INITIAL_SD    0.005f       // rad/s, gyro is calibrated at boot
+#define IMU_EKF_GYRO_BIAS_MAX           0.1f        // rad/s
+#define IMU_EKF_BIAS_LEARNING_RATE      0.1f        // rad/s, gyro bias is not learned from gravity above this body rate
+#define IMU_EKF_COVARIANCE_MAX          10.0f       // variance above which the covariance is considered broken and reset
+#define IMU_EKF_INNOVATION_GATE         25.0f       // squared innovation over its variance above which a measurement is rejected
+#define IMU_EKF_REJECT_RESET_TIME       2.0f        // s of rejected gravity corrections after which attitude covariance is reset
+
+typedef struct imuEkfStatus_s {
+    float attitudeStdDev[XYZ_AXIS_COUNT];       // rad, body frame
+    float gyroBias[XYZ_AXIS_COUNT];             // rad/s
+    float gyroBiasStdDev[XYZ_AXIS_COUNT];       // rad/s
+    float gravityInnovationRatio;               // largest squared innovation over its variance of the last gravity correction
+    uint16_t rejectedCorrections;
+    uint16_t covarianceResets;
+} imuEkfStatus_t;
+
+void imuEkfInit(void);
+void imuEkfPredict(float q[4], const float gyroRate[XYZ_AXIS_COUNT], float dt, float processNoiseScale);
+void imuEkfCorrectGravity(float q[4], const float accel[XYZ_AXIS_COUNT], float accelWeight, float dt, bool updateBias);
+void imuEkfCorrectHeading(float q[4], float headingError, float dt, bool updateBias);
+const imuEkfStatus_t *imuEkfGetStatus(void);
@@ -0,0 +1,150 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "platform.h"
+
+#ifdef USE_LOOPTIME_GOVERNOR
+
+#include "common/maths.h"
+#include "common/utils.h"
+
+#include "drivers/gyro_sync.h"
+
+#include "scheduler/scheduler.h"
+
+#include "config/runtime_config.h"
+
+#include "flight/looptime_governor.h"
+
+/*
+ * The loop can only be slowed down by whole multiples of the boot looptime: with gyro_sync the gyro
+ * sample rate is programmed once at sensor init, and every loop must consume a fresh sample.
+ */
+static const uint8_t looptimeDividers[] = { 1, 2, 3, 4, 6, 8 };
+
+#define LOOPTIME_DIVIDER_COUNT  (sizeof(looptimeDividers) / sizeof(looptimeDividers[0]))
+
+static bool governorEnabled = false;
+static uint32_t governorBaseLooptime;
+static uint8_t dividerIndex;
+static bool evaluationWindowStarted;
+static uint32_t nextEvaluationAt;
+static uint16_t peakSystemLoadPercent;
+static uint8_t quietEvaluations;
+
+static void startEvaluationWindow(uint32_t windowStart)
+{
+    evaluationWindowStarted = true;
+    nextEvaluationAt = windowStart + LOOPTIME_GOVERNOR_EVALUATION_INTERVAL;
+    peakSystemLoadPercent = 0;
+}
+
+static void applyLooptimeDivider(uint8_t newDividerIndex)
+{
+    dividerIndex = newDividerIndex;
+    targetLooptime = governorBaseLooptime * looptimeDividers[dividerIndex];
+
+    // Filters designed for targetLooptime notice the change and re-initialise themselves on their next run
+    rescheduleTask(TASK_GYROPID, targetLooptime);
+}
+
+void looptimeGovernorInit(bool enabled, uint32_t baseLooptime)
+{
+    governorEnabled = enabled;
+    governorBaseLooptime = baseLooptime;
+    dividerIndex = 0;
+    quietEvaluations = 0;
+    evaluationWindowStarted = false;
+}
+
+static bool pidLoopFitsLooptime(uint32_t looptime)
+{
+    return cfTasks[TASK_GYROPID].averageExecutionTime * 100 <= looptime * LOOPTIME_GOVERNOR_PID_HEADROOM;
+}
+
+void looptimeGovernorUpdate(uint32_t currentTime)
+{
+    if (!governorEnabled || !governorBaseLooptime) {
+        return;
+    }
+
+    // Loop rate is frozen while armed, measurements taken in flight are not reused after disarming
+    if (ARMING_FLAG(ARMED)) {
+        evaluationWindowStarted = false;
+        quietEvaluations = 0;
+        return;
+    }
+
+    if (!evaluationWindowStarted) {
+        startEvaluationWindow(currentTime);
+    }
+
+    // averageSystemLoadPercent is recalculated every 100ms, track the worst value seen in this window
+    peakSystemLoadPercent = MAX(peakSystemLoadPercent, averageSystemLoadPercent);
+
+    if (cmp32(currentTime, nextEvaluationAt) < 0) {
+        return;
+    }
+
+    const bool overloaded = peakSystemLoadPercent >= 100;   // same threshold as isSystemOverloaded()
+    const bool quiet = peakSystemLoadPercent < LOOPTIME_GOVERNOR_LOAD_LOW;
+
+    startEvaluationWindow(nextEvaluationAt);
+
+    if (overloaded) {
+        quietEvaluations = 0;
+        if (dividerIndex < LOOPTIME_DIVIDER_COUNT - 1) {
+            applyLooptimeDivider(dividerIndex + 1);
+        }
+        return;
+    }
+
+    if (!quiet || dividerIndex == 0) {
+        quietEvaluations = 0;
+        return;
+    }
+
+    // Require a few quiet windows in a row so that a rate that overloaded the CPU is not retried immediately
+    if (++quietEvaluations < LOOPTIME_GOVERNOR_SPEEDUP_EVALUATIONS) {
+        return;
+    }
+
+    quietEvaluations = 0;
+    if (pidLoopFitsLooptime(governorBaseLooptime * looptimeDividers[dividerIndex - 1])) {
+        applyLooptimeDivider(dividerIndex - 1);
+    }
+}
+
+bool isLooptimeGovernorEnabled(void)
+{
+    return governorEnabled;
+}
+
+uint8_t looptimeGovernorGetDivider(void)
+{
+    return looptimeDividers[dividerIndex];
+}
+
+uint32_t looptimeGovernorGetBaseLooptime(void)
+{
+    return governorBaseLooptime;
+}
+
+#endif
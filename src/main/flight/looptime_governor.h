@@ -0,0 +1,30 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#define LOOPTIME_GOVERNOR_EVALUATION_INTERVAL   1000000     // us, system load is averaged by taskSystem every 100ms
+#define LOOPTIME_GOVERNOR_LOAD_LOW              50          // averageSystemLoadPercent below which a faster loop is tried, slowing down happens on isSystemOverloaded()
+#define LOOPTIME_GOVERNOR_PID_HEADROOM          60          // percent of the faster period the PID task may use
+#define LOOPTIME_GOVERNOR_SPEEDUP_EVALUATIONS   3           // consecutive quiet evaluations required before speeding up
+
+void looptimeGovernorInit(bool enabled, uint32_t baseLooptime);
+void looptimeGovernorUpdate(uint32_t currentTime);
+
+bool isLooptimeGovernorEnabled(void);
+uint8_t looptimeGovernorGetDivider(void);
+uint32_t looptimeGovernorGetBaseLooptime(void);
@@ -35,6 +35,7 @@
 #include "drivers/sensor.h"
 #include "drivers/accgyro.h"
 #include "drivers/system.h"
+#include "drivers/gyro_sync.h"
 
 #include "rx/rx.h"
 
@@ -85,7 +86,7 @@ static uint8_t maxServoIndex;
 
 static servoParam_t *servoConf;
 static biquad_t servoFitlerState[MAX_SUPPORTED_SERVOS];
-static bool servoFilterIsSet;
+static uint32_t servoFilterLooptime;        // looptime the servo filters were designed for
 #endif
 
 static const motorMixer_t mixerQuadX[] = {
@@ -877,12 +878,12 @@ void filterServos(void)
 
     if (mixerConfig->servo_lowpass_enable) {
         // Initialize servo lowpass filter (servos are calculated at looptime rate)
-        if (!servoFilterIsSet) {
+        if (servoFilterLooptime != targetLooptime) {
             for (servoIdx = 0; servoIdx < MAX_SUPPORTED_SERVOS; servoIdx++) {
                 filterInitBiQuad(mixerConfig->servo_lowpass_freq, &servoFitlerState[servoIdx], 0);
             }
 
-            servoFilterIsSet = true;
+            servoFilterLooptime = targetLooptime;
         }
 
         for (servoIdx = 0; servoIdx < MAX_SUPPORTED_SERVOS; servoIdx++) {
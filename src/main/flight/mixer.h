@@ -98,7 +98,7 @@ typedef struct flight3DConfig_s {
 #ifdef USE_SERVOS
 
 // These must be consecutive, see 'reversedSources'
-enum {
+typedef enum {
     INPUT_STABILIZED_ROLL = 0,
     INPUT_STABILIZED_PITCH,
     INPUT_STABILIZED_YAW,
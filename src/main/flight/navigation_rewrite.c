@@ -17,6 +17,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <math.h>
 
 #include "build_config.h"
@@ -37,6 +38,7 @@
 
 #include "io/beeper.h"
 #include "io/gps.h"
+#include "io/rc_controls.h"
 
 #include "flight/pid.h"
 #include "flight/imu.h"
@@ -46,6 +48,8 @@
 #include "config/runtime_config.h"
 #include "config/config.h"
 
+#include "scheduler/scheduler.h"
+
 /*-----------------------------------------------------------
  * Compatibility for home position
  *-----------------------------------------------------------*/
@@ -55,6 +59,10 @@ int16_t       GPS_directionToHome;       // direction to home point in degrees
 
 #if defined(NAV)
 navigationPosControl_t  posControl;
+
+/* TASK_NAV builds a setpoint in the inactive buffer and flips navSetpointActive once it is complete */
+static navSetpoint_t navSetpoint[2];
+static volatile uint8_t navSetpointActive;
 navSystemStatus_t       NAV_Status;
 
 #if defined(NAV_BLACKBOX)
@@ -77,7 +85,7 @@ static void resetPositionController(void);
 static void setupAltitudeController(void);
 void resetNavigation(void);
 
-static void calcualteAndSetActiveWaypoint(navWaypoint_t * waypoint);
+static void calcualteAndSetActiveWaypoint(const navWaypoint_t * waypoint);
 static void calcualteAndSetActiveWaypointToLocalPosition(t_fp_vector * pos);
 void calculateInitialHoldPosition(t_fp_vector * pos);
 void calculateFarAwayTarget(t_fp_vector * farAwayPos, int32_t yaw, int32_t distance);
@@ -477,15 +485,21 @@ static navigationFSMStateDescriptor_t navFSM[NAV_STATE_COUNT] = {
 
     [NAV_STATE_WAYPOINT_PRE_ACTION] = {
         .onEntry = navOnEnteringState_NAV_STATE_WAYPOINT_PRE_ACTION,
-        .timeoutMs = 0,
+        .timeoutMs = 10,
         .stateFlags = NAV_CTL_ALT | NAV_CTL_POS | NAV_CTL_YAW | NAV_REQUIRE_ANGLE | NAV_REQUIRE_MAGHOLD | NAV_REQUIRE_THRTILT | NAV_AUTO_WP,
         .mapToFlightModes = NAV_WP_MODE | NAV_ALTHOLD_MODE,
         .mwState = MW_NAV_STATE_PROCESS_NEXT,
         .mwError = MW_NAV_ERROR_NONE,
         .onEvent = {
+            [NAV_FSM_EVENT_TIMEOUT]                     = NAV_STATE_WAYPOINT_PRE_ACTION,    // waypoint not read yet, re-process the state
             [NAV_FSM_EVENT_SUCCESS]                     = NAV_STATE_WAYPOINT_IN_PROGRESS,
             [NAV_FSM_EVENT_ERROR]                       = NAV_STATE_IDLE,
             [NAV_FSM_EVENT_SWITCH_TO_IDLE]              = NAV_STATE_IDLE,
+            [NAV_FSM_EVENT_SWITCH_TO_ALTHOLD]           = NAV_STATE_ALTHOLD_INITIALIZE,
+            [NAV_FSM_EVENT_SWITCH_TO_POSHOLD_2D]        = NAV_STATE_POSHOLD_2D_INITIALIZE,
+            [NAV_FSM_EVENT_SWITCH_TO_POSHOLD_3D]        = NAV_STATE_POSHOLD_3D_INITIALIZE,
+            [NAV_FSM_EVENT_SWITCH_TO_RTH]               = NAV_STATE_RTH_INITIALIZE,
+            [NAV_FSM_EVENT_SWITCH_TO_EMERGENCY_LANDING] = NAV_STATE_EMERGENCY_LANDING_INITIALIZE,
             [NAV_FSM_EVENT_SWITCH_TO_WAYPOINT_FINISHED] = NAV_STATE_WAYPOINT_FINISHED,
         }
     },
@@ -511,12 +525,13 @@ static navigationFSMStateDescriptor_t navFSM[NAV_STATE_COUNT] = {
 
     [NAV_STATE_WAYPOINT_REACHED] = {
         .onEntry = navOnEnteringState_NAV_STATE_WAYPOINT_REACHED,
-        .timeoutMs = 0,
+        .timeoutMs = 10,
         .stateFlags = NAV_CTL_ALT | NAV_CTL_POS | NAV_CTL_YAW | NAV_REQUIRE_ANGLE | NAV_REQUIRE_MAGHOLD | NAV_REQUIRE_THRTILT | NAV_AUTO_WP,
         .mapToFlightModes = NAV_WP_MODE | NAV_ALTHOLD_MODE,
         .mwState = MW_NAV_STATE_PROCESS_NEXT,
         .mwError = MW_NAV_ERROR_NONE,
         .onEvent = {
+            [NAV_FSM_EVENT_TIMEOUT]                     = NAV_STATE_WAYPOINT_REACHED,       // waypoint not read yet, re-process the state
             [NAV_FSM_EVENT_SUCCESS]                     = NAV_STATE_WAYPOINT_PRE_ACTION,
             [NAV_FSM_EVENT_SWITCH_TO_WAYPOINT_FINISHED] = NAV_STATE_WAYPOINT_FINISHED,
             [NAV_FSM_EVENT_SWITCH_TO_IDLE]              = NAV_STATE_IDLE,
@@ -1005,9 +1020,16 @@ static navigationFSMEvent_t navOnEnteringState_NAV_STATE_WAYPOINT_PRE_ACTION(nav
     /* A helper function to do waypoint-specific action */
     UNUSED(previousState);
 
-    switch (posControl.waypointList[posControl.activeWaypointIndex].action) {
+    const navWaypoint_t * waypoint = getMissionWaypoint(posControl.activeWaypointIndex);
+
+    /* Dataflash busy, keep holding the last target until the waypoint can be read */
+    if (waypoint == NULL) {
+        return NAV_FSM_EVENT_NONE;      // will re-process state in >10ms
+    }
+
+    switch (waypoint->action) {
         case NAV_WP_ACTION_WAYPOINT:
-            calcualteAndSetActiveWaypoint(&posControl.waypointList[posControl.activeWaypointIndex]);
+            calcualteAndSetActiveWaypoint(waypoint);
             return NAV_FSM_EVENT_SUCCESS;       // will switch to NAV_STATE_WAYPOINT_IN_PROGRESS
 
         case NAV_WP_ACTION_RTH:
@@ -1023,7 +1045,13 @@ static navigationFSMEvent_t navOnEnteringState_NAV_STATE_WAYPOINT_IN_PROGRESS(na
 
     // If no position sensor available - land immediately
     if (posControl.flags.hasValidPositionSensor && posControl.flags.hasValidHeadingSensor) {
-        switch (posControl.waypointList[posControl.activeWaypointIndex].action) {
+        const navWaypoint_t * waypoint = getMissionWaypoint(posControl.activeWaypointIndex);
+
+        if (waypoint == NULL) {
+            return NAV_FSM_EVENT_NONE;      // will re-process state in >10ms
+        }
+
+        switch (waypoint->action) {
             case NAV_WP_ACTION_WAYPOINT:
             case NAV_WP_ACTION_RTH:
             default:
@@ -1032,6 +1060,8 @@ static navigationFSMEvent_t navOnEnteringState_NAV_STATE_WAYPOINT_IN_PROGRESS(na
                     return NAV_FSM_EVENT_SUCCESS;   // will switch to NAV_STATE_WAYPOINT_REACHED
                 }
                 else {
+                    prefetchMissionWaypoints(posControl.activeWaypointIndex);
+
                     // Update XY-position target to active waypoint
                     setDesiredPosition(&posControl.activeWaypoint.pos, 0, NAV_POS_UPDATE_XY | NAV_POS_UPDATE_BEARING);
                     return NAV_FSM_EVENT_NONE;      // will re-process state in >10ms
@@ -1052,7 +1082,13 @@ static navigationFSMEvent_t navOnEnteringState_NAV_STATE_WAYPOINT_REACHED(naviga
 {
     UNUSED(previousState);
 
-    bool isLastWaypoint = (posControl.waypointList[posControl.activeWaypointIndex].flag == NAV_WP_FLAG_LAST) ||
+    const navWaypoint_t * waypoint = getMissionWaypoint(posControl.activeWaypointIndex);
+
+    if (waypoint == NULL) {
+        return NAV_FSM_EVENT_NONE;      // will re-process state in >10ms
+    }
+
+    bool isLastWaypoint = (waypoint->flag == NAV_WP_FLAG_LAST) ||
                           (posControl.activeWaypointIndex >= (posControl.waypointCount - 1));
 
     if (isLastWaypoint) {
@@ -1193,8 +1229,11 @@ static void navProcessFSMEvents(navigationFSMEvent_t injectedEvent)
 
     NAV_Status.activeWpNumber = posControl.activeWaypointIndex + 1;
     NAV_Status.activeWpAction = 0;
-    if ((posControl.activeWaypointIndex >= 0) && (posControl.activeWaypointIndex < NAV_MAX_WAYPOINTS)) {
-        NAV_Status.activeWpAction = posControl.waypointList[posControl.activeWaypointIndex].action;
+    if ((posControl.activeWaypointIndex >= 0) && (posControl.activeWaypointIndex < posControl.waypointCount)) {
+        const navWaypoint_t * waypoint = getMissionWaypoint(posControl.activeWaypointIndex);
+        if (waypoint) {
+            NAV_Status.activeWpAction = waypoint->action;
+        }
     }
 }
 
@@ -1316,6 +1355,7 @@ void updateActualHorizontalPositionAndVelocity(bool hasValidSensor, float newX,
     if (hasValidSensor) {
         posControl.flags.horizontalPositionNewData = 1;
         posControl.lastValidPositionTimeMs = millis();
+        signalTask(TASK_NAV);
     }
     else {
         posControl.flags.horizontalPositionNewData = 0;
@@ -1344,6 +1384,7 @@ void updateActualAltitudeAndClimbRate(bool hasValidSensor, float newAltitude, fl
         updateDesiredRTHAltitude();
         posControl.flags.verticalPositionNewData = 1;
         posControl.lastValidAltitudeTimeMs = millis();
+        signalTask(TASK_NAV);
     }
     else {
         posControl.flags.verticalPositionNewData = 0;
@@ -1400,8 +1441,7 @@ void updateActualHeading(int32_t newHeading)
     posControl.actualState.yaw = newHeading;
 
     /* Precompute sin/cos of yaw angle */
-    posControl.actualState.sinYaw = sin_approx(CENTIDEGREES_TO_RADIANS(newHeading));
-    posControl.actualState.cosYaw = cos_approx(CENTIDEGREES_TO_RADIANS(newHeading));
+    sincos_approx(CENTIDEGREES_TO_RADIANS(newHeading), &posControl.actualState.sinYaw, &posControl.actualState.cosYaw);
 
     posControl.flags.headingNewData = 1;
 }
@@ -1596,8 +1636,11 @@ void setDesiredPosition(t_fp_vector * pos, int32_t yaw, navSetWaypointFlags_t us
 
 void calculateFarAwayTarget(t_fp_vector * farAwayPos, int32_t yaw, int32_t distance)
 {
-    farAwayPos->V.X = posControl.actualState.pos.V.X + distance * cos_approx(CENTIDEGREES_TO_RADIANS(yaw));
-    farAwayPos->V.Y = posControl.actualState.pos.V.Y + distance * sin_approx(CENTIDEGREES_TO_RADIANS(yaw));
+    float sinYaw, cosYaw;
+    sincos_approx(CENTIDEGREES_TO_RADIANS(yaw), &sinYaw, &cosYaw);
+
+    farAwayPos->V.X = posControl.actualState.pos.V.X + distance * cosYaw;
+    farAwayPos->V.Y = posControl.actualState.pos.V.Y + distance * sinYaw;
     farAwayPos->V.Z = posControl.actualState.pos.V.Z;
 }
 
@@ -1770,11 +1813,9 @@ void getWaypoint(uint8_t wpNumber, navWaypoint_t * wpData)
         wpData->lon = wpLLH.lon;
         wpData->alt = wpLLH.alt;
     }
-    // WP #1 - #15 - common waypoints - pre-programmed mission
-    else if ((wpNumber >= 1) && (wpNumber <= NAV_MAX_WAYPOINTS)) {
-        if (wpNumber <= posControl.waypointCount) {
-            *wpData = posControl.waypointList[wpNumber - 1];
-        }
+    // WP #1 - #254 - common waypoints - pre-programmed mission
+    else {
+        readMissionWaypoint(wpNumber - 1, wpData);
     }
 }
 
@@ -1815,16 +1856,10 @@ void setWaypoint(uint8_t wpNumber, navWaypoint_t * wpData)
 
         setDesiredPosition(&wpPos.pos, DEGREES_TO_DECIDEGREES(wpData->p1), waypointUpdateFlags);
     }
-    // WP #1 - #15 - common waypoints - pre-programmed mission
-    else if ((wpNumber >= 1) && (wpNumber <= NAV_MAX_WAYPOINTS) && !ARMING_FLAG(ARMED)) {
-        if (wpData->action == NAV_WP_ACTION_WAYPOINT || wpData->action == NAV_WP_ACTION_RTH) {
-            // Only allow upload next waypoint (continue upload mission) or first waypoint (new mission)
-            if (wpNumber == (posControl.waypointCount + 1) || wpNumber == 1) {
-                posControl.waypointList[wpNumber - 1] = *wpData;
-                posControl.waypointCount = wpNumber;
-                posControl.waypointListValid = (wpData->flag == NAV_WP_FLAG_LAST);
-            }
-        }
+    // WP #1 - #254 - common waypoints - pre-programmed mission, longer missions are uploaded with setWaypointRecords()
+    else if ((wpNumber >= 1) && (wpNumber < 255) && !ARMING_FLAG(ARMED)) {
+        // Only allow upload next waypoint (continue upload mission) or first waypoint (new mission)
+        appendMissionWaypoint(wpNumber - 1, wpData);
     }
 }
 
@@ -1832,8 +1867,7 @@ void resetWaypointList(void)
 {
     /* Can only reset waypoint list if not armed */
     if (!ARMING_FLAG(ARMED)) {
-        posControl.waypointCount = 0;
-        posControl.waypointListValid = false;
+        resetMission();
     }
 }
 
@@ -1848,7 +1882,7 @@ static void calcualteAndSetActiveWaypointToLocalPosition(t_fp_vector * pos)
     setDesiredPosition(&posControl.activeWaypoint.pos, posControl.activeWaypoint.yaw, NAV_POS_UPDATE_XY | NAV_POS_UPDATE_Z | NAV_POS_UPDATE_HEADING);
 }
 
-static void calcualteAndSetActiveWaypoint(navWaypoint_t * waypoint)
+static void calcualteAndSetActiveWaypoint(const navWaypoint_t * waypoint)
 {
     gpsLocation_t wpLLH;
     t_fp_vector localPos;
@@ -1868,12 +1902,14 @@ static void calcualteAndSetActiveWaypoint(navWaypoint_t * waypoint)
 bool isApproachingLastWaypoint(void)
 {
     if (navGetStateFlags(posControl.navState) & NAV_AUTO_WP) {
+        const navWaypoint_t * waypoint = getMissionWaypoint(posControl.activeWaypointIndex);
+
         if (posControl.waypointCount == 0) {
             /* No waypoints */
             return true;
         }
         else if ((posControl.activeWaypointIndex == (posControl.waypointCount - 1)) ||
-                 (posControl.waypointList[posControl.activeWaypointIndex].flag == NAV_WP_FLAG_LAST)) {
+                 (waypoint != NULL && waypoint->flag == NAV_WP_FLAG_LAST)) {
             return true;
         }
         else {
@@ -1894,8 +1930,10 @@ float getActiveWaypointSpeed(void)
     uint16_t waypointSpeed = posControl.navConfig->max_speed;
 
     if (navGetStateFlags(posControl.navState) & NAV_AUTO_WP) {
-        if (posControl.waypointCount > 0 && posControl.waypointList[posControl.activeWaypointIndex].action == NAV_WP_ACTION_WAYPOINT) {
-            waypointSpeed = posControl.waypointList[posControl.activeWaypointIndex].p1;
+        const navWaypoint_t * waypoint = getMissionWaypoint(posControl.activeWaypointIndex);
+
+        if (posControl.waypointCount > 0 && waypoint != NULL && waypoint->action == NAV_WP_ACTION_WAYPOINT) {
+            waypointSpeed = waypoint->p1;
 
             if (waypointSpeed < 50 || waypointSpeed > posControl.navConfig->max_speed) {
                 waypointSpeed = posControl.navConfig->max_speed;
@@ -1946,7 +1984,47 @@ static void processNavigationRCAdjustments(void)
 }
 
 /*-----------------------------------------------------------
- * A main function to call position controllers at loop rate
+ * Controller output handed over to the PID loop
+ *-----------------------------------------------------------*/
+void setNavigationRcCommand(uint8_t channel, int16_t value)
+{
+    navSetpoint_t * setpoint = &navSetpoint[navSetpointActive ^ 1];
+
+    setpoint->rcCommand[channel] = value;
+    setpoint->rcCommandMask |= (1 << channel);
+}
+
+static void beginNavigationSetpoint(void)
+{
+    navSetpoint[navSetpointActive ^ 1].rcCommandMask = 0;
+}
+
+static void publishNavigationSetpoint(void)
+{
+    navSetpointActive ^= 1;
+}
+
+/*-----------------------------------------------------------
+ * Called from the PID loop, overrides pilot's rcCommand with the latest setpoint
+ *-----------------------------------------------------------*/
+void applyNavigationSetpoint(void)
+{
+    // Controllers may have been switched off since the setpoint was published
+    if (!ARMING_FLAG(ARMED) || !(navGetCurrentStateFlags() & (NAV_CTL_ALT | NAV_CTL_POS | NAV_CTL_YAW | NAV_CTL_EMERG))) {
+        return;
+    }
+
+    const navSetpoint_t * setpoint = &navSetpoint[navSetpointActive];
+
+    for (int channel = 0; channel < 4; channel++) {
+        if (setpoint->rcCommandMask & (1 << channel)) {
+            rcCommand[channel] = setpoint->rcCommand[channel];
+        }
+    }
+}
+
+/*-----------------------------------------------------------
+ * A main function to call position controllers, runs in TASK_NAV
  *-----------------------------------------------------------*/
 void applyWaypointNavigationAndAltitudeHold(void)
 {
@@ -1963,10 +2041,13 @@ void applyWaypointNavigationAndAltitudeHold(void)
 #endif
 #endif
 
+    beginNavigationSetpoint();
+
     // No navigation when disarmed
     if (!ARMING_FLAG(ARMED)) {
         // If we are disarmed, abort forced RTH
         posControl.flags.forcedRTHActivated = false;
+        publishNavigationSetpoint();
         return;
     }
 
@@ -1979,6 +2060,8 @@ void applyWaypointNavigationAndAltitudeHold(void)
         applyMulticopterNavigationController(navStateFlags, currentTime);
     }
 
+    publishNavigationSetpoint();
+
 #if defined(NAV_BLACKBOX)
     if (posControl.flags.isAdjustingPosition)       navFlags |= (1 << 5);
     if (posControl.flags.isAdjustingAltitude)       navFlags |= (1 << 6);
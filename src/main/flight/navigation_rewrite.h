@@ -41,7 +41,16 @@ void onNewGPSData(void);
 #define NAV_BLACKBOX
 #endif
 
-#define NAV_MAX_WAYPOINTS           15
+#define NAV_MAX_RAM_WAYPOINTS       15      // mission kept in RAM when there is no flash to store it
+
+#if defined(USE_NAV_MISSION_STORE)
+#define NAV_MAX_WAYPOINTS           600     // kept in flash, only a window ahead of the active waypoint is in RAM
+#else
+#define NAV_MAX_WAYPOINTS           NAV_MAX_RAM_WAYPOINTS
+#endif
+
+#define NAV_WAYPOINT_RECORD_SIZE    20      // packed waypoint in flash and in bulk transfers: action, lat, lon, alt, p1, p2, p3, flag
+#define NAV_MAX_WAYPOINT_BATCH      12      // most waypoints setWaypointRecords() takes at once
 
 enum {
     NAV_GPS_ATTI    = 0,                    // Pitch/roll stick controls attitude (pitch/roll lean angles)
@@ -62,6 +71,11 @@ enum {
     NAV_HEADING_CONTROL_MANUAL
 };
 
+typedef enum {
+    NAV_POS_ESTIMATOR_COMPLEMENTARY = 0,
+    NAV_POS_ESTIMATOR_EKF,                  // needs USE_NAV_EKF, complementary filter is used otherwise
+} navPosEstimator_e;
+
 typedef struct navConfig_s {
     struct {
         uint8_t use_thr_mid_for_althold;    // Don't remember throttle when althold was initiated, assume that throttle is at Thr Mid = zero climb rate
@@ -79,7 +93,9 @@ typedef struct navConfig_s {
         uint8_t gps_min_sats;
         uint8_t accz_unarmed_cal;
         uint8_t use_gps_velned;
-        uint16_t gps_delay_ms;
+        uint16_t gps_delay_ms;  // Age of a GPS solution when its first byte is sent, transfer time is measured
+        uint8_t estimator;  // see navPosEstimator_e
+        uint16_t update_rate_hz;    // Rate of the position estimator task
 
         float w_z_baro_p;   // Weight (cutoff frequency) for barometer altitude measurements
 
@@ -101,6 +117,7 @@ typedef struct navConfig_s {
         float baro_epv;     // Baro position error
     } inav;
 
+    uint16_t update_rate_hz;                // Rate of the navigation controller task, new position estimates also run it
     uint8_t  pos_failure_timeout;           // Time to wait before switching to emergency landing (0 - disable)
     uint16_t waypoint_radius;               // if we are within this distance to a waypoint then we consider it reached (distance is in cm)
     uint16_t max_speed;                     // autonomous navigation speed cm/sec
@@ -230,8 +247,10 @@ void navigationInit(navConfig_t *initialnavConfig,
 void updateWaypointsAndNavigationMode(void);
 void updatePositionEstimator_BaroTopic(uint32_t currentTime);
 void updatePositionEstimator_SonarTopic(uint32_t currentTime);
+void initializePositionEstimator(void);
 void updatePositionEstimator(void);
 void applyWaypointNavigationAndAltitudeHold(void);
+void applyNavigationSetpoint(void);
 
 /* Functions to signal navigation requirements to main loop */
 bool naivationRequiresAngleMode(void);
@@ -248,6 +267,16 @@ float getEstimatedActualPosition(int axis);
 void getWaypoint(uint8_t wpNumber, navWaypoint_t * wpData);
 void setWaypoint(uint8_t wpNumber, navWaypoint_t * wpData);
 void resetWaypointList(void);
+void loadWaypointList(void);
+
+/* Bulk mission transfer, waypoints are numbered from 0 and packed in NAV_WAYPOINT_RECORD_SIZE records */
+uint16_t getWaypointCount(void);
+bool isWaypointListValid(void);
+bool isWaypointStoreBusy(void);
+void getWaypointRecords(uint16_t startIndex, uint8_t count, uint8_t * records);
+bool setWaypointRecords(uint16_t startIndex, uint8_t count, const uint8_t * records);
+bool finishWaypointUpload(uint16_t count, uint32_t crc);
+void updateWaypointStore(void);
 
 /* Geodetic functions */
 typedef enum {
@@ -47,6 +47,7 @@
 
 static bool isPitchAndThrottleAdjustmentValid = false;
 static bool isRollAdjustmentValid = false;
+static int16_t rcRollAdjustment = 0;     // pilot's roll while adjusting position, rcCommand holds NAV output when controllers run
 
 /*-----------------------------------------------------------
  * Altitude controller
@@ -200,9 +201,11 @@ static void calculateVirtualPositionTarget_FW(float trackingPeriod)
     if (needToCalculateCircularLoiter) {
         // We are closing in on a waypoint, calculate circular loiter
         float loiterAngle = atan2_approx(-posErrorY, -posErrorX) + DEGREES_TO_RADIANS(45.0f);
+        float sinLoiterAngle, cosLoiterAngle;
+        sincos_approx(loiterAngle, &sinLoiterAngle, &cosLoiterAngle);
 
-        float loiterTargetX = posControl.desiredState.pos.V.X + posControl.navConfig->fw_loiter_radius * cos_approx(loiterAngle);
-        float loiterTargetY = posControl.desiredState.pos.V.Y + posControl.navConfig->fw_loiter_radius * sin_approx(loiterAngle);
+        float loiterTargetX = posControl.desiredState.pos.V.X + posControl.navConfig->fw_loiter_radius * cosLoiterAngle;
+        float loiterTargetY = posControl.desiredState.pos.V.Y + posControl.navConfig->fw_loiter_radius * sinLoiterAngle;
 
         // We have temporary loiter target. Recalculate distance and position error
         posErrorX = loiterTargetX - posControl.actualState.pos.V.X;
@@ -216,8 +219,6 @@ static void calculateVirtualPositionTarget_FW(float trackingPeriod)
 
     // Shift position according to pilot's ROLL input (up to max_manual_speed velocity)
     if (posControl.flags.isAdjustingPosition) {
-        int16_t rcRollAdjustment = applyDeadband(rcCommand[ROLL], posControl.rcControlsConfig->pos_hold_deadband);
-
         if (rcRollAdjustment) {
             float rcShiftY = rcRollAdjustment * posControl.navConfig->max_manual_speed / 500.0f * trackingPeriod;
 
@@ -232,7 +233,7 @@ static void calculateVirtualPositionTarget_FW(float trackingPeriod)
 
 bool adjustFixedWingPositionFromRCInput(void)
 {
-    int16_t rcRollAdjustment = applyDeadband(rcCommand[ROLL], posControl.rcControlsConfig->pos_hold_deadband);
+    rcRollAdjustment = applyDeadband(rcCommand[ROLL], posControl.rcControlsConfig->pos_hold_deadband);
     return (rcRollAdjustment);
 }
 
@@ -335,13 +336,13 @@ void applyFixedWingPitchRollThrottleController(void)
     if (isPitchAndThrottleAdjustmentValid) {
         // PITCH angle is measured in opposite direction ( >0 - dive, <0 - climb)
         pitchCorrection = constrain(pitchCorrection, -DEGREES_TO_CENTIDEGREES(posControl.navConfig->fw_max_dive_angle), DEGREES_TO_CENTIDEGREES(posControl.navConfig->fw_max_climb_angle));
-        rcCommand[PITCH] = -pidAngleToRcCommand(pitchCorrection);
-        rcCommand[THROTTLE] = constrain(throttleCorrection, posControl.escAndServoConfig->minthrottle, posControl.escAndServoConfig->maxthrottle);
+        setNavigationRcCommand(PITCH, -pidAngleToRcCommand(pitchCorrection));
+        setNavigationRcCommand(THROTTLE, constrain(throttleCorrection, posControl.escAndServoConfig->minthrottle, posControl.escAndServoConfig->maxthrottle));
     }
 
     if (isRollAdjustmentValid) {
         rollCorrection = constrain(rollCorrection, -DEGREES_TO_CENTIDEGREES(posControl.navConfig->fw_max_bank_angle), DEGREES_TO_CENTIDEGREES(posControl.navConfig->fw_max_bank_angle));
-        rcCommand[ROLL] = pidAngleToRcCommand(rollCorrection);
+        setNavigationRcCommand(ROLL, pidAngleToRcCommand(rollCorrection));
     }
 }
 
@@ -0,0 +1,633 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Waypoint mission storage.
+ *
+ * The mission is kept as packed NAV_WAYPOINT_RECORD_SIZE records behind a header with the waypoint count and a CRC32
+ * of all records. With USE_NAV_MISSION_STORE it lives in the sectors reserved at the end of the dataflash, or in the
+ * MCU flash pages below the config on targets built with USE_NAV_MISSION_CONFIG_FLASH, and survives a reboot. Only a
+ * small window of waypoints starting at the active one is held in RAM. Without a flash store a short mission is kept
+ * in RAM.
+ *
+ * The storage is erased when an upload starts, records are programmed as they arrive and the header is written last,
+ * so an interrupted upload leaves no valid mission behind. The dataflash is erased in the background, the first
+ * waypoints of the upload are held in RAM meanwhile and programmed by updateWaypointStore().
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "build_config.h"
+#include "platform.h"
+
+#include "common/axis.h"
+#include "common/maths.h"
+
+#include "drivers/system.h"
+#include "drivers/sensor.h"
+#include "drivers/accgyro.h"
+
+#include "io/flashfs.h"
+
+#include "rx/rx.h"
+
+#include "sensors/sensors.h"
+#include "sensors/acceleration.h"
+#include "sensors/boardalignment.h"
+
+#include "flight/pid.h"
+#include "flight/imu.h"
+#include "flight/navigation_rewrite.h"
+#include "flight/navigation_rewrite_private.h"
+
+#include "config/runtime_config.h"
+#include "config/config.h"
+
+#if defined(NAV)
+
+#if defined(USE_NAV_MISSION_STORE) && defined(USE_NAV_MISSION_CONFIG_FLASH)
+#include "config/config_eeprom.h"
+#endif
+
+#define NAV_MISSION_MAGIC               0x4E4D5331  // "NMS1"
+
+#if defined(USE_NAV_MISSION_STORE) && defined(USE_FLASHFS)
+#define NAV_MISSION_PENDING_WAYPOINTS   NAV_MAX_WAYPOINT_BATCH
+#else
+#define NAV_MISSION_PENDING_WAYPOINTS   1           // only the dataflash is erased in the background
+#endif
+
+#if defined(USE_NAV_MISSION_STORE)
+#define NAV_MISSION_WINDOW_SIZE         8
+#else
+#define NAV_MISSION_WINDOW_SIZE         2
+#endif
+
+typedef struct navMissionHeader_s {
+    uint32_t magic;
+    uint16_t waypointCount;
+    uint16_t recordSize;
+    uint32_t crc;                   // CRC32 of all packed waypoints
+} navMissionHeader_t;
+
+#define NAV_MISSION_STORAGE_SIZE(waypoints) (sizeof(navMissionHeader_t) + (waypoints) * NAV_WAYPOINT_RECORD_SIZE)
+#define NAV_MISSION_RECORD_OFFSET(index) (sizeof(navMissionHeader_t) + (uint32_t)(index) * NAV_WAYPOINT_RECORD_SIZE)
+
+typedef enum {
+    MISSION_STORAGE_NONE,
+    MISSION_STORAGE_RAM,
+    MISSION_STORAGE_DATAFLASH,
+    MISSION_STORAGE_CONFIG_FLASH
+} missionStorage_e;
+
+static missionStorage_e missionStorage = MISSION_STORAGE_NONE;
+static uint16_t missionCapacity;        // waypoints
+
+// Also used by store builds when neither the dataflash nor the MCU flash can hold the mission
+static uint8_t missionRamStorage[NAV_MISSION_STORAGE_SIZE(NAV_MAX_RAM_WAYPOINTS)];
+
+// First waypoints of an upload, waiting for the storage erase to finish
+static uint8_t pendingRecords[NAV_MISSION_PENDING_WAYPOINTS * NAV_WAYPOINT_RECORD_SIZE];
+static uint8_t pendingRecordCount;
+static bool pendingCommit;              // a single waypoint upload finished while its waypoints were pending
+
+static navWaypoint_t waypointWindow[NAV_MISSION_WINDOW_SIZE];
+static int16_t waypointWindowStart;
+static uint8_t waypointWindowCount;
+
+// Flown instead of a waypoint which can't be read back from the storage, takes the craft home
+static const navWaypoint_t missionReadFailedWaypoint = { .action = NAV_WP_ACTION_RTH, .flag = NAV_WP_FLAG_LAST };
+
+/*-----------------------------------------------------------
+ * Storage backends
+ *-----------------------------------------------------------*/
+static void selectMissionStorage(void)
+{
+#if defined(USE_NAV_MISSION_STORE)
+    BUILD_BUG_ON(NAV_MISSION_STORAGE_SIZE(NAV_MAX_WAYPOINTS) > NAV_MISSION_STORE_SIZE);
+
+#if defined(USE_FLASHFS)
+    if (flashfsGetReservedSize() >= NAV_MISSION_STORE_SIZE) {
+        missionStorage = MISSION_STORAGE_DATAFLASH;
+        missionCapacity = NAV_MAX_WAYPOINTS;
+        return;
+    }
+#endif
+
+#if defined(USE_NAV_MISSION_CONFIG_FLASH)
+    BUILD_BUG_ON(NAV_MISSION_STORE_SIZE % FLASH_PAGE_SIZE != 0);
+
+    missionStorage = MISSION_STORAGE_CONFIG_FLASH;
+    missionCapacity = NAV_MAX_WAYPOINTS;
+    return;
+#endif
+#endif
+
+    missionStorage = MISSION_STORAGE_RAM;
+    missionCapacity = NAV_MAX_RAM_WAYPOINTS;
+}
+
+#if defined(USE_NAV_MISSION_CONFIG_FLASH)
+static void unlockConfigFlash(void)
+{
+    FLASH_Unlock();
+#ifdef STM32F303
+    FLASH_ClearFlag(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+#endif
+#ifdef STM32F10X
+    FLASH_ClearFlag(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPRTERR);
+#endif
+}
+#endif
+
+static bool eraseMissionStorage(void)
+{
+    switch (missionStorage) {
+    case MISSION_STORAGE_RAM:
+        memset(missionRamStorage, 0xFF, sizeof(missionRamStorage));
+        return true;
+
+#if defined(USE_NAV_MISSION_STORE) && defined(USE_FLASHFS)
+    case MISSION_STORAGE_DATAFLASH:
+        // Takes up to a few seconds, completes in the background
+        flashfsEraseReserved();
+        return true;
+#endif
+
+#if defined(USE_NAV_MISSION_CONFIG_FLASH)
+    case MISSION_STORAGE_CONFIG_FLASH:
+        {
+            FLASH_Status status = FLASH_COMPLETE;
+
+            // Erasing stalls the CPU for a while, like saving the config
+            suspendRxSignal();
+            unlockConfigFlash();
+            for (uint32_t offset = 0; offset < NAV_MISSION_STORE_SIZE && status == FLASH_COMPLETE; offset += FLASH_PAGE_SIZE) {
+                status = FLASH_ErasePage(NAV_MISSION_START_FLASH_ADDRESS + offset);
+            }
+            FLASH_Lock();
+            resumeRxSignal();
+
+            return status == FLASH_COMPLETE;
+        }
+#endif
+
+    default:
+        return false;
+    }
+}
+
+/* offset and length are multiples of 4, records and the header are whole words */
+static bool writeMissionStorage(uint32_t offset, const uint8_t * data, uint32_t length)
+{
+    switch (missionStorage) {
+    case MISSION_STORAGE_RAM:
+        memcpy(&missionRamStorage[offset], data, length);
+        return true;
+
+#if defined(USE_NAV_MISSION_STORE) && defined(USE_FLASHFS)
+    case MISSION_STORAGE_DATAFLASH:
+        return flashfsWriteReserved(offset, data, length) == (int)length;
+#endif
+
+#if defined(USE_NAV_MISSION_CONFIG_FLASH)
+    case MISSION_STORAGE_CONFIG_FLASH:
+        {
+            FLASH_Status status = FLASH_COMPLETE;
+
+            unlockConfigFlash();
+            for (uint32_t i = 0; i < length && status == FLASH_COMPLETE; i += 4) {
+                uint32_t word;
+                memcpy(&word, &data[i], sizeof(word));
+                status = FLASH_ProgramWord(NAV_MISSION_START_FLASH_ADDRESS + offset + i, word);
+            }
+            FLASH_Lock();
+
+            return status == FLASH_COMPLETE;
+        }
+#endif
+
+    default:
+        return false;
+    }
+}
+
+static bool readMissionStorage(uint32_t offset, uint8_t * data, uint32_t length)
+{
+    switch (missionStorage) {
+    case MISSION_STORAGE_RAM:
+        memcpy(data, &missionRamStorage[offset], length);
+        return true;
+
+#if defined(USE_NAV_MISSION_STORE) && defined(USE_FLASHFS)
+    case MISSION_STORAGE_DATAFLASH:
+        // Goes through flashfs so a blackbox page program is finished first
+        return flashfsReadReserved(offset, data, length) == (int)length;
+#endif
+
+#if defined(USE_NAV_MISSION_CONFIG_FLASH)
+    case MISSION_STORAGE_CONFIG_FLASH:
+        memcpy(data, (const uint8_t *)(NAV_MISSION_START_FLASH_ADDRESS + offset), length);
+        return true;
+#endif
+
+    default:
+        return false;
+    }
+}
+
+static bool isMissionStorageReady(void)
+{
+#if defined(USE_NAV_MISSION_STORE) && defined(USE_FLASHFS)
+    // The dataflash is shared with the blackbox, which may be writing or erasing it
+    if (missionStorage == MISSION_STORAGE_DATAFLASH) {
+        return flashfsIsReady();
+    }
+#endif
+
+    return true;
+}
+
+/* True while the storage is erased or the first waypoints of an upload are still waiting to be programmed */
+bool isWaypointStoreBusy(void)
+{
+    return (pendingRecordCount > 0) || !isMissionStorageReady();
+}
+
+/*-----------------------------------------------------------
+ * Packed waypoint records, little endian
+ *-----------------------------------------------------------*/
+static void packUint16(uint8_t * buffer, uint16_t value)
+{
+    buffer[0] = value;
+    buffer[1] = value >> 8;
+}
+
+static void packUint32(uint8_t * buffer, uint32_t value)
+{
+    packUint16(&buffer[0], value);
+    packUint16(&buffer[2], value >> 16);
+}
+
+static uint16_t unpackUint16(const uint8_t * buffer)
+{
+    return buffer[0] | (buffer[1] << 8);
+}
+
+static uint32_t unpackUint32(const uint8_t * buffer)
+{
+    return unpackUint16(&buffer[0]) | ((uint32_t)unpackUint16(&buffer[2]) << 16);
+}
+
+static void packWaypoint(const navWaypoint_t * waypoint, uint8_t * record)
+{
+    record[0] = waypoint->action;
+    packUint32(&record[1], waypoint->lat);
+    packUint32(&record[5], waypoint->lon);
+    packUint32(&record[9], waypoint->alt);
+    packUint16(&record[13], waypoint->p1);
+    packUint16(&record[15], waypoint->p2);
+    packUint16(&record[17], waypoint->p3);
+    record[19] = waypoint->flag;
+}
+
+static void unpackWaypoint(const uint8_t * record, navWaypoint_t * waypoint)
+{
+    waypoint->action = record[0];
+    waypoint->lat = unpackUint32(&record[1]);
+    waypoint->lon = unpackUint32(&record[5]);
+    waypoint->alt = unpackUint32(&record[9]);
+    waypoint->p1 = unpackUint16(&record[13]);
+    waypoint->p2 = unpackUint16(&record[15]);
+    waypoint->p3 = unpackUint16(&record[17]);
+    waypoint->flag = record[19];
+}
+
+/* CRC-32 as used by zlib, bitwise to keep the table out of flash */
+static uint32_t crc32Update(uint32_t crc, const uint8_t * data, uint32_t length)
+{
+    while (length--) {
+        crc ^= *data++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+
+    return crc;
+}
+
+static bool calculateMissionCrc(uint16_t waypointCount, uint32_t * crc)
+{
+    uint8_t record[NAV_WAYPOINT_RECORD_SIZE];
+    uint32_t value = 0xFFFFFFFF;
+
+    for (int i = 0; i < waypointCount; i++) {
+        if (!readMissionStorage(NAV_MISSION_RECORD_OFFSET(i), record, sizeof(record))) {
+            return false;
+        }
+        value = crc32Update(value, record, sizeof(record));
+    }
+
+    *crc = ~value;
+    return true;
+}
+
+/*-----------------------------------------------------------
+ * Waypoint window
+ *-----------------------------------------------------------*/
+static bool readWaypointFromStorage(int16_t index, navWaypoint_t * waypoint)
+{
+    uint8_t record[NAV_WAYPOINT_RECORD_SIZE];
+
+    if (!readMissionStorage(NAV_MISSION_RECORD_OFFSET(index), record, sizeof(record))) {
+        return false;
+    }
+
+    unpackWaypoint(record, waypoint);
+    return true;
+}
+
+static bool isInWaypointWindow(int16_t index)
+{
+    return (index >= waypointWindowStart) && (index < waypointWindowStart + waypointWindowCount);
+}
+
+static void loadWaypointWindow(int16_t startIndex)
+{
+    waypointWindowStart = startIndex;
+    waypointWindowCount = 0;
+
+    while ((waypointWindowCount < NAV_MISSION_WINDOW_SIZE) && (startIndex + waypointWindowCount < posControl.waypointCount)) {
+        if (!readWaypointFromStorage(startIndex + waypointWindowCount, &waypointWindow[waypointWindowCount])) {
+            break;
+        }
+        waypointWindowCount++;
+    }
+}
+
+/*
+ * Called from the PID loop, so a waypoint outside the window is only read while the flash is idle. NULL while the
+ * blackbox keeps it busy, the caller holds its current target and asks again.
+ */
+const navWaypoint_t * getMissionWaypoint(int16_t index)
+{
+    if (!isInWaypointWindow(index)) {
+        if (!isMissionStorageReady()) {
+            return NULL;
+        }
+        loadWaypointWindow(index);
+    }
+
+    if (!isInWaypointWindow(index)) {
+        return &missionReadFailedWaypoint;
+    }
+
+    return &waypointWindow[index - waypointWindowStart];
+}
+
+/*
+ * Reads ahead while the leg to the active waypoint is flown, so that reaching it never waits for the flash.
+ * Waits for a later call while the flash is busy.
+ */
+void prefetchMissionWaypoints(int16_t index)
+{
+    if ((index + 1 < posControl.waypointCount) && !isInWaypointWindow(index + 1) && isMissionStorageReady()) {
+        loadWaypointWindow(index);
+    }
+}
+
+/* Doesn't move the window, mission downloads must not evict the waypoints being flown */
+bool readMissionWaypoint(int16_t index, navWaypoint_t * waypoint)
+{
+    if ((index < 0) || (index >= posControl.waypointCount)) {
+        return false;
+    }
+
+    if (isInWaypointWindow(index)) {
+        *waypoint = waypointWindow[index - waypointWindowStart];
+        return true;
+    }
+
+    return readWaypointFromStorage(index, waypoint);
+}
+
+void resetMission(void)
+{
+    posControl.waypointCount = 0;
+    posControl.waypointListValid = false;
+    waypointWindowCount = 0;
+    pendingRecordCount = 0;
+    pendingCommit = false;
+}
+
+/*-----------------------------------------------------------
+ * Upload
+ *-----------------------------------------------------------*/
+static bool commitMission(uint16_t waypointCount, uint32_t crc)
+{
+    const navMissionHeader_t header = {
+        .magic = NAV_MISSION_MAGIC,
+        .waypointCount = waypointCount,
+        .recordSize = NAV_WAYPOINT_RECORD_SIZE,
+        .crc = crc
+    };
+
+    if (!writeMissionStorage(0, (const uint8_t *)&header, sizeof(header))) {
+        return false;
+    }
+
+    posControl.waypointListValid = true;
+    return true;
+}
+
+/**
+ * Programs waypoints right behind the ones already uploaded, startIndex 0 starts a new mission.
+ * The mission becomes valid once finishWaypointUpload() has checked its CRC.
+ */
+bool setWaypointRecords(uint16_t startIndex, uint8_t count, const uint8_t * records)
+{
+    if (ARMING_FLAG(ARMED) || (missionStorage == MISSION_STORAGE_NONE) || (count == 0) || (count > NAV_MAX_WAYPOINT_BATCH)) {
+        return false;
+    }
+
+    // Callers wait for the store, the MSP commands are postponed while it's busy
+    if (isWaypointStoreBusy()) {
+        return false;
+    }
+
+    if ((startIndex != 0) && ((startIndex != posControl.waypointCount) || posControl.waypointListValid)) {
+        return false;
+    }
+
+    if (startIndex + count > missionCapacity) {
+        return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const uint8_t action = records[i * NAV_WAYPOINT_RECORD_SIZE];
+        if ((action != NAV_WP_ACTION_WAYPOINT) && (action != NAV_WP_ACTION_RTH)) {
+            return false;
+        }
+    }
+
+    if (startIndex == 0) {
+        resetMission();
+        if (!eraseMissionStorage()) {
+            return false;
+        }
+    }
+
+    if (!isMissionStorageReady()) {
+        if (count > NAV_MISSION_PENDING_WAYPOINTS) {
+            resetMission();
+            return false;
+        }
+        memcpy(pendingRecords, records, count * NAV_WAYPOINT_RECORD_SIZE);
+        pendingRecordCount = count;
+    }
+    else if (!writeMissionStorage(NAV_MISSION_RECORD_OFFSET(startIndex), records, count * NAV_WAYPOINT_RECORD_SIZE)) {
+        // Partially programmed, the upload has to start over
+        resetMission();
+        return false;
+    }
+
+    posControl.waypointCount = startIndex + count;
+    return true;
+}
+
+/* crc is the CRC32 of all packed waypoints as sent, it is checked against what was read back from the storage */
+bool finishWaypointUpload(uint16_t count, uint32_t crc)
+{
+    uint32_t storedCrc;
+
+    if (ARMING_FLAG(ARMED) || posControl.waypointListValid || (count == 0) || (count != posControl.waypointCount) || isWaypointStoreBusy()) {
+        return false;
+    }
+
+    if (!calculateMissionCrc(count, &storedCrc) || (storedCrc != crc)) {
+        return false;
+    }
+
+    return commitMission(count, crc);
+}
+
+/* One waypoint at a time, a waypoint flagged NAV_WP_FLAG_LAST finishes the upload */
+bool appendMissionWaypoint(int16_t index, const navWaypoint_t * waypoint)
+{
+    uint8_t record[NAV_WAYPOINT_RECORD_SIZE];
+    uint32_t crc;
+
+    packWaypoint(waypoint, record);
+
+    if (!setWaypointRecords(index, 1, record)) {
+        return false;
+    }
+
+    if (waypoint->flag == NAV_WP_FLAG_LAST) {
+        if (pendingRecordCount > 0) {
+            pendingCommit = true;
+            return true;
+        }
+
+        return calculateMissionCrc(posControl.waypointCount, &crc) && commitMission(posControl.waypointCount, crc);
+    }
+
+    return true;
+}
+
+/* Programs the waypoints held back by setWaypointRecords() once the storage erase has finished */
+void updateWaypointStore(void)
+{
+    uint32_t crc;
+
+    if ((pendingRecordCount == 0) || !isMissionStorageReady()) {
+        return;
+    }
+
+    const bool written = writeMissionStorage(NAV_MISSION_RECORD_OFFSET(0), pendingRecords, pendingRecordCount * NAV_WAYPOINT_RECORD_SIZE);
+    const bool commit = pendingCommit;
+
+    pendingRecordCount = 0;
+    pendingCommit = false;
+
+    if (!written) {
+        resetMission();
+    }
+    else if (commit) {
+        if (!calculateMissionCrc(posControl.waypointCount, &crc) || !commitMission(posControl.waypointCount, crc)) {
+            resetMission();
+        }
+    }
+}
+
+/*-----------------------------------------------------------
+ * Access for MSP and init
+ *-----------------------------------------------------------*/
+uint16_t getWaypointCount(void)
+{
+    return posControl.waypointCount;
+}
+
+bool isWaypointListValid(void)
+{
+    return posControl.waypointListValid;
+}
+
+/* Waypoints which can't be read are returned as zeroes */
+void getWaypointRecords(uint16_t startIndex, uint8_t count, uint8_t * records)
+{
+    navWaypoint_t waypoint;
+
+    for (int i = 0; i < count; i++) {
+        if (readMissionWaypoint(startIndex + i, &waypoint)) {
+            packWaypoint(&waypoint, &records[i * NAV_WAYPOINT_RECORD_SIZE]);
+        }
+        else {
+            memset(&records[i * NAV_WAYPOINT_RECORD_SIZE], 0, NAV_WAYPOINT_RECORD_SIZE);
+        }
+    }
+}
+
+/* Loads the mission saved by a previous upload, call once the flash chip is initialised */
+void loadWaypointList(void)
+{
+    navMissionHeader_t header;
+    uint32_t crc;
+
+    selectMissionStorage();
+    resetMission();
+
+    if (!readMissionStorage(0, (uint8_t *)&header, sizeof(header))) {
+        return;
+    }
+
+    if ((header.magic != NAV_MISSION_MAGIC) || (header.recordSize != NAV_WAYPOINT_RECORD_SIZE) ||
+        (header.waypointCount == 0) || (header.waypointCount > missionCapacity)) {
+        return;
+    }
+
+    if (!calculateMissionCrc(header.waypointCount, &crc) || (crc != header.crc)) {
+        return;
+    }
+
+    posControl.waypointCount = header.waypointCount;
+    posControl.waypointListValid = true;
+}
+
+#endif  // NAV
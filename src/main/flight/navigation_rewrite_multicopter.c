@@ -221,10 +221,8 @@ static void applyMulticopterAltitudeController(uint32_t currentTime)
     }
 
     // Update throttle controller
-    rcCommand[THROTTLE] = constrain((int16_t)posControl.navConfig->mc_hover_throttle + posControl.rcAdjustment[THROTTLE], posControl.escAndServoConfig->minthrottle, posControl.escAndServoConfig->maxthrottle);
-
-    // Save processed throttle for future use
-    rcCommandAdjustedThrottle = rcCommand[THROTTLE];
+    rcCommandAdjustedThrottle = constrain((int16_t)posControl.navConfig->mc_hover_throttle + posControl.rcAdjustment[THROTTLE], posControl.escAndServoConfig->minthrottle, posControl.escAndServoConfig->maxthrottle);
+    setNavigationRcCommand(THROTTLE, rcCommandAdjustedThrottle);
 }
 
 /*-----------------------------------------------------------
@@ -460,8 +458,8 @@ static void applyMulticopterPositionController(uint32_t currentTime)
     }
 
     if (!bypassPositionController) {
-        rcCommand[PITCH] = pidAngleToRcCommand(posControl.rcAdjustment[PITCH]);
-        rcCommand[ROLL] = pidAngleToRcCommand(posControl.rcAdjustment[ROLL]);
+        setNavigationRcCommand(PITCH, pidAngleToRcCommand(posControl.rcAdjustment[PITCH]));
+        setNavigationRcCommand(ROLL, pidAngleToRcCommand(posControl.rcAdjustment[ROLL]));
     }
 }
 
@@ -509,9 +507,9 @@ static void applyMulticopterEmergencyLandingController(uint32_t currentTime)
     previousTimeUpdate = currentTime;
 
     /* Attempt to stabilise */
-    rcCommand[ROLL] = 0;
-    rcCommand[PITCH] = 0;
-    rcCommand[YAW] = 0;
+    setNavigationRcCommand(ROLL, 0);
+    setNavigationRcCommand(PITCH, 0);
+    setNavigationRcCommand(YAW, 0);
 
     if (posControl.flags.hasValidAltitudeSensor) {
         /* We have an altitude reference, apply AH-based landing controller */
@@ -544,17 +542,17 @@ static void applyMulticopterEmergencyLandingController(uint32_t currentTime)
         }
 
         // Update throttle controller
-        rcCommand[THROTTLE] = constrain((int16_t)posControl.navConfig->mc_hover_throttle + posControl.rcAdjustment[THROTTLE], posControl.escAndServoConfig->minthrottle, posControl.escAndServoConfig->maxthrottle);
+        setNavigationRcCommand(THROTTLE, constrain((int16_t)posControl.navConfig->mc_hover_throttle + posControl.rcAdjustment[THROTTLE], posControl.escAndServoConfig->minthrottle, posControl.escAndServoConfig->maxthrottle));
     }
     else {
         /* Sensors has gone haywire, attempt to land regardless */
         failsafeConfig_t * failsafeConfig = getActiveFailsafeConfig();
 
         if (failsafeConfig) {
-            rcCommand[THROTTLE] = failsafeConfig->failsafe_throttle;
+            setNavigationRcCommand(THROTTLE, failsafeConfig->failsafe_throttle);
         }
         else {
-            rcCommand[THROTTLE] = posControl.escAndServoConfig->minthrottle;
+            setNavigationRcCommand(THROTTLE, posControl.escAndServoConfig->minthrottle);
         }
     }
 }
@@ -0,0 +1,228 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Kalman filter for position, velocity and accelerometer bias
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "platform.h"
+
+#ifdef USE_NAV_EKF
+
+#include "common/axis.h"
+#include "common/maths.h"
+
+#include "flight/navigation_rewrite_pos_ekf.h"
+
+/*
+ * Position and velocity are owned by the caller, the filter keeps the earth frame accelerometer bias and the
+ * covariance. Acceleration is measured in earth frame, so the axes don't interact and each axis keeps its own
+ * 3x3 covariance of (position, velocity, bias). A prediction is a fixed number of multiplies per axis and
+ * measurements are scalar, nothing is inverted or allocated.
+ */
+#define STATE_POS   0
+#define STATE_VEL   1
+#define STATE_BIAS  2
+
+typedef float navEkfMatrix3_t[3][3];
+
+static navEkfMatrix3_t P[XYZ_AXIS_COUNT];
+static float accelBias[XYZ_AXIS_COUNT];
+static uint8_t rejectCount[XYZ_AXIS_COUNT][2];      // consecutive rejections of position and velocity measurements
+
+static navEkfStatus_t ekfStatus;
+
+static void navEkfResetAxis(uint8_t axis)
+{
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            P[axis][i][j] = 0;
+        }
+    }
+    P[axis][STATE_POS][STATE_POS] = sq(NAV_EKF_POS_INITIAL_SD);
+    P[axis][STATE_VEL][STATE_VEL] = sq(NAV_EKF_VEL_INITIAL_SD);
+    P[axis][STATE_BIAS][STATE_BIAS] = sq(NAV_EKF_ACC_BIAS_INITIAL_SD);
+
+    rejectCount[axis][STATE_POS] = 0;
+    rejectCount[axis][STATE_VEL] = 0;
+}
+
+void navEkfInit(void)
+{
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        navEkfResetAxis(axis);
+        accelBias[axis] = 0;
+    }
+
+    ekfStatus.rejectedMeasurements = 0;
+    ekfStatus.axisResets = 0;
+}
+
+/*
+ * An unaided position variance is scaled back as P = D * P * D with D = diag(s, 1, 1), which keeps P positive
+ * definite. Rounding that broke the covariance starts the axis over.
+ */
+static void navEkfCheckCovariance(uint8_t axis)
+{
+    navEkfMatrix3_t *p = &P[axis];
+
+    for (int i = 0; i < 3; i++) {
+        if (!((*p)[i][i] > 0.0f) || isinf((*p)[i][i])) {
+            navEkfResetAxis(axis);
+            ekfStatus.axisResets++;
+            return;
+        }
+    }
+
+    if ((*p)[STATE_POS][STATE_POS] > NAV_EKF_POS_VARIANCE_MAX) {
+        const float scale = sqrtf(NAV_EKF_POS_VARIANCE_MAX / (*p)[STATE_POS][STATE_POS]);
+        (*p)[STATE_POS][STATE_POS] = NAV_EKF_POS_VARIANCE_MAX;
+        (*p)[STATE_POS][STATE_VEL] = (*p)[STATE_VEL][STATE_POS] = (*p)[STATE_POS][STATE_VEL] * scale;
+        (*p)[STATE_POS][STATE_BIAS] = (*p)[STATE_BIAS][STATE_POS] = (*p)[STATE_POS][STATE_BIAS] * scale;
+    }
+}
+
+/*
+ * accel is the earth frame (NEU) acceleration with gravity removed, cm/s^2. Per axis
+ *      pos += vel * dt + (accel - bias) * dt^2 / 2
+ *      vel += (accel - bias) * dt
+ *          | 1  dt  -dt^2/2 |
+ *      F = | 0  1   -dt     |     P = F * P * F' + Q, expanded
+ *          | 0  0    1      |
+ * Q integrates white acceleration noise over dt and adds the bias random walk.
+ */
+void navEkfPredict(float pos[XYZ_AXIS_COUNT], float vel[XYZ_AXIS_COUNT], const float accel[XYZ_AXIS_COUNT], float dt)
+{
+    if (dt <= 0.0f) {
+        return;
+    }
+
+    const float dt2 = 0.5f * sq(dt);
+    const float accNoise = sq(NAV_EKF_ACC_NOISE);
+    const float biasNoise = sq(NAV_EKF_ACC_BIAS_NOISE) * dt;
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        const float acc = accel[axis] - accelBias[axis];
+        pos[axis] += vel[axis] * dt + acc * dt2;
+        vel[axis] += acc * dt;
+
+        navEkfMatrix3_t *p = &P[axis];
+
+        // A = F * P, rows of F only mix with the rows below them
+        float a[3][3];
+        for (int j = 0; j < 3; j++) {
+            a[0][j] = (*p)[0][j] + dt * (*p)[1][j] - dt2 * (*p)[2][j];
+            a[1][j] = (*p)[1][j] - dt * (*p)[2][j];
+            a[2][j] = (*p)[2][j];
+        }
+
+        // P = A * F'
+        for (int i = 0; i < 3; i++) {
+            (*p)[i][0] = a[i][0] + dt * a[i][1] - dt2 * a[i][2];
+            (*p)[i][1] = a[i][1] - dt * a[i][2];
+            (*p)[i][2] = a[i][2];
+        }
+
+        (*p)[0][0] += accNoise * sq(dt) * dt / 3.0f;
+        (*p)[0][1] += accNoise * dt2;
+        (*p)[1][0] += accNoise * dt2;
+        (*p)[1][1] += accNoise * dt;
+        (*p)[2][2] += biasNoise;
+
+        navEkfCheckCovariance(axis);
+    }
+}
+
+/*
+ * Scalar update of the state measured by H = e(state). The innovation is formed by the caller, a delayed measurement
+ * is compared with the estimate of its time, the correction is applied to the current state with the current covariance.
+ * A measurement rejected NAV_EKF_REJECT_RESET_COUNT times in a row is taken as the truth, the axis is reset to it.
+ * Position variance of an unaided axis is capped and no longer covers the drift, it takes any position measurement.
+ */
+static bool navEkfFuse(float pos[XYZ_AXIS_COUNT], float vel[XYZ_AXIS_COUNT], uint8_t axis, uint8_t state, float innovation, float variance)
+{
+    navEkfMatrix3_t *p = &P[axis];
+    const float innovationVariance = (*p)[state][state] + variance;
+
+    const bool isUnaided = (state == STATE_POS) && ((*p)[STATE_POS][STATE_POS] >= NAV_EKF_POS_VARIANCE_MAX);
+
+    if (!isUnaided && (sq(innovation) > NAV_EKF_INNOVATION_GATE * innovationVariance)) {
+        ekfStatus.rejectedMeasurements++;
+        if (++rejectCount[axis][state] >= NAV_EKF_REJECT_RESET_COUNT) {
+            if (state == STATE_POS) {
+                pos[axis] += innovation;
+            } else {
+                vel[axis] += innovation;
+            }
+            navEkfResetAxis(axis);
+            ekfStatus.axisResets++;
+        }
+        return false;
+    }
+    rejectCount[axis][state] = 0;
+
+    const float recipVariance = 1.0f / innovationVariance;
+    const float k[3] = { (*p)[0][state] * recipVariance, (*p)[1][state] * recipVariance, (*p)[2][state] * recipVariance };
+
+    pos[axis] += k[STATE_POS] * innovation;
+    vel[axis] += k[STATE_VEL] * innovation;
+    accelBias[axis] = constrainf(accelBias[axis] + k[STATE_BIAS] * innovation, -NAV_EKF_ACC_BIAS_MAX, NAV_EKF_ACC_BIAS_MAX);
+
+    // P = P - K * H * P, the measured row of P is read before it changes
+    const float hp[3] = { (*p)[state][0], (*p)[state][1], (*p)[state][2] };
+    for (int i = 0; i < 3; i++) {
+        for (int j = i; j < 3; j++) {
+            (*p)[i][j] -= k[i] * hp[j];
+            (*p)[j][i] = (*p)[i][j];
+        }
+    }
+
+    navEkfCheckCovariance(axis);
+    return true;
+}
+
+/* innovation is the measured minus the estimated position in cm, variance of the measurement in cm^2 */
+bool navEkfFusePosition(float pos[XYZ_AXIS_COUNT], float vel[XYZ_AXIS_COUNT], uint8_t axis, float innovation, float variance)
+{
+    return navEkfFuse(pos, vel, axis, STATE_POS, innovation, variance);
+}
+
+/* innovation is the measured minus the estimated velocity in cm/s, variance of the measurement in cm^2/s^2 */
+bool navEkfFuseVelocity(float pos[XYZ_AXIS_COUNT], float vel[XYZ_AXIS_COUNT], uint8_t axis, float innovation, float variance)
+{
+    return navEkfFuse(pos, vel, axis, STATE_VEL, innovation, variance);
+}
+
+float navEkfGetPositionVariance(uint8_t axis)
+{
+    return P[axis][STATE_POS][STATE_POS];
+}
+
+const navEkfStatus_t *navEkfGetStatus(void)
+{
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        ekfStatus.posStdDev[axis] = sqrtf(P[axis][STATE_POS][STATE_POS]);
+        ekfStatus.velStdDev[axis] = sqrtf(P[axis][STATE_VEL][STATE_VEL]);
+        ekfStatus.accelBias[axis] = accelBias[axis];
+    }
+
+    return &ekfStatus;
+}
+
+#endif
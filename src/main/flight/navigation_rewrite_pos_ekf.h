@@ -0,0 +1,47 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// Noise densities, all in cm and s
+#define NAV_EKF_ACC_NOISE               40.0f       // cm/s^2/sqrt(Hz), accelerometer noise and attitude error projected to earth frame
+#define NAV_EKF_ACC_BIAS_NOISE          0.5f        // cm/s^3/sqrt(Hz), accelerometer bias random walk
+#define NAV_EKF_GPS_VEL_NOISE           50.0f       // cm/s
+#define NAV_EKF_SONAR_VEL_NOISE         30.0f       // cm/s, sonar climb rate over flat ground
+
+#define NAV_EKF_POS_INITIAL_SD          1000.0f     // cm
+#define NAV_EKF_VEL_INITIAL_SD          200.0f      // cm/s
+#define NAV_EKF_ACC_BIAS_INITIAL_SD     20.0f       // cm/s^2
+#define NAV_EKF_ACC_BIAS_MAX            150.0f      // cm/s^2
+#define NAV_EKF_POS_VARIANCE_MAX        1.0e8f      // cm^2, position variance of an axis no sensor aids stops growing here
+#define NAV_EKF_INNOVATION_GATE         25.0f       // squared innovation over its variance above which a measurement is rejected
+#define NAV_EKF_REJECT_RESET_COUNT      10          // consecutive rejections of a measurement after which the axis is reset to it
+
+typedef struct navEkfStatus_s {
+    float posStdDev[XYZ_AXIS_COUNT];        // cm
+    float velStdDev[XYZ_AXIS_COUNT];        // cm/s
+    float accelBias[XYZ_AXIS_COUNT];        // cm/s^2, earth frame
+    uint16_t rejectedMeasurements;
+    uint16_t axisResets;
+} navEkfStatus_t;
+
+void navEkfInit(void);
+void navEkfPredict(float pos[XYZ_AXIS_COUNT], float vel[XYZ_AXIS_COUNT], const float accel[XYZ_AXIS_COUNT], float dt);
+bool navEkfFusePosition(float pos[XYZ_AXIS_COUNT], float vel[XYZ_AXIS_COUNT], uint8_t axis, float innovation, float variance);
+bool navEkfFuseVelocity(float pos[XYZ_AXIS_COUNT], float vel[XYZ_AXIS_COUNT], uint8_t axis, float innovation, float variance);
+float navEkfGetPositionVariance(uint8_t axis);
+const navEkfStatus_t *navEkfGetStatus(void);
@@ -43,6 +43,7 @@
 #include "flight/imu.h"
 #include "flight/navigation_rewrite.h"
 #include "flight/navigation_rewrite_private.h"
+#include "flight/navigation_rewrite_pos_ekf.h"
 
 #include "config/runtime_config.h"
 #include "config/config.h"
@@ -59,6 +60,7 @@
 
 #define INAV_GPS_GLITCH_RADIUS              250.0f  // 2.5m GPS glitch radius
 #define INAV_GPS_GLITCH_ACCEL               1000.0f // 10m/s/s max possible acceleration for GPS glitch detection
+#define INAV_GPS_GLITCH_MEDIAN_WINDOW       7       // GPS updates over which the typical prediction error is tracked
 
 #define INAV_POSITION_PUBLISH_RATE_HZ       50      // Publish position updates at this rate
 #define INAV_BARO_UPDATE_RATE               20
@@ -71,7 +73,8 @@
 #define INAV_SONAR_W1                       0.8461f // Sonar predictive filter gain for altitude
 #define INAV_SONAR_W2                       6.2034f // Sonar predictive filter gain for velocity
 
-#define INAV_HISTORY_BUF_SIZE               (INAV_POSITION_PUBLISH_RATE_HZ / 2)     // Enough to hold 0.5 sec historical data
+#define INAV_HISTORY_RATE_HZ                100     // Estimate snapshots for GPS delay compensation, interpolated between
+#define INAV_HISTORY_BUF_SIZE               (INAV_HISTORY_RATE_HZ * 6 / 10)         // 0.6 sec, max gps_delay_ms plus transfer time
 
 extern float magneticDeclination;
 
@@ -82,12 +85,15 @@ typedef struct {
 
 typedef struct {
     uint32_t    lastUpdateTime; // Last update time (us)
+    uint32_t    measurementTime;    // When the GPS measured pos and vel (us), first byte arrival minus gps_delay_ms
 #if defined(NAV_GPS_GLITCH_DETECTION)
     bool        glitchDetected;
     bool        glitchRecovery;
 #endif
     t_fp_vector pos;            // GPS position in NEU coordinate system (cm)
     t_fp_vector vel;            // GPS velocity (cms)
+    t_fp_vector estPos;         // Estimated position at measurementTime, GPS corrections are relative to it
+    t_fp_vector estVel;
     float       eph;
     float       epv;
 } navPositionEstimatorGPS_t;
@@ -120,10 +126,19 @@ typedef struct {
     bool        isBaroGroundValid;
 } navPositionEstimatorSTATE_t;
 
+/* 14 bytes per snapshot instead of 28 for float time, position and velocity */
 typedef struct {
-    uint8_t     index;
-    t_fp_vector pos[INAV_HISTORY_BUF_SIZE];
-    t_fp_vector vel[INAV_HISTORY_BUF_SIZE];
+    uint16_t    dtUs;           // Time since the previous snapshot
+    int16_t     posDelta[XYZ_AXIS_COUNT];   // Position change since the previous snapshot (mm)
+    int16_t     vel[XYZ_AXIS_COUNT];        // Velocity (cm/s)
+} navPositionEstimatorSnapshot_t;
+
+typedef struct {
+    uint8_t     index;          // Next snapshot to write
+    uint8_t     count;          // Snapshots that can be reconstructed, older ones are dropped when the estimate jumps
+    uint32_t    lastTime;       // Time of the newest snapshot (us)
+    t_fp_vector lastPos;        // Position of the newest snapshot, older ones are reconstructed by subtracting deltas
+    navPositionEstimatorSnapshot_t  snapshot[INAV_HISTORY_BUF_SIZE];
 } navPosisitonEstimatorHistory_t;
 
 typedef struct {
@@ -210,11 +225,13 @@ static bool detectGPSGlitch(uint32_t currentTime)
     static uint32_t previousTime = 0;
     static t_fp_vector lastKnownGoodPosition;
     static t_fp_vector lastKnownGoodVelocity;
+    static medianFilter_t predictionErrorFilter;
 
     bool isGlitching = false;
 
     if (previousTime == 0) {
         isGlitching = false;
+        medianFilterInit(&predictionErrorFilter, INAV_GPS_GLITCH_MEDIAN_WINDOW);
     }
     else {
         t_fp_vector predictedGpsPosition;
@@ -225,10 +242,18 @@ static bool detectGPSGlitch(uint32_t currentTime)
         predictedGpsPosition.V.X = lastKnownGoodPosition.V.X + lastKnownGoodVelocity.V.X * dT;
         predictedGpsPosition.V.Y = lastKnownGoodPosition.V.Y + lastKnownGoodVelocity.V.Y * dT;
 
-        /* New pos is within predefined radius of predicted pos, radius is expanded exponentially */
-        gpsDistance = sqrtf(sq(predictedGpsPosition.V.X - lastKnownGoodPosition.V.X) + sq(predictedGpsPosition.V.Y - lastKnownGoodPosition.V.Y));
-        if (gpsDistance <= (INAV_GPS_GLITCH_RADIUS + 0.5f * INAV_GPS_GLITCH_ACCEL * dT * dT)) {
+        /* Distance of the new GPS position from the predicted one */
+        gpsDistance = sqrtf(sq(posEstimator.gps.pos.V.X - predictedGpsPosition.V.X) + sq(posEstimator.gps.pos.V.Y - predictedGpsPosition.V.Y));
+
+        /*
+         * New pos is within predefined radius of predicted pos, radius is expanded by the time since the last good fix
+         * and by the median prediction error of recent good fixes. Only accepted fixes enter the median and it's limited
+         * to the glitch radius, so a glitch train or a sustained offset can't widen the gate until nothing is rejected.
+         */
+        const float typicalError = MIN((float)medianFilterGet(&predictionErrorFilter), INAV_GPS_GLITCH_RADIUS);
+        if (gpsDistance <= (INAV_GPS_GLITCH_RADIUS + typicalError + 0.5f * INAV_GPS_GLITCH_ACCEL * dT * dT)) {
             isGlitching = false;
+            medianFilterApply(&predictionErrorFilter, lrintf(gpsDistance));
         }
         else {
             isGlitching = true;
@@ -245,6 +270,90 @@ static bool detectGPSGlitch(uint32_t currentTime)
 }
 #endif
 
+/**
+ * Store a snapshot of the estimate. Position is delta encoded against the reconstructed previous snapshot,
+ *  so rounding doesn't accumulate. A jump that doesn't fit the encoding starts the history over.
+ */
+static void storeEstimateHistory(uint32_t currentTime)
+{
+    navPositionEstimatorSnapshot_t * snapshot = &posEstimator.history.snapshot[posEstimator.history.index];
+    const uint32_t dtUs = currentTime - posEstimator.history.lastTime;
+    bool isContinuous = (posEstimator.history.count > 0) && (dtUs <= UINT16_MAX);
+    int32_t posDelta[XYZ_AXIS_COUNT];
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        posDelta[axis] = lrintf((posEstimator.est.pos.A[axis] - posEstimator.history.lastPos.A[axis]) * 10.0f);
+        isContinuous = isContinuous && (ABS(posDelta[axis]) <= INT16_MAX);
+    }
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        if (isContinuous) {
+            snapshot->posDelta[axis] = posDelta[axis];
+            posEstimator.history.lastPos.A[axis] += posDelta[axis] * 0.1f;
+        }
+        else {
+            snapshot->posDelta[axis] = 0;
+            posEstimator.history.lastPos.A[axis] = posEstimator.est.pos.A[axis];
+        }
+        snapshot->vel[axis] = constrain(lrintf(posEstimator.est.vel.A[axis]), INT16_MIN, INT16_MAX);
+    }
+
+    snapshot->dtUs = isContinuous ? dtUs : 0;
+    posEstimator.history.count = isContinuous ? MIN(posEstimator.history.count + 1, INAV_HISTORY_BUF_SIZE) : 1;
+    posEstimator.history.lastTime = currentTime;
+
+    posEstimator.history.index++;
+    if (posEstimator.history.index >= INAV_HISTORY_BUF_SIZE) {
+        posEstimator.history.index = 0;
+    }
+}
+
+/**
+ * Estimated position and velocity at a past time, linearly interpolated between the two snapshots around it.
+ *  Times newer than the newest snapshot get the newest, older than the history get the oldest
+ */
+static void getEstimateHistory(uint32_t time, t_fp_vector * pos, t_fp_vector * vel)
+{
+    int index = (posEstimator.history.index == 0) ? INAV_HISTORY_BUF_SIZE - 1 : posEstimator.history.index - 1;
+    uint32_t snapshotTime = posEstimator.history.lastTime;
+    t_fp_vector snapshotPos = posEstimator.history.lastPos;
+
+    if (posEstimator.history.count == 0) {
+        *pos = posEstimator.est.pos;
+        *vel = posEstimator.est.vel;
+        return;
+    }
+
+    if ((int32_t)(time - snapshotTime) < 0) {
+        for (int n = 1; n < posEstimator.history.count; n++) {
+            const navPositionEstimatorSnapshot_t * newer = &posEstimator.history.snapshot[index];
+            const int olderIndex = (index == 0) ? INAV_HISTORY_BUF_SIZE - 1 : index - 1;
+            const navPositionEstimatorSnapshot_t * older = &posEstimator.history.snapshot[olderIndex];
+            const uint32_t olderTime = snapshotTime - newer->dtUs;
+
+            if ((int32_t)(time - olderTime) >= 0) {
+                const float k = (float)(time - olderTime) / newer->dtUs;
+                for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+                    pos->A[axis] = snapshotPos.A[axis] - newer->posDelta[axis] * 0.1f * (1.0f - k);
+                    vel->A[axis] = older->vel[axis] + (newer->vel[axis] - older->vel[axis]) * k;
+                }
+                return;
+            }
+
+            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+                snapshotPos.A[axis] -= newer->posDelta[axis] * 0.1f;
+            }
+            snapshotTime = olderTime;
+            index = olderIndex;
+        }
+    }
+
+    *pos = snapshotPos;
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        vel->A[axis] = posEstimator.history.snapshot[index].vel[axis];
+    }
+}
+
 /**
  * Update GPS topic
  *  Function is called on each GPS update
@@ -328,6 +437,10 @@ void onNewGPSData(void)
                 posEstimator.gps.eph = INAV_GPS_EPH;
                 posEstimator.gps.epv = INAV_GPS_EPV;
 
+                /* Compare with the estimate of the time the GPS measured, not of the time it arrived */
+                posEstimator.gps.measurementTime = gpsSol.arrivalTime - MS2US(posControl.navConfig->inav.gps_delay_ms);
+                getEstimateHistory(posEstimator.gps.measurementTime, &posEstimator.gps.estPos, &posEstimator.gps.estVel);
+
                 /* Indicate a last valid reading of Pos/Vel */
                 posEstimator.gps.lastUpdateTime = currentTime;
             }
@@ -420,14 +533,15 @@ static void updateIMUTopic(void)
         posEstimator.imu.accelNEU.V.X = 0;
         posEstimator.imu.accelNEU.V.Y = 0;
         posEstimator.imu.accelNEU.V.Z = 0;
+
+        /* Samples taken while the gyro (re)calibrates are not used */
+        imuResetAverageAccelInBodyFrame();
     }
     else {
         t_fp_vector accelBF;
 
-        /* Read acceleration data in body frame */
-        accelBF.V.X = imuAccelInBodyFrame.V.X;
-        accelBF.V.Y = imuAccelInBodyFrame.V.Y;
-        accelBF.V.Z = imuAccelInBodyFrame.V.Z;
+        /* Read acceleration data in body frame, averaged since the previous update */
+        imuGetAverageAccelInBodyFrame(&accelBF);
 
         /* Correct accelerometer bias */
         accelBF.V.X -= posEstimator.imu.accelBias.V.X;
@@ -454,75 +568,11 @@ static void updateIMUTopic(void)
 }
 
 /**
- * Calculate next estimate using IMU and apply corrections from reference sensors (GPS, BARO etc)
- *  Function is called at main loop rate
+ * Complementary filter, corrections are applied at loop rate with fixed weights
  */
-static void updateEstimatedTopic(uint32_t currentTime)
+static void updateEstimatedTopicComplementary(float dt, bool isGPSValid, bool isBaroValid, bool useGpsZ, bool isAirCushionEffectDetected)
 {
     t_fp_vector accelBiasCorr;
-    float dt = US2S(currentTime - posEstimator.est.lastUpdateTime);
-    posEstimator.est.lastUpdateTime = currentTime;
-
-    /* If IMU is not ready we can't estimate anything */
-    if (!isImuReady()) {
-        posEstimator.est.eph = posControl.navConfig->inav.max_eph_epv + 0.001f;
-        posEstimator.est.epv = posControl.navConfig->inav.max_eph_epv + 0.001f;
-        return;
-    }
-
-    /* increase EPH/EPV on each iteration */
-    if (posEstimator.est.eph <= posControl.navConfig->inav.max_eph_epv) {
-        posEstimator.est.eph *= 1.0f + dt;
-    }
-
-    if (posEstimator.est.epv <= posControl.navConfig->inav.max_eph_epv) {
-        posEstimator.est.epv *= 1.0f + dt;
-    }
-
-    /* Figure out if we have valid position data from our data sources */
-    bool isGPSValid = sensors(SENSOR_GPS) && posControl.gpsOrigin.valid && ((currentTime - posEstimator.gps.lastUpdateTime) <= MS2US(INAV_GPS_TIMEOUT_MS));
-    bool isBaroValid = sensors(SENSOR_BARO) && ((currentTime - posEstimator.baro.lastUpdateTime) <= MS2US(INAV_BARO_TIMEOUT_MS));
-    bool isSonarValid = sensors(SENSOR_SONAR) && ((currentTime - posEstimator.sonar.lastUpdateTime) <= MS2US(INAV_SONAR_TIMEOUT_MS));
-
-    /* Do some preparations to data */
-    if (isBaroValid) {
-        if (!ARMING_FLAG(ARMED)) {
-            posEstimator.state.baroGroundAlt = posEstimator.est.pos.V.Z;
-            posEstimator.state.isBaroGroundValid = true;
-            posEstimator.state.baroGroundTimeout = currentTime + 250000;   // 0.25 sec
-        }
-        else {
-            if (posEstimator.est.vel.V.Z > 15) {
-                if (currentTime > posEstimator.state.baroGroundTimeout) {
-                    posEstimator.state.isBaroGroundValid = false;
-                }
-            }
-            else {
-                posEstimator.state.baroGroundTimeout = currentTime + 250000;   // 0.25 sec
-            }
-        }
-    }
-    else {
-        posEstimator.state.isBaroGroundValid = false;
-    }
-
-    /* We might be experiencing air cushion effect - use sonar or baro groung altitude to detect it */
-    bool isAirCushionEffectDetected = ARMING_FLAG(ARMED) &&
-                                        ((isSonarValid && posEstimator.sonar.alt < 20.0f && posEstimator.state.isBaroGroundValid) ||
-                                         (isBaroValid && posEstimator.state.isBaroGroundValid && posEstimator.baro.alt < posEstimator.state.baroGroundAlt));
-
-#if defined(NAV_GPS_GLITCH_DETECTION)
-    //isGPSValid = isGPSValid && !posEstimator.gps.glitchDetected;
-#endif
-
-    /* Apply GPS altitude corrections only on fixed wing aircrafts */
-    bool useGpsZ = STATE(FIXED_WING) && isGPSValid;
-
-    /* Pre-calculate history index for GPS delay compensation */
-    int gpsHistoryIndex = (posEstimator.history.index - 1) - constrain(((int)posControl.navConfig->inav.gps_delay_ms / (1000 / INAV_POSITION_PUBLISH_RATE_HZ)), 0, INAV_HISTORY_BUF_SIZE - 1);
-    if (gpsHistoryIndex < 0) {
-        gpsHistoryIndex += INAV_HISTORY_BUF_SIZE;
-    }
 
     /* Correct accelerometer bias */
     if (posControl.navConfig->inav.w_acc_bias > 0) {
@@ -532,14 +582,14 @@ static void updateEstimatedTopic(uint32_t currentTime)
 
         /* accelerometer bias correction for GPS */
         if (isGPSValid) {
-            accelBiasCorr.V.X -= (posEstimator.gps.pos.V.X - posEstimator.history.pos[gpsHistoryIndex].V.X) * sq(posControl.navConfig->inav.w_xy_gps_p);
-            accelBiasCorr.V.X -= (posEstimator.gps.vel.V.X - posEstimator.history.vel[gpsHistoryIndex].V.X) * posControl.navConfig->inav.w_xy_gps_v;
-            accelBiasCorr.V.Y -= (posEstimator.gps.pos.V.Y - posEstimator.history.pos[gpsHistoryIndex].V.Y) * sq(posControl.navConfig->inav.w_xy_gps_p);
-            accelBiasCorr.V.Y -= (posEstimator.gps.vel.V.Y - posEstimator.history.vel[gpsHistoryIndex].V.Y) * posControl.navConfig->inav.w_xy_gps_v;
+            accelBiasCorr.V.X -= (posEstimator.gps.pos.V.X - posEstimator.gps.estPos.V.X) * sq(posControl.navConfig->inav.w_xy_gps_p);
+            accelBiasCorr.V.X -= (posEstimator.gps.vel.V.X - posEstimator.gps.estVel.V.X) * posControl.navConfig->inav.w_xy_gps_v;
+            accelBiasCorr.V.Y -= (posEstimator.gps.pos.V.Y - posEstimator.gps.estPos.V.Y) * sq(posControl.navConfig->inav.w_xy_gps_p);
+            accelBiasCorr.V.Y -= (posEstimator.gps.vel.V.Y - posEstimator.gps.estVel.V.Y) * posControl.navConfig->inav.w_xy_gps_v;
 
             if (useGpsZ) {
-                accelBiasCorr.V.Z -= (posEstimator.gps.pos.V.Z - posEstimator.history.pos[gpsHistoryIndex].V.Z) * sq(posControl.navConfig->inav.w_z_gps_p);
-                accelBiasCorr.V.Z -= (posEstimator.gps.vel.V.Z - posEstimator.history.vel[gpsHistoryIndex].V.Z) * posControl.navConfig->inav.w_z_gps_v;
+                accelBiasCorr.V.Z -= (posEstimator.gps.pos.V.Z - posEstimator.gps.estPos.V.Z) * sq(posControl.navConfig->inav.w_z_gps_p);
+                accelBiasCorr.V.Z -= (posEstimator.gps.vel.V.Z - posEstimator.gps.estVel.V.Z) * posControl.navConfig->inav.w_z_gps_v;
             }
         }
 
@@ -576,8 +626,8 @@ static void updateEstimatedTopic(uint32_t currentTime)
 
         /* Apply GPS correction to altitude */
         if (useGpsZ) {
-            inavFilterCorrectPos(Z, dt, posEstimator.gps.pos.V.Z - posEstimator.history.pos[gpsHistoryIndex].V.Z, posControl.navConfig->inav.w_z_gps_p);
-            inavFilterCorrectVel(Z, dt, posEstimator.gps.vel.V.Z - posEstimator.history.vel[gpsHistoryIndex].V.Z, posControl.navConfig->inav.w_z_gps_v);
+            inavFilterCorrectPos(Z, dt, posEstimator.gps.pos.V.Z - posEstimator.gps.estPos.V.Z, posControl.navConfig->inav.w_z_gps_p);
+            inavFilterCorrectVel(Z, dt, posEstimator.gps.vel.V.Z - posEstimator.gps.estVel.V.Z, posControl.navConfig->inav.w_z_gps_v);
 
             /* Adjust EPV */
             posEstimator.est.epv = MIN(posEstimator.est.epv, posEstimator.gps.epv);
@@ -596,11 +646,11 @@ static void updateEstimatedTopic(uint32_t currentTime)
 
         /* Correct position from GPS - always if GPS is valid */
         if (isGPSValid) {
-            inavFilterCorrectPos(X, dt, posEstimator.gps.pos.V.X - posEstimator.history.pos[gpsHistoryIndex].V.X, posControl.navConfig->inav.w_xy_gps_p);
-            inavFilterCorrectPos(Y, dt, posEstimator.gps.pos.V.Y - posEstimator.history.pos[gpsHistoryIndex].V.Y, posControl.navConfig->inav.w_xy_gps_p);
+            inavFilterCorrectPos(X, dt, posEstimator.gps.pos.V.X - posEstimator.gps.estPos.V.X, posControl.navConfig->inav.w_xy_gps_p);
+            inavFilterCorrectPos(Y, dt, posEstimator.gps.pos.V.Y - posEstimator.gps.estPos.V.Y, posControl.navConfig->inav.w_xy_gps_p);
 
-            inavFilterCorrectVel(X, dt, posEstimator.gps.vel.V.X - posEstimator.history.vel[gpsHistoryIndex].V.X, posControl.navConfig->inav.w_xy_gps_v);
-            inavFilterCorrectVel(Y, dt, posEstimator.gps.vel.V.Y - posEstimator.history.vel[gpsHistoryIndex].V.Y, posControl.navConfig->inav.w_xy_gps_v);
+            inavFilterCorrectVel(X, dt, posEstimator.gps.vel.V.X - posEstimator.gps.estVel.V.X, posControl.navConfig->inav.w_xy_gps_v);
+            inavFilterCorrectVel(Y, dt, posEstimator.gps.vel.V.Y - posEstimator.gps.estVel.V.Y, posControl.navConfig->inav.w_xy_gps_v);
 
             /* Adjust EPH */
             posEstimator.est.eph = MIN(posEstimator.est.eph, posEstimator.gps.eph);
@@ -610,6 +660,155 @@ static void updateEstimatedTopic(uint32_t currentTime)
         inavFilterCorrectVel(X, dt, 0.0f - posEstimator.est.vel.V.X, posControl.navConfig->inav.w_xy_res_v);
         inavFilterCorrectVel(Y, dt, 0.0f - posEstimator.est.vel.V.Y, posControl.navConfig->inav.w_xy_res_v);
     }
+}
+
+#if defined(USE_NAV_EKF)
+/**
+ * Kalman filter, each measurement is fused once when it arrives and weighted by its expected error.
+ *  GPS is delayed, it is compared with the estimate from gps_delay_ms ago and the correction is applied to the current estimate
+ */
+static void updateEstimatedTopicEkf(float dt, bool isGPSValid, bool isBaroValid, bool isSonarValid, bool useGpsZ, bool isAirCushionEffectDetected)
+{
+    static uint32_t gpsFusedTime = 0;
+    static uint32_t baroFusedTime = 0;
+    static uint32_t sonarFusedTime = 0;
+
+    /* Without valid heading X-Y acceleration can't be rotated to North-East, position is only held by GPS */
+    float accel[XYZ_AXIS_COUNT];
+    accel[X] = isImuHeadingValid() ? posEstimator.imu.accelNEU.V.X : 0.0f;
+    accel[Y] = isImuHeadingValid() ? posEstimator.imu.accelNEU.V.Y : 0.0f;
+    accel[Z] = posEstimator.imu.accelNEU.V.Z;
+
+    navEkfPredict(posEstimator.est.pos.A, posEstimator.est.vel.A, accel, dt);
+
+    if (isGPSValid && (posEstimator.gps.lastUpdateTime != gpsFusedTime)) {
+        gpsFusedTime = posEstimator.gps.lastUpdateTime;
+
+        for (int axis = X; axis <= Y; axis++) {
+            navEkfFusePosition(posEstimator.est.pos.A, posEstimator.est.vel.A, axis, posEstimator.gps.pos.A[axis] - posEstimator.gps.estPos.A[axis], sq(posEstimator.gps.eph));
+            navEkfFuseVelocity(posEstimator.est.pos.A, posEstimator.est.vel.A, axis, posEstimator.gps.vel.A[axis] - posEstimator.gps.estVel.A[axis], sq(NAV_EKF_GPS_VEL_NOISE));
+        }
+
+        if (useGpsZ) {
+            navEkfFusePosition(posEstimator.est.pos.A, posEstimator.est.vel.A, Z, posEstimator.gps.pos.V.Z - posEstimator.gps.estPos.V.Z, sq(posEstimator.gps.epv));
+            navEkfFuseVelocity(posEstimator.est.pos.A, posEstimator.est.vel.A, Z, posEstimator.gps.vel.V.Z - posEstimator.gps.estVel.V.Z, sq(NAV_EKF_GPS_VEL_NOISE));
+        }
+    }
+
+#if defined(BARO)
+    if (isBaroValid && (posEstimator.baro.lastUpdateTime != baroFusedTime)) {
+        baroFusedTime = posEstimator.baro.lastUpdateTime;
+
+        float baroError = (isAirCushionEffectDetected ? posEstimator.state.baroGroundAlt : posEstimator.baro.alt) - posEstimator.est.pos.V.Z;
+        navEkfFusePosition(posEstimator.est.pos.A, posEstimator.est.vel.A, Z, baroError, sq(posEstimator.baro.epv));
+    }
+#else
+    UNUSED(isBaroValid);
+    UNUSED(baroFusedTime);
+    UNUSED(isAirCushionEffectDetected);
+#endif
+
+#if defined(SONAR)
+    /* Sonar measures distance to the ground, its rate of change is the climb rate over flat ground */
+    if (isSonarValid && (posEstimator.sonar.lastUpdateTime != sonarFusedTime)) {
+        sonarFusedTime = posEstimator.sonar.lastUpdateTime;
+
+        navEkfFuseVelocity(posEstimator.est.pos.A, posEstimator.est.vel.A, Z, posEstimator.sonar.vel - posEstimator.est.vel.V.Z, sq(NAV_EKF_SONAR_VEL_NOISE));
+    }
+#else
+    UNUSED(isSonarValid);
+    UNUSED(sonarFusedTime);
+#endif
+
+    posEstimator.est.eph = sqrtf(MAX(navEkfGetPositionVariance(X), navEkfGetPositionVariance(Y)));
+    posEstimator.est.epv = sqrtf(navEkfGetPositionVariance(Z));
+
+    /* Don't let velocity run away while no sensor holds the position */
+    if (!isGPSValid && posEstimator.est.eph >= posControl.navConfig->inav.max_eph_epv) {
+        inavFilterCorrectVel(X, dt, 0.0f - posEstimator.est.vel.V.X, posControl.navConfig->inav.w_xy_res_v);
+        inavFilterCorrectVel(Y, dt, 0.0f - posEstimator.est.vel.V.Y, posControl.navConfig->inav.w_xy_res_v);
+    }
+
+    if (!isBaroValid && !useGpsZ && posEstimator.est.epv >= posControl.navConfig->inav.max_eph_epv) {
+        inavFilterCorrectVel(Z, dt, 0.0f - posEstimator.est.vel.V.Z, posControl.navConfig->inav.w_z_res_v);
+    }
+}
+#endif
+
+/**
+ * Calculate next estimate using IMU and apply corrections from reference sensors (GPS, BARO etc)
+ *  Function is called at main loop rate
+ */
+static void updateEstimatedTopic(uint32_t currentTime)
+{
+    float dt = US2S(currentTime - posEstimator.est.lastUpdateTime);
+    posEstimator.est.lastUpdateTime = currentTime;
+
+    /* If IMU is not ready we can't estimate anything */
+    if (!isImuReady()) {
+        posEstimator.est.eph = posControl.navConfig->inav.max_eph_epv + 0.001f;
+        posEstimator.est.epv = posControl.navConfig->inav.max_eph_epv + 0.001f;
+        return;
+    }
+
+    /* increase EPH/EPV on each iteration */
+    if (posEstimator.est.eph <= posControl.navConfig->inav.max_eph_epv) {
+        posEstimator.est.eph *= 1.0f + dt;
+    }
+
+    if (posEstimator.est.epv <= posControl.navConfig->inav.max_eph_epv) {
+        posEstimator.est.epv *= 1.0f + dt;
+    }
+
+    /* Figure out if we have valid position data from our data sources */
+    bool isGPSValid = sensors(SENSOR_GPS) && posControl.gpsOrigin.valid && ((currentTime - posEstimator.gps.lastUpdateTime) <= MS2US(INAV_GPS_TIMEOUT_MS));
+    bool isBaroValid = sensors(SENSOR_BARO) && ((currentTime - posEstimator.baro.lastUpdateTime) <= MS2US(INAV_BARO_TIMEOUT_MS));
+    bool isSonarValid = sensors(SENSOR_SONAR) && ((currentTime - posEstimator.sonar.lastUpdateTime) <= MS2US(INAV_SONAR_TIMEOUT_MS));
+
+    /* Do some preparations to data */
+    if (isBaroValid) {
+        if (!ARMING_FLAG(ARMED)) {
+            posEstimator.state.baroGroundAlt = posEstimator.est.pos.V.Z;
+            posEstimator.state.isBaroGroundValid = true;
+            posEstimator.state.baroGroundTimeout = currentTime + 250000;   // 0.25 sec
+        }
+        else {
+            if (posEstimator.est.vel.V.Z > 15) {
+                if (currentTime > posEstimator.state.baroGroundTimeout) {
+                    posEstimator.state.isBaroGroundValid = false;
+                }
+            }
+            else {
+                posEstimator.state.baroGroundTimeout = currentTime + 250000;   // 0.25 sec
+            }
+        }
+    }
+    else {
+        posEstimator.state.isBaroGroundValid = false;
+    }
+
+    /* We might be experiencing air cushion effect - use sonar or baro groung altitude to detect it */
+    bool isAirCushionEffectDetected = ARMING_FLAG(ARMED) &&
+                                        ((isSonarValid && posEstimator.sonar.alt < 20.0f && posEstimator.state.isBaroGroundValid) ||
+                                         (isBaroValid && posEstimator.state.isBaroGroundValid && posEstimator.baro.alt < posEstimator.state.baroGroundAlt));
+
+#if defined(NAV_GPS_GLITCH_DETECTION)
+    //isGPSValid = isGPSValid && !posEstimator.gps.glitchDetected;
+#endif
+
+    /* Apply GPS altitude corrections only on fixed wing aircrafts */
+    bool useGpsZ = STATE(FIXED_WING) && isGPSValid;
+
+#if defined(USE_NAV_EKF)
+    if (posControl.navConfig->inav.estimator == NAV_POS_ESTIMATOR_EKF) {
+        updateEstimatedTopicEkf(dt, isGPSValid, isBaroValid, isSonarValid, useGpsZ, isAirCushionEffectDetected);
+    }
+    else {
+        updateEstimatedTopicComplementary(dt, isGPSValid, isBaroValid, useGpsZ, isAirCushionEffectDetected);
+    }
+#else
+    updateEstimatedTopicComplementary(dt, isGPSValid, isBaroValid, useGpsZ, isAirCushionEffectDetected);
+#endif
 
     /* Surface offset */
 #if defined(SONAR)
@@ -663,14 +862,6 @@ static void publishEstimatedTopic(uint32_t currentTime)
         else {
             updateActualSurfaceDistance(false, -1, 0);
         }
-
-        /* Store history data */
-        posEstimator.history.pos[posEstimator.history.index] = posEstimator.est.pos;
-        posEstimator.history.vel[posEstimator.history.index] = posEstimator.est.vel;
-        posEstimator.history.index++;
-        if (posEstimator.history.index >= INAV_HISTORY_BUF_SIZE) {
-            posEstimator.history.index = 0;
-        }
     }
 }
 
@@ -681,6 +872,17 @@ bool isGPSGlitchDetected(void)
 }
 #endif
 
+/* Estimated horizontal and vertical position error (cm), above max_eph_epv the estimate is not published as valid */
+float getPositionEstimateEPH(void)
+{
+    return posEstimator.est.eph;
+}
+
+float getPositionEstimateEPV(void)
+{
+    return posEstimator.est.epv;
+}
+
 /**
  * Initialize position estimator
  *  Should be called once before any update occurs
@@ -697,6 +899,11 @@ void initializePositionEstimator(void)
     posEstimator.sonar.lastUpdateTime = 0;
 
     posEstimator.history.index = 0;
+    posEstimator.history.count = 0;
+
+#if defined(USE_NAV_EKF)
+    navEkfInit();
+#endif
 
     for (axis = 0; axis < 3; axis++) {
         posEstimator.imu.accelBias.A[axis] = 0;
@@ -704,17 +911,17 @@ void initializePositionEstimator(void)
         posEstimator.est.vel.A[axis] = 0;
     }
 
-    memset(&posEstimator.history.pos[0], 0, sizeof(posEstimator.history.pos));
-    memset(&posEstimator.history.vel[0], 0, sizeof(posEstimator.history.vel));
+    memset(&posEstimator.history.snapshot[0], 0, sizeof(posEstimator.history.snapshot));
 }
 
 /**
  * Update estimator
- *  Update rate: loop rate (>100Hz)
+ *  Update rate: inav_update_rate_hz, runs in TASK_POS_ESTIMATOR
  */
 void updatePositionEstimator(void)
 {
     static bool isInitialized = false;
+    static navigationTimer_t historyTimer;
 
     if (!isInitialized) {
         initializePositionEstimator();
@@ -740,6 +947,11 @@ void updatePositionEstimator(void)
 
     /* Publish estimate */
     publishEstimatedTopic(currentTime);
+
+    /* Keep history for GPS delay compensation */
+    if (updateTimer(&historyTimer, HZ2US(INAV_HISTORY_RATE_HZ), currentTime)) {
+        storeEstimateHistory(currentTime);
+    }
 }
 
 #endif
\ No newline at end of file
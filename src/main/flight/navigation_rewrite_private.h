@@ -228,6 +228,12 @@ typedef struct {
     navigationFSMState_t                onEvent[NAV_FSM_EVENT_COUNT];
 } navigationFSMStateDescriptor_t;
 
+/* Controller output for the PID loop, only complete setpoints are handed over */
+typedef struct navSetpoint_s {
+    int16_t rcCommand[4];           // same channel order as rcCommand[]
+    uint8_t rcCommandMask;          // bit per rcCommand[] channel taken over by navigation
+} navSetpoint_t;
+
 typedef struct {
     /* Flags and navigation system state */
     navigationFSMState_t        navState;
@@ -256,13 +262,12 @@ typedef struct {
     uint32_t                    homeDistance;   // cm
     int32_t                     homeDirection;  // deg*100
 
-    /* Waypoint list */
-    navWaypoint_t               waypointList[NAV_MAX_WAYPOINTS];
+    /* Waypoint list, see navigation_rewrite_mission.c */
     bool                        waypointListValid;
-    int8_t                      waypointCount;
+    int16_t                     waypointCount;
 
     navWaypointPosition_t       activeWaypoint;     // Local position and initial bearing, filled on waypoint activation
-    int8_t                      activeWaypointIndex;
+    int16_t                     activeWaypointIndex;
 
     /* Internals */
     int16_t                     rcAdjustment[4];
@@ -302,6 +307,14 @@ bool isWaypointMissed(navWaypointPosition_t * waypoint);
 bool isApproachingLastWaypoint(void);
 float getActiveWaypointSpeed(void);
 
+const navWaypoint_t * getMissionWaypoint(int16_t index);
+void prefetchMissionWaypoints(int16_t index);
+bool readMissionWaypoint(int16_t index, navWaypoint_t * waypoint);
+bool appendMissionWaypoint(int16_t index, const navWaypoint_t * waypoint);
+void resetMission(void);
+
+void setNavigationRcCommand(uint8_t channel, int16_t value);
+
 void updateActualHeading(int32_t newHeading);
 void updateActualHorizontalPositionAndVelocity(bool hasValidSensor, float newX, float newY, float newVelX, float newVelY);
 void updateActualAltitudeAndClimbRate(bool hasValidSensor, float newAltitude, float newVelocity);
@@ -310,6 +323,8 @@ void updateActualSurfaceDistance(bool hasValidSensor, float surfaceDistance, flo
 bool checkForPositionSensorTimeout(void);
 
 bool isGPSGlitchDetected(void);
+float getPositionEstimateEPH(void);
+float getPositionEstimateEPV(void);
 
 /* Multicopter-specific functions */
 void setupMulticopterAltitudeController(void);
@@ -58,10 +58,6 @@ typedef struct {
     float gyroRate;
     float rateTarget;
 
-    // Buffer for derivative calculation
-#define DTERM_BUF_COUNT 5
-    float dTermBuf[DTERM_BUF_COUNT];
-
     // Rate integrator
     float errorGyroIf;
     float errorGyroIfLimit;
@@ -75,6 +71,11 @@ typedef struct {
     // Rate filtering
     filterStatePt1_t ptermLpfState;
     filterStatePt1_t deltaLpfState;
+    biquad_t deltaNotchState;
+#ifdef USE_FIXED_POINT_MATH
+    biquadFixed_t deltaNotchFixed;
+    pt1FilterFixed_t deltaLpfFixed;
+#endif
 } pidState_t;
 
 extern uint8_t motorCount;
@@ -93,6 +94,29 @@ int32_t axisPID_P[FLIGHT_DYNAMICS_INDEX_COUNT], axisPID_I[FLIGHT_DYNAMICS_INDEX_
 
 static pidState_t pidState[FLIGHT_DYNAMICS_INDEX_COUNT];
 
+// Calculate derivative using 5-point noise-robust differentiators without time delay (one-sided or forward filters)
+// by Pavel Holoborodko, see http://www.holoborodko.com/pavel/numerical-methods/numerical-derivative/smooth-low-noise-differentiators/
+// h[0] = 5/8, h[-1] = 1/4, h[-2] = -1, h[-3] = -1/4, h[-4] = 3/8
+#define DTERM_BUF_COUNT 5
+static const float dtermCoeffs[DTERM_BUF_COUNT] = {5.0f, 2.0f, -8.0f, -2.0f, 3.0f};
+static firFilter_t dtermFilter = { .coeffs = dtermCoeffs, .length = DTERM_BUF_COUNT, .channelCount = FLIGHT_DYNAMICS_INDEX_COUNT };
+
+#ifdef USE_FIXED_POINT_MATH
+// Without FPU the D-term filters run on raw gyro samples and are scaled to float once at the end
+static const int16_t dtermCoeffsFixed[DTERM_BUF_COUNT] = {5, 2, -8, -2, 3};
+static firFilterFixed_t dtermFilterFixed = { .coeffs = dtermCoeffsFixed, .length = DTERM_BUF_COUNT, .channelCount = FLIGHT_DYNAMICS_INDEX_COUNT };
+
+// Fixed-point PT1 gain is precomputed for the nominal looptime
+static uint32_t dtermLpfLooptime;
+static uint16_t dtermLpfHz;
+#endif
+
+// D-term notch is rebuilt whenever its settings or the loop rate change
+static bool dtermNotchEnabled;
+static uint32_t dtermNotchLooptime;
+static uint16_t dtermNotchHz;
+static uint16_t dtermNotchQ;
+
 void pidResetErrorAccumulators(void)
 {
     // Reset R/P/Y integrator
@@ -258,17 +282,30 @@ static void pidApplyRateController(const pidProfile_t *pidProfile, pidState_t *p
         // optimisation for when D8 is zero, often used by YAW axis
         newDTerm = 0;
     } else {
-        // Calculate derivative using 5-point noise-robust differentiators without time delay (one-sided or forward filters)
-        // by Pavel Holoborodko, see http://www.holoborodko.com/pavel/numerical-methods/numerical-derivative/smooth-low-noise-differentiators/
-        // h[0] = 5/8, h[-1] = 1/4, h[-2] = -1, h[-3] = -1/4, h[-4] = 3/8
-        static const float dtermCoeffs[DTERM_BUF_COUNT] = {5.0f, 2.0f, -8.0f, -2.0f, 3.0f};
-        filterUpdateFIR(DTERM_BUF_COUNT, pidState->dTermBuf, pidState->gyroRate);
-        newDTerm = filterApplyFIR(DTERM_BUF_COUNT, pidState->dTermBuf, dtermCoeffs, -pidState->kD / (8 * dT));
-
-        // Apply additional lowpass
+#ifdef USE_FIXED_POINT_MATH
+        int32_t deltaFixed = firFilterFixedApply(&dtermFilterFixed, axis, gyroADC[axis]);
+
+        if (dtermNotchEnabled) {
+            deltaFixed = filterApplyBiQuadFixed(deltaFixed, &pidState->deltaNotchFixed);
+        }
+
+        if (pidProfile->dterm_lpf_hz) {
+            deltaFixed = filterApplyPt1Fixed(deltaFixed, &pidState->deltaLpfFixed);
+        }
+
+        newDTerm = deltaFixed * (-pidState->kD * gyro.scale / (8 * dT));
+#else
+        newDTerm = firFilterApply(&dtermFilter, axis, pidState->gyroRate) * (-pidState->kD / (8 * dT));
+
+        // Apply additional notch and lowpass
+        if (dtermNotchEnabled) {
+            newDTerm = filterApplyBiQuad(newDTerm, &pidState->deltaNotchState);
+        }
+
         if (pidProfile->dterm_lpf_hz) {
             newDTerm = filterApplyPt1(newDTerm, &pidState->deltaLpfState, pidProfile->dterm_lpf_hz, dT);
         }
+#endif
     }
 
     // TODO: Get feedback from mixer on available correction range for each axis
@@ -395,8 +432,53 @@ float pidMagHold(const pidProfile_t *pidProfile)
     return magHoldRate;
 }
 
+static void pidUpdateDTermNotch(const pidProfile_t *pidProfile)
+{
+    if (dtermNotchLooptime == targetLooptime && dtermNotchHz == pidProfile->dterm_notch_hz && dtermNotchQ == pidProfile->dterm_notch_q) {
+        return;
+    }
+
+    dtermNotchLooptime = targetLooptime;
+    dtermNotchHz = pidProfile->dterm_notch_hz;
+    dtermNotchQ = pidProfile->dterm_notch_q;
+    dtermNotchEnabled = false;
+
+    if (dtermNotchHz && targetLooptime) {
+        dtermNotchEnabled = true;
+        for (int axis = 0; axis < 3; axis++) {
+            // Notch at or above Nyquist for the current looptime is skipped
+            dtermNotchEnabled &= filterInitBiQuadOfType(&pidState[axis].deltaNotchState, FILTER_BIQUAD_NOTCH, dtermNotchHz, dtermNotchQ / 100.0f, 0);
+#ifdef USE_FIXED_POINT_MATH
+            filterInitBiQuadFixed(&pidState[axis].deltaNotchFixed, &pidState[axis].deltaNotchState);
+#endif
+        }
+    }
+}
+
+#ifdef USE_FIXED_POINT_MATH
+static void pidUpdateDTermLpfFixed(const pidProfile_t *pidProfile)
+{
+    if (dtermLpfLooptime == targetLooptime && dtermLpfHz == pidProfile->dterm_lpf_hz) {
+        return;
+    }
+
+    dtermLpfLooptime = targetLooptime;
+    dtermLpfHz = pidProfile->dterm_lpf_hz;
+
+    if (dtermLpfHz && targetLooptime) {
+        for (int axis = 0; axis < 3; axis++) {
+            filterInitPt1Fixed(&pidState[axis].deltaLpfFixed, dtermLpfHz, targetLooptime * 1e-6f);
+        }
+    }
+}
+#endif
+
 void pidController(const pidProfile_t *pidProfile, const controlRateConfig_t *controlRateConfig, const rxConfig_t *rxConfig)
 {
+    pidUpdateDTermNotch(pidProfile);
+#ifdef USE_FIXED_POINT_MATH
+    pidUpdateDTermLpfFixed(pidProfile);
+#endif
 
     uint8_t magHoldState = getMagHoldState();
 
@@ -63,6 +63,8 @@
 
 #include "config/config.h"
 
+#include "scheduler/scheduler.h"
+
 #include "display.h"
 
 controlRateConfig_t *getControlRateConfig(uint8_t profileIndex);
@@ -299,9 +301,16 @@ void showArmedPage(void)
 }
 #endif
 
+static taskContinuation_t statusPageContinuation;
+
+// Each line is an I2C transfer of several hundred microseconds, page is drawn a few lines per time slice
 void showStatusPage(void)
 {
-    uint8_t rowIndex = PAGE_TITLE_LINE_COUNT;
+    static uint8_t rowIndex;
+
+    TASK_BEGIN(statusPageContinuation);
+
+    rowIndex = PAGE_TITLE_LINE_COUNT;
 
     if (feature(FEATURE_VBAT)) {
         i2c_OLED_set_line(rowIndex++);        
@@ -311,6 +320,7 @@ void showStatusPage(void)
         
         uint8_t batteryPercentage = calculateBatteryPercentage();
         drawHorizonalPercentageBar(10, batteryPercentage);
+        TASK_YIELD_IF_EXPIRED(statusPageContinuation);
     }
 
     if (feature(FEATURE_CURRENT_METER)) {
@@ -321,6 +331,7 @@ void showStatusPage(void)
         
         uint8_t capacityPercentage = calculateBatteryCapacityRemainingPercentage();
         drawHorizonalPercentageBar(10, capacityPercentage);
+        TASK_YIELD_IF_EXPIRED(statusPageContinuation);
     }
     
     rowIndex++;
@@ -336,17 +347,19 @@ void showStatusPage(void)
         padHalfLineBuffer();
         i2c_OLED_set_xy(HALF_SCREEN_CHARACTER_COLUMN_COUNT, rowIndex++);
         i2c_OLED_send_string(lineBuffer);
-        
+        TASK_YIELD_IF_EXPIRED(statusPageContinuation);
+
         tfp_sprintf(lineBuffer, "HDOP: %d.%1d", gpsSol.hdop / 100, gpsSol.hdop % 100);
         padLineBuffer();
         i2c_OLED_set_line(rowIndex++);
         i2c_OLED_send_string(lineBuffer);
+        TASK_YIELD_IF_EXPIRED(statusPageContinuation);
 
         tfp_sprintf(lineBuffer, "La/Lo: %d/%d", gpsSol.llh.lat / GPS_DEGREES_DIVIDER, gpsSol.llh.lon / GPS_DEGREES_DIVIDER);
         padLineBuffer();
         i2c_OLED_set_line(rowIndex++);
         i2c_OLED_send_string(lineBuffer);
-        
+        TASK_YIELD_IF_EXPIRED(statusPageContinuation);
     }
 #endif
     
@@ -356,6 +369,7 @@ void showStatusPage(void)
         padHalfLineBuffer();
         i2c_OLED_set_line(rowIndex);
         i2c_OLED_send_string(lineBuffer);
+        TASK_YIELD_IF_EXPIRED(statusPageContinuation);
     }
 #endif
 
@@ -367,15 +381,20 @@ void showStatusPage(void)
         i2c_OLED_set_xy(HALF_SCREEN_CHARACTER_COLUMN_COUNT, rowIndex);
         i2c_OLED_send_string(lineBuffer);
     }
-#endif    
-    
+#endif
+
+    TASK_END(statusPageContinuation);
 }
 
 void updateDisplay(void)
 {
-    uint32_t now = micros();
+    static taskContinuation_t continuation;
     static uint8_t previousArmedState = 0;
+    static bool armedState;
+
+    TASK_BEGIN(continuation);
 
+    uint32_t now = micros();
     bool pageChanging = false;
     bool updateNow = (int32_t)(now - nextDisplayUpdateAt) >= 0L;
 
@@ -385,7 +404,7 @@ void updateDisplay(void)
 
     nextDisplayUpdateAt = now + DISPLAY_UPDATE_FREQUENCY;
 
-    bool armedState = ARMING_FLAG(ARMED) ? true : false;
+    armedState = ARMING_FLAG(ARMED) ? true : false;
     bool armedStateChanged = armedState != previousArmedState;
     previousArmedState = armedState;
 
@@ -426,6 +445,7 @@ void updateDisplay(void)
         
         i2c_OLED_clear_display_quick();
         showTitle();
+        TASK_YIELD_IF_EXPIRED(continuation);
     }
 
     if (!displayPresent) {
@@ -444,11 +464,19 @@ void updateDisplay(void)
             break;
     }
 
+    while (statusPageContinuation != 0) {
+        TASK_YIELD(continuation);
+        showStatusPage();
+    }
+
     if (!armedState) {
         updateFailsafeStatus();
+        TASK_YIELD_IF_EXPIRED(continuation);
         updateRxStatus();
         updateTicker();
     }
+
+    TASK_END(continuation);
 }
 
 void displaySetPage(pageId_e newPageId)
@@ -33,9 +33,19 @@
 #include <stdbool.h>
 #include <string.h>
 
+#include "platform.h"
+
+#include "common/maths.h"
+
 #include "drivers/flash_m25p16.h"
 #include "flashfs.h"
 
+#if defined(NAV) && defined(USE_NAV_MISSION_STORE)
+#define FLASHFS_RESERVED_SIZE NAV_MISSION_STORE_SIZE
+#else
+#define FLASHFS_RESERVED_SIZE 0
+#endif
+
 static uint8_t flashWriteBuffer[FLASHFS_WRITE_BUFFER_SIZE];
 
 /* The position of our head and tail in the circular flash write buffer.
@@ -50,6 +60,9 @@ static uint8_t bufferHead = 0, bufferTail = 0;
 // The position of the buffer's tail in the overall flash address space:
 static uint32_t tailAddress = 0;
 
+// Sectors still to be erased when the volume or the reserved area is erased sector by sector, [eraseNextSector...eraseEndSector)
+static uint16_t eraseNextSector = 0, eraseEndSector = 0;
+
 static void flashfsClearBuffer()
 {
     bufferTail = bufferHead = 0;
@@ -65,15 +78,76 @@ static void flashfsSetTailAddress(uint32_t address)
     tailAddress = address;
 }
 
+/**
+ * Issue the next sector erase of a pending volume or reserved area erase once the chip is idle.
+ *
+ * Returns true while the erase is still in progress.
+ */
+static bool flashfsContinueErase()
+{
+    if (eraseNextSector >= eraseEndSector) {
+        return false;
+    }
+
+    if (m25p16_isReady()) {
+        m25p16_eraseSector(eraseNextSector * m25p16_getGeometry()->sectorSize);
+        eraseNextSector++;
+    }
+
+    return true;
+}
+
+/**
+ * Add the sectors [startSector...endSector) to the ones still to be erased and issue the first erase if the chip is idle.
+ *
+ * The volume and the reserved area are adjacent, so a pending erase is simply widened to cover both ranges. An erase
+ * requested while the other one is in progress doesn't drop the sectors that one still had to erase.
+ */
+static void flashfsQueueErase(uint16_t startSector, uint16_t endSector)
+{
+    if (eraseNextSector < eraseEndSector) {
+        startSector = MIN(startSector, eraseNextSector);
+        endSector = MAX(endSector, eraseEndSector);
+    }
+
+    eraseNextSector = startSector;
+    eraseEndSector = endSector;
+
+    flashfsContinueErase();
+}
+
+/**
+ * Erase the volume. This doesn't block, flashfsIsReady() returns false until the erase completes.
+ *
+ * If the end of the chip is reserved, the volume is erased one sector at a time on later calls to flashfsIsReady()
+ * so that the reserved sectors survive.
+ */
 void flashfsEraseCompletely()
 {
-    m25p16_eraseCompletely();
+    if (flashfsGetReservedSize() > 0) {
+        flashfsQueueErase(0, flashfsGetSize() / m25p16_getGeometry()->sectorSize);
+    } else {
+        m25p16_eraseCompletely();
+    }
 
     flashfsClearBuffer();
 
     flashfsSetTailAddress(0);
 }
 
+/**
+ * Erase the sectors reserved at the end of the chip. This doesn't block, flashfsIsReady() returns false until the
+ * erase completes. A volume erase still in progress is completed as well.
+ */
+void flashfsEraseReserved()
+{
+    if (flashfsGetReservedSize() == 0) {
+        return;
+    }
+
+    flashfsQueueErase(flashfsGetSize() / m25p16_getGeometry()->sectorSize, m25p16_getGeometry()->sectors);
+}
+
 /**
  * Start and end must lie on sector boundaries, or they will be rounded out to sector boundaries such that
  * all the bytes in the range [start...end) are erased.
@@ -106,12 +180,35 @@ void flashfsEraseRange(uint32_t start, uint32_t end)
  */
 bool flashfsIsReady()
 {
-    return m25p16_isReady();
+    return !flashfsContinueErase() && m25p16_isReady();
+}
+
+/**
+ * Size of the area at the end of the chip which is left out of the volume, a whole number of sectors.
+ *
+ * The area starts at flashfsGetSize().
+ */
+uint32_t flashfsGetReservedSize()
+{
+    const flashGeometry_t *geometry = m25p16_getGeometry();
+
+    if (FLASHFS_RESERVED_SIZE == 0 || geometry->sectorSize == 0) {
+        return 0;
+    }
+
+    const uint32_t reservedSize = ((FLASHFS_RESERVED_SIZE + geometry->sectorSize - 1) / geometry->sectorSize) * geometry->sectorSize;
+
+    // Don't take a small chip away from the blackbox
+    if (reservedSize * 2 > geometry->totalSize) {
+        return 0;
+    }
+
+    return reservedSize;
 }
 
 uint32_t flashfsGetSize()
 {
-    return m25p16_getGeometry()->totalSize;
+    return m25p16_getGeometry()->totalSize - flashfsGetReservedSize();
 }
 
 static uint32_t flashfsTransmitBufferUsed()
@@ -172,6 +269,11 @@ static uint32_t flashfsWriteBuffers(uint8_t const **buffers, uint32_t *bufferSiz
         bytesTotal += bufferSizes[i];
     }
 
+    // The sectors ahead of us might not be erased yet, drop the data like the chip would during a complete erase
+    if (flashfsContinueErase() && eraseEndSector * m25p16_getGeometry()->sectorSize <= flashfsGetSize()) {
+        return 0;
+    }
+
     if (!sync && !m25p16_isReady()) {
         return 0;
     }
@@ -479,6 +581,66 @@ int flashfsReadAbs(uint32_t address, uint8_t *buffer, unsigned int len)
     return bytesRead;
 }
 
+/**
+ * Read from the sectors reserved at the end of the chip, `offset` is relative to their start.
+ *
+ * The volume's write buffer is left alone, only a page program already in progress is waited for. Nothing is read
+ * while an erase is in progress. Returns the number of bytes actually read.
+ */
+int flashfsReadReserved(uint32_t offset, uint8_t *buffer, unsigned int len)
+{
+    const uint32_t reservedSize = flashfsGetReservedSize();
+
+    if (offset >= reservedSize || flashfsContinueErase()) {
+        return 0;
+    }
+
+    if (offset + len > reservedSize) {
+        len = reservedSize - offset;
+    }
+
+    return m25p16_readBytes(flashfsGetSize() + offset, buffer, len);
+}
+
+/**
+ * Program erased bytes of the sectors reserved at the end of the chip, `offset` is relative to their start.
+ *
+ * Like flashfsReadReserved(), this only waits for a page program already in progress. Returns the number of bytes
+ * actually written.
+ */
+int flashfsWriteReserved(uint32_t offset, const uint8_t *data, unsigned int len)
+{
+    const uint32_t reservedSize = flashfsGetReservedSize();
+    int bytesWritten = 0;
+
+    if (offset >= reservedSize || flashfsContinueErase()) {
+        return 0;
+    }
+
+    if (offset + len > reservedSize) {
+        len = reservedSize - offset;
+    }
+
+    while (len > 0) {
+        const uint32_t address = flashfsGetSize() + offset;
+        // Each page needs to be saved in a separate program operation
+        uint32_t bytesThisIteration = M25P16_PAGESIZE - address % M25P16_PAGESIZE;
+
+        if (bytesThisIteration > len) {
+            bytesThisIteration = len;
+        }
+
+        m25p16_pageProgram(address, data, bytesThisIteration);
+
+        offset += bytesThisIteration;
+        data += bytesThisIteration;
+        len -= bytesThisIteration;
+        bytesWritten += bytesThisIteration;
+    }
+
+    return bytesWritten;
+}
+
 /**
  * Find the offset of the start of the free space on the device (or the size of the device if it is full).
  */
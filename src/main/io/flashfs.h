@@ -29,8 +29,10 @@
 
 void flashfsEraseCompletely();
 void flashfsEraseRange(uint32_t start, uint32_t end);
+void flashfsEraseReserved();
 
 uint32_t flashfsGetSize();
+uint32_t flashfsGetReservedSize();
 uint32_t flashfsGetOffset();
 uint32_t flashfsGetWriteBufferFreeSpace();
 uint32_t flashfsGetWriteBufferSize();
@@ -44,6 +46,8 @@ void flashfsWriteByte(uint8_t byte);
 void flashfsWrite(const uint8_t *data, unsigned int len, bool sync);
 
 int flashfsReadAbs(uint32_t offset, uint8_t *data, unsigned int len);
+int flashfsReadReserved(uint32_t offset, uint8_t *buffer, unsigned int len);
+int flashfsWriteReserved(uint32_t offset, const uint8_t *data, unsigned int len);
 
 bool flashfsFlushAsync();
 void flashfsFlushSync();
@@ -49,6 +49,8 @@
 #include "config/config.h"
 #include "config/runtime_config.h"
 
+#include "scheduler/scheduler.h"
+
 #ifdef GPS
 
 // GPS timeout for wrong baud rate/disconnection/etc in milliseconds (default 2000 ms)
@@ -162,6 +164,12 @@ static void gpsResetSolution(void)
     gpsSol.flags.validMag = 0;
 }
 
+// Called from UART interrupt when GPS stops sending, whole message burst is waiting in the buffer
+static void gpsSerialIdle(void)
+{
+    signalTask(TASK_GPS);
+}
+
 void gpsPreInit(gpsConfig_t *initialGpsConfig)
 {
     // Make sure gpsProvider is known when gpsMagDetect is called
@@ -212,6 +220,7 @@ void gpsInit(serialConfig_t *initialSerialConfig, gpsConfig_t *initialGpsConfig)
                 featureClear(FEATURE_GPS);
             }
             else {
+                serialSetIdleCallback(gpsState.gpsPort, gpsSerialIdle);
                 gpsSetState(GPS_INITIALIZING);
                 return;
             }
@@ -238,6 +247,7 @@ static void gpsFakeGPSUpdate(void)
         gpsSol.flags.validEPE = 1;
         gpsSol.eph = 100;
         gpsSol.epv = 100;
+        gpsSol.arrivalTime = micros();
 
         ENABLE_STATE(GPS_FIX);
         sensorsSet(SENSOR_GPS);
@@ -265,6 +275,17 @@ void gpsFinalizeChangeBaud(void)
     }
 }
 
+/*
+ * Called by serial protocol parsers on the first byte of a frame. Bytes still waiting in the RX buffer arrived after it,
+ * back off their transfer time (10 bits per byte) to estimate when the frame started to arrive.
+ */
+void gpsMarkFrameStart(void)
+{
+    const uint32_t byteTimeUs = 10 * 1000000 / baudRates[gpsToSerialBaudRate[gpsState.baudrateIndex]];
+
+    gpsState.frameStartUs = micros() - (serialRxBytesWaiting(gpsState.gpsPort) + 1) * byteTimeUs;
+}
+
 uint16_t gpsConstrainEPE(uint32_t epe)
 {
     return (epe > 99999) ? 9999 : epe; // max 99.99m error
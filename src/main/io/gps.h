@@ -120,6 +120,8 @@ typedef struct gpsSolutionData_s {
     uint16_t epv;   // vertical accuracy (cm)
 
     uint16_t hdop;  // generic HDOP value (*100)
+
+    uint32_t arrivalTime;   // estimated arrival of the first byte of the position message (us)
 } gpsSolutionData_t;
 
 typedef struct {
@@ -88,6 +88,7 @@ bool gpsPollI2CNAV(void)
                 gpsSol.llh.lat = gpsMsg.latitude;
                 gpsSol.llh.lon = gpsMsg.longitude;
                 gpsSol.llh.alt = gpsMsg.altitude;
+                gpsSol.arrivalTime = micros();      // polled, no better estimate
                 gpsSol.flags.validVelNE = 0;
                 gpsSol.flags.validVelD = 0;
                 gpsSol.flags.validEPE = 0;
@@ -161,6 +161,7 @@ static bool NAZA_parse_gps(void)
         gpsSol.llh.lon = decodeLong(_buffernaza.nav.longitude, mask);
         gpsSol.llh.lat = decodeLong(_buffernaza.nav.latitude, mask);
         gpsSol.llh.alt = decodeLong(_buffernaza.nav.altitude_msl, mask) / 10.0f;  //alt in cm
+        gpsSol.arrivalTime = gpsState.frameStartUs;
 
         uint8_t fixType = _buffernaza.nav.fix_type ^ mask;
         //uint8_t fixFlags = _buffernaza.nav.fix_status ^ mask;
@@ -240,6 +241,7 @@ static bool gpsNewFrameNAZA(uint8_t data)
     switch (_step) {
         case 0: // Sync char 1 (0x55)
             if (HEADER1 == data) {
+                gpsMarkFrameStart();
                 _skip_packet = false;
                 _step++;
             }
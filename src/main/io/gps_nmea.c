@@ -106,6 +106,7 @@ static bool gpsNewFrameNMEA(char c)
 
     switch (c) {
         case '$':
+            gpsMarkFrameStart();
             param = 0;
             offset = 0;
             parity = 0;
@@ -193,6 +194,7 @@ static bool gpsNewFrameNMEA(char c)
                             gpsSol.llh.lat = gps_Msg.latitude;
                             gpsSol.llh.lon = gps_Msg.longitude;
                             gpsSol.llh.alt = gps_Msg.altitude;
+                            gpsSol.arrivalTime = gpsState.frameStartUs;
 
                             // EPH/EPV are unreliable for NMEA as they are not real accuracy
                             gpsSol.hdop = gpsConstrainHDOP(gps_Msg.hdop);
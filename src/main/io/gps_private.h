@@ -47,6 +47,7 @@ typedef struct {
     uint32_t        lastStateSwitchMs;
     uint32_t        lastLastMessageMs;
     uint32_t        lastMessageMs;
+    uint32_t        frameStartUs;           // Serial GPS only, estimated arrival of the first byte of the frame being parsed
 } gpsReceiverData_t;
 
 extern gpsReceiverData_t gpsState;
@@ -55,6 +56,7 @@ extern baudRate_e gpsToSerialBaudRate[GPS_BAUDRATE_COUNT];
 
 extern void gpsSetState(gpsState_e state);
 extern void gpsFinalizeChangeBaud(void);
+extern void gpsMarkFrameStart(void);
 
 extern uint16_t gpsConstrainEPE(uint32_t epe);
 extern uint16_t gpsConstrainHDOP(uint32_t hdop);
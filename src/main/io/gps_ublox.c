@@ -371,6 +371,7 @@ static bool gpsParceFrameUBLOX(void)
         gpsSol.llh.alt = _buffer.posllh.altitude_msl / 10;  //alt in cm
         gpsSol.eph = gpsConstrainEPE(_buffer.posllh.horizontal_accuracy / 10);
         gpsSol.epv = gpsConstrainEPE(_buffer.posllh.vertical_accuracy / 10);
+        gpsSol.arrivalTime = gpsState.frameStartUs;
         if (next_fix_type != GPS_NO_FIX)
             gpsSol.fixType = next_fix_type;
         _new_position = true;
@@ -404,6 +405,7 @@ static bool gpsParceFrameUBLOX(void)
         gpsSol.llh.lon = _buffer.pvt.longitude;
         gpsSol.llh.lat = _buffer.pvt.latitude;
         gpsSol.llh.alt = _buffer.pvt.altitude_msl / 10;  //alt in cm
+        gpsSol.arrivalTime = gpsState.frameStartUs;
         gpsSol.velNED[X]=_buffer.pvt.ned_north / 10;  // to cm/s
         gpsSol.velNED[Y]=_buffer.pvt.ned_east / 10;   // to cm/s
         gpsSol.velNED[Z]=_buffer.pvt.ned_down / 10;   // to cm/s
@@ -448,6 +450,7 @@ static bool gpsNewFrameUBLOX(uint8_t data)
     switch (_step) {
         case 0: // Sync char 1 (0xB5)
             if (PREAMBLE1 == data) {
+                gpsMarkFrameStart();
                 _skip_packet = false;
                 _step++;
             }
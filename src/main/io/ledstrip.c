@@ -49,6 +49,8 @@
 #include "config/runtime_config.h"
 #include "config/config.h"
 
+#include "scheduler/scheduler.h"
+
 static bool ledStripInitialised = false;
 static bool ledStripEnabled = true;
 
@@ -874,8 +876,20 @@ static void applyLedAnimationLayer(void)
 
 void updateLedStrip(void)
 {
+    // Layers are applied over several time slices, state has to survive a yield
+    static taskContinuation_t continuation;
+    static uint32_t now;
+    static bool indicatorFlashNow;
+    static bool warningFlashNow;
+    static bool rotationUpdateNow;
+#ifdef USE_LED_ANIMATION
+    static bool animationUpdateNow;
+#endif
+    static uint8_t indicatorFlashState = 0;
 
-	if (!(ledStripInitialised && isWS2811LedStripReady())) {
+    TASK_BEGIN(continuation);
+
+    if (!(ledStripInitialised && isWS2811LedStripReady())) {
         return;
     }
 
@@ -893,13 +907,13 @@ void updateLedStrip(void)
     }
     
 
-    uint32_t now = micros();
+    now = micros();
 
-    bool indicatorFlashNow = (int32_t)(now - nextIndicatorFlashAt) >= 0L;
-    bool warningFlashNow = (int32_t)(now - nextWarningFlashAt) >= 0L;
-    bool rotationUpdateNow = (int32_t)(now - nextRotationUpdateAt) >= 0L;
+    indicatorFlashNow = (int32_t)(now - nextIndicatorFlashAt) >= 0L;
+    warningFlashNow = (int32_t)(now - nextWarningFlashAt) >= 0L;
+    rotationUpdateNow = (int32_t)(now - nextRotationUpdateAt) >= 0L;
 #ifdef USE_LED_ANIMATION
-    bool animationUpdateNow = (int32_t)(now - nextAnimationUpdateAt) >= 0L;
+    animationUpdateNow = (int32_t)(now - nextAnimationUpdateAt) >= 0L;
 #endif
     if (!(
             indicatorFlashNow ||
@@ -912,11 +926,10 @@ void updateLedStrip(void)
         return;
     }
 
-    static uint8_t indicatorFlashState = 0;
-
     // LAYER 1
     applyLedModeLayer();
     applyLedThrottleLayer();
+    TASK_YIELD_IF_EXPIRED(continuation);
 
     // LAYER 2
 
@@ -942,6 +955,7 @@ void updateLedStrip(void)
     }
 
     applyLedIndicatorLayer(indicatorFlashState);
+    TASK_YIELD_IF_EXPIRED(continuation);
 
 #ifdef USE_LED_ANIMATION
     if (animationUpdateNow) {
@@ -963,8 +977,11 @@ void updateLedStrip(void)
 
         nextRotationUpdateAt = now + LED_STRIP_5HZ/animationSpeedScale;
     }
+    TASK_YIELD_IF_EXPIRED(continuation);
 
     ws2811UpdateStrip();
+
+    TASK_END(continuation);
 }
 
 bool parseColor(uint8_t index, const char *colorConfig)
@@ -60,7 +60,7 @@
 #define MSP_PROTOCOL_VERSION                0
 
 #define API_VERSION_MAJOR                   1 // increment when major changes are made
-#define API_VERSION_MINOR                   17 // increment when any change is made, reset to zero when major changes are released after changing API_VERSION_MAJOR
+#define API_VERSION_MINOR                   23 // increment when any change is made, reset to zero when major changes are released after changing API_VERSION_MAJOR
 
 #define API_VERSION_LENGTH                  2
 
@@ -240,6 +240,15 @@
 #define MSP_UID                  160    //out message         Unique device ID
 #define MSP_GPSSVINFO            164    //out message         get Signal Strength (only U-Blox)
 #define MSP_GPSSTATISTICS        166    //out message         get GPS debugging data
+#define MSP_TASK_STATS           170    //out message         task execution time and start latency histograms with p50/p95/p99, param: task id
+#define MSP_LOOPTIME_GOVERNOR    171    //out message         governor state, loop time divider, current and boot looptime, system load
+#define MSP_FILTER_CONFIG        172    //out message         gyro and D-term LPF cutoff, gyro and D-term notch center frequency and Q
+#define MSP_SET_FILTER_CONFIG    173    //in message          gyro and D-term LPF cutoff, gyro and D-term notch center frequency and Q
+#define MSP_IMU_EKF_STATUS       174    //out message         attitude estimator, EKF attitude and gyro bias standard deviations, gyro bias, innovation ratio, rejections
+#define MSP_GYRO_CALIBRATION     175    //out message         gyro calibration state, duration, samples, restarts, zero and residual noise per axis
+#define MSP_WP_MISSION           176    //out message         waypoint count, mission state (incomplete, valid, busy) and up to a frame of packed waypoints, param: first waypoint
+#define MSP_SET_WP_MISSION       177    //in message          first waypoint, count and packed waypoints, first waypoint 0 starts a new mission
+#define MSP_SET_WP_MISSION_END   178    //in message          waypoint count and CRC32 of all packed waypoints, makes the uploaded mission valid
 #define MSP_ACC_TRIM             240    //out message         get acc angle trim values
 #define MSP_SET_ACC_TRIM         239    //in message          set acc angle trim values
 #define MSP_SERVO_MIX_RULES      241    //out message         Returns servo mixer configuration
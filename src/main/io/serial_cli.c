@@ -386,6 +386,22 @@ static const char * const lookupTableFailsafeProcedure[] = {
     "SET-THR", "DROP", "RTH"
 };
 
+static const char * const lookupTableSchedulerPolicy[] = {
+    "DYNAMIC", "EDF"
+};
+
+#ifdef USE_IMU_EKF
+static const char * const lookupTableImuEstimator[] = {
+    "MAHONY", "EKF"
+};
+#endif
+
+#ifdef USE_NAV_EKF
+static const char * const lookupTableNavEstimator[] = {
+    "COMPLEMENTARY", "EKF"
+};
+#endif
+
 #ifdef NAV
 static const char * const lookupTableNavControlMode[] = {
     "ATTI", "CRUISE"
@@ -419,6 +435,13 @@ typedef enum {
     TABLE_SERIAL_RX,
     TABLE_GYRO_LPF,
     TABLE_FAILSAFE_PROCEDURE,
+    TABLE_SCHEDULER_POLICY,
+#ifdef USE_IMU_EKF
+    TABLE_IMU_ESTIMATOR,
+#endif
+#ifdef USE_NAV_EKF
+    TABLE_NAV_ESTIMATOR,
+#endif
 #ifdef NAV
     TABLE_NAV_USER_CTL_MODE,
     TABLE_NAV_RTH_ALT_MODE,
@@ -443,6 +466,13 @@ static const lookupTableEntry_t lookupTables[] = {
     { lookupTableSerialRX, sizeof(lookupTableSerialRX) / sizeof(char *) },
     { lookupTableGyroLpf, sizeof(lookupTableGyroLpf) / sizeof(char *) },
     { lookupTableFailsafeProcedure, sizeof(lookupTableFailsafeProcedure) / sizeof(char *) },
+    { lookupTableSchedulerPolicy, sizeof(lookupTableSchedulerPolicy) / sizeof(char *) },
+#ifdef USE_IMU_EKF
+    { lookupTableImuEstimator, sizeof(lookupTableImuEstimator) / sizeof(char *) },
+#endif
+#ifdef USE_NAV_EKF
+    { lookupTableNavEstimator, sizeof(lookupTableNavEstimator) / sizeof(char *) },
+#endif
 #ifdef NAV
     { lookupTableNavControlMode, sizeof(lookupTableNavControlMode) / sizeof(char *) },
     { lookupTableNavRthAltMode, sizeof(lookupTableNavRthAltMode) / sizeof(char *) },
@@ -505,6 +535,11 @@ const clivalue_t valueTable[] = {
     { "i2c_overclock",              VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP,  &masterConfig.i2c_overclock, .config.lookup = { TABLE_OFF_ON }, 0 },
     { "gyro_sync",                  VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP,  &masterConfig.gyroSync, .config.lookup = { TABLE_OFF_ON } },
     { "gyro_sync_denom",            VAR_UINT8  | MASTER_VALUE,  &masterConfig.gyroSyncDenominator, .config.minmax = { 1,  32 } },
+    { "gyro_oversampling",          VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP,  &masterConfig.gyroSyncOversampling, .config.lookup = { TABLE_OFF_ON }, 0 },
+    { "scheduler_policy",           VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP,  &masterConfig.schedulerPolicy, .config.lookup = { TABLE_SCHEDULER_POLICY }, 0 },
+#ifdef USE_LOOPTIME_GOVERNOR
+    { "looptime_governor",          VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP,  &masterConfig.looptimeGovernor, .config.lookup = { TABLE_OFF_ON }, 0 },
+#endif
 
     { "mid_rc",                     VAR_UINT16 | MASTER_VALUE,  &masterConfig.rxConfig.midrc, .config.minmax = { 1200,  1700 }, 0 },
     { "min_check",                  VAR_UINT16 | MASTER_VALUE,  &masterConfig.rxConfig.mincheck, .config.minmax = { PWM_RANGE_ZERO,  PWM_RANGE_MAX }, 0 },
@@ -568,6 +603,10 @@ const clivalue_t valueTable[] = {
     { "inav_accz_unarmedcal",       VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, &masterConfig.navConfig.inav.accz_unarmed_cal, .config.lookup = { TABLE_OFF_ON }, 0 },
     { "inav_use_gps_velned",        VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, &masterConfig.navConfig.inav.use_gps_velned, .config.lookup = { TABLE_OFF_ON }, 0 },
     { "inav_gps_delay",             VAR_UINT16 | MASTER_VALUE, &masterConfig.navConfig.inav.gps_delay_ms, .config.minmax = { 0,  500 }, 0 },
+#ifdef USE_NAV_EKF
+    { "inav_estimator",             VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, &masterConfig.navConfig.inav.estimator, .config.lookup = { TABLE_NAV_ESTIMATOR }, 0 },
+#endif
+    { "inav_update_rate_hz",        VAR_UINT16 | MASTER_VALUE, &masterConfig.navConfig.inav.update_rate_hz, .config.minmax = { 50,  500 }, 0 },
     { "inav_gps_min_sats",          VAR_UINT8  | MASTER_VALUE, &masterConfig.navConfig.inav.gps_min_sats, .config.minmax = { 5,  10}, 0 },
 
     { "inav_w_z_baro_p",            VAR_FLOAT  | MASTER_VALUE, &masterConfig.navConfig.inav.w_z_baro_p, .config.minmax = { 0,  10 }, 0 },
@@ -586,6 +625,7 @@ const clivalue_t valueTable[] = {
     { "nav_use_midthr_for_althold", VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, &masterConfig.navConfig.flags.use_thr_mid_for_althold, .config.lookup = { TABLE_OFF_ON }, 0 },
     { "nav_extra_arming_safety",    VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, &masterConfig.navConfig.flags.extra_arming_safety, .config.lookup = { TABLE_OFF_ON }, 0 },
     { "nav_user_control_mode",      VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, &masterConfig.navConfig.flags.user_control_mode, .config.lookup = { TABLE_NAV_USER_CTL_MODE }, 0 },
+    { "nav_update_rate_hz",         VAR_UINT16 | MASTER_VALUE, &masterConfig.navConfig.update_rate_hz, .config.minmax = { 10,  500 }, 0 },
     { "nav_position_timeout",       VAR_UINT8  | MASTER_VALUE, &masterConfig.navConfig.pos_failure_timeout, .config.minmax = { 0,  10 }, 0 },
     { "nav_wp_radius",              VAR_UINT16 | MASTER_VALUE, &masterConfig.navConfig.waypoint_radius, .config.minmax = { 10,  10000 }, 0 },
     { "nav_max_speed",              VAR_UINT16 | MASTER_VALUE, &masterConfig.navConfig.max_speed, .config.minmax = { 10,  2000 }, 0 },
@@ -647,11 +687,30 @@ const clivalue_t valueTable[] = {
 
     { "gyro_lpf",                   VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP,  &masterConfig.gyro_lpf, .config.lookup = { TABLE_GYRO_LPF } },
     { "moron_threshold",            VAR_UINT8  | MASTER_VALUE,  &masterConfig.gyroConfig.gyroMovementCalibrationThreshold, .config.minmax = { 0,  128 }, 0 },
+    { "gyro_cal_min_cycles",        VAR_UINT16 | MASTER_VALUE,  &masterConfig.gyroConfig.gyroCalibrationMinCycles, .config.minmax = { 1,  CALIBRATING_GYRO_CYCLES }, 0 },
+    { "gyro_notch1_hz",             VAR_UINT16 | MASTER_VALUE,  &masterConfig.gyroConfig.gyroNotchHz[0], .config.minmax = { 0,  1000 }, 0 },
+    { "gyro_notch1_q",              VAR_UINT16 | MASTER_VALUE,  &masterConfig.gyroConfig.gyroNotchQ[0], .config.minmax = { 10,  2000 }, 0 },
+    { "gyro_notch2_hz",             VAR_UINT16 | MASTER_VALUE,  &masterConfig.gyroConfig.gyroNotchHz[1], .config.minmax = { 0,  1000 }, 0 },
+    { "gyro_notch2_q",              VAR_UINT16 | MASTER_VALUE,  &masterConfig.gyroConfig.gyroNotchQ[1], .config.minmax = { 10,  2000 }, 0 },
+#ifdef USE_GYRO_DYNAMIC_NOTCH
+    { "gyro_dyn_notch",             VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP,  &masterConfig.gyroConfig.gyroDynamicNotch, .config.lookup = { TABLE_OFF_ON }, 0 },
+    { "gyro_dyn_notch_min_hz",      VAR_UINT16 | MASTER_VALUE,  &masterConfig.gyroConfig.gyroDynamicNotchMinHz, .config.minmax = { 30,  500 }, 0 },
+    { "gyro_dyn_notch_q",           VAR_UINT16 | MASTER_VALUE,  &masterConfig.gyroConfig.gyroDynamicNotchQ, .config.minmax = { 10,  2000 }, 0 },
+#endif
+#ifdef USE_GYRO_DYNAMIC_LPF
+    { "gyro_dyn_lpf",               VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP,  &masterConfig.gyroConfig.gyroDynamicLpf, .config.lookup = { TABLE_OFF_ON }, 0 },
+    { "gyro_dyn_lpf_min_hz",        VAR_UINT8  | MASTER_VALUE,  &masterConfig.gyroConfig.gyroDynamicLpfMinHz, .config.minmax = { 10,  200 }, 0 },
+    { "gyro_dyn_lpf_max_hz",        VAR_UINT8  | MASTER_VALUE,  &masterConfig.gyroConfig.gyroDynamicLpfMaxHz, .config.minmax = { 10,  200 }, 0 },
+#endif
 
     { "imu_dcm_kp",                 VAR_UINT16 | MASTER_VALUE,  &masterConfig.dcm_kp_acc, .config.minmax = { 0,  65535 }, 0 },
     { "imu_dcm_ki",                 VAR_UINT16 | MASTER_VALUE,  &masterConfig.dcm_ki_acc, .config.minmax = { 0,  65535 }, 0 },
     { "imu_dcm_kp_mag",             VAR_UINT16 | MASTER_VALUE,  &masterConfig.dcm_kp_mag, .config.minmax = { 0,  65535 }, 0 },
     { "imu_dcm_ki_mag",             VAR_UINT16 | MASTER_VALUE,  &masterConfig.dcm_ki_mag, .config.minmax = { 0,  65535 }, 0 },
+    { "imu_correction_hz",          VAR_UINT16 | MASTER_VALUE,  &masterConfig.imu_correction_hz, .config.minmax = { 0,  1000 }, 0 },
+#ifdef USE_IMU_EKF
+    { "imu_estimator",              VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP,  &masterConfig.imu_estimator, .config.lookup = { TABLE_IMU_ESTIMATOR }, 0 },
+#endif
 
     { "deadband",                   VAR_UINT8  | PROFILE_VALUE, &masterConfig.profile[0].rcControlsConfig.deadband, .config.minmax = { 0,  32 }, 0 },
     { "yaw_deadband",               VAR_UINT8  | PROFILE_VALUE, &masterConfig.profile[0].rcControlsConfig.yaw_deadband, .config.minmax = { 0,  100 }, 0 },
@@ -724,6 +783,8 @@ const clivalue_t valueTable[] = {
 	{ "gyro_soft_lpf_hz",           VAR_UINT8  | PROFILE_VALUE, &masterConfig.profile[0].pidProfile.gyro_soft_lpf_hz, .config.minmax = {0, 200 } },
     { "acc_soft_lpf_hz",            VAR_UINT8  | PROFILE_VALUE, &masterConfig.profile[0].pidProfile.acc_soft_lpf_hz, .config.minmax = {0, 200 } },
     { "dterm_lpf_hz",               VAR_UINT8  | PROFILE_VALUE, &masterConfig.profile[0].pidProfile.dterm_lpf_hz, .config.minmax = {0, 200 } },
+    { "dterm_notch_hz",             VAR_UINT16 | PROFILE_VALUE, &masterConfig.profile[0].pidProfile.dterm_notch_hz, .config.minmax = {0, 1000 } },
+    { "dterm_notch_q",              VAR_UINT16 | PROFILE_VALUE, &masterConfig.profile[0].pidProfile.dterm_notch_q, .config.minmax = {10, 2000 } },
     { "yaw_lpf_hz",                 VAR_UINT8  | PROFILE_VALUE, &masterConfig.profile[0].pidProfile.yaw_lpf_hz, .config.minmax = {0, 200 } },
 
     { "yaw_p_limit",                VAR_UINT16 | PROFILE_VALUE,  &masterConfig.profile[0].pidProfile.yaw_p_limit, .config.minmax = { YAW_P_LIMIT_MIN,  YAW_P_LIMIT_MAX }, 0 },
@@ -1602,21 +1663,17 @@ static void cliFlashRead(char *cmdline)
 #endif
 #endif
 
-static void dumpValues(uint16_t valueSection)
+static void dumpValue(uint32_t index, uint16_t valueSection)
 {
-    uint32_t i;
-    const clivalue_t *value;
-    for (i = 0; i < VALUE_COUNT; i++) {
-        value = &valueTable[i];
-
-        if ((value->type & VALUE_SECTION_MASK) != valueSection) {
-            continue;
-        }
+    const clivalue_t *value = &valueTable[index];
 
-        cliPrintf("set %s = ", valueTable[i].name);
-        cliPrintVar(value, 0);
-        cliPrint("\r\n");
+    if ((value->type & VALUE_SECTION_MASK) != valueSection) {
+        return;
     }
+
+    cliPrintf("set %s = ", value->name);
+    cliPrintVar(value, 0);
+    cliPrint("\r\n");
 }
 
 typedef enum {
@@ -1632,26 +1689,33 @@ static const char* const sectionBreak = "\r\n";
 
 #define printSectionBreak() cliPrintf((char *)sectionBreak)
 
-static void cliDump(char *cmdline)
+// Longest line printed by dump between two yield points should fit into this
+#define DUMP_TX_HEADROOM 64
+
+static uint8_t dumpMask;
+static taskContinuation_t dumpContinuation;
+
+// Dump continues on next time slice once the slice is used up or when the next lines could block on a full transmit buffer
+static bool cliDumpShouldYield(void)
 {
-    unsigned int i;
-    char buf[16];
-    uint32_t mask;
+    bufWriterFlush(cliWriter);
+    return isTaskTimeSliceExpired() || serialTxBytesFree(cliPort) < DUMP_TX_HEADROOM;
+}
+
+#define DUMP_YIELD() do { if (cliDumpShouldYield()) { TASK_YIELD(dumpContinuation); } } while (0)
+
+static void cliDumpResume(void)
+{
+    // Yields lose locals, all state lives in statics
+    static unsigned int i;
+    static char buf[16];
+    static uint32_t mask;
 
 #ifndef USE_QUAD_MIXER_ONLY
-    float thr, roll, pitch, yaw;
+    static float thr, roll, pitch, yaw;
 #endif
 
-    uint8_t dumpMask = DUMP_ALL;
-    if (strcasecmp(cmdline, "master") == 0) {
-        dumpMask = DUMP_MASTER; // only
-    }
-    if (strcasecmp(cmdline, "profile") == 0) {
-        dumpMask = DUMP_PROFILE; // only
-    }
-    if (strcasecmp(cmdline, "rates") == 0) {
-        dumpMask = DUMP_CONTROL_RATE_PROFILE; // only
-    }
+    TASK_BEGIN(dumpContinuation);
 
     if (dumpMask & DUMP_MASTER) {
 
@@ -1689,6 +1753,7 @@ static void cliDump(char *cmdline)
             if (yaw < 0)
                 cliWrite(' ');
             cliPrintf("%s\r\n", ftoa(yaw, buf));
+            DUMP_YIELD();
         }
 
         // print custom servo mixer if exists
@@ -1709,6 +1774,7 @@ static void cliDump(char *cmdline)
                 masterConfig.customServoMixer[i].max,
                 masterConfig.customServoMixer[i].box
             );
+            DUMP_YIELD();
         }
 
 #endif
@@ -1720,25 +1786,27 @@ static void cliDump(char *cmdline)
             if (featureNames[i] == NULL)
                 break;
             cliPrintf("feature -%s\r\n", featureNames[i]);
+            DUMP_YIELD();
         }
         for (i = 0; ; i++) {  // reenable what we want.
             if (featureNames[i] == NULL)
                 break;
             if (mask & (1 << i))
                 cliPrintf("feature %s\r\n", featureNames[i]);
+            DUMP_YIELD();
         }
 
 
 #ifdef BEEPER
         cliPrint("\r\n\r\n# beeper\r\n");
 
-        uint8_t beeperCount = beeperTableEntryCount();
         mask = getBeeperOffMask();
-        for (int i = 0; i < (beeperCount-2); i++) {
+        for (i = 0; i < (unsigned int)(beeperTableEntryCount() - 2); i++) {
             if (mask & (1 << i))
                 cliPrintf("beeper -%s\r\n", beeperNameForTableIndex(i));
             else
                 cliPrintf("beeper %s\r\n", beeperNameForTableIndex(i));
+            DUMP_YIELD();
         }
 #endif
 
@@ -1749,22 +1817,30 @@ static void cliDump(char *cmdline)
             buf[masterConfig.rxConfig.rcmap[i]] = rcChannelLetters[i];
         buf[i] = '\0';
         cliPrintf("map %s\r\n", buf);
+        DUMP_YIELD();
 
         cliPrint("\r\n\r\n# serial\r\n");
         cliSerial("");
+        DUMP_YIELD();
 
 #ifdef LED_STRIP
         cliPrint("\r\n\r\n# led\r\n");
         cliLed("");
+        DUMP_YIELD();
 
         cliPrint("\r\n\r\n# color\r\n");
         cliColor("");
+        DUMP_YIELD();
 #endif
         printSectionBreak();
-        dumpValues(MASTER_VALUE);
+        for (i = 0; i < VALUE_COUNT; i++) {
+            dumpValue(i, MASTER_VALUE);
+            DUMP_YIELD();
+        }
 
         cliPrint("\r\n# rxfail\r\n");
         cliRxFail("");
+        DUMP_YIELD();
     }
 
     if (dumpMask & DUMP_PROFILE) {
@@ -1776,35 +1852,41 @@ static void cliDump(char *cmdline)
         cliPrint("\r\n# aux\r\n");
 
         cliAux("");
+        DUMP_YIELD();
 
         cliPrint("\r\n# adjrange\r\n");
 
         cliAdjustmentRange("");
+        DUMP_YIELD();
 
         cliPrintf("\r\n# rxrange\r\n");
 
         cliRxRange("");
+        DUMP_YIELD();
 
 #ifdef USE_SERVOS
         cliPrint("\r\n# servo\r\n");
 
         cliServo("");
+        DUMP_YIELD();
 
         // print servo directions
-        unsigned int channel;
-
         for (i = 0; i < MAX_SUPPORTED_SERVOS; i++) {
-            for (channel = 0; channel < INPUT_SOURCE_COUNT; channel++) {
+            for (unsigned int channel = 0; channel < INPUT_SOURCE_COUNT; channel++) {
                 if (servoDirection(i, channel) < 0) {
                     cliPrintf("smix reverse %d %d r\r\n", i , channel);
                 }
             }
+            DUMP_YIELD();
         }
 #endif
 
         printSectionBreak();
 
-        dumpValues(PROFILE_VALUE);
+        for (i = 0; i < VALUE_COUNT; i++) {
+            dumpValue(i, PROFILE_VALUE);
+            DUMP_YIELD();
+        }
     }
 
     if (dumpMask & DUMP_CONTROL_RATE_PROFILE) {
@@ -1815,8 +1897,36 @@ static void cliDump(char *cmdline)
 
         printSectionBreak();
 
-        dumpValues(CONTROL_RATE_VALUE);
+        for (i = 0; i < VALUE_COUNT; i++) {
+            dumpValue(i, CONTROL_RATE_VALUE);
+            DUMP_YIELD();
+        }
+    }
+
+    TASK_END(dumpContinuation);
+}
+
+static bool isDumpInProgress(void)
+{
+    return dumpContinuation != 0;
+}
+
+static void cliDump(char *cmdline)
+{
+    dumpMask = DUMP_ALL;
+    if (strcasecmp(cmdline, "master") == 0) {
+        dumpMask = DUMP_MASTER; // only
     }
+    if (strcasecmp(cmdline, "profile") == 0) {
+        dumpMask = DUMP_PROFILE; // only
+    }
+    if (strcasecmp(cmdline, "rates") == 0) {
+        dumpMask = DUMP_CONTROL_RATE_PROFILE; // only
+    }
+
+    // Runs until first yield, cliProcess() resumes it on following time slices
+    dumpContinuation = 0;
+    cliDumpResume();
 }
 
 void cliEnter(serialPort_t *serialPort)
@@ -2534,6 +2644,18 @@ static void cliTasks(char *cmdline)
                    taskId, taskInfo.taskName, taskInfo.maxExecutionTime, taskInfo.averageExecutionTime, taskFrequency, taskInfo.totalExecutionTime / 1000);
         }
     }
+
+    cliPrintf("\r\nTask percentiles   exec p50/p95/p99 us   latency p50/p95/p99 us\r\n");
+    for (taskId = 0; taskId < TASK_COUNT; taskId++) {
+        getTaskInfo(taskId, &taskInfo);
+        if (taskInfo.isEnabled) {
+            const taskHistogram_t *exec = getTaskHistogram(taskId, TASK_HISTOGRAM_EXECUTION_TIME);
+            const taskHistogram_t *latency = getTaskHistogram(taskId, TASK_HISTOGRAM_START_LATENCY);
+            cliPrintf("%2d - %12s, %5d %5d %5d,    %5d %5d %5d\r\n", taskId, taskInfo.taskName,
+                   taskHistogramPercentile(exec, 50), taskHistogramPercentile(exec, 95), taskHistogramPercentile(exec, 99),
+                   taskHistogramPercentile(latency, 50), taskHistogramPercentile(latency, 95), taskHistogramPercentile(latency, 99));
+        }
+    }
 }
 #endif
 
@@ -2567,6 +2689,15 @@ void cliProcess(void)
     // Be a little bit tricky.  Flush the last inputs buffer, if any.
     bufWriterFlush(cliWriter);
 
+    // Input waits until a running dump has finished
+    if (isDumpInProgress()) {
+        cliDumpResume();
+        if (isDumpInProgress()) {
+            return;
+        }
+        cliPrompt();
+    }
+
     while (serialRxBytesWaiting(cliPort)) {
         uint8_t c = serialRead(cliPort);
         if (c == '\t' || c == '?') {
@@ -2651,6 +2782,10 @@ void cliProcess(void)
             if (!cliMode)
                 return;
 
+            if (isDumpInProgress()) {
+                return;
+            }
+
             cliPrompt();
         } else if (c == 127) {
             // backspace
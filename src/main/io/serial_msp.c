@@ -46,6 +46,7 @@
 #include "drivers/pwm_rx.h"
 
 #include "drivers/buf_writer.h"
+#include "drivers/gyro_sync.h"
 #include "rx/rx.h"
 #include "rx/msp.h"
 
@@ -72,9 +73,11 @@
 #include "flight/mixer.h"
 #include "flight/pid.h"
 #include "flight/imu.h"
+#include "flight/imu_ekf.h"
 #include "flight/hil.h"
 #include "flight/failsafe.h"
 #include "flight/navigation_rewrite.h"
+#include "flight/looptime_governor.h"
 
 #include "mw.h"
 
@@ -316,8 +319,9 @@ static void serializeDataflashSummaryReply(void)
 #ifdef USE_FLASHFS
     const flashGeometry_t *geometry = flashfsGetGeometry();
     serialize8(flashfsIsReady() ? 1 : 0);
-    serialize32(geometry->sectors);
-    serialize32(geometry->totalSize);
+    // Sectors and size of the volume, without the sectors reserved at the end of the chip
+    serialize32(geometry->sectorSize ? flashfsGetSize() / geometry->sectorSize : 0);
+    serialize32(flashfsGetSize());
     serialize32(flashfsGetOffset()); // Effectively the current number of bytes stored on the volume
 #else
     serialize8(0);
@@ -327,10 +331,23 @@ static void serializeDataflashSummaryReply(void)
 #endif
 }
 
+#ifdef NAV
+#define MSP_WP_MISSION_BATCH_SIZE       ((MSP_PORT_INBUF_SIZE - 3) / NAV_WAYPOINT_RECORD_SIZE)
+#define MSP_WP_MISSION_REPLY_SIZE       (6 + 6 + MSP_WP_MISSION_BATCH_SIZE * NAV_WAYPOINT_RECORD_SIZE)  // header, size, command, checksum and mission info with waypoints
+
+// Mission state in the MSP_WP_MISSION reply
+#define MSP_WP_MISSION_INCOMPLETE       0
+#define MSP_WP_MISSION_VALID            1
+#define MSP_WP_MISSION_BUSY             2
+#endif
+
 #ifdef USE_FLASHFS
+#define MSP_DATAFLASH_READ_SIZE         128
+#define MSP_DATAFLASH_READ_REPLY_SIZE   (6 + 4 + MSP_DATAFLASH_READ_SIZE)   // header, size, command, checksum and address with data
+
 static void serializeDataflashReadReply(uint32_t address, uint8_t size)
 {
-    uint8_t buffer[128];
+    uint8_t buffer[MSP_DATAFLASH_READ_SIZE];
     int bytesRead;
 
     if (size > sizeof(buffer)) {
@@ -357,6 +374,12 @@ static void resetMspPort(mspPort_t *mspPortToReset, serialPort_t *serialPort)
     mspPortToReset->port = serialPort;
 }
 
+// Called from UART interrupt once a request has been received, MSP and CLI are handled by TASK_SERIAL
+static void mspSerialIdle(void)
+{
+    signalTask(TASK_SERIAL);
+}
+
 void mspAllocateSerialPorts(void)
 {
     serialPort_t *serialPort;
@@ -374,6 +397,7 @@ void mspAllocateSerialPorts(void)
 
         serialPort = openSerialPort(portConfig->identifier, FUNCTION_MSP, NULL, baudRates[portConfig->msp_baudrateIndex], MODE_RXTX, SERIAL_NOT_INVERTED);
         if (serialPort) {
+            serialSetIdleCallback(serialPort, mspSerialIdle);
             resetMspPort(mspPort, serialPort);
             portIndex++;
         }
@@ -882,6 +906,28 @@ static bool processOutCommand(uint8_t cmdMSP)
         serialize16(msp_wp.p3);     // P3
         serialize8(msp_wp.flag);    // flags
         break;
+    case MSP_WP_MISSION:
+        {
+            const uint16_t startIndex = read16();
+            const uint16_t waypointCount = getWaypointCount();
+            const bool storeBusy = isWaypointStoreBusy();
+            // No waypoints while the store is busy, e.g. erasing for an upload, the request has to be repeated
+            const uint8_t count = (startIndex < waypointCount && !storeBusy) ? MIN(waypointCount - startIndex, MSP_WP_MISSION_BATCH_SIZE) : 0;
+            uint8_t record[NAV_WAYPOINT_RECORD_SIZE];
+
+            headSerialReply(6 + count * NAV_WAYPOINT_RECORD_SIZE);
+            serialize16(waypointCount);
+            serialize8(storeBusy ? MSP_WP_MISSION_BUSY : (isWaypointListValid() ? MSP_WP_MISSION_VALID : MSP_WP_MISSION_INCOMPLETE));
+            serialize16(startIndex);
+            serialize8(count);
+            for (i = 0; i < count; i++) {
+                getWaypointRecords(startIndex + i, 1, record);
+                for (int j = 0; j < NAV_WAYPOINT_RECORD_SIZE; j++) {
+                    serialize8(record[j]);
+                }
+            }
+        }
+        break;
 #endif
     case MSP_GPSSVINFO:
         /* Compatibility stub - return zero SVs */
@@ -915,6 +961,95 @@ static bool processOutCommand(uint8_t cmdMSP)
             serialize16(debug[i]);      // 4 variables are here for general monitoring purpose
         break;
 
+#ifndef SKIP_TASK_STATISTICS
+    case MSP_TASK_STATS:
+        {
+            const cfTaskId_e taskId = read8();
+            if (taskId >= TASK_COUNT) {
+                return false;
+            }
+            headSerialReply(2 + TASK_HISTOGRAM_COUNT * (1 + TASK_HISTOGRAM_BUCKET_COUNT * 2 + 3 * 2));
+            serialize8(taskId);
+            serialize8(TASK_HISTOGRAM_COUNT);
+            for (i = 0; i < TASK_HISTOGRAM_COUNT; i++) {
+                const taskHistogram_t *histogram = getTaskHistogram(taskId, i);
+                serialize8(TASK_HISTOGRAM_BUCKET_COUNT);
+                for (int ii = 0; ii < TASK_HISTOGRAM_BUCKET_COUNT; ii++) {
+                    serialize16(histogram->bucket[ii]);
+                }
+                serialize16(taskHistogramPercentile(histogram, 50));
+                serialize16(taskHistogramPercentile(histogram, 95));
+                serialize16(taskHistogramPercentile(histogram, 99));
+            }
+        }
+        break;
+#endif
+
+#ifdef USE_LOOPTIME_GOVERNOR
+    case MSP_LOOPTIME_GOVERNOR:
+        headSerialReply(8);
+        serialize8(isLooptimeGovernorEnabled());
+        serialize8(looptimeGovernorGetDivider());
+        serialize16(targetLooptime);
+        serialize16(looptimeGovernorGetBaseLooptime());
+        serialize16(averageSystemLoadPercent);
+        break;
+#endif
+
+    case MSP_FILTER_CONFIG:
+        headSerialReply(3 + GYRO_NOTCH_COUNT * 4 + 4);
+        serialize8(currentProfile->pidProfile.gyro_soft_lpf_hz);
+        serialize8(currentProfile->pidProfile.dterm_lpf_hz);
+        serialize8(GYRO_NOTCH_COUNT);
+        for (i = 0; i < GYRO_NOTCH_COUNT; i++) {
+            serialize16(masterConfig.gyroConfig.gyroNotchHz[i]);
+            serialize16(masterConfig.gyroConfig.gyroNotchQ[i]);
+        }
+        serialize16(currentProfile->pidProfile.dterm_notch_hz);
+        serialize16(currentProfile->pidProfile.dterm_notch_q);
+        break;
+
+    case MSP_GYRO_CALIBRATION:
+        {
+            // Noise in 0.01 degree/s
+            const gyroCalibrationStatus_t *calibration = gyroGetCalibrationStatus();
+            headSerialReply(6 + 3 * 4);
+            serialize8(isGyroCalibrationComplete());
+            serialize16(calibration->durationMs);
+            serialize16(calibration->sampleCount);
+            serialize8(calibration->restartCount);
+            for (i = 0; i < XYZ_AXIS_COUNT; i++) {
+                serialize16(calibration->zero[i]);
+            }
+            for (i = 0; i < XYZ_AXIS_COUNT; i++) {
+                serialize16(constrain(lrintf(calibration->noiseStdDev[i] * gyro.scale * 100), 0, UINT16_MAX));
+            }
+        }
+        break;
+
+#ifdef USE_IMU_EKF
+    case MSP_IMU_EKF_STATUS:
+        {
+            // Angles in 0.01 degree, rates in 0.01 degree/s
+            const imuEkfStatus_t *ekfStatus = imuEkfGetStatus();
+            headSerialReply(1 + 3 * 6 + 6);
+            serialize8(masterConfig.imu_estimator);
+            for (i = 0; i < XYZ_AXIS_COUNT; i++) {
+                serialize16(constrain(lrintf(RADIANS_TO_CENTIDEGREES(ekfStatus->attitudeStdDev[i])), 0, UINT16_MAX));
+            }
+            for (i = 0; i < XYZ_AXIS_COUNT; i++) {
+                serialize16(lrintf(RADIANS_TO_CENTIDEGREES(ekfStatus->gyroBias[i])));
+            }
+            for (i = 0; i < XYZ_AXIS_COUNT; i++) {
+                serialize16(constrain(lrintf(RADIANS_TO_CENTIDEGREES(ekfStatus->gyroBiasStdDev[i])), 0, UINT16_MAX));
+            }
+            serialize16(constrain(lrintf(ekfStatus->gravityInnovationRatio * 100), 0, UINT16_MAX));
+            serialize16(ekfStatus->rejectedCorrections);
+            serialize16(ekfStatus->covarianceResets);
+        }
+        break;
+#endif
+
     case MSP_UID:
         headSerialReply(12);
         serialize32(U_ID_0);
@@ -1061,7 +1196,7 @@ static bool processOutCommand(uint8_t cmdMSP)
         {
             uint32_t readAddress = read32();
 
-            serializeDataflashReadReply(readAddress, 128);
+            serializeDataflashReadReply(readAddress, MSP_DATAFLASH_READ_SIZE);
         }
         break;
 #endif
@@ -1398,12 +1533,48 @@ static bool processInCommand(void)
         msp_wp.flag = read8();      // future: to set nav flag
         setWaypoint(msp_wp_no, &msp_wp);
         break;
+    case MSP_SET_WP_MISSION:
+        {
+            const uint16_t startIndex = read16();
+            const uint8_t count = read8();
+
+            BUILD_BUG_ON(MSP_WP_MISSION_BATCH_SIZE > NAV_MAX_WAYPOINT_BATCH);
+
+            // Waypoints are stored as they were sent, index 0 starts erasing the store and replies before it's done
+            if (currentPort->dataSize != 3 + count * NAV_WAYPOINT_RECORD_SIZE ||
+                    !setWaypointRecords(startIndex, count, &currentPort->inBuf[currentPort->indRX])) {
+                headSerialError(0);
+                return true;
+            }
+        }
+        break;
+    case MSP_SET_WP_MISSION_END:
+        {
+            const uint16_t count = read16();
+            if (!finishWaypointUpload(count, read32())) {
+                headSerialError(0);
+                return true;
+            }
+        }
+        break;
 #endif
     case MSP_SET_FEATURE:
         featureClearAll();
         featureSet(read32()); // features bitmap
         break;
 
+    case MSP_SET_FILTER_CONFIG:
+        currentProfile->pidProfile.gyro_soft_lpf_hz = constrain(read8(), 0, 200);
+        currentProfile->pidProfile.dterm_lpf_hz = constrain(read8(), 0, 200);
+        for (i = 0; i < GYRO_NOTCH_COUNT; i++) {
+            masterConfig.gyroConfig.gyroNotchHz[i] = constrain(read16(), 0, 1000);
+            masterConfig.gyroConfig.gyroNotchQ[i] = constrain(read16(), 10, 2000);
+        }
+        currentProfile->pidProfile.dterm_notch_hz = constrain(read16(), 0, 1000);
+        currentProfile->pidProfile.dterm_notch_q = constrain(read16(), 10, 2000);
+        useGyroConfig(&masterConfig.gyroConfig, currentProfile->pidProfile.gyro_soft_lpf_hz);
+        break;
+
     case MSP_SET_BOARD_ALIGNMENT:
         masterConfig.boardAlignment.rollDeciDegrees = read16();
         masterConfig.boardAlignment.pitchDeciDegrees = read16();
@@ -1594,6 +1765,30 @@ static bool processInCommand(void)
     return true;
 }
 
+// Replies which would block on the flash or on a full transmit buffer are postponed to a later time slice
+static bool mspCommandReplyWouldBlock(void)
+{
+#ifdef NAV
+    switch (currentPort->cmdMSP) {
+    case MSP_WP_MISSION:
+        return serialTxBytesFree(mspSerialPort) < MSP_WP_MISSION_REPLY_SIZE;
+    case MSP_WP:
+    case MSP_SET_WP:
+    case MSP_SET_WP_MISSION:
+    case MSP_SET_WP_MISSION_END:
+        return isWaypointStoreBusy();
+    default:
+        break;
+    }
+#endif
+#ifdef USE_FLASHFS
+    if (currentPort->cmdMSP == MSP_DATAFLASH_READ) {
+        return !flashfsFlushAsync() || !flashfsIsReady() || serialTxBytesFree(mspSerialPort) < MSP_DATAFLASH_READ_REPLY_SIZE;
+    }
+#endif
+    return false;
+}
+
 static void mspProcessReceivedCommand() {
     if (!(processOutCommand(currentPort->cmdMSP) || processInCommand())) {
         headSerialError(0);
@@ -1666,7 +1861,7 @@ void mspProcess(void)
         writer = bufWriterInit(buf, sizeof(buf),
                                (bufWrite_t)serialWriteBufShim, currentPort->port);
 
-        while (serialRxBytesWaiting(mspSerialPort)) {
+        while (currentPort->c_state != COMMAND_RECEIVED && serialRxBytesWaiting(mspSerialPort)) {
 
             uint8_t c = serialRead(mspSerialPort);
             bool consumed = mspProcessReceivedData(c);
@@ -1674,10 +1869,14 @@ void mspProcess(void)
             if (!consumed && !ARMING_FLAG(ARMED)) {
                 evaluateOtherData(mspSerialPort, c);
             }
+        }
 
-            if (currentPort->c_state == COMMAND_RECEIVED) {
+        // process one command at a time so as not to block.
+        if (currentPort->c_state == COMMAND_RECEIVED) {
+            if (mspCommandReplyWouldBlock()) {
+                taskYield();
+            } else {
                 mspProcessReceivedCommand();
-                break; // process one command at a time so as not to block.
             }
         }
 
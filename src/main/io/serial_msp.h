@@ -33,7 +33,11 @@ typedef enum {
     COMMAND_RECEIVED
 } mspState_e;
 
+#if defined(NAV) && defined(USE_NAV_MISSION_STORE)
+#define MSP_PORT_INBUF_SIZE 248     // MSP_SET_WP_MISSION with 12 waypoints
+#else
 #define MSP_PORT_INBUF_SIZE 64
+#endif
 
 typedef struct mspPort_s {
     serialPort_t *port; // null when port unused.
@@ -82,6 +82,7 @@
 #include "flight/mixer.h"
 #include "flight/failsafe.h"
 #include "flight/navigation_rewrite.h"
+#include "flight/looptime_governor.h"
 
 #include "config/runtime_config.h"
 #include "config/config.h"
@@ -391,7 +392,7 @@ void init(void)
 #endif
 
     // Set gyro sampling rate divider before initialization
-    gyroSetSampleRate(masterConfig.looptime, masterConfig.gyro_lpf, masterConfig.gyroSync, masterConfig.gyroSyncDenominator);
+    gyroSetSampleRate(masterConfig.looptime, masterConfig.gyro_lpf, masterConfig.gyroSync, masterConfig.gyroSyncDenominator, masterConfig.gyroSyncOversampling);
 
     if (!sensorsAutodetect(&masterConfig.sensorAlignmentConfig, masterConfig.gyro_lpf,
         masterConfig.acc_hardware, masterConfig.mag_hardware, masterConfig.baro_hardware, currentProfile->mag_declination)) {
@@ -484,6 +485,10 @@ void init(void)
     flashfsInit();
 #endif
 
+#ifdef NAV
+    loadWaypointList();
+#endif
+
 #ifdef BLACKBOX
     initBlackbox();
 #endif
@@ -544,8 +549,12 @@ int main(void) {
 
     /* Setup scheduler */
     schedulerInit();
+    schedulerSetPolicy(masterConfig.schedulerPolicy);
 
     rescheduleTask(TASK_GYROPID, targetLooptime);
+#ifdef USE_LOOPTIME_GOVERNOR
+    looptimeGovernorInit(masterConfig.looptimeGovernor, targetLooptime);
+#endif
     setTaskEnabled(TASK_GYROPID, true);
 
     setTaskEnabled(TASK_SERIAL, true);
@@ -554,6 +563,12 @@ int main(void) {
 #endif
     setTaskEnabled(TASK_BATTERY, feature(FEATURE_VBAT) || feature(FEATURE_CURRENT_METER));
     setTaskEnabled(TASK_RX, true);
+#ifdef NAV
+    rescheduleTask(TASK_POS_ESTIMATOR, 1000000 / masterConfig.navConfig.inav.update_rate_hz);
+    setTaskEnabled(TASK_POS_ESTIMATOR, true);
+    rescheduleTask(TASK_NAV, 1000000 / masterConfig.navConfig.update_rate_hz);
+    setTaskEnabled(TASK_NAV, true);
+#endif
 #ifdef GPS
     setTaskEnabled(TASK_GPS, feature(FEATURE_GPS));
 #endif
@@ -77,6 +77,7 @@
 #include "flight/hil.h"
 #include "flight/failsafe.h"
 #include "flight/navigation_rewrite.h"
+#include "flight/looptime_governor.h"
 
 #include "config/runtime_config.h"
 #include "config/config.h"
@@ -165,8 +166,8 @@ void annexCode(void)
 
     if (FLIGHT_MODE(HEADFREE_MODE)) {
         float radDiff = degreesToRadians(DECIDEGREES_TO_DEGREES(attitude.values.yaw) - headFreeModeHold);
-        float cosDiff = cos_approx(radDiff);
-        float sinDiff = sin_approx(radDiff);
+        float cosDiff, sinDiff;
+        sincos_approx(radDiff, &sinDiff, &cosDiff);
         int16_t rcCommand_PITCH = rcCommand[PITCH] * cosDiff + rcCommand[ROLL] * sinDiff;
         rcCommand[ROLL] = rcCommand[ROLL] * cosDiff - rcCommand[PITCH] * sinDiff;
         rcCommand[PITCH] = rcCommand_PITCH;
@@ -489,7 +490,7 @@ void filterRc(bool isRXDataNew)
     static int16_t deltaRC[4] = { 0, 0, 0, 0 };
     static int16_t factor, rcInterpolationFactor;
     static biquad_t filteredCycleTimeState;
-    static bool filterInitialised;
+    static uint32_t filterLooptime;
     uint16_t filteredCycleTime;
     uint16_t rxRefreshRate;
 
@@ -497,9 +498,9 @@ void filterRc(bool isRXDataNew)
     initRxRefreshRate(&rxRefreshRate);
 
     // Calculate average cycle time (1Hz LPF on cycle time)
-    if (!filterInitialised) {
+    if (filterLooptime != targetLooptime) {
         filterInitBiQuad(1, &filteredCycleTimeState, 0);
-        filterInitialised = true;
+        filterLooptime = targetLooptime;
     }
 
     filteredCycleTime = filterApplyBiQuad((float) cycleTime, &filteredCycleTimeState);
@@ -550,8 +551,8 @@ void taskMainPidLoop(void)
     isRXDataNew = false;
 
 #if defined(NAV)
-    updatePositionEstimator();
-    applyWaypointNavigationAndAltitudeHold();
+    // Estimator and controllers run in their own tasks, only the last complete setpoint is applied here
+    applyNavigationSetpoint();
 #endif
 
     // If we're armed, at minimum throttle, and we do arming via the
@@ -644,6 +645,10 @@ void taskMainPidLoopChecker(void) {
     }
 
     taskMainPidLoop();
+
+#ifdef USE_LOOPTIME_GOVERNOR
+    looptimeGovernorUpdate(currentTime);
+#endif
 }
 
 void taskHandleSerial(void)
@@ -693,6 +698,19 @@ void taskUpdateRxMain(void)
     isRXDataNew = true;
 }
 
+#ifdef NAV
+void taskUpdatePositionEstimator(void)
+{
+    updatePositionEstimator();
+}
+
+void taskNavigation(void)
+{
+    updateWaypointStore();
+    applyWaypointNavigationAndAltitudeHold();
+}
+#endif
+
 #ifdef GPS
 void taskProcessGPS(void)
 {
@@ -35,6 +35,8 @@
 #include "drivers/serial_uart.h"
 #include "io/serial.h"
 
+#include "scheduler/scheduler.h"
+
 #include "rx/rx.h"
 #include "rx/ibus.h"
 
@@ -92,6 +94,7 @@ static void ibusDataReceive(uint16_t c)
 
     if (ibusFramePosition == IBUS_BUFFSIZE - 1) {
         ibusFrameDone = true;
+        signalTask(TASK_RX);
     } else {
         ibusFramePosition++;
     }
@@ -32,6 +32,8 @@
 #include "drivers/serial_uart.h"
 #include "io/serial.h"
 
+#include "scheduler/scheduler.h"
+
 #include "rx/rx.h"
 #include "rx/sbus.h"
 
@@ -164,6 +166,7 @@ static void sbusDataReceive(uint16_t c)
         if (sbusFramePosition == SBUS_FRAME_SIZE) {
             // endByte currently ignored
             sbusFrameDone = true;
+            signalTask(TASK_RX);
 #ifdef DEBUG_SBUS_PACKETS
             debug[2] = sbusFrameTime;
 #endif
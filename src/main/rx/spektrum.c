@@ -31,6 +31,8 @@
 #include "drivers/serial_uart.h"
 #include "io/serial.h"
 
+#include "scheduler/scheduler.h"
+
 #include "config/config.h"
 
 #include "rx/rx.h"
@@ -112,6 +114,7 @@ static void spektrumDataReceive(uint16_t c)
         spekFrame[spekFramePosition++] = (uint8_t)c;
         if (spekFramePosition == SPEK_FRAME_SIZE) {
             rcFrameComplete = true;
+            signalTask(TASK_RX);
         } else {
             rcFrameComplete = false;
         }
@@ -29,6 +29,8 @@
 #include "drivers/serial_uart.h"
 #include "io/serial.h"
 
+#include "scheduler/scheduler.h"
+
 #include "rx/rx.h"
 #include "rx/sumd.h"
 
@@ -119,6 +121,7 @@ static void sumdDataReceive(uint16_t c)
         if (sumdIndex == sumdChannelCount * 2 + 5) {
             sumdIndex = 0;
             sumdFrameDone = true;
+            signalTask(TASK_RX);
         }
 }
 
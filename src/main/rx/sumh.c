@@ -35,6 +35,8 @@
 #include "drivers/serial_uart.h"
 #include "io/serial.h"
 
+#include "scheduler/scheduler.h"
+
 #include "rx/rx.h"
 #include "rx/sumh.h"
 
@@ -98,6 +100,7 @@ static void sumhDataReceive(uint16_t c)
     if (sumhFramePosition == SUMH_FRAME_SIZE - 1) {
         // FIXME at this point the value of 'c' is unused and un tested, what should it be, is it important?
         sumhFrameDone = true;
+        signalTask(TASK_RX);
     } else {
         sumhFramePosition++;
     }
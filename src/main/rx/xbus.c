@@ -27,6 +27,8 @@
 #include "drivers/serial_uart.h"
 #include "io/serial.h"
 
+#include "scheduler/scheduler.h"
+
 #include "rx/rx.h"
 #include "rx/xbus.h"
 
@@ -200,6 +202,7 @@ static void xBusUnpackModeBFrame(uint8_t offsetBytes)
         }
 
         xBusFrameReceived = true;
+        signalTask(TASK_RX);
     }
 
 }
@@ -19,9 +19,6 @@
 #include <stdint.h>
 #include <string.h>
 
-#ifdef UNIT_TEST
-typedef enum {TEST_IRQ = 0 } IRQn_Type;
-#endif
 #include "platform.h"
 
 #include "scheduler.h"
@@ -32,19 +29,50 @@ typedef enum {TEST_IRQ = 0 } IRQn_Type;
 
 #include "drivers/system.h"
 
+#ifdef UNIT_TEST
+#define ATOMIC_OR(ptr, val) __sync_fetch_and_or(ptr, val)
+#define ATOMIC_AND(ptr, val) __sync_fetch_and_and(ptr, val)
+#else
+#include "common/atomic.h"
+#endif
+
+#ifdef UNIT_TEST
+// Defined by the unit test so it can observe scheduling decisions
+extern cfTask_t *unittest_scheduler_selectedTask;
+extern uint16_t unittest_scheduler_waitingTasks;
+extern uint32_t unittest_scheduler_timeToNextRealtimeTask;
+extern bool unittest_outsideRealtimeGuardInterval;
+#endif
+
 static cfTask_t *currentTask = NULL;
+static schedulerPolicy_e schedulerPolicy = SCHEDULER_POLICY_DYNAMIC_PRIORITY;
+
+// One bit per cfTaskId_e, set from interrupt context by signalTask()
+static volatile uint32_t pendingTaskSignals = 0;
+// Signals taken over by the scheduler, bit is cleared when the task runs
+static uint32_t signaledTasks = 0;
+// Tasks which yielded with work left, released again on next pass without the precedence of signaled tasks
+static uint32_t yieldedTasks = 0;
+static uint32_t currentTaskSliceEndsAt = 0;
+
+// Can be overridden by the scheduler simulator to compare guard interval strategies
+#ifndef REALTIME_GUARD_INTERVAL_MIN
+#define REALTIME_GUARD_INTERVAL_MIN     10
+#endif
+#ifndef REALTIME_GUARD_INTERVAL_MAX
+#define REALTIME_GUARD_INTERVAL_MAX     300
+#endif
+#ifndef REALTIME_GUARD_INTERVAL_MARGIN
+#define REALTIME_GUARD_INTERVAL_MARGIN  25
+#endif
 
 static uint32_t totalWaitingTasks;
 static uint32_t totalWaitingTasksSamples;
-static uint32_t realtimeGuardInterval;
+static uint32_t realtimeGuardInterval = REALTIME_GUARD_INTERVAL_MAX;
 
 uint32_t currentTime = 0;
 uint16_t averageSystemLoadPercent = 0;
 
-#define REALTIME_GUARD_INTERVAL_MIN     10
-#define REALTIME_GUARD_INTERVAL_MAX     300
-#define REALTIME_GUARD_INTERVAL_MARGIN  25
-
 static int taskQueuePos = 0;
 static int taskQueueSize = 0;
 // No need for a linked list for the queue, since items are only inserted at startup
@@ -53,11 +81,35 @@ STATIC_UNIT_TESTED cfTask_t* taskQueueArray[TASK_COUNT + 2]; // 1 extra space so
 #else
 static cfTask_t* taskQueueArray[TASK_COUNT + 1]; // extra item for NULL pointer at end of queue
 #endif
+
+/*
+ * EDF ready structures. Realtime tasks are dispatched directly, everything else lives either
+ * in the pending heap (time-driven tasks waiting for their release time), in the ready heap
+ * (released tasks ordered by deadline) or in the event task list (polled through checkFunc).
+ * Picking the next task is O(1), releasing or re-arming a task is O(log n).
+ */
+typedef struct {
+    uint32_t key;
+    cfTask_t *task;
+} taskHeapEntry_t;
+
+typedef struct {
+    taskHeapEntry_t entry[TASK_COUNT];
+    int size;
+} taskHeap_t;
+
+STATIC_UNIT_TESTED taskHeap_t edfPendingHeap;
+STATIC_UNIT_TESTED taskHeap_t edfReadyHeap;
+static cfTask_t *edfEventTasks[TASK_COUNT];
+static int edfEventTaskCount = 0;
+static bool edfRebuildRequired = true;
+
 STATIC_UNIT_TESTED void queueClear(void)
 {
     memset(taskQueueArray, 0, sizeof(taskQueueArray));
     taskQueuePos = 0;
     taskQueueSize = 0;
+    edfRebuildRequired = true;
 }
 
 #ifdef UNIT_TEST
@@ -87,6 +139,7 @@ STATIC_UNIT_TESTED bool queueAdd(cfTask_t *task)
             memmove(&taskQueueArray[ii+1], &taskQueueArray[ii], sizeof(task) * (taskQueueSize - ii));
             taskQueueArray[ii] = task;
             ++taskQueueSize;
+            edfRebuildRequired = true;
             return true;
         }
     }
@@ -99,6 +152,7 @@ STATIC_UNIT_TESTED bool queueRemove(cfTask_t *task)
         if (taskQueueArray[ii] == task) {
             memmove(&taskQueueArray[ii], &taskQueueArray[ii+1], sizeof(task) * (taskQueueSize - ii));
             --taskQueueSize;
+            edfRebuildRequired = true;
             return true;
         }
     }
@@ -122,6 +176,273 @@ STATIC_INLINE_UNIT_TESTED cfTask_t *queueNext(void)
     return taskQueueArray[++taskQueuePos]; // guaranteed to be NULL at end of queue
 }
 
+// Keys are timestamps, compare them wrap-around safe
+#define heapKeyBefore(a, b) ((int32_t)((a) - (b)) < 0)
+
+static void heapSwap(taskHeap_t *heap, int a, int b)
+{
+    const taskHeapEntry_t tmp = heap->entry[a];
+    heap->entry[a] = heap->entry[b];
+    heap->entry[b] = tmp;
+}
+
+static void heapSiftUp(taskHeap_t *heap, int ii)
+{
+    while (ii > 0) {
+        const int parent = (ii - 1) / 2;
+        if (!heapKeyBefore(heap->entry[ii].key, heap->entry[parent].key)) {
+            break;
+        }
+        heapSwap(heap, ii, parent);
+        ii = parent;
+    }
+}
+
+static void heapSiftDown(taskHeap_t *heap, int ii)
+{
+    while (true) {
+        const int left = 2 * ii + 1;
+        const int right = left + 1;
+        int smallest = ii;
+        if (left < heap->size && heapKeyBefore(heap->entry[left].key, heap->entry[smallest].key)) {
+            smallest = left;
+        }
+        if (right < heap->size && heapKeyBefore(heap->entry[right].key, heap->entry[smallest].key)) {
+            smallest = right;
+        }
+        if (smallest == ii) {
+            break;
+        }
+        heapSwap(heap, ii, smallest);
+        ii = smallest;
+    }
+}
+
+STATIC_UNIT_TESTED void heapPush(taskHeap_t *heap, uint32_t key, cfTask_t *task)
+{
+    if (heap->size >= TASK_COUNT) {
+        return;
+    }
+
+    const int ii = heap->size++;
+    heap->entry[ii].key = key;
+    heap->entry[ii].task = task;
+    heapSiftUp(heap, ii);
+}
+
+STATIC_UNIT_TESTED void heapPop(taskHeap_t *heap)
+{
+    if (heap->size == 0) {
+        return;
+    }
+
+    heap->entry[0] = heap->entry[--heap->size];
+    heapSiftDown(heap, 0);
+}
+
+// Linear search is fine here, heaps are tiny and removal is only needed for signaled tasks
+static bool heapRemove(taskHeap_t *heap, const cfTask_t *task)
+{
+    for (int ii = 0; ii < heap->size; ii++) {
+        if (heap->entry[ii].task == task) {
+            heap->entry[ii] = heap->entry[--heap->size];
+            if (ii < heap->size) {
+                heapSiftUp(heap, ii);
+                heapSiftDown(heap, ii);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+static void heapUpdateKey(taskHeap_t *heap, const cfTask_t *task, uint32_t key)
+{
+    for (int ii = 0; ii < heap->size; ii++) {
+        if (heap->entry[ii].task == task) {
+            heap->entry[ii].key = key;
+            heapSiftUp(heap, ii);
+            heapSiftDown(heap, ii);
+            return;
+        }
+    }
+}
+
+static uint32_t taskSignalBit(const cfTask_t *task)
+{
+    return 1 << (task - cfTasks);
+}
+
+static uint32_t taskRelativeDeadline(const cfTask_t *task)
+{
+    return task->relativeDeadline ? task->relativeDeadline : task->desiredPeriod;
+}
+
+static void edfReleaseTask(cfTask_t *task, uint32_t releasedAt)
+{
+    task->absoluteDeadline = releasedAt + taskRelativeDeadline(task);
+    task->dynamicPriority = 1 + task->staticPriority;   // non-zero marks the task as waiting
+    // Signaled tasks are ordered as if their deadline was now, guard interval still uses the real deadline
+    heapPush(&edfReadyHeap, (signaledTasks & taskSignalBit(task)) ? releasedAt : task->absoluteDeadline, task);
+}
+
+static void edfRebuild(void)
+{
+    edfPendingHeap.size = 0;
+    edfReadyHeap.size = 0;
+    edfEventTaskCount = 0;
+
+    for (cfTask_t *task = queueFirst(); task != NULL; task = queueNext()) {
+        task->dynamicPriority = 0;
+        if (task->staticPriority >= TASK_PRIORITY_REALTIME) {
+            continue;
+        }
+        if (task->checkFunc != NULL) {
+            edfEventTasks[edfEventTaskCount++] = task;
+        } else {
+            heapPush(&edfPendingHeap, task->lastExecutedAt + task->desiredPeriod, task);
+        }
+    }
+
+    edfRebuildRequired = false;
+}
+
+static cfTask_t *edfSelectTask(cfTask_t *realtimeTask, bool outsideRealtimeGuardInterval, uint16_t *waitingTasks)
+{
+    if (edfRebuildRequired) {
+        edfRebuild();
+    }
+
+    // Signaled and yielded time-driven tasks don't wait for their release time
+    if (signaledTasks | yieldedTasks) {
+        cfTask_t *signaled[TASK_COUNT];
+        int signaledCount = 0;
+        for (int ii = 0; ii < edfPendingHeap.size; ii++) {
+            if ((signaledTasks | yieldedTasks) & taskSignalBit(edfPendingHeap.entry[ii].task)) {
+                signaled[signaledCount++] = edfPendingHeap.entry[ii].task;
+            }
+        }
+        for (int ii = 0; ii < signaledCount; ii++) {
+            heapRemove(&edfPendingHeap, signaled[ii]);
+            signaled[ii]->lastSignaledAt = currentTime;
+            edfReleaseTask(signaled[ii], currentTime);
+        }
+    }
+
+    // Move time-driven tasks which reached their release time to the ready heap
+    while (edfPendingHeap.size > 0 && !heapKeyBefore(currentTime, edfPendingHeap.entry[0].key)) {
+        cfTask_t *task = edfPendingHeap.entry[0].task;
+        const uint32_t releasedAt = edfPendingHeap.entry[0].key;
+        heapPop(&edfPendingHeap);
+        edfReleaseTask(task, releasedAt);
+    }
+
+    // Event-driven tasks are released by their checkFunc
+    for (int ii = 0; ii < edfEventTaskCount; ii++) {
+        cfTask_t *task = edfEventTasks[ii];
+        if (task->dynamicPriority == 0) {
+            if (task->checkFunc(currentTime - task->lastExecutedAt)) {
+                task->lastSignaledAt = currentTime;
+                edfReleaseTask(task, currentTime);
+            } else {
+                signaledTasks &= ~taskSignalBit(task);
+                yieldedTasks &= ~taskSignalBit(task);
+            }
+        }
+    }
+
+    *waitingTasks = edfReadyHeap.size + (realtimeTask ? 1 : 0);
+
+    if (realtimeTask) {
+        return realtimeTask;
+    }
+
+    if (edfReadyHeap.size > 0) {
+        cfTask_t *task = edfReadyHeap.entry[0].task;
+        // Task may only eat into realtime guard interval if it already missed its deadline
+        if (outsideRealtimeGuardInterval || !heapKeyBefore(currentTime, task->absoluteDeadline)) {
+            heapPop(&edfReadyHeap);
+            task->taskAgeCycles = 1 + ((currentTime - (task->absoluteDeadline - taskRelativeDeadline(task))) / task->desiredPeriod);
+            return task;
+        }
+    }
+
+    return NULL;
+}
+
+static void edfTaskExecuted(cfTask_t *task)
+{
+    // Realtime tasks are not kept in heaps, event-driven tasks are polled again by edfSelectTask
+    if (task->staticPriority < TASK_PRIORITY_REALTIME && task->checkFunc == NULL && !edfRebuildRequired) {
+        heapPush(&edfPendingHeap, task->lastExecutedAt + task->desiredPeriod, task);
+    }
+}
+
+static cfTask_t *dynamicPrioritySelectTask(bool outsideRealtimeGuardInterval, uint16_t *waitingTasks)
+{
+    cfTask_t *selectedTask = NULL;
+    uint16_t selectedTaskDynamicPriority = 0;
+    bool selectedTaskSignaled = false;
+
+    // Update task dynamic priorities
+    for (cfTask_t *task = queueFirst(); task != NULL; task = queueNext()) {
+        const uint32_t signalBit = taskSignalBit(task);
+
+        // Task has checkFunc - event driven
+        if (task->checkFunc != NULL) {
+            // Increase priority for event driven tasks
+            if (task->dynamicPriority > 0) {
+                task->taskAgeCycles = 1 + ((currentTime - task->lastSignaledAt) / task->desiredPeriod);
+                task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
+                (*waitingTasks)++;
+            } else if (task->checkFunc(currentTime - task->lastExecutedAt)) {
+                task->lastSignaledAt = currentTime;
+                task->taskAgeCycles = 1;
+                task->dynamicPriority = 1 + task->staticPriority;
+                (*waitingTasks)++;
+            } else {
+                task->taskAgeCycles = 0;
+                signaledTasks &= ~signalBit;
+                yieldedTasks &= ~signalBit;
+            }
+        } else {
+            // Task is time-driven, dynamicPriority is last execution age (measured in desiredPeriods)
+            // Task age is calculated from last execution
+            task->taskAgeCycles = ((currentTime - task->lastExecutedAt) / task->desiredPeriod);
+            if (task->taskAgeCycles > 0) {
+                task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
+                (*waitingTasks)++;
+            } else if ((signaledTasks | yieldedTasks) & signalBit) {
+                // Signaled or yielded before its period elapsed, release it right away
+                if (task->dynamicPriority == 0) {
+                    task->lastSignaledAt = currentTime;
+                    task->dynamicPriority = 1 + task->staticPriority;
+                }
+                (*waitingTasks)++;
+            }
+        }
+
+        // Waiting signaled tasks take precedence over other tasks as soon as the realtime guard allows
+        const bool taskSignaled = (signaledTasks & signalBit) && (task->dynamicPriority > 0);
+        if (taskSignaled < selectedTaskSignaled) {
+            continue;
+        }
+        if (task->dynamicPriority > selectedTaskDynamicPriority || (taskSignaled && !selectedTaskSignaled && task->dynamicPriority > 0)) {
+            const bool taskCanBeChosenForScheduling =
+                (outsideRealtimeGuardInterval) ||
+                (task->taskAgeCycles > 1) ||
+                (task->staticPriority == TASK_PRIORITY_REALTIME);
+            if (taskCanBeChosenForScheduling) {
+                selectedTaskDynamicPriority = task->dynamicPriority;
+                selectedTaskSignaled = taskSignaled;
+                selectedTask = task;
+            }
+        }
+    }
+
+    return selectedTask;
+}
+
 void taskSystem(void)
 {
     /* Calculate system load */
@@ -157,6 +478,63 @@ void getTaskInfo(cfTaskId_e taskId, cfTaskInfo_t * taskInfo)
     taskInfo->averageExecutionTime = cfTasks[taskId].averageExecutionTime;
     taskInfo->latestDeltaTime = cfTasks[taskId].taskLatestDeltaTime;
 }
+
+const taskHistogram_t *getTaskHistogram(cfTaskId_e taskId, taskHistogramType_e type)
+{
+    return &cfTasks[taskId].histogram[type];
+}
+
+/*
+ * Returns the value below which given percentage of samples fall, linearly interpolated inside the bucket.
+ * Samples in the open ended last bucket are reported as its lower bound.
+ */
+uint32_t taskHistogramPercentile(const taskHistogram_t *histogram, uint8_t percentile)
+{
+    uint32_t sampleCount = 0;
+    for (int ii = 0; ii < TASK_HISTOGRAM_BUCKET_COUNT; ii++) {
+        sampleCount += histogram->bucket[ii];
+    }
+    if (sampleCount == 0) {
+        return 0;
+    }
+
+    const uint32_t rank = (sampleCount * percentile + 99) / 100;
+    uint32_t samplesBelow = 0;
+    for (int ii = 0; ii < TASK_HISTOGRAM_BUCKET_COUNT - 1; ii++) {
+        const uint32_t count = histogram->bucket[ii];
+        if (samplesBelow + count >= rank && count > 0) {
+            if (ii == 0) {
+                return 0;
+            }
+            const uint32_t lowerBound = 1 << (ii - 1);
+            return lowerBound + (lowerBound * (rank - samplesBelow)) / count;
+        }
+        samplesBelow += count;
+    }
+    return 1 << (TASK_HISTOGRAM_BUCKET_COUNT - 2);
+}
+
+static void taskHistogramAdd(taskHistogram_t *histogram, uint32_t value)
+{
+    const int bucket = value ? MIN(32 - __builtin_clz(value), TASK_HISTOGRAM_BUCKET_COUNT - 1) : 0;
+    if (histogram->bucket[bucket] == UINT16_MAX) {
+        // Halve all counts to make room, keeps the shape and gives recent samples more weight
+        for (int ii = 0; ii < TASK_HISTOGRAM_BUCKET_COUNT; ii++) {
+            histogram->bucket[ii] /= 2;
+        }
+    }
+    histogram->bucket[bucket]++;
+}
+
+static uint32_t taskStartLatency(const cfTask_t *task)
+{
+    // Event-driven and signaled tasks are due since their signal, time-driven tasks one period after their last run
+    if (task->checkFunc != NULL || ((signaledTasks | yieldedTasks) & taskSignalBit(task))) {
+        return currentTime - task->lastSignaledAt;
+    }
+    const uint32_t dueAt = task->lastExecutedAt + task->desiredPeriod;
+    return (int32_t)(currentTime - dueAt) > 0 ? currentTime - dueAt : 0;
+}
 #endif
 
 void rescheduleTask(cfTaskId_e taskId, uint32_t newPeriodMicros)
@@ -164,6 +542,8 @@ void rescheduleTask(cfTaskId_e taskId, uint32_t newPeriodMicros)
     if (taskId == TASK_SELF || taskId < TASK_COUNT) {
         cfTask_t *task = taskId == TASK_SELF ? currentTask : &cfTasks[taskId];
         task->desiredPeriod = MAX((uint32_t)100, newPeriodMicros);  // Limit delay to 100us (10 kHz) to prevent scheduler clogging
+        // Pending heap is keyed by release time, which depends on the period
+        heapUpdateKey(&edfPendingHeap, task, task->lastExecutedAt + task->desiredPeriod);
     }
 }
 
@@ -189,8 +569,50 @@ uint32_t getTaskDeltaTime(cfTaskId_e taskId)
     }
 }
 
+/*
+ * Safe to call from interrupt context. The task becomes ready on the next scheduler pass and is run
+ * ahead of tasks which were not signaled, as soon as realtime guard interval allows.
+ */
+void signalTask(cfTaskId_e taskId)
+{
+    if (taskId < TASK_COUNT) {
+        ATOMIC_OR(&pendingTaskSignals, 1 << taskId);
+    }
+}
+
+/*
+ * Resumable tasks check this between units of work and yield once it returns true.
+ * The slice ends REALTIME_GUARD_INTERVAL_MARGIN ahead of the next realtime task, but is never longer than TASK_TIME_SLICE_MAX.
+ */
+bool isTaskTimeSliceExpired(void)
+{
+    return currentTask != NULL && (int32_t)(micros() - currentTaskSliceEndsAt) >= 0;
+}
+
+// Current task is invoked again as soon as possible, even if its period has not elapsed
+void taskYield(void)
+{
+    if (currentTask != NULL) {
+        yieldedTasks |= taskSignalBit(currentTask);
+    }
+}
+
+void schedulerSetPolicy(schedulerPolicy_e policy)
+{
+    if (policy != schedulerPolicy) {
+        schedulerPolicy = policy;
+        edfRebuildRequired = true;
+        // Policies use dynamicPriority differently, start over with all tasks idle
+        for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+            cfTasks[taskId].dynamicPriority = 0;
+        }
+    }
+}
+
 void schedulerInit(void)
 {
+    BUILD_BUG_ON(TASK_COUNT > 32);  // pendingTaskSignals holds one bit per task
+
     queueClear();
     queueAdd(&cfTasks[TASK_SYSTEM]);
 }
@@ -200,11 +622,20 @@ void scheduler(void)
     // Cache currentTime
     currentTime = micros();
 
+    // Take over signals raised by interrupts since last pass
+    if (pendingTaskSignals) {
+        signaledTasks |= ATOMIC_AND(&pendingTaskSignals, 0);
+    }
+
     uint32_t timeToNextRealtimeTask = UINT32_MAX;
-    for (const cfTask_t *task = queueFirst(); task != NULL && task->staticPriority >= TASK_PRIORITY_REALTIME; task = queueNext()) {
+    cfTask_t *realtimeTaskDue = NULL;
+    for (cfTask_t *task = queueFirst(); task != NULL && task->staticPriority >= TASK_PRIORITY_REALTIME; task = queueNext()) {
         const uint32_t nextExecuteAt = task->lastExecutedAt + task->desiredPeriod;
         if ((int32_t)(currentTime - nextExecuteAt) >= 0) {
             timeToNextRealtimeTask = 0;
+            if (realtimeTaskDue == NULL) {
+                realtimeTaskDue = task;
+            }
         } else {
             const uint32_t newTimeInterval = nextExecuteAt - currentTime;
             timeToNextRealtimeTask = MIN(timeToNextRealtimeTask, newTimeInterval);
@@ -213,47 +644,12 @@ void scheduler(void)
     const bool outsideRealtimeGuardInterval = (timeToNextRealtimeTask > realtimeGuardInterval);
 
     // The task to be invoked
-    cfTask_t *selectedTask = NULL;
-    uint16_t selectedTaskDynamicPriority = 0;
-
-    // Update task dynamic priorities
     uint16_t waitingTasks = 0;
-    for (cfTask_t *task = queueFirst(); task != NULL; task = queueNext()) {
-        // Task has checkFunc - event driven
-        if (task->checkFunc != NULL) {
-            // Increase priority for event driven tasks
-            if (task->dynamicPriority > 0) {
-                task->taskAgeCycles = 1 + ((currentTime - task->lastSignaledAt) / task->desiredPeriod);
-                task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
-                waitingTasks++;
-            } else if (task->checkFunc(currentTime - task->lastExecutedAt)) {
-                task->lastSignaledAt = currentTime;
-                task->taskAgeCycles = 1;
-                task->dynamicPriority = 1 + task->staticPriority;
-                waitingTasks++;
-            } else {
-                task->taskAgeCycles = 0;
-            }
-        } else {
-            // Task is time-driven, dynamicPriority is last execution age (measured in desiredPeriods)
-            // Task age is calculated from last execution
-            task->taskAgeCycles = ((currentTime - task->lastExecutedAt) / task->desiredPeriod);
-            if (task->taskAgeCycles > 0) {
-                task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
-                waitingTasks++;
-            }
-        }
-
-        if (task->dynamicPriority > selectedTaskDynamicPriority) {
-            const bool taskCanBeChosenForScheduling =
-                (outsideRealtimeGuardInterval) ||
-                (task->taskAgeCycles > 1) ||
-                (task->staticPriority == TASK_PRIORITY_REALTIME);
-            if (taskCanBeChosenForScheduling) {
-                selectedTaskDynamicPriority = task->dynamicPriority;
-                selectedTask = task;
-            }
-        }
+    cfTask_t *selectedTask;
+    if (schedulerPolicy == SCHEDULER_POLICY_EDF) {
+        selectedTask = edfSelectTask(realtimeTaskDue, outsideRealtimeGuardInterval, &waitingTasks);
+    } else {
+        selectedTask = dynamicPrioritySelectTask(outsideRealtimeGuardInterval, &waitingTasks);
     }
 
     totalWaitingTasksSamples++;
@@ -261,11 +657,25 @@ void scheduler(void)
 
     currentTask = selectedTask;
 
+#ifdef UNIT_TEST
+    unittest_scheduler_selectedTask = selectedTask;
+    unittest_scheduler_waitingTasks = waitingTasks;
+    unittest_scheduler_timeToNextRealtimeTask = timeToNextRealtimeTask;
+    unittest_outsideRealtimeGuardInterval = outsideRealtimeGuardInterval;
+#endif
+
     if (selectedTask != NULL) {
         // Found a task that should be run
+#ifndef SKIP_TASK_STATISTICS
+        const uint32_t startLatency = taskStartLatency(selectedTask);
+#endif
         selectedTask->taskLatestDeltaTime = currentTime - selectedTask->lastExecutedAt;
         selectedTask->lastExecutedAt = currentTime;
         selectedTask->dynamicPriority = 0;
+        signaledTasks &= ~taskSignalBit(selectedTask);
+        yieldedTasks &= ~taskSignalBit(selectedTask);
+        const uint32_t timeSlice = MIN(timeToNextRealtimeTask, (uint32_t)(TASK_TIME_SLICE_MAX + REALTIME_GUARD_INTERVAL_MARGIN));
+        currentTaskSliceEndsAt = currentTime + (timeSlice > REALTIME_GUARD_INTERVAL_MARGIN ? timeSlice - REALTIME_GUARD_INTERVAL_MARGIN : 0);
 
         // Execute task
         const uint32_t currentTimeBeforeTaskCall = micros();
@@ -276,7 +686,12 @@ void scheduler(void)
 #ifndef SKIP_TASK_STATISTICS
         selectedTask->totalExecutionTime += taskExecutionTime;   // time consumed by scheduler + task
         selectedTask->maxExecutionTime = MAX(selectedTask->maxExecutionTime, taskExecutionTime);
+        taskHistogramAdd(&selectedTask->histogram[TASK_HISTOGRAM_EXECUTION_TIME], taskExecutionTime);
+        taskHistogramAdd(&selectedTask->histogram[TASK_HISTOGRAM_START_LATENCY], startLatency);
 #endif
+        if (schedulerPolicy == SCHEDULER_POLICY_EDF) {
+            edfTaskExecuted(selectedTask);
+        }
 #if defined SCHEDULER_DEBUG
         debug[3] = (micros() - currentTime) - taskExecutionTime;
     } else {
@@ -28,6 +28,23 @@ typedef enum {
     TASK_PRIORITY_MAX = 255
 } cfTaskPriority_e;
 
+typedef enum {
+    SCHEDULER_POLICY_DYNAMIC_PRIORITY = 0,  // Task with the highest age-weighted static priority runs first
+    SCHEDULER_POLICY_EDF,                   // Released task with the earliest deadline runs first
+} schedulerPolicy_e;
+
+#define TASK_HISTOGRAM_BUCKET_COUNT 16   // bucket n counts samples in [2^(n-1), 2^n) us, bucket 0 is 0us, last bucket is open ended
+
+typedef enum {
+    TASK_HISTOGRAM_EXECUTION_TIME = 0,  // time spent in taskFunc
+    TASK_HISTOGRAM_START_LATENCY,       // time from task becoming due to task being started
+    TASK_HISTOGRAM_COUNT
+} taskHistogramType_e;
+
+typedef struct {
+    uint16_t bucket[TASK_HISTOGRAM_BUCKET_COUNT];
+} taskHistogram_t;
+
 typedef struct {
     const char * taskName;
     bool         isEnabled;
@@ -47,6 +64,10 @@ typedef enum {
     TASK_BEEPER,
     TASK_BATTERY,
     TASK_RX,
+#ifdef NAV
+    TASK_POS_ESTIMATOR,
+    TASK_NAV,
+#endif
 #ifdef GPS
     TASK_GPS,
 #endif
@@ -84,12 +105,14 @@ typedef struct {
     void (*taskFunc)(void);
     uint32_t desiredPeriod;         // target period of execution
     const uint8_t staticPriority;   // dynamicPriority grows in steps of this size, shouldn't be zero
+    uint32_t relativeDeadline;      // EDF: allowed start latency after release, desiredPeriod is used if zero
 
     /* Scheduling */
     uint16_t dynamicPriority;       // measurement of how old task was last executed, used to avoid task starvation
     uint16_t taskAgeCycles;
     uint32_t lastExecutedAt;        // last time of invocation
     uint32_t lastSignaledAt;        // time of invocation event for event-driven tasks
+    uint32_t absoluteDeadline;      // EDF: time by which the pending invocation should have started
 
     /* Statistics */
     uint32_t averageExecutionTime;  // Moving average over 6 samples, used to calculate guard interval
@@ -97,6 +120,7 @@ typedef struct {
 #ifndef SKIP_TASK_STATISTICS
     uint32_t maxExecutionTime;
     uint32_t totalExecutionTime;    // total time consumed by task since boot
+    taskHistogram_t histogram[TASK_HISTOGRAM_COUNT];
 #endif
 } cfTask_t;
 
@@ -105,9 +129,40 @@ extern uint16_t cpuLoad;
 extern uint16_t averageSystemLoadPercent;
 
 void getTaskInfo(cfTaskId_e taskId, cfTaskInfo_t * taskInfo);
+const taskHistogram_t *getTaskHistogram(cfTaskId_e taskId, taskHistogramType_e type);
+uint32_t taskHistogramPercentile(const taskHistogram_t *histogram, uint8_t percentile);
 void rescheduleTask(cfTaskId_e taskId, uint32_t newPeriodMicros);
 void setTaskEnabled(cfTaskId_e taskId, bool newEnabledState);
 uint32_t getTaskDeltaTime(cfTaskId_e taskId);
+void signalTask(cfTaskId_e taskId);
+
+void schedulerSetPolicy(schedulerPolicy_e policy);
+
+#define TASK_TIME_SLICE_MAX 100     // upper limit of the time slice (in us) given to resumable tasks
+
+bool isTaskTimeSliceExpired(void);
+void taskYield(void);
+
+/*
+ * Protothread style continuations for tasks that have more work than fits into one time slice.
+ * TASK_YIELD returns from the enclosing void function and the next call resumes right after it,
+ * local variables are not preserved across a yield so keep state in static variables.
+ * Event-driven tasks must keep their checkFunc returning true until the work is done.
+ *
+ *     static taskContinuation_t continuation;
+ *     TASK_BEGIN(continuation);
+ *     for (index = 0; index < count; index++) {
+ *         doSomeWork(index);
+ *         TASK_YIELD_IF_EXPIRED(continuation);
+ *     }
+ *     TASK_END(continuation);
+ */
+typedef uint16_t taskContinuation_t;
+
+#define TASK_BEGIN(continuation) switch (continuation) { case 0:
+#define TASK_YIELD(continuation) do { (continuation) = __LINE__; taskYield(); return; case __LINE__:; } while (0)
+#define TASK_YIELD_IF_EXPIRED(continuation) do { if (isTaskTimeSliceExpired()) { TASK_YIELD(continuation); } } while (0)
+#define TASK_END(continuation) } (continuation) = 0
 
 void schedulerInit(void);
 void scheduler(void);
@@ -28,6 +28,8 @@ void taskUpdateBeeper(void);
 void taskUpdateBattery(void);
 bool taskUpdateRxCheck(uint32_t currentDeltaTime);
 void taskUpdateRxMain(void);
+void taskUpdatePositionEstimator(void);
+void taskNavigation(void);
 void taskProcessGPS(void);
 void taskUpdateCompass(void);
 void taskUpdateBaro(void);
@@ -81,6 +83,22 @@ cfTask_t cfTasks[TASK_COUNT] = {
         .staticPriority = TASK_PRIORITY_HIGH,
     },
 
+#ifdef NAV
+    [TASK_POS_ESTIMATOR] = {
+        .taskName = "POSEST",
+        .taskFunc = taskUpdatePositionEstimator,
+        .desiredPeriod = 1000000 / 100,     // rescheduled to inav_update_rate_hz
+        .staticPriority = TASK_PRIORITY_HIGH,
+    },
+
+    [TASK_NAV] = {
+        .taskName = "NAV",
+        .taskFunc = taskNavigation,
+        .desiredPeriod = 1000000 / 50,      // rescheduled to nav_update_rate_hz, also signaled by every new position estimate
+        .staticPriority = TASK_PRIORITY_HIGH,
+    },
+#endif
+
 #ifdef GPS
     [TASK_GPS] = {
         .taskName = "GPS",
@@ -49,8 +49,8 @@ static flightDynamicsTrims_t * accZero;
 static flightDynamicsTrims_t * accGain;
 
 static int8_t accLpfCutHz = 0;
-static biquad_t accFilterState[XYZ_AXIS_COUNT];
-static bool accFilterInitialised = false;
+static biquadBank_t accFilterBank;
+static uint32_t accFilterLooptime = 0;      // looptime the filter was designed for, 0 if not yet initialised
 
 void accSetCalibrationCycles(uint16_t calibrationCyclesRequired)
 {
@@ -181,20 +181,19 @@ void updateAccelerationReadings(void)
     for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) accADC[axis] = accADCRaw[axis];
 
     if (accLpfCutHz) {
-        if (!accFilterInitialised) {
-            if (targetLooptime) {  /* Initialisation needs to happen once sample rate is known */
-                for (int axis = 0; axis < 3; axis++) {
-                    filterInitBiQuad(accLpfCutHz, &accFilterState[axis], 0);
-                }
-
-                accFilterInitialised = true;
+        if (accFilterLooptime != targetLooptime) {
+            if (targetLooptime) {  /* Initialisation needs to happen once sample rate is known, and again if it changes */
+                biquad_t accFilterStage;
+                filterInitBiQuad(accLpfCutHz, &accFilterStage, 0);
+                filterInitBiQuadBank(&accFilterBank);
+                filterBiQuadBankAddStage(&accFilterBank, &accFilterStage);
+
+                accFilterLooptime = targetLooptime;
             }
         }
 
-        if (accFilterInitialised) {
-            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
-                accADC[axis] = lrintf(filterApplyBiQuad((float) accADC[axis], &accFilterState[axis]));
-            }
+        if (accFilterLooptime) {
+            filterApplyBiQuadBankInt32(&accFilterBank, accADC);
         }
     }
 
@@ -204,7 +203,7 @@ void updateAccelerationReadings(void)
 
     applyAccelerationZero(accZero, accGain);
 
-    alignSensors(accADC, accADC, accAlign);
+    alignSensors(SENSOR_INDEX_ACC, accADC);
 }
 
 void setAccelerationZero(flightDynamicsTrims_t * accZeroToUse)
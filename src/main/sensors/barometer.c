@@ -24,6 +24,7 @@
 #include "scheduler/scheduler.h"
 
 #include "common/maths.h"
+#include "common/filter.h"
 
 #include "drivers/barometer.h"
 #include "drivers/system.h"
@@ -67,24 +68,17 @@ static bool baroReady = false;
 
 static int32_t applyBarometerMedianFilter(int32_t newPressureReading)
 {
-    static int32_t barometerFilterSamples[PRESSURE_SAMPLES_MEDIAN];
-    static int currentFilterSampleIndex = 0;
-    static bool medianFilterReady = false;
-    int nextSampleIndex;
-
-    nextSampleIndex = (currentFilterSampleIndex + 1);
-    if (nextSampleIndex == PRESSURE_SAMPLES_MEDIAN) {
-        nextSampleIndex = 0;
-        medianFilterReady = true;
+    static medianFilter_t barometerMedianFilter;
+    static bool medianFilterInitialised = false;
+
+    if (!medianFilterInitialised) {
+        medianFilterInit(&barometerMedianFilter, PRESSURE_SAMPLES_MEDIAN);
+        medianFilterInitialised = true;
     }
 
-    barometerFilterSamples[currentFilterSampleIndex] = newPressureReading;
-    currentFilterSampleIndex = nextSampleIndex;
+    const int32_t median = medianFilterApply(&barometerMedianFilter, newPressureReading);
 
-    if (medianFilterReady)
-        return quickMedianFilter3(barometerFilterSamples);
-    else
-        return newPressureReading;
+    return medianFilterIsFull(&barometerMedianFilter) ? median : newPressureReading;
 }
 
 typedef enum {
@@ -18,18 +18,62 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <math.h>
-#include <string.h>
 
 #include "common/maths.h"
 #include "common/axis.h"
+#include "common/fixedpoint.h"
 
 #include "sensors.h"
 
 #include "boardalignment.h"
 
+#define ALIGNED_SENSOR_COUNT    MAX_SENSORS_TO_DETECT
+
+// dest = rotation * src for every sensor_align_e, rows are the destination axes
+static const int8_t sensorRotations[CW270_DEG_FLIP + 1][3][3] = {
+    [ALIGN_DEFAULT]  = { {  1,  0,  0 }, {  0,  1,  0 }, {  0,  0,  1 } },
+    [CW0_DEG]        = { {  1,  0,  0 }, {  0,  1,  0 }, {  0,  0,  1 } },
+    [CW90_DEG]       = { {  0,  1,  0 }, { -1,  0,  0 }, {  0,  0,  1 } },
+    [CW180_DEG]      = { { -1,  0,  0 }, {  0, -1,  0 }, {  0,  0,  1 } },
+    [CW270_DEG]      = { {  0, -1,  0 }, {  1,  0,  0 }, {  0,  0,  1 } },
+    [CW0_DEG_FLIP]   = { { -1,  0,  0 }, {  0,  1,  0 }, {  0,  0, -1 } },
+    [CW90_DEG_FLIP]  = { {  0,  1,  0 }, {  1,  0,  0 }, {  0,  0, -1 } },
+    [CW180_DEG_FLIP] = { {  1,  0,  0 }, {  0, -1,  0 }, {  0,  0, -1 } },
+    [CW270_DEG_FLIP] = { {  0, -1,  0 }, { -1,  0,  0 }, {  0,  0, -1 } },
+};
+
 static bool standardBoardAlignment = true;     // board orientation correction
 static float boardRotation[3][3];              // matrix
 
+// Sensor rotation followed by board rotation, one Q30 matrix per sensor rebuilt whenever either changes
+static sensor_align_e sensorAlignment[ALIGNED_SENSOR_COUNT];
+static q31_t sensorAlignmentMatrix[ALIGNED_SENSOR_COUNT][3][3];
+
+static void buildSensorAlignmentMatrix(sensorIndex_e sensor)
+{
+    const int8_t (*rotation)[3] = sensorRotations[sensorAlignment[sensor]];
+
+    for (int row = 0; row < 3; row++) {
+        for (int col = 0; col < 3; col++) {
+            float value;
+            if (standardBoardAlignment) {
+                value = rotation[row][col];
+            } else {
+                // board alignment is applied to the sensor aligned vector with the transposed board matrix
+                value = boardRotation[X][row] * rotation[X][col] + boardRotation[Y][row] * rotation[Y][col] + boardRotation[Z][row] * rotation[Z][col];
+            }
+            sensorAlignmentMatrix[sensor][row][col] = floatToQ30(value);
+        }
+    }
+}
+
+static void buildSensorAlignmentMatrices(void)
+{
+    for (int sensor = 0; sensor < ALIGNED_SENSOR_COUNT; sensor++) {
+        buildSensorAlignmentMatrix(sensor);
+    }
+}
+
 static bool isBoardAlignmentStandard(boardAlignment_t *boardAlignment)
 {
     return !boardAlignment->rollDeciDegrees && !boardAlignment->pitchDeciDegrees && !boardAlignment->yawDeciDegrees;
@@ -51,12 +95,20 @@ void initBoardAlignment(boardAlignment_t *boardAlignment)
 
         buildRotationMatrix(&rotationAngles, boardRotation);
     }
+
+    buildSensorAlignmentMatrices();
+}
+
+void initSensorAlignment(sensorIndex_e sensor, sensor_align_e rotation)
+{
+    sensorAlignment[sensor] = (rotation <= CW270_DEG_FLIP) ? rotation : ALIGN_DEFAULT;
+    buildSensorAlignmentMatrix(sensor);
 }
 
 void updateBoardAlignment(boardAlignment_t *boardAlignment, int16_t roll, int16_t pitch)
 {
-    float sinAlignYaw = sin_approx(DECIDEGREES_TO_RADIANS(boardAlignment->yawDeciDegrees));
-    float cosAlignYaw = cos_approx(DECIDEGREES_TO_RADIANS(boardAlignment->yawDeciDegrees));
+    float sinAlignYaw, cosAlignYaw;
+    sincos_approx(DECIDEGREES_TO_RADIANS(boardAlignment->yawDeciDegrees), &sinAlignYaw, &cosAlignYaw);
 
     boardAlignment->rollDeciDegrees += -sinAlignYaw * pitch + cosAlignYaw * roll;
     boardAlignment->pitchDeciDegrees += cosAlignYaw * pitch + sinAlignYaw * roll;
@@ -64,66 +116,18 @@ void updateBoardAlignment(boardAlignment_t *boardAlignment, int16_t roll, int16_
     initBoardAlignment(boardAlignment);
 }
 
-static void alignBoard(int32_t *vec)
+// Rotates a raw sample in place, 9 integer multiply-accumulates whatever the sensor and board orientation
+void alignSensors(sensorIndex_e sensor, int32_t *vec)
 {
-    int32_t x = vec[X];
-    int32_t y = vec[Y];
-    int32_t z = vec[Z];
-
-    vec[X] = lrintf(boardRotation[0][X] * x + boardRotation[1][X] * y + boardRotation[2][X] * z);
-    vec[Y] = lrintf(boardRotation[0][Y] * x + boardRotation[1][Y] * y + boardRotation[2][Y] * z);
-    vec[Z] = lrintf(boardRotation[0][Z] * x + boardRotation[1][Z] * y + boardRotation[2][Z] * z);
-}
-
-void alignSensors(int32_t *src, int32_t *dest, uint8_t rotation)
-{
-    static uint32_t swap[3];
-    memcpy(swap, src, sizeof(swap));
-
-    switch (rotation) {
-        default:
-        case CW0_DEG:
-            dest[X] = swap[X];
-            dest[Y] = swap[Y];
-            dest[Z] = swap[Z];
-            break;
-        case CW90_DEG:
-            dest[X] = swap[Y];
-            dest[Y] = -swap[X];
-            dest[Z] = swap[Z];
-            break;
-        case CW180_DEG:
-            dest[X] = -swap[X];
-            dest[Y] = -swap[Y];
-            dest[Z] = swap[Z];
-            break;
-        case CW270_DEG:
-            dest[X] = -swap[Y];
-            dest[Y] = swap[X];
-            dest[Z] = swap[Z];
-            break;
-        case CW0_DEG_FLIP:
-            dest[X] = -swap[X];
-            dest[Y] = swap[Y];
-            dest[Z] = -swap[Z];
-            break;
-        case CW90_DEG_FLIP:
-            dest[X] = swap[Y];
-            dest[Y] = swap[X];
-            dest[Z] = -swap[Z];
-            break;
-        case CW180_DEG_FLIP:
-            dest[X] = swap[X];
-            dest[Y] = -swap[Y];
-            dest[Z] = -swap[Z];
-            break;
-        case CW270_DEG_FLIP:
-            dest[X] = -swap[Y];
-            dest[Y] = -swap[X];
-            dest[Z] = -swap[Z];
-            break;
+    const int32_t x = vec[X];
+    const int32_t y = vec[Y];
+    const int32_t z = vec[Z];
+
+    for (int axis = 0; axis < 3; axis++) {
+        int64_t accumulator = 0;
+        accumulator = q31Mac(accumulator, sensorAlignmentMatrix[sensor][axis][X], x);
+        accumulator = q31Mac(accumulator, sensorAlignmentMatrix[sensor][axis][Y], y);
+        accumulator = q31Mac(accumulator, sensorAlignmentMatrix[sensor][axis][Z], z);
+        vec[axis] = q31SatAccumulator(accumulator, Q30_SHIFT);
     }
-
-    if (!standardBoardAlignment)
-        alignBoard(dest);
 }
@@ -17,12 +17,15 @@
 
 #pragma once
 
+#include "sensors/sensors.h"
+
 typedef struct boardAlignment_s {
     int16_t rollDeciDegrees;
     int16_t pitchDeciDegrees;
     int16_t yawDeciDegrees;
 } boardAlignment_t;
 
-void alignSensors(int32_t *src, int32_t *dest, uint8_t rotation);
+void alignSensors(sensorIndex_e sensor, int32_t *vec);
 void initBoardAlignment(boardAlignment_t *boardAlignment);
+void initSensorAlignment(sensorIndex_e sensor, sensor_align_e rotation);
 void updateBoardAlignment(boardAlignment_t *boardAlignment, int16_t roll, int16_t pitch);
@@ -129,7 +129,7 @@ void updateCompass(flightDynamicsTrims_t *magZero)
         }
     }
 
-    alignSensors(magADC, magADC, magAlign);
+    alignSensors(SENSOR_INDEX_MAG, magADC);
 
     magUpdatedAtLeastOnce = 1;
 }
@@ -28,6 +28,7 @@
 #include "drivers/sensor.h"
 #include "drivers/accgyro.h"
 #include "drivers/gyro_sync.h"
+#include "drivers/system.h"
 
 #include "io/beeper.h"
 #include "io/statusindicator.h"
@@ -35,6 +36,8 @@
 #include "sensors/sensors.h"
 #include "sensors/boardalignment.h"
 #include "sensors/gyro.h"
+#include "sensors/gyroanalyse.h"
+#include "sensors/gyronoise.h"
 
 gyro_t gyro;                      // gyro access functions
 sensor_align_e gyroAlign = 0;
@@ -43,23 +46,69 @@ int32_t gyroADC[XYZ_AXIS_COUNT];
 
 static gyroConfig_t *gyroConfig;
 
-static uint16_t calibratingG = 0;
+static uint16_t calibratingG = 0;         // cycles left before calibration is forced to finish
+static bool calibrationStarted = false;
+static uint32_t calibrationStartTime;
+static gyroCalibrationStatus_t calibrationStatus;
 static int16_t gyroADCRaw[XYZ_AXIS_COUNT];
 static int32_t gyroZero[FLIGHT_DYNAMICS_INDEX_COUNT] = { 0, 0, 0 };
 
 static int8_t gyroLpfCutHz = 0;
-static biquad_t gyroFilterState[XYZ_AXIS_COUNT];
-static bool gyroFilterInitialised = false;
+static biquadBank_t gyroFilterBank;
+static uint32_t gyroFilterLooptime = 0;     // looptime the filter was designed for, 0 if not yet initialised
 
 void useGyroConfig(gyroConfig_t *gyroConfigToUse, int8_t initialGyroLpfCutHz)
 {
     gyroConfig = gyroConfigToUse;
     gyroLpfCutHz = initialGyroLpfCutHz;
+    gyroFilterLooptime = 0;     // settings may have changed, rebuild filters on next update
+}
+
+static bool isGyroDynamicLpfEnabled(void)
+{
+#ifdef USE_GYRO_DYNAMIC_LPF
+    return gyroConfig->gyroDynamicLpf;
+#else
+    return false;
+#endif
+}
+
+static void gyroInitFilters(void)
+{
+    biquad_t gyroFilterStage;
+
+    filterInitBiQuadBank(&gyroFilterBank);
+
+    // Dynamic low pass replaces the static one
+    if (gyroLpfCutHz && !isGyroDynamicLpfEnabled()) {
+        filterInitBiQuad(gyroLpfCutHz, &gyroFilterStage, 0);
+        filterBiQuadBankAddStage(&gyroFilterBank, &gyroFilterStage);
+    }
+
+    for (int i = 0; i < GYRO_NOTCH_COUNT; i++) {
+        // Notches at or above Nyquist for the current looptime are skipped
+        if (gyroConfig->gyroNotchHz[i] && filterInitBiQuadOfType(&gyroFilterStage, FILTER_BIQUAD_NOTCH, gyroConfig->gyroNotchHz[i], gyroConfig->gyroNotchQ[i] / 100.0f, 0)) {
+            filterBiQuadBankAddStage(&gyroFilterBank, &gyroFilterStage);
+        }
+    }
+
+#ifdef USE_GYRO_DYNAMIC_NOTCH
+    if (gyroConfig->gyroDynamicNotch) {
+        gyroDynamicNotchInit(targetLooptime, gyroConfig->gyroDynamicNotchMinHz, gyroConfig->gyroDynamicNotchQ);
+    }
+#endif
+
+#ifdef USE_GYRO_DYNAMIC_LPF
+    if (gyroConfig->gyroDynamicLpf) {
+        gyroDynamicLpfInit(targetLooptime, gyroConfig->gyroDynamicLpfMinHz, gyroConfig->gyroDynamicLpfMaxHz);
+    }
+#endif
 }
 
 void gyroSetCalibrationCycles(uint16_t calibrationCyclesRequired)
 {
     calibratingG = calibrationCyclesRequired;
+    calibrationStarted = false;
 }
 
 bool isGyroCalibrationComplete(void)
@@ -77,11 +126,37 @@ static bool isOnFirstGyroCalibrationCycle(void)
     return calibratingG == CALIBRATING_GYRO_CYCLES;
 }
 
-static void performAcclerationCalibration(uint8_t gyroMovementCalibrationThreshold)
+static void restartGyroCalibration(void)
+{
+    calibratingG = CALIBRATING_GYRO_CYCLES;
+    if (calibrationStatus.restartCount < UINT8_MAX) {
+        calibrationStatus.restartCount++;
+    }
+}
+
+/*
+ * Averages up to CALIBRATING_GYRO_CYCLES readings into the gyro zero. Once minCalibrationCycles are in, calibration
+ * ends as soon as the standard error of the mean (deviation / sqrt(samples)) is below GYRO_CALIBRATION_ZERO_TOLERANCE
+ * on all axes, so a still craft doesn't wait for the full count. A deviation above the movement threshold starts over.
+ * Readings are taken before the gyro filters: low pass filtered samples are correlated, their standard error would
+ * look far smaller than it is.
+ */
+static void performGyroCalibration(uint8_t gyroMovementCalibrationThreshold, uint16_t minCalibrationCycles)
 {
     static int32_t g[3];
     static stdev_t var[3];
 
+    if (!calibrationStarted) {
+        calibrationStarted = true;
+        calibrationStartTime = millis();
+        calibrationStatus.restartCount = 0;
+    }
+
+    const uint16_t sampleCount = CALIBRATING_GYRO_CYCLES - calibratingG + 1;
+    const bool canFinish = sampleCount >= minCalibrationCycles;
+    bool converged = canFinish;
+    bool moved = false;
+
     for (int axis = 0; axis < 3; axis++) {
 
         // Reset g[axis] at start of calibration
@@ -90,30 +165,51 @@ static void performAcclerationCalibration(uint8_t gyroMovementCalibrationThresho
             devClear(&var[axis]);
         }
 
-        // Sum up CALIBRATING_GYRO_CYCLES readings
-        g[axis] += gyroADC[axis];
-        devPush(&var[axis], gyroADC[axis]);
+        // Sum up the unfiltered readings
+        g[axis] += gyroADCRaw[axis];
+        devPush(&var[axis], gyroADCRaw[axis]);
 
         // Reset global variables to prevent other code from using un-calibrated data
         gyroADC[axis] = 0;
         gyroZero[axis] = 0;
 
-        if (isOnFinalGyroCalibrationCycle()) {
-            float dev = devStandardDeviation(&var[axis]);
+        if (canFinish) {
+            const float variance = devVariance(&var[axis]);
             // check deviation and startover in case the model was moved
-            if (gyroMovementCalibrationThreshold && dev > gyroMovementCalibrationThreshold) {
-                gyroSetCalibrationCycles(CALIBRATING_GYRO_CYCLES);
-                return;
+            if (gyroMovementCalibrationThreshold && variance > sq(gyroMovementCalibrationThreshold)) {
+                moved = true;
+            }
+            if (variance > sq(GYRO_CALIBRATION_ZERO_TOLERANCE) * sampleCount) {
+                converged = false;
             }
-            gyroZero[axis] = (g[axis] + (CALIBRATING_GYRO_CYCLES / 2)) / CALIBRATING_GYRO_CYCLES;
         }
     }
 
-    if (isOnFinalGyroCalibrationCycle()) {
-        beeper(BEEPER_GYRO_CALIBRATED);
+    if (moved) {
+        restartGyroCalibration();
+        return;
     }
-    calibratingG--;
 
+    if (!converged && !isOnFinalGyroCalibrationCycle()) {
+        calibratingG--;
+        return;
+    }
+
+    for (int axis = 0; axis < 3; axis++) {
+        gyroZero[axis] = (g[axis] + (sampleCount / 2)) / sampleCount;
+        calibrationStatus.zero[axis] = gyroZero[axis];
+        calibrationStatus.noiseStdDev[axis] = devStandardDeviation(&var[axis]);
+    }
+    calibrationStatus.sampleCount = sampleCount;
+    calibrationStatus.durationMs = MIN(millis() - calibrationStartTime, (uint32_t)UINT16_MAX);
+
+    beeper(BEEPER_GYRO_CALIBRATED);
+    calibratingG = 0;
+}
+
+const gyroCalibrationStatus_t *gyroGetCalibrationStatus(void)
+{
+    return &calibrationStatus;
 }
 
 static void applyGyroZero(void)
@@ -133,29 +229,36 @@ void gyroUpdate(void)
     // Prepare a copy of int32_t gyroADC for mangling to prevent overflow
     for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) gyroADC[axis] = gyroADCRaw[axis];
 
-    if (gyroLpfCutHz) {
-        if (!gyroFilterInitialised) {
-            if (targetLooptime) {  /* Initialisation needs to happen once sample rate is known */
-                for (int axis = 0; axis < 3; axis++) {
-                    filterInitBiQuad(gyroLpfCutHz, &gyroFilterState[axis], 0);
-                }
-
-                gyroFilterInitialised = true;
-            }
+    if (gyroFilterLooptime != targetLooptime) {
+        if (targetLooptime) {  /* Initialisation needs to happen once sample rate is known, and again if it changes */
+            gyroInitFilters();
+            gyroFilterLooptime = targetLooptime;
         }
+    }
 
-        if (gyroFilterInitialised) {
-            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
-                gyroADC[axis] = lrintf(filterApplyBiQuad((float) gyroADC[axis], &gyroFilterState[axis]));
-            }
-        }
+    if (gyroFilterLooptime && gyroFilterBank.stageCount) {
+        filterApplyBiQuadBankInt32(&gyroFilterBank, gyroADC);
+    }
+
+#ifdef USE_GYRO_DYNAMIC_NOTCH
+    // Analysis sees the statically filtered signal, before its own notches
+    if (gyroFilterLooptime && gyroConfig->gyroDynamicNotch) {
+        gyroDynamicNotchUpdate(gyroADC);
+    }
+#endif
+
+#ifdef USE_GYRO_DYNAMIC_LPF
+    // Noise is measured after all notches, the low pass only has to deal with what they leave
+    if (gyroFilterLooptime && gyroConfig->gyroDynamicLpf) {
+        gyroDynamicLpfUpdate(gyroADC);
     }
+#endif
 
     if (!isGyroCalibrationComplete()) {
-        performAcclerationCalibration(gyroConfig->gyroMovementCalibrationThreshold);
+        performGyroCalibration(gyroConfig->gyroMovementCalibrationThreshold, gyroConfig->gyroCalibrationMinCycles);
     }
 
     applyGyroZero();
 
-    alignSensors(gyroADC, gyroADC, gyroAlign);
+    alignSensors(SENSOR_INDEX_GYRO, gyroADC);
 }
@@ -34,11 +34,33 @@ extern sensor_align_e gyroAlign;
 
 extern int32_t gyroADC[XYZ_AXIS_COUNT];
 
+#define GYRO_NOTCH_COUNT 2
+
 typedef struct gyroConfig_s {
     uint8_t gyroMovementCalibrationThreshold; // people keep forgetting that moving model while init results in wrong gyro offsets. and then they never reset gyro. so this is now on by default.
+    uint16_t gyroNotchHz[GYRO_NOTCH_COUNT];  // notch center frequency, 0 = disabled
+    uint16_t gyroNotchQ[GYRO_NOTCH_COUNT];   // notch quality factor * 100
+    uint8_t gyroDynamicNotch;                // notch steered to the strongest gyro noise peak found by FFT
+    uint16_t gyroDynamicNotchMinHz;          // lowest frequency searched for a peak
+    uint16_t gyroDynamicNotchQ;              // dynamic notch quality factor * 100
+    uint8_t gyroDynamicLpf;                  // low pass cutoff follows the measured gyro noise instead of gyro_soft_lpf_hz
+    uint8_t gyroDynamicLpfMinHz;             // lowest cutoff, used for the noisiest gyro
+    uint8_t gyroDynamicLpfMaxHz;             // highest cutoff, used for a quiet gyro
+    uint16_t gyroCalibrationMinCycles;       // samples averaged before calibration may end early
 } gyroConfig_t;
 
+#define GYRO_CALIBRATION_ZERO_TOLERANCE     0.25f   // gyro LSB, standard error of the zero at which calibration may end
+
+typedef struct gyroCalibrationStatus_s {
+    uint16_t durationMs;                     // time the last calibration took, restarts included
+    uint16_t sampleCount;                    // samples averaged into the zero
+    uint8_t restartCount;                    // restarts because the craft moved
+    int16_t zero[XYZ_AXIS_COUNT];            // gyro LSB
+    float noiseStdDev[XYZ_AXIS_COUNT];       // gyro LSB, noise of the craft at rest
+} gyroCalibrationStatus_t;
+
 void useGyroConfig(gyroConfig_t *gyroConfigToUse, int8_t initialGyroLpfCutHz);
 void gyroSetCalibrationCycles(uint16_t calibrationCyclesRequired);
 void gyroUpdate(void);
 bool isGyroCalibrationComplete(void);
+const gyroCalibrationStatus_t *gyroGetCalibrationStatus(void);
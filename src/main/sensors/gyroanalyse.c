@@ -0,0 +1,215 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "platform.h"
+
+#ifdef USE_GYRO_DYNAMIC_NOTCH
+
+#include "debug.h"
+
+#include "common/axis.h"
+#include "common/maths.h"
+#include "common/filter.h"
+#include "common/fft.h"
+
+#include "sensors/gyroanalyse.h"
+
+/*
+ * Analysis of one axis is split in steps, one step runs per gyro update so the FFT never takes more than a
+ * butterfly stage worth of time out of a loop:
+ *   load windowed samples, FFT_SIZE_LOG2 butterfly stages, peak search and notch update.
+ * Axes are analysed in turn, samples of all axes keep being collected meanwhile.
+ */
+#define STEP_LOAD           0
+#define STEP_FIRST_STAGE    1
+#define STEP_PEAK_SEARCH    (STEP_FIRST_STAGE + FFT_SIZE_LOG2)
+
+static float samples[XYZ_AXIS_COUNT][FFT_SIZE];
+static float sampleSum[XYZ_AXIS_COUNT];
+static uint8_t sampleCount;
+static uint8_t sampleIndex;             // next sample to write, also the oldest sample of a full buffer
+static bool samplesFilled;
+static uint8_t decimation;
+
+static fftData_t fftData;
+static uint8_t analysedAxis;
+static uint8_t analysisStep;
+
+static float binWidthHz;
+static uint8_t minBin;
+static uint16_t minHz;
+static uint16_t maxHz;
+static float notchQ;
+
+static biquad_t notch[XYZ_AXIS_COUNT];
+static bool notchActive[XYZ_AXIS_COUNT];
+static float centerHz[XYZ_AXIS_COUNT];
+static uint16_t notchHz[XYZ_AXIS_COUNT];
+
+void gyroDynamicNotchInit(uint32_t looptime, uint16_t minFrequency, uint16_t q)
+{
+    const uint32_t sampleRateHz = 1000000 / looptime;
+
+    fftInit();
+
+    decimation = MAX(1u, sampleRateHz / GYRO_ANALYSE_RATE_MAX_HZ);
+    binWidthHz = (float)sampleRateHz / decimation / FFT_SIZE;
+
+    minBin = constrain(lrintf(minFrequency / binWidthHz), 1, FFT_BIN_COUNT - 2);
+    minHz = minFrequency;
+    // Highest bin below the analysis Nyquist frequency, which is never above the loop Nyquist frequency
+    maxHz = (FFT_BIN_COUNT - 1) * binWidthHz;
+    notchQ = q / 100.0f;
+
+    sampleCount = 0;
+    sampleIndex = 0;
+    samplesFilled = false;
+    analysedAxis = 0;
+    analysisStep = STEP_LOAD;
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        sampleSum[axis] = 0;
+        notchActive[axis] = false;
+        centerHz[axis] = 0;
+        notchHz[axis] = 0;
+        debug[axis] = 0;
+    }
+}
+
+static void pushSamples(const int32_t *gyroData)
+{
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        sampleSum[axis] += gyroData[axis];
+    }
+
+    if (++sampleCount < decimation) {
+        return;
+    }
+
+    // Averaging the decimated samples also keeps frequencies above the analysis Nyquist out of the spectrum
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        samples[axis][sampleIndex] = sampleSum[axis] / decimation;
+        sampleSum[axis] = 0;
+    }
+    sampleCount = 0;
+    sampleIndex = (sampleIndex + 1) & (FFT_SIZE - 1);
+    if (sampleIndex == 0) {
+        samplesFilled = true;
+    }
+}
+
+static void updateNotch(uint8_t axis, float peakHz)
+{
+    if (notchActive[axis]) {
+        centerHz[axis] += GYRO_ANALYSE_CENTER_SMOOTHING * (peakHz - centerHz[axis]);
+    } else {
+        centerHz[axis] = peakHz;
+    }
+
+    const uint16_t newNotchHz = constrain(lrintf(centerHz[axis]), minHz, maxHz);
+    if (notchActive[axis] && newNotchHz == notchHz[axis]) {
+        return;
+    }
+
+    // Only coefficients are replaced, the filter state carries over so moving the notch doesn't glitch the output
+    biquad_t newNotch;
+    if (!filterInitBiQuadOfType(&newNotch, FILTER_BIQUAD_NOTCH, newNotchHz, notchQ, 0)) {
+        return;
+    }
+    if (notchActive[axis]) {
+        newNotch.d1 = notch[axis].d1;
+        newNotch.d2 = notch[axis].d2;
+    }
+    notch[axis] = newNotch;
+    notchHz[axis] = newNotchHz;
+    notchActive[axis] = true;
+}
+
+static void searchPeak(uint8_t axis)
+{
+    float powerSum = 0;
+    float peakPower = 0;
+    uint8_t peakBin = 0;
+
+    for (int bin = minBin; bin < FFT_BIN_COUNT; bin++) {
+        const float power = fftBinPower(&fftData, bin);
+        powerSum += power;
+        if (power > peakPower) {
+            peakPower = power;
+            peakBin = bin;
+        }
+    }
+
+    const float meanPower = powerSum / (FFT_BIN_COUNT - minBin);
+    float peakHz = 0;
+
+    if (peakBin && peakPower > GYRO_ANALYSE_PEAK_RATIO * meanPower) {
+        // Parabolic interpolation between the neighbouring bins for a resolution finer than a bin
+        const float left = fftBinPower(&fftData, peakBin - 1);
+        const float right = fftBinPower(&fftData, peakBin + 1);
+        const float curvature = left - 2 * peakPower + right;
+        const float offset = (curvature < 0) ? 0.5f * (left - right) / curvature : 0;
+
+        peakHz = (peakBin + constrainf(offset, -0.5f, 0.5f)) * binWidthHz;
+        updateNotch(axis, peakHz);
+    }
+
+    debug[axis] = notchHz[axis];
+    debug[3] = lrintf(peakHz);
+}
+
+static void analyseStep(void)
+{
+    if (analysisStep == STEP_LOAD) {
+        fftLoadWindowedReal(&fftData, samples[analysedAxis], sampleIndex);
+    } else if (analysisStep < STEP_PEAK_SEARCH) {
+        fftButterflyStage(&fftData, analysisStep - STEP_FIRST_STAGE);
+    } else {
+        searchPeak(analysedAxis);
+        analysedAxis = (analysedAxis + 1) % XYZ_AXIS_COUNT;
+        analysisStep = STEP_LOAD;
+        return;
+    }
+    analysisStep++;
+}
+
+/* collects a sample of each axis, runs one step of the analysis and applies the per axis notches in place */
+void gyroDynamicNotchUpdate(int32_t *gyroData)
+{
+    pushSamples(gyroData);
+
+    if (samplesFilled) {
+        analyseStep();
+    }
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        if (notchActive[axis]) {
+            gyroData[axis] = lrintf(filterApplyBiQuad(gyroData[axis], &notch[axis]));
+        }
+    }
+}
+
+uint16_t gyroDynamicNotchGetCenterHz(uint8_t axis)
+{
+    return notchActive[axis] ? notchHz[axis] : 0;
+}
+
+#endif
@@ -0,0 +1,26 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#define GYRO_ANALYSE_RATE_MAX_HZ        1000    // gyro samples are averaged down to at most this rate before the FFT
+#define GYRO_ANALYSE_PEAK_RATIO         4       // a bin is a peak if its power is this many times the mean of the searched bins
+#define GYRO_ANALYSE_CENTER_SMOOTHING   0.3f    // weight of a new peak in the notch center, per analysis of the axis
+
+void gyroDynamicNotchInit(uint32_t looptime, uint16_t minHz, uint16_t q);
+void gyroDynamicNotchUpdate(int32_t *gyroData);
+uint16_t gyroDynamicNotchGetCenterHz(uint8_t axis);
@@ -0,0 +1,179 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "platform.h"
+
+#ifdef USE_GYRO_DYNAMIC_LPF
+
+#include "common/axis.h"
+#include "common/maths.h"
+#include "common/filter.h"
+
+#include "sensors/gyronoise.h"
+
+/*
+ * Noise is the variance of the second difference x[n] - 2 x[n-1] + x[n-2]. It rejects the slow rotation the pilot
+ * commands (gain 1e-3 at 5Hz for a 1kHz loop) and keeps the fast content the low pass is there for, for white noise
+ * it multiplies the variance by 6. Variance is collected over a window with the same running estimator used for gyro
+ * calibration and only evaluated once per window, the loop pays a few additions and devPush() per axis.
+ */
+#define SECOND_DIFFERENCE_WHITE_NOISE_GAIN  6.0f
+
+static stdev_t noiseWindow[XYZ_AXIS_COUNT];
+static int32_t previousSample[XYZ_AXIS_COUNT][2];
+static uint8_t previousSampleCount;
+static uint16_t windowSamples;
+static uint16_t windowLength;
+static float noiseStdDev[XYZ_AXIS_COUNT];
+
+static float sampleRateHz;
+static uint8_t minCutoffHz;
+static uint8_t maxCutoffHz;
+
+static biquad_t lpf[XYZ_AXIS_COUNT];
+static biquad_t fadingLpf[XYZ_AXIS_COUNT];      // previous low pass, still running while its output is faded out
+static float lastOutput[XYZ_AXIS_COUNT];
+static uint8_t cutoffHz[XYZ_AXIS_COUNT];
+static uint16_t fadeRemaining[XYZ_AXIS_COUNT];
+static uint16_t fadeLength;
+
+void gyroDynamicLpfInit(uint32_t looptime, uint8_t minHz, uint8_t maxHz)
+{
+    sampleRateHz = 1000000.0f / looptime;
+    minCutoffHz = MIN(minHz, maxHz);
+    maxCutoffHz = maxHz;
+
+    windowLength = MAX(1, lrintf(sampleRateHz / GYRO_NOISE_UPDATE_HZ));
+    windowSamples = 0;
+    previousSampleCount = 0;
+    fadeLength = MAX(1, lrintf(sampleRateHz * GYRO_NOISE_CROSSFADE_MS / 1000));
+
+    // Start at the least delay, the first windows bring the cutoff down if the gyro is noisy
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        devClear(&noiseWindow[axis]);
+        noiseStdDev[axis] = 0;
+        cutoffHz[axis] = maxCutoffHz;
+        fadeRemaining[axis] = 0;
+        lastOutput[axis] = 0;
+        filterInitBiQuad(maxCutoffHz, &lpf[axis], 0);
+    }
+}
+
+/*
+ * White noise of standard deviation sd through an ideal low pass at fc keeps sd * sqrt(2 * fc / fs),
+ * the cutoff is chosen to leave GYRO_NOISE_TARGET of it.
+ */
+static uint8_t cutoffForNoise(float stdDev)
+{
+    if (stdDev <= GYRO_NOISE_TARGET) {
+        return maxCutoffHz;
+    }
+
+    const float cutoff = 0.5f * sampleRateHz * sq(GYRO_NOISE_TARGET / stdDev);
+    return constrain(lrintf(cutoff), minCutoffHz, maxCutoffHz);
+}
+
+static void updateCutoff(uint8_t axis)
+{
+    const uint8_t newCutoffHz = cutoffForNoise(noiseStdDev[axis]);
+
+    // Small changes and changes while the previous one is still fading in are ignored
+    if (ABS(newCutoffHz - cutoffHz[axis]) < GYRO_NOISE_HYSTERESIS_HZ || fadeRemaining[axis]) {
+        return;
+    }
+
+    biquad_t newLpf;
+    filterInitBiQuad(newCutoffHz, &newLpf, 0);
+
+    // New filter starts in the steady state for the current output, the cross-fade hides what remains of the step
+    newLpf.d2 = (newLpf.b2 - newLpf.a2) * lastOutput[axis];
+    newLpf.d1 = (newLpf.b1 - newLpf.a1) * lastOutput[axis] + newLpf.d2;
+
+    fadingLpf[axis] = lpf[axis];
+    lpf[axis] = newLpf;
+    cutoffHz[axis] = newCutoffHz;
+    fadeRemaining[axis] = fadeLength;
+}
+
+static void evaluateWindow(void)
+{
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        const float windowStdDev = sqrtf(devVariance(&noiseWindow[axis]) / SECOND_DIFFERENCE_WHITE_NOISE_GAIN);
+
+        if (noiseStdDev[axis] == 0) {
+            noiseStdDev[axis] = windowStdDev;
+        } else {
+            noiseStdDev[axis] += GYRO_NOISE_SMOOTHING * (windowStdDev - noiseStdDev[axis]);
+        }
+        devClear(&noiseWindow[axis]);
+
+        updateCutoff(axis);
+    }
+}
+
+/* estimates the noise of each axis and applies the per axis low pass in place */
+void gyroDynamicLpfUpdate(int32_t *gyroData)
+{
+    // The first two samples have nothing to be differenced against
+    if (previousSampleCount == 2) {
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            devPush(&noiseWindow[axis], gyroData[axis] - 2 * previousSample[axis][0] + previousSample[axis][1]);
+        }
+
+        if (++windowSamples >= windowLength) {
+            windowSamples = 0;
+            evaluateWindow();
+        }
+    } else {
+        previousSampleCount++;
+    }
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        previousSample[axis][1] = previousSample[axis][0];
+        previousSample[axis][0] = gyroData[axis];
+    }
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        float output = filterApplyBiQuad(gyroData[axis], &lpf[axis]);
+
+        if (fadeRemaining[axis]) {
+            const float fadingOutput = filterApplyBiQuad(gyroData[axis], &fadingLpf[axis]);
+            const float newWeight = 1.0f - (float)fadeRemaining[axis] / fadeLength;
+            output = fadingOutput + newWeight * (output - fadingOutput);
+            fadeRemaining[axis]--;
+        }
+
+        lastOutput[axis] = output;
+        gyroData[axis] = lrintf(output);
+    }
+}
+
+uint8_t gyroDynamicLpfGetCutoffHz(uint8_t axis)
+{
+    return cutoffHz[axis];
+}
+
+float gyroNoiseGetStdDev(uint8_t axis)
+{
+    return noiseStdDev[axis];
+}
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#define GYRO_NOISE_UPDATE_HZ            5       // noise of each window of this length is evaluated and the cutoff updated
+#define GYRO_NOISE_SMOOTHING            0.2f    // weight of a new window in the noise estimate
+#define GYRO_NOISE_TARGET               8.0f    // gyro LSB, RMS noise left after the low pass for white noise of the estimated level
+#define GYRO_NOISE_HYSTERESIS_HZ        10      // cutoff change needed before the low pass is redesigned
+#define GYRO_NOISE_CROSSFADE_MS         20      // old and new low pass outputs are blended over this time
+
+void gyroDynamicLpfInit(uint32_t looptime, uint8_t minHz, uint8_t maxHz);
+void gyroDynamicLpfUpdate(int32_t *gyroData);
+uint8_t gyroDynamicLpfGetCutoffHz(uint8_t axis);
+float gyroNoiseGetStdDev(uint8_t axis);
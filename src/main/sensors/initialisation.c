@@ -67,6 +67,7 @@
 #include "sensors/gyro.h"
 #include "sensors/compass.h"
 #include "sensors/sonar.h"
+#include "sensors/boardalignment.h"
 #include "sensors/initialisation.h"
 
 #ifdef NAZE
@@ -742,6 +743,10 @@ static void reconfigureAlignment(const sensorAlignmentConfig_t *sensorAlignmentC
     if (sensorAlignmentConfig->mag_align != ALIGN_DEFAULT) {
         magAlign = sensorAlignmentConfig->mag_align;
     }
+
+    initSensorAlignment(SENSOR_INDEX_GYRO, gyroAlign);
+    initSensorAlignment(SENSOR_INDEX_ACC, accAlign);
+    initSensorAlignment(SENSOR_INDEX_MAG, magAlign);
 }
 
 bool sensorsAutodetect(sensorAlignmentConfig_t *sensorAlignmentConfig, uint8_t gyroLpf, uint8_t accHardwareToUse, uint8_t magHardwareToUse, uint8_t baroHardwareToUse,
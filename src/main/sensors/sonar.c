@@ -23,6 +23,7 @@
 #include "build_config.h"
 
 #include "common/maths.h"
+#include "common/filter.h"
 
 #include "config/config.h"
 #include "config/runtime_config.h"
@@ -177,19 +178,18 @@ void sonarInit(void)
 static int32_t applySonarMedianFilter(int32_t newSonarReading)
 {
     #define DISTANCE_SAMPLES_MEDIAN 5
-    static int32_t sonarFilterSamples[DISTANCE_SAMPLES_MEDIAN];
-    static int filterSampleIndex = 0;
-    static bool medianFilterReady = false;
+    static medianFilter_t sonarMedianFilter;
+    static bool medianFilterInitialised = false;
+
+    if (!medianFilterInitialised) {
+        medianFilterInit(&sonarMedianFilter, DISTANCE_SAMPLES_MEDIAN);
+        medianFilterInitialised = true;
+    }
 
     if (newSonarReading > SONAR_OUT_OF_RANGE) {// only accept samples that are in range
-        sonarFilterSamples[filterSampleIndex] = newSonarReading;
-        ++filterSampleIndex;
-        if (filterSampleIndex == DISTANCE_SAMPLES_MEDIAN) {
-            filterSampleIndex = 0;
-            medianFilterReady = true;
-        }
+        medianFilterApply(&sonarMedianFilter, newSonarReading);
     }
-    return medianFilterReady ? quickMedianFilter5(sonarFilterSamples) : newSonarReading;
+    return medianFilterIsFull(&sonarMedianFilter) ? medianFilterGet(&sonarMedianFilter) : newSonarReading;
 }
 
 /*
@@ -47,6 +47,7 @@
 
 //#define DEBUG_MPU_DATA_READY_INTERRUPT
 #define USE_MPU_DATA_READY_SIGNAL
+#define USE_GYRO_OVERSAMPLING
 
 #define GYRO
 #define USE_GYRO_SPI_MPU6000
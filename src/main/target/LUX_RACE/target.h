@@ -142,6 +142,7 @@
 // MPU6500 interrupt
 //#define DEBUG_MPU_DATA_READY_INTERRUPT
 #define USE_MPU_DATA_READY_SIGNAL
+#define USE_GYRO_OVERSAMPLING
 #define ENSURE_MPU_DATA_READY_IS_LOW
 
 #define SPEKTRUM_BIND
@@ -21,12 +21,24 @@
 #if (FLASH_SIZE > 128)
 #define DISPLAY
 #define DISPLAY_ARMED_BITMAP
+#define USE_GYRO_DYNAMIC_NOTCH
+#define USE_GYRO_DYNAMIC_LPF
+#define USE_IMU_EKF
+#define USE_LOOPTIME_GOVERNOR
+#define USE_NAV_EKF
+#define USE_NAV_MISSION_STORE
+#define NAV_MISSION_STORE_SIZE  (12 * 1024)     // bytes, reserved at the end of the dataflash or below the config
 #else
 #define SKIP_CLI_COMMAND_HELP
 #define SKIP_RX_MSP
 #define DISABLE_UNCOMMON_MIXERS
 #endif
 
+#if defined(STM32F10X)
+// No FPU, hottest filters and the PID D-term run in fixed point
+#define USE_FIXED_POINT_MATH
+#endif
+
 #define SERIAL_RX
 #define USE_SERVOS
 #define USE_CLI
@@ -18,9 +18,11 @@
 #include "math.h"
 #include "stdint.h"
 #include "time.h"
+#include "string.h"
 
 extern "C" {
 #include "common/axis.h"
+#include "common/maths.h"
 #include "sensors/boardalignment.h"
 #include "sensors/sensors.h"
 }
@@ -39,6 +41,13 @@ extern "C" {
 
 #define DEG2RAD 0.01745329251
 
+static void alignSensor(int32_t *src, int32_t *dest, sensor_align_e rotation)
+{
+    initSensorAlignment(SENSOR_INDEX_GYRO, rotation);
+    memcpy(dest, src, sizeof(int32_t) * XYZ_AXIS_COUNT);
+    alignSensors(SENSOR_INDEX_GYRO, dest);
+}
+
 static void rotateVector(int32_t mat[3][3], int32_t vec[3], int32_t *out)
 {
     int32_t tmp[3];
@@ -110,7 +119,7 @@ static void testCW(sensor_align_e rotation, int32_t angle)
     initZAxisRotation(matrix, angle);
     rotateVector(matrix, src, test);
 
-    alignSensors(src, dest, rotation);
+    alignSensor(src, dest, rotation);
     EXPECT_EQ(test[X], dest[X]) << "X-Unit alignment does not match in X-Axis. " << test[X] << " " << dest[X];
     EXPECT_EQ(test[Y], dest[Y]) << "X-Unit alignment does not match in Y-Axis. " << test[Y] << " " << dest[Y];
     EXPECT_EQ(test[Z], dest[Z]) << "X-Unit alignment does not match in Z-Axis. " << test[Z] << " " << dest[Z];
@@ -121,7 +130,7 @@ static void testCW(sensor_align_e rotation, int32_t angle)
     src[Z] = 0;
 
     rotateVector(matrix, src, test);
-    alignSensors(src, dest, rotation);
+    alignSensor(src, dest, rotation);
     EXPECT_EQ(test[X], dest[X]) << "Y-Unit alignment does not match in X-Axis. " << test[X] << " " << dest[X];
     EXPECT_EQ(test[Y], dest[Y]) << "Y-Unit alignment does not match in Y-Axis. " << test[Y] << " " << dest[Y];
     EXPECT_EQ(test[Z], dest[Z]) << "Y-Unit alignment does not match in Z-Axis. " << test[Z] << " " << dest[Z];
@@ -132,7 +141,7 @@ static void testCW(sensor_align_e rotation, int32_t angle)
     src[Z] = 1;
 
     rotateVector(matrix, src, test);
-    alignSensors(src, dest, rotation);
+    alignSensor(src, dest, rotation);
     EXPECT_EQ(test[X], dest[X]) << "Z-Unit alignment does not match in X-Axis. " << test[X] << " " << dest[X];
     EXPECT_EQ(test[Y], dest[Y]) << "Z-Unit alignment does not match in Y-Axis. " << test[Y] << " " << dest[Y];
     EXPECT_EQ(test[Z], dest[Z]) << "Z-Unit alignment does not match in Z-Axis. " << test[Z] << " " << dest[Z];
@@ -143,7 +152,7 @@ static void testCW(sensor_align_e rotation, int32_t angle)
     src[Z] = rand() % 5;
 
     rotateVector(matrix, src, test);
-    alignSensors(src, dest, rotation);
+    alignSensor(src, dest, rotation);
     EXPECT_EQ(test[X], dest[X]) << "Random alignment does not match in X-Axis. " << test[X] << " " << dest[X];
     EXPECT_EQ(test[Y], dest[Y]) << "Random alignment does not match in Y-Axis. " << test[Y] << " " << dest[Y];
     EXPECT_EQ(test[Z], dest[Z]) << "Random alignment does not match in Z-Axis. " << test[Z] << " " << dest[Z];
@@ -170,7 +179,7 @@ static void testCWFlip(sensor_align_e rotation, int32_t angle)
     initZAxisRotation(matrix, angle);
     rotateVector(matrix, test, test);
 
-    alignSensors(src, dest, rotation);
+    alignSensor(src, dest, rotation);
 
     EXPECT_EQ(test[X], dest[X]) << "X-Unit alignment does not match in X-Axis. " << test[X] << " " << dest[X];
     EXPECT_EQ(test[Y], dest[Y]) << "X-Unit alignment does not match in Y-Axis. " << test[Y] << " " << dest[Y];
@@ -186,7 +195,7 @@ static void testCWFlip(sensor_align_e rotation, int32_t angle)
     initZAxisRotation(matrix, angle);
     rotateVector(matrix, test, test);
 
-    alignSensors(src, dest, rotation);
+    alignSensor(src, dest, rotation);
 
     EXPECT_EQ(test[X], dest[X]) << "Y-Unit alignment does not match in X-Axis. " << test[X] << " " << dest[X];
     EXPECT_EQ(test[Y], dest[Y]) << "Y-Unit alignment does not match in Y-Axis. " << test[Y] << " " << dest[Y];
@@ -202,7 +211,7 @@ static void testCWFlip(sensor_align_e rotation, int32_t angle)
     initZAxisRotation(matrix, angle);
     rotateVector(matrix, test, test);
 
-    alignSensors(src, dest, rotation);
+    alignSensor(src, dest, rotation);
 
     EXPECT_EQ(test[X], dest[X]) << "Z-Unit alignment does not match in X-Axis. " << test[X] << " " << dest[X];
     EXPECT_EQ(test[Y], dest[Y]) << "Z-Unit alignment does not match in Y-Axis. " << test[Y] << " " << dest[Y];
@@ -218,7 +227,7 @@ static void testCWFlip(sensor_align_e rotation, int32_t angle)
     initZAxisRotation(matrix, angle);
     rotateVector(matrix, test, test);
 
-    alignSensors(src, dest, rotation);
+    alignSensor(src, dest, rotation);
 
     EXPECT_EQ(test[X], dest[X]) << "Random alignment does not match in X-Axis. " << test[X] << " " << dest[X];
     EXPECT_EQ(test[Y], dest[Y]) << "Random alignment does not match in Y-Axis. " << test[Y] << " " << dest[Y];
@@ -267,3 +276,47 @@ TEST(AlignSensorTest, ClockwiseTwoSeventyDegreesFlip)
     testCWFlip(CW270_DEG_FLIP, 270);
 }
 
+// Fused sensor and board rotation gives the same result as rotating by the sensor and then by the board matrix
+TEST(AlignSensorTest, BoardAlignmentFusedWithSensorRotation)
+{
+    boardAlignment_t boardAlignment = { 100, -50, 450 };
+    fp_angles_t rotationAngles;
+    float boardRotation[3][3];
+
+    rotationAngles.angles.roll  = DECIDEGREES_TO_RADIANS(boardAlignment.rollDeciDegrees);
+    rotationAngles.angles.pitch = DECIDEGREES_TO_RADIANS(boardAlignment.pitchDeciDegrees);
+    rotationAngles.angles.yaw   = DECIDEGREES_TO_RADIANS(boardAlignment.yawDeciDegrees);
+    buildRotationMatrix(&rotationAngles, boardRotation);
+
+    initBoardAlignment(&boardAlignment);
+
+    const int32_t samples[][XYZ_AXIS_COUNT] = { { 4096, 0, 0 }, { 0, -4096, 0 }, { 0, 0, 4096 }, { 1234, -2345, 3456 }, { 32767, 32767, -32768 } };
+
+    for (int rotation = CW0_DEG; rotation <= CW270_DEG_FLIP; rotation++) {
+        for (unsigned i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+            int32_t expected[XYZ_AXIS_COUNT];
+            int32_t dest[XYZ_AXIS_COUNT];
+            int32_t src[XYZ_AXIS_COUNT] = { samples[i][X], samples[i][Y], samples[i][Z] };
+
+            // standard board alignment for the sensor rotation only
+            boardAlignment_t standard = { 0, 0, 0 };
+            initBoardAlignment(&standard);
+            alignSensor(src, expected, (sensor_align_e)rotation);
+            initBoardAlignment(&boardAlignment);
+
+            const float x = expected[X];
+            const float y = expected[Y];
+            const float z = expected[Z];
+            expected[X] = lrintf(boardRotation[0][X] * x + boardRotation[1][X] * y + boardRotation[2][X] * z);
+            expected[Y] = lrintf(boardRotation[0][Y] * x + boardRotation[1][Y] * y + boardRotation[2][Y] * z);
+            expected[Z] = lrintf(boardRotation[0][Z] * x + boardRotation[1][Z] * y + boardRotation[2][Z] * z);
+
+            alignSensor(src, dest, (sensor_align_e)rotation);
+
+            // float board rotation rounds once more than the fused integer matrix
+            EXPECT_NEAR(expected[X], dest[X], 1);
+            EXPECT_NEAR(expected[Y], dest[Y], 1);
+            EXPECT_NEAR(expected[Z], dest[Z], 1);
+        }
+    }
+}
@@ -0,0 +1,369 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/axis.h"
+    #include "common/maths.h"
+    #include "common/utils.h"
+    #include "common/filter.h"
+
+    #include "drivers/gyro_sync.h"
+}
+
+#include "unittest_macros.h"
+#include "unittest_benchmark.h"
+#include "unittest_random.h"
+#include "gtest/gtest.h"
+
+#define FILTER_SAMPLING_RATE        1000
+#define FILTER_BENCHMARK_SAMPLES    200000
+
+// deterministic gyro-like noise
+static float noiseSample(void)
+{
+    return (float)(int32_t)(unittestRandom() % 4096) - 2048.0f;
+}
+
+// |H(e^jw)| of the biquad coefficients at the given frequency
+static float biquadMagnitude(const biquad_t *filter, float frequency, float samplingRate)
+{
+    const double w = 2 * M_PI * frequency / samplingRate;
+    const double numRe = filter->b0 + filter->b1 * cos(w) + filter->b2 * cos(2 * w);
+    const double numIm = -filter->b1 * sin(w) - filter->b2 * sin(2 * w);
+    const double denRe = 1 + filter->a1 * cos(w) + filter->a2 * cos(2 * w);
+    const double denIm = -filter->a1 * sin(w) - filter->a2 * sin(2 * w);
+    return sqrt((numRe * numRe + numIm * numIm) / (denRe * denRe + denIm * denIm));
+}
+
+// width of the band around center where the filter is on the same side of -3dB as at center
+static float halfPowerBandwidth(const biquad_t *filter, float center, float samplingRate)
+{
+    const bool insideBelow = biquadMagnitude(filter, center, samplingRate) < M_SQRT1_2;
+    float lower = center;
+    float upper = center;
+
+    while (lower > 0 && (biquadMagnitude(filter, lower, samplingRate) < M_SQRT1_2) == insideBelow) {
+        lower -= 0.1f;
+    }
+    while (upper < samplingRate / 2 && (biquadMagnitude(filter, upper, samplingRate) < M_SQRT1_2) == insideBelow) {
+        upper += 0.1f;
+    }
+
+    return upper - lower;
+}
+
+TEST(FilterUnittest, TestBiQuadLowPassResponse)
+{
+    biquad_t filter;
+
+    filterInitBiQuad(100, &filter, FILTER_SAMPLING_RATE);
+
+    EXPECT_NEAR(1.0f, biquadMagnitude(&filter, 0, FILTER_SAMPLING_RATE), 0.01f);
+    EXPECT_NEAR(M_SQRT1_2, biquadMagnitude(&filter, 100, FILTER_SAMPLING_RATE), 0.01f);
+    EXPECT_LT(biquadMagnitude(&filter, 400, FILTER_SAMPLING_RATE), 0.05f);
+}
+
+TEST(FilterUnittest, TestBiQuadNotchResponse)
+{
+    biquad_t filter;
+
+    EXPECT_TRUE(filterInitBiQuadOfType(&filter, FILTER_BIQUAD_NOTCH, 200, 2.0f, FILTER_SAMPLING_RATE));
+
+    EXPECT_NEAR(1.0f, biquadMagnitude(&filter, 0, FILTER_SAMPLING_RATE), 0.01f);
+    EXPECT_LT(biquadMagnitude(&filter, 200, FILTER_SAMPLING_RATE), 0.01f);
+    EXPECT_NEAR(1.0f, biquadMagnitude(&filter, 499, FILTER_SAMPLING_RATE), 0.01f);
+
+    // bandwidth between the -3dB points is center / Q well below Nyquist, frequency warping narrows it closer to Nyquist
+    biquad_t low;
+    filterInitBiQuadOfType(&low, FILTER_BIQUAD_NOTCH, 80, 2.0f, FILTER_SAMPLING_RATE);
+    EXPECT_NEAR(80 / 2.0f, halfPowerBandwidth(&low, 80, FILTER_SAMPLING_RATE), 80 / 2.0f * 0.1f);
+    EXPECT_LT(halfPowerBandwidth(&filter, 200, FILTER_SAMPLING_RATE), 200 / 2.0f);
+
+    // a higher Q gives a narrower notch
+    biquad_t narrow;
+    filterInitBiQuadOfType(&narrow, FILTER_BIQUAD_NOTCH, 200, 8.0f, FILTER_SAMPLING_RATE);
+    EXPECT_LT(biquadMagnitude(&narrow, 200, FILTER_SAMPLING_RATE), 0.01f);
+    EXPECT_GT(biquadMagnitude(&narrow, 170, FILTER_SAMPLING_RATE), biquadMagnitude(&filter, 170, FILTER_SAMPLING_RATE));
+}
+
+TEST(FilterUnittest, TestBiQuadBandPassResponse)
+{
+    biquad_t filter;
+
+    EXPECT_TRUE(filterInitBiQuadOfType(&filter, FILTER_BIQUAD_BPF, 150, 3.0f, FILTER_SAMPLING_RATE));
+
+    EXPECT_NEAR(0.0f, biquadMagnitude(&filter, 0, FILTER_SAMPLING_RATE), 0.01f);
+    EXPECT_NEAR(1.0f, biquadMagnitude(&filter, 150, FILTER_SAMPLING_RATE), 0.01f);
+    EXPECT_NEAR(0.0f, biquadMagnitude(&filter, 500, FILTER_SAMPLING_RATE), 0.01f);
+    EXPECT_NEAR(150 / 3.0f, halfPowerBandwidth(&filter, 150, FILTER_SAMPLING_RATE), 150 / 3.0f * 0.2f);
+}
+
+TEST(FilterUnittest, TestBiQuadNotchAboveNyquistRejected)
+{
+    biquad_t filter = { 1, 2, 3, 4, 5, 6, 7 };
+
+    EXPECT_FALSE(filterInitBiQuadOfType(&filter, FILTER_BIQUAD_NOTCH, FILTER_SAMPLING_RATE / 2, 2.0f, FILTER_SAMPLING_RATE));
+    EXPECT_FALSE(filterInitBiQuadOfType(&filter, FILTER_BIQUAD_BPF, 600, 2.0f, FILTER_SAMPLING_RATE));
+    EXPECT_EQ(1, filter.b0);
+    EXPECT_EQ(5, filter.a2);
+
+    // sampling rate of 0 uses the loop rate
+    targetLooptime = 2000;
+    EXPECT_FALSE(filterInitBiQuadOfType(&filter, FILTER_BIQUAD_NOTCH, 250, 2.0f, 0));
+    EXPECT_TRUE(filterInitBiQuadOfType(&filter, FILTER_BIQUAD_NOTCH, 200, 2.0f, 0));
+}
+
+TEST(FilterUnittest, TestBiQuadBankMatchesPerAxisBiQuad)
+{
+    biquad_t reference[XYZ_AXIS_COUNT];
+    biquad_t stage;
+    biquadBank_t bank;
+
+    filterInitBiQuad(90, &stage, FILTER_SAMPLING_RATE);
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        filterInitBiQuad(90, &reference[axis], FILTER_SAMPLING_RATE);
+    }
+    filterInitBiQuadBank(&bank);
+    EXPECT_TRUE(filterBiQuadBankAddStage(&bank, &stage));
+
+    for (int i = 0; i < 1000; i++) {
+        float samples[XYZ_AXIS_COUNT];
+        float expected[XYZ_AXIS_COUNT];
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            samples[axis] = noiseSample();
+            expected[axis] = filterApplyBiQuad(samples[axis], &reference[axis]);
+        }
+
+        filterApplyBiQuadBank(&bank, samples);
+
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            EXPECT_FLOAT_EQ(expected[axis], samples[axis]);
+        }
+    }
+}
+
+TEST(FilterUnittest, TestBiQuadBankCascade)
+{
+    biquad_t reference[BIQUAD_BANK_MAX_STAGES][XYZ_AXIS_COUNT];
+    biquad_t stage;
+    biquadBank_t bank;
+    const uint8_t cutoffs[BIQUAD_BANK_MAX_STAGES] = { 120, 40, 90 };
+
+    filterInitBiQuadBank(&bank);
+    for (int n = 0; n < BIQUAD_BANK_MAX_STAGES; n++) {
+        filterInitBiQuad(cutoffs[n], &stage, FILTER_SAMPLING_RATE);
+        EXPECT_TRUE(filterBiQuadBankAddStage(&bank, &stage));
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            filterInitBiQuad(cutoffs[n], &reference[n][axis], FILTER_SAMPLING_RATE);
+        }
+    }
+
+    // bank is full
+    EXPECT_FALSE(filterBiQuadBankAddStage(&bank, &stage));
+    EXPECT_EQ(BIQUAD_BANK_MAX_STAGES, bank.stageCount);
+
+    for (int i = 0; i < 1000; i++) {
+        int32_t samples[XYZ_AXIS_COUNT];
+        int32_t expected[XYZ_AXIS_COUNT];
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            samples[axis] = noiseSample();
+            float value = samples[axis];
+            for (int n = 0; n < BIQUAD_BANK_MAX_STAGES; n++) {
+                value = filterApplyBiQuad(value, &reference[n][axis]);
+            }
+            expected[axis] = lrintf(value);
+        }
+
+        filterApplyBiQuadBankInt32(&bank, samples);
+
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            EXPECT_EQ(expected[axis], samples[axis]);
+        }
+    }
+}
+
+// shift register FIR the circular buffer filter replaced, kept as the reference for its output
+static void referenceUpdateFIR(int filterLength, float *shiftBuf, float newSample)
+{
+    for (int i = filterLength - 1; i > 0; i--)
+        shiftBuf[i] = shiftBuf[i - 1];
+
+    shiftBuf[0] = newSample;
+}
+
+static float referenceApplyFIR(int filterLength, const float *shiftBuf, const float *coeffBuf, float commonMultiplier)
+{
+    float accum = 0;
+
+    for (int i = 0; i < filterLength; i++)
+        accum += shiftBuf[i] * coeffBuf[i];
+
+    return accum * commonMultiplier;
+}
+
+TEST(FilterUnittest, TestFIRMatchesShiftRegisterFIR)
+{
+    static const float dtermCoeffs[5] = {5.0f, 2.0f, -8.0f, -2.0f, 3.0f};
+    float longCoeffs[FIR_MAX_LENGTH];
+    for (int i = 0; i < FIR_MAX_LENGTH; i++) {
+        longCoeffs[i] = noiseSample() / 2048.0f;
+    }
+
+    const struct {
+        const float *coeffs;
+        uint8_t length;
+    } setups[] = { { dtermCoeffs, 5 }, { longCoeffs, FIR_MAX_LENGTH }, { longCoeffs, 1 } };
+
+    for (unsigned s = 0; s < sizeof(setups) / sizeof(setups[0]); s++) {
+        firFilter_t filter;
+        float shiftBuf[FIR_MAX_CHANNELS][FIR_MAX_LENGTH] = { { 0 } };
+        firFilterInit(&filter, setups[s].coeffs, setups[s].length, FIR_MAX_CHANNELS);
+
+        for (int i = 0; i < 1000; i++) {
+            for (int channel = 0; channel < FIR_MAX_CHANNELS; channel++) {
+                // channels are updated at different rates, each keeps its own position in the history
+                if (channel == 2 && (i % 3) != 0) {
+                    continue;
+                }
+                const float sample = noiseSample() / 16.0f;
+                referenceUpdateFIR(setups[s].length, shiftBuf[channel], sample);
+                const float expected = referenceApplyFIR(setups[s].length, shiftBuf[channel], setups[s].coeffs, -0.37f);
+                const float actual = firFilterApply(&filter, channel, sample) * -0.37f;
+                ASSERT_EQ(expected, actual) << "length " << (int)setups[s].length << " sample " << i << " channel " << channel;
+            }
+        }
+    }
+}
+
+// Median of the newest samples by sorting a copy, upper median while the window holds an even number of samples
+static int32_t referenceMedian(const int32_t *samples, int newest, int windowSize)
+{
+    const int count = MIN(newest + 1, windowSize);
+    int32_t window[MEDIAN_FILTER_MAX_WINDOW];
+
+    for (int i = 0; i < count; i++) {
+        window[i] = samples[newest - i];
+    }
+    std::sort(window, window + count);
+    return window[count / 2];
+}
+
+TEST(FilterUnittest, TestMedianFilterMatchesSortedWindow)
+{
+    static int32_t samples[2000];
+    for (unsigned i = 0; i < ARRAYLEN(samples); i++) {
+        // narrow range so that repeated values are common
+        samples[i] = (i % 200 < 100) ? (int32_t)(noiseSample() / 64) : (int32_t)noiseSample();
+    }
+
+    for (int windowSize = 1; windowSize <= MEDIAN_FILTER_MAX_WINDOW; windowSize += 2) {
+        medianFilter_t filter;
+        medianFilterInit(&filter, windowSize);
+
+        for (unsigned i = 0; i < ARRAYLEN(samples); i++) {
+            const int32_t median = medianFilterApply(&filter, samples[i]);
+            ASSERT_EQ(referenceMedian(samples, i, windowSize), median) << "window " << windowSize << ", sample " << i;
+            EXPECT_EQ(median, medianFilterGet(&filter));
+            EXPECT_EQ((int)i + 1 >= windowSize, medianFilterIsFull(&filter));
+        }
+    }
+}
+
+TEST(FilterUnittest, TestMedianFilterRejectsSpikes)
+{
+    medianFilter_t filter;
+    medianFilterInit(&filter, 4);   // rounded up to 5
+
+    for (int i = 0; i < 20; i++) {
+        const int32_t spike = (i % 5 == 2) ? 100000 : ((i % 5 == 4) ? -100000 : 0);
+        const int32_t median = medianFilterApply(&filter, 1000 + spike);
+        if (medianFilterIsFull(&filter)) {
+            EXPECT_EQ(1000, median);
+        }
+    }
+}
+
+// Reports host timings of both ways of filtering gyro data, checks that both filtered the same signal
+TEST(FilterUnittest, BenchmarkBiQuadBankAgainstPerAxisLoop)
+{
+    static int32_t input[FILTER_BENCHMARK_SAMPLES][XYZ_AXIS_COUNT];
+    for (int i = 0; i < FILTER_BENCHMARK_SAMPLES; i++) {
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            input[i][axis] = noiseSample();
+        }
+    }
+
+    for (int stages = 1; stages <= BIQUAD_BANK_MAX_STAGES; stages++) {
+        biquad_t perAxis[BIQUAD_BANK_MAX_STAGES][XYZ_AXIS_COUNT];
+        biquadBank_t bank;
+        biquad_t stage;
+        int64_t checksumPerAxis = 0;
+        int64_t checksumBank = 0;
+
+        filterInitBiQuadBank(&bank);
+        for (int n = 0; n < stages; n++) {
+            filterInitBiQuad(80, &stage, FILTER_SAMPLING_RATE);
+            filterBiQuadBankAddStage(&bank, &stage);
+            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+                perAxis[n][axis] = stage;
+            }
+        }
+
+        const double perAxisTime = unittestNanosecondsPerSample(FILTER_BENCHMARK_SAMPLES, [&](int i) {
+            int32_t samples[XYZ_AXIS_COUNT] = { input[i][X], input[i][Y], input[i][Z] };
+            for (int n = 0; n < stages; n++) {
+                for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+                    samples[axis] = lrintf(filterApplyBiQuad((float) samples[axis], &perAxis[n][axis]));
+                }
+            }
+            checksumPerAxis += samples[X] + samples[Y] + samples[Z];
+        });
+
+        const double bankTime = unittestNanosecondsPerSample(FILTER_BENCHMARK_SAMPLES, [&](int i) {
+            int32_t samples[XYZ_AXIS_COUNT] = { input[i][X], input[i][Y], input[i][Z] };
+            filterApplyBiQuadBankInt32(&bank, samples);
+            checksumBank += samples[X] + samples[Y] + samples[Z];
+        });
+
+        char name[32];
+        snprintf(name, sizeof(name), "per_axis_%d_stages", stages);
+        unittestReportBenchmark(name, perAxisTime);
+        snprintf(name, sizeof(name), "bank_%d_stages", stages);
+        unittestReportBenchmark(name, bankTime);
+
+        // per axis loop rounds between stages, so results only match exactly for a single stage. Rounding is
+        // unbiased, with more stages the sums still agree to well within a hundredth of a unit per sample
+        if (stages == 1) {
+            EXPECT_EQ(checksumPerAxis, checksumBank);
+        } else {
+            EXPECT_LE(llabs(checksumPerAxis - checksumBank), FILTER_BENCHMARK_SAMPLES / 100);
+        }
+    }
+}
+
+// STUBS
+
+extern "C" {
+uint32_t targetLooptime;
+}
@@ -0,0 +1,223 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/axis.h"
+    #include "common/maths.h"
+    #include "common/utils.h"
+    #include "common/filter.h"
+    #include "common/fixedpoint.h"
+
+    #include "drivers/gyro_sync.h"
+}
+
+#include "unittest_macros.h"
+#include "unittest_random.h"
+#include "gtest/gtest.h"
+
+#define FILTER_SAMPLING_RATE    1000
+#define FILTER_TEST_SAMPLES     5000
+
+// deterministic gyro-like samples, noise on top of a 37Hz sine
+static int32_t gyroSample(int i)
+{
+    const int32_t noise = (int32_t)(unittestRandom() % 1024) - 512;
+    return lrintf(6000.0f * sinf(2 * M_PI * 37 * i / FILTER_SAMPLING_RATE)) + noise;
+}
+
+TEST(FixedPointUnittest, TestSaturation)
+{
+    EXPECT_EQ(Q15_MAX, q15SatAdd(30000, 30000));
+    EXPECT_EQ(Q15_MIN, q15SatAdd(-30000, -30000));
+    EXPECT_EQ(Q31_MAX, q31SatAdd(Q31_MAX, 1));
+    EXPECT_EQ(Q31_MIN, q31SatSub(Q31_MIN, 1));
+    EXPECT_EQ(Q15_MAX, q15Mul(Q15_MIN, Q15_MIN));
+    EXPECT_EQ(Q31_MAX, q31Mul(Q31_MIN, Q31_MIN));
+    EXPECT_EQ(INT32_MAX, q31SatAccumulator((int64_t)INT32_MAX << 4, 2));
+    EXPECT_EQ(Q31_MAX, floatToQ31(1.5f));
+    EXPECT_EQ(Q15_MIN, floatToQ15(-2.0f));
+}
+
+TEST(FixedPointUnittest, TestMultiply)
+{
+    const float values[] = { -0.9f, -0.5f, -0.123f, 0.0f, 0.001f, 0.3f, 0.77f };
+
+    for (unsigned i = 0; i < ARRAYLEN(values); i++) {
+        for (unsigned j = 0; j < ARRAYLEN(values); j++) {
+            const float expected = values[i] * values[j];
+            EXPECT_NEAR(expected, q31ToFloat(q31Mul(floatToQ31(values[i]), floatToQ31(values[j]))), 1e-7f);
+            EXPECT_NEAR(expected, q15ToFloat(q15Mul(floatToQ15(values[i]), floatToQ15(values[j]))), 1.0f / 32768);
+        }
+    }
+}
+
+TEST(FixedPointUnittest, TestFastInvSqrt)
+{
+    for (float x = 1e-4f; x < 1e4f; x *= 1.37f) {
+        const float expected = 1.0f / sqrtf(x);
+        EXPECT_NEAR(1.0f, fastInvSqrtf(x) / expected, 1e-5f);
+    }
+}
+
+// Same coefficients evaluated in double, reference for both float and fixed-point implementations
+typedef struct {
+    double b0, b1, b2, a1, a2;
+    double x1, x2, y1, y2;
+} biquadReference_t;
+
+static void biquadReferenceInit(biquadReference_t *reference, const biquad_t *design)
+{
+    *reference = (biquadReference_t) { design->b0, design->b1, design->b2, design->a1, design->a2, 0, 0, 0, 0 };
+}
+
+static double biquadReferenceApply(biquadReference_t *reference, double sample)
+{
+    const double result = reference->b0 * sample + reference->b1 * reference->x1 + reference->b2 * reference->x2
+        - reference->a1 * reference->y1 - reference->a2 * reference->y2;
+    reference->x2 = reference->x1;
+    reference->x1 = sample;
+    reference->y2 = reference->y1;
+    reference->y1 = result;
+    return result;
+}
+
+static void expectBiQuadFixedMatchesReference(biquad_t *design)
+{
+    biquadReference_t reference;
+    biquadFixed_t fixed;
+    biquadReferenceInit(&reference, design);
+    filterInitBiQuadFixed(&fixed, design);
+
+    double maxFixedError = 0;
+    double maxFloatError = 0;
+    for (int i = 0; i < FILTER_TEST_SAMPLES; i++) {
+        const int32_t sample = gyroSample(i);
+        const double expected = biquadReferenceApply(&reference, sample);
+        maxFixedError = MAX(maxFixedError, fabs(filterApplyBiQuadFixed(sample, &fixed) - expected));
+        maxFloatError = MAX(maxFloatError, fabs(filterApplyBiQuad(sample, design) - expected));
+    }
+
+    // Output rounding only, fraction bits keep the recursion from accumulating error
+    EXPECT_LE(maxFixedError, 1.0);
+    EXPECT_LE(maxFixedError, maxFloatError + 0.5);
+}
+
+TEST(FixedPointUnittest, TestBiQuadLowPassMatchesFloat)
+{
+    biquad_t design;
+    filterInitBiQuad(20, &design, FILTER_SAMPLING_RATE);
+    expectBiQuadFixedMatchesReference(&design);
+}
+
+TEST(FixedPointUnittest, TestBiQuadNotchMatchesFloat)
+{
+    biquad_t design;
+    EXPECT_TRUE(filterInitBiQuadOfType(&design, FILTER_BIQUAD_NOTCH, 150, 2.0f, FILTER_SAMPLING_RATE));
+    expectBiQuadFixedMatchesReference(&design);
+}
+
+TEST(FixedPointUnittest, TestBiQuadBankMatchesReference)
+{
+    const uint16_t cutoffs[] = { 90, 120 };
+    biquadReference_t reference[ARRAYLEN(cutoffs)][BIQUAD_FIXED_BANK_AXIS_COUNT];
+    biquadFixedBank_t fixed;
+
+    filterInitBiQuadFixedBank(&fixed);
+    for (unsigned n = 0; n < ARRAYLEN(cutoffs); n++) {
+        biquad_t stage;
+        filterInitBiQuad(cutoffs[n], &stage, FILTER_SAMPLING_RATE);
+        EXPECT_TRUE(filterBiQuadFixedBankAddStage(&fixed, &stage));
+        for (int axis = 0; axis < BIQUAD_FIXED_BANK_AXIS_COUNT; axis++) {
+            biquadReferenceInit(&reference[n][axis], &stage);
+        }
+    }
+
+    double maxError = 0;
+    for (int i = 0; i < FILTER_TEST_SAMPLES; i++) {
+        int32_t samples[BIQUAD_FIXED_BANK_AXIS_COUNT];
+        double expected[BIQUAD_FIXED_BANK_AXIS_COUNT];
+        for (int axis = 0; axis < BIQUAD_FIXED_BANK_AXIS_COUNT; axis++) {
+            samples[axis] = gyroSample(i) * (axis + 1) / 3;
+            expected[axis] = samples[axis];
+            for (unsigned n = 0; n < ARRAYLEN(cutoffs); n++) {
+                expected[axis] = biquadReferenceApply(&reference[n][axis], expected[axis]);
+            }
+        }
+
+        filterApplyBiQuadFixedBank(&fixed, samples);
+
+        for (int axis = 0; axis < BIQUAD_FIXED_BANK_AXIS_COUNT; axis++) {
+            maxError = MAX(maxError, fabs(samples[axis] - expected[axis]));
+        }
+    }
+
+    EXPECT_LE(maxError, 1.0);
+}
+
+TEST(FixedPointUnittest, TestPt1MatchesFloat)
+{
+    const float dT = 1.0f / FILTER_SAMPLING_RATE;
+    filterStatePt1_t reference = { 0, 0, 0 };
+    pt1FilterFixed_t fixed;
+
+    filterInitPt1Fixed(&fixed, 30, dT);
+
+    int32_t maxError = 0;
+    for (int i = 0; i < FILTER_TEST_SAMPLES; i++) {
+        const int32_t sample = gyroSample(i);
+        const int32_t expected = lrintf(filterApplyPt1(sample, &reference, 30, dT));
+        maxError = MAX(maxError, abs(filterApplyPt1Fixed(sample, &fixed) - expected));
+    }
+
+    EXPECT_LE(maxError, 1);
+}
+
+TEST(FixedPointUnittest, TestFIRMatchesFloatFIR)
+{
+    static const float coeffs[] = { 5.0f, 2.0f, -8.0f, -2.0f, 3.0f };
+    static const int16_t coeffsFixed[] = { 5, 2, -8, -2, 3 };
+    firFilter_t reference;
+    firFilterFixed_t fixed;
+
+    firFilterInit(&reference, coeffs, ARRAYLEN(coeffs), 2);
+    firFilterFixedInit(&fixed, coeffsFixed, ARRAYLEN(coeffsFixed), 2);
+
+    for (int i = 0; i < FILTER_TEST_SAMPLES; i++) {
+        const int32_t sample = gyroSample(i);
+        // Integer samples and coefficients, float is exact here too
+        EXPECT_EQ(lrintf(firFilterApply(&reference, 0, sample)), firFilterFixedApply(&fixed, 0, sample));
+        EXPECT_EQ(lrintf(firFilterApply(&reference, 1, -sample)), firFilterFixedApply(&fixed, 1, -sample));
+    }
+
+    // Sum saturates instead of wrapping
+    for (int i = 0; i < 5; i++) {
+        firFilterFixedApply(&fixed, 0, INT32_MAX / 2);
+    }
+    EXPECT_EQ(INT32_MAX, firFilterFixedApply(&fixed, 0, INT32_MAX));
+}
+
+// STUBS
+
+extern "C" {
+uint32_t targetLooptime;
+}
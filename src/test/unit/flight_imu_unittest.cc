@@ -19,6 +19,7 @@
 #include <stdbool.h>
 
 #include <limits.h>
+#include <math.h>
 
 #define BARO
 
@@ -39,22 +40,30 @@ extern "C" {
 
     #include "config/runtime_config.h"
 
+    #include "io/gps.h"
+
     #include "rx/rx.h"
 
     #include "flight/mixer.h"
     #include "flight/pid.h"
     #include "flight/imu.h"
+    #include "flight/imu_ekf.h"
 }
 
 #include "unittest_macros.h"
 #include "gtest/gtest.h"
 
 extern float q0, q1, q2, q3;
+extern float rMat[3][3];
 extern "C" { 
 void imuComputeRotationMatrix(void);
 void imuUpdateEulerAngles(void);
+void imuInit(void);
 }
 
+static uint32_t simulatedTime;
+static uint32_t enabledSensors;
+
 void imuComputeQuaternionFromRPY(int16_t initialRoll, int16_t initialPitch, int16_t initialYaw)
 {
     if (initialRoll > 1800) initialRoll -= 3600;
@@ -123,6 +132,188 @@ TEST(FlightImuTest, TestEulerAngleCalculation)
     EXPECT_FLOAT_EQ(attitude.values.yaw, 2700);
 }
 
+// Runs the attitude estimator on a level, motionless board starting from a tilted attitude, returns roll after duration
+static imuRuntimeConfig_t imuRuntimeConfig;
+
+static void configureImu(uint8_t estimator, uint16_t correctionHz)
+{
+    imuRuntimeConfig.dcm_kp_acc = 0.25f;
+    imuRuntimeConfig.dcm_ki_acc = 0.005f;
+    imuRuntimeConfig.correction_interval = correctionHz ? 1000000 / correctionHz : 0;
+    imuRuntimeConfig.estimator = estimator;
+    imuConfigure(&imuRuntimeConfig, NULL);
+}
+
+static int16_t runLevellingFromTilt(uint16_t correctionHz, uint32_t looptime, uint32_t duration, uint8_t estimator = IMU_ESTIMATOR_MAHONY)
+{
+    configureImu(estimator, correctionHz);
+
+    acc.acc_1G = 512;
+    gyro.scale = 1.0f / 16.4f;
+    enabledSensors = SENSOR_ACC;
+    imuInit();
+
+    imuComputeQuaternionFromRPY(300, 0, 0);
+
+    accADC[X] = 0;
+    accADC[Y] = 0;
+    accADC[Z] = acc.acc_1G;
+    gyroADC[X] = gyroADC[Y] = gyroADC[Z] = 0;
+
+    imuUpdateAccelerometer();
+    // simulatedTime keeps running between calls, the estimator keeps its previous update time
+    imuUpdateGyroAndAttitude();
+
+    for (uint32_t time = 0; time < duration; time += looptime) {
+        simulatedTime += looptime;
+        imuUpdateAccelerometer();
+        imuUpdateGyroAndAttitude();
+    }
+
+    enabledSensors = 0;
+    return attitude.values.roll;
+}
+
+TEST(FlightImuTest, TestReducedRateCorrectionMatchesFullRate)
+{
+    // fast gains are in use while disarmed, the 30 degree error has mostly gone after 300ms
+    const int16_t fullRateRoll = runLevellingFromTilt(0, 1000, 300000);
+    const int16_t reducedRateRoll = runLevellingFromTilt(100, 1000, 300000);
+
+    EXPECT_LT(ABS(fullRateRoll), 150);
+    EXPECT_NEAR(fullRateRoll, reducedRateRoll, 10);     // within one degree
+
+    EXPECT_NEAR(0, runLevellingFromTilt(100, 1000, 3000000), 5);
+    EXPECT_NEAR(0, runLevellingFromTilt(50, 500, 3000000), 5);
+}
+
+TEST(FlightImuTest, TestEkfLevelsFromTilt)
+{
+    EXPECT_NEAR(0, runLevellingFromTilt(0, 1000, 3000000, IMU_ESTIMATOR_EKF), 5);
+    EXPECT_NEAR(0, runLevellingFromTilt(100, 1000, 3000000, IMU_ESTIMATOR_EKF), 5);
+}
+
+/*
+ * Synthetic trajectory: the board hovers level for settleTime, rolls to bankAngle in one second and then turns
+ * about the earth Z axis at turnRate. While turning the accelerometer measures gravity plus the centripetal
+ * acceleration of a coordinated turn, which is along the body Z axis. The estimator starts at the true attitude,
+ * returns the tilt error in degrees at the end.
+ */
+#define TRAJECTORY_ROLL_IN_TIME 1000000
+
+static float runTrajectory(uint8_t estimator, uint32_t settleTime, float bankAngle, float turnRate, const float gyroBias[XYZ_AXIS_COUNT], uint32_t duration)
+{
+    const uint32_t looptime = 1000;
+    const float dt = looptime * 1e-6f;
+
+    configureImu(estimator, 0);
+
+    acc.acc_1G = 4096;
+    gyro.scale = 1.0f / 16.4f;
+    enabledSensors = SENSOR_ACC;
+    armingFlags = ARMED;
+    imuInit();
+
+    float qt[4] = { 1, 0, 0, 0 };
+    q0 = 1;
+    q1 = q2 = q3 = 0;
+    imuComputeRotationMatrix();
+
+    for (uint32_t time = 0; time < settleTime + TRAJECTORY_ROLL_IN_TIME + duration; time += looptime) {
+        // Rotation matrix of the true attitude, body to earth
+        const float rt[3][3] = {
+            { 1 - 2 * (qt[2] * qt[2] + qt[3] * qt[3]), 2 * (qt[1] * qt[2] - qt[0] * qt[3]), 2 * (qt[1] * qt[3] + qt[0] * qt[2]) },
+            { 2 * (qt[1] * qt[2] + qt[0] * qt[3]), 1 - 2 * (qt[1] * qt[1] + qt[3] * qt[3]), 2 * (qt[2] * qt[3] - qt[0] * qt[1]) },
+            { 2 * (qt[1] * qt[3] - qt[0] * qt[2]), 2 * (qt[2] * qt[3] + qt[0] * qt[1]), 1 - 2 * (qt[1] * qt[1] + qt[2] * qt[2]) }
+        };
+        float bodyRate[3] = { 0, 0, 0 };
+        float accel[3] = { rt[2][0], rt[2][1], rt[2][2] };      // in G
+
+        if (time >= settleTime + TRAJECTORY_ROLL_IN_TIME) {
+            // Rotation about earth Z in body frame is R' * (0, 0, turnRate)
+            for (int axis = 0; axis < 3; axis++) {
+                bodyRate[axis] = rt[2][axis] * turnRate;
+            }
+            accel[X] = 0;
+            accel[Y] = 0;
+            accel[Z] = 1.0f / cosf(bankAngle);
+        }
+        else if (time >= settleTime) {
+            bodyRate[X] = bankAngle / (TRAJECTORY_ROLL_IN_TIME * 1e-6f);
+        }
+
+        for (int axis = 0; axis < 3; axis++) {
+            gyroADC[axis] = lrintf((bodyRate[axis] + gyroBias[axis]) / (gyro.scale * M_PIf / 180.0f));
+            accADC[axis] = lrintf(accel[axis] * acc.acc_1G);
+        }
+
+        simulatedTime += looptime;
+        imuUpdateAccelerometer();
+        imuUpdateGyroAndAttitude();
+
+        // Propagate the truth the same way as the estimators, q = q * (0, bodyRate * dt / 2)
+        const float gx = bodyRate[X] * dt / 2, gy = bodyRate[Y] * dt / 2, gz = bodyRate[Z] * dt / 2;
+        const float qa = qt[0], qb = qt[1], qc = qt[2];
+        qt[0] += -qb * gx - qc * gy - qt[3] * gz;
+        qt[1] += qa * gx + qc * gz - qt[3] * gy;
+        qt[2] += qa * gy - qb * gz + qt[3] * gx;
+        qt[3] += qa * gz + qb * gy - qc * gx;
+        const float norm = sqrtf(qt[0] * qt[0] + qt[1] * qt[1] + qt[2] * qt[2] + qt[3] * qt[3]);
+        for (int i = 0; i < 4; i++) {
+            qt[i] /= norm;
+        }
+    }
+
+    // Angle between true and estimated gravity in body frame
+    const float trueGravity[3] = {
+        2 * (qt[1] * qt[3] - qt[0] * qt[2]),
+        2 * (qt[2] * qt[3] + qt[0] * qt[1]),
+        1 - 2 * (qt[1] * qt[1] + qt[2] * qt[2])
+    };
+    const float cosError = trueGravity[0] * rMat[2][0] + trueGravity[1] * rMat[2][1] + trueGravity[2] * rMat[2][2];
+
+    enabledSensors = 0;
+    armingFlags = 0;
+    return acosf(constrainf(cosError, -1.0f, 1.0f)) * 180.0f / M_PIf;
+}
+
+TEST(FlightImuTest, TestEkfEstimatesGyroBias)
+{
+    const float noBias[XYZ_AXIS_COUNT] = { 0, 0, 0 };
+    const float gyroBias[XYZ_AXIS_COUNT] = { DEGREES_TO_RADIANS(2), DEGREES_TO_RADIANS(-2), 0 };
+
+    // Without bias both stay on the truth
+    EXPECT_LT(runTrajectory(IMU_ESTIMATOR_MAHONY, 0, 0, 0, noBias, 10000000), 1.0f);
+    EXPECT_LT(runTrajectory(IMU_ESTIMATOR_EKF, 0, 0, 0, noBias, 10000000), 1.0f);
+
+    // Hovering with a gyro bias of 2 degree/s on roll and pitch for 60s
+    const float mahonyError = runTrajectory(IMU_ESTIMATOR_MAHONY, 0, 0, 0, gyroBias, 60000000);
+    const float ekfError = runTrajectory(IMU_ESTIMATOR_EKF, 0, 0, 0, gyroBias, 60000000);
+
+    EXPECT_LT(ekfError, 0.5f);
+    EXPECT_LT(ekfError, mahonyError);
+
+    const imuEkfStatus_t *status = imuEkfGetStatus();
+    EXPECT_NEAR(gyroBias[X], status->gyroBias[X], DEGREES_TO_RADIANS(0.2f));
+    EXPECT_NEAR(gyroBias[Y], status->gyroBias[Y], DEGREES_TO_RADIANS(0.2f));
+    EXPECT_LT(status->attitudeStdDev[X], DEGREES_TO_RADIANS(1));
+    EXPECT_LT(status->attitudeStdDev[Y], DEGREES_TO_RADIANS(1));
+}
+
+TEST(FlightImuTest, TestEkfDriftsLessInCoordinatedTurn)
+{
+    const float noBias[XYZ_AXIS_COUNT] = { 0, 0, 0 };
+
+    // Fixed-wing circling at 20 degree bank and 15m/s for 30s, no GPS
+    const float bankAngle = DEGREES_TO_RADIANS(20);
+    const float turnRate = 9.80665f * tanf(bankAngle) / 15.0f;
+
+    const float mahonyError = runTrajectory(IMU_ESTIMATOR_MAHONY, 10000000, bankAngle, turnRate, noBias, 30000000);
+    const float ekfError = runTrajectory(IMU_ESTIMATOR_EKF, 10000000, bankAngle, turnRate, noBias, 30000000);
+
+    EXPECT_LT(ekfError, mahonyError / 2);
+}
+
 // STUBS
 
 extern "C" {
@@ -133,6 +324,9 @@ int16_t rcData[MAX_SUPPORTED_RC_CHANNEL_COUNT];
 uint16_t acc_1G;
 int16_t heading;
 gyro_t gyro;
+acc_t acc;
+gpsSolutionData_t gpsSol;
+uint32_t targetLooptime;
 int32_t magADC[XYZ_AXIS_COUNT];
 int32_t BaroAlt;
 int16_t debug[DEBUG16_VALUE_COUNT];
@@ -165,16 +359,16 @@ uint16_t disableFlightMode(flightModeFlags_e mask)
 void gyroUpdate(void) {};
 bool sensors(uint32_t mask)
 {
-    UNUSED(mask);
-    return false;
+    return enabledSensors & mask;
 };
 void updateAccelerationReadings(void)
 {
 }
 bool isGyroCalibrationComplete(void) { return 1; }
 bool isCompassReady(void) { return 1; }
-uint32_t micros(void) { return 0; }
+uint32_t micros(void) { return simulatedTime; }
 uint32_t millis(void) { return 0; }
+bool persistentFlag(uint8_t mask) { UNUSED(mask); return false; }
 bool isBaroCalibrationComplete(void) { return true; }
 void performBaroCalibrationCycle(void) {}
 int32_t baroCalculateAltitude(void) { return 0; }
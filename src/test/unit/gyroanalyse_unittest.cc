@@ -0,0 +1,164 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <math.h>
+
+extern "C" {
+    #include "platform.h"
+    #include "debug.h"
+
+    #include "common/axis.h"
+    #include "common/maths.h"
+    #include "common/filter.h"
+    #include "common/fft.h"
+
+    #include "drivers/gyro_sync.h"
+
+    #include "sensors/gyroanalyse.h"
+}
+
+#include "unittest_macros.h"
+#include "unittest_signal.h"
+#include "gtest/gtest.h"
+
+static uint8_t peakBin(const fftData_t *data)
+{
+    uint8_t peak = 1;
+    for (int bin = 1; bin < FFT_BIN_COUNT; bin++) {
+        if (fftBinPower(data, bin) > fftBinPower(data, peak)) {
+            peak = bin;
+        }
+    }
+    return peak;
+}
+
+TEST(GyroAnalyseTest, FftFindsSineBin)
+{
+    fftInit();
+
+    // bin 10 of a 64 point FFT at 1kHz is 156.25Hz
+    float samples[FFT_SIZE];
+    for (int i = 0; i < FFT_SIZE; i++) {
+        samples[i] = 1000 * unittestSine(156.25f, 1000, i) + 300;
+    }
+
+    fftData_t data;
+    fftLoadWindowedReal(&data, samples, 0);
+    fftCalculate(&data);
+
+    EXPECT_EQ(10, peakBin(&data));
+    // Hann window spreads a bin centered sine over the two neighbours only
+    EXPECT_NEAR(fftBinPower(&data, 9), fftBinPower(&data, 11), fftBinPower(&data, 10) * 0.01f);
+    EXPECT_LT(fftBinPower(&data, 13), fftBinPower(&data, 10) * 1e-6f);
+}
+
+TEST(GyroAnalyseTest, FftMatchesDft)
+{
+    fftInit();
+
+    float samples[FFT_SIZE];
+    for (int i = 0; i < FFT_SIZE; i++) {
+        samples[i] = 400 * unittestSine(90, 1000, i) + 250 * unittestSine(333, 1000, i);
+    }
+
+    // circular buffer starting in the middle, the window applies from the oldest sample on
+    const uint8_t firstSample = 23;
+    fftData_t data;
+    fftLoadWindowedReal(&data, samples, firstSample);
+    fftCalculate(&data);
+
+    for (int bin = 0; bin < FFT_BIN_COUNT; bin++) {
+        double re = 0, im = 0;
+        for (int i = 0; i < FFT_SIZE; i++) {
+            const double window = 0.5 - 0.5 * cos(2 * M_PI * i / FFT_SIZE);
+            const double value = samples[(firstSample + i) % FFT_SIZE] * window;
+            re += value * cos(2 * M_PI * bin * i / FFT_SIZE);
+            im -= value * sin(2 * M_PI * bin * i / FFT_SIZE);
+        }
+        EXPECT_NEAR(re, data.re[bin], 0.05);
+        EXPECT_NEAR(im, data.im[bin], 0.05);
+    }
+}
+
+TEST(GyroAnalyseTest, DynamicNotchTracksNoisePeak)
+{
+    // 2kHz loop, analysed at 1kHz
+    targetLooptime = 500;
+    gyroDynamicNotchInit(targetLooptime, 80, 300);
+
+    const float rollNoiseHz = 210;
+    const float pitchNoiseHz = 170;
+    int32_t gyroData[XYZ_AXIS_COUNT];
+    float inputPower = 0, outputPower = 0;
+
+    for (int i = 0; i < 4000; i++) {
+        gyroData[X] = lrintf(500 * unittestSine(rollNoiseHz, 2000, i) + 100 * unittestSine(15, 2000, i));
+        gyroData[Y] = lrintf(500 * unittestSine(pitchNoiseHz, 2000, i));
+        gyroData[Z] = 0;
+        const float rollInput = gyroData[X] - 100 * unittestSine(15, 2000, i);
+
+        gyroDynamicNotchUpdate(gyroData);
+
+        if (i >= 3000) {
+            inputPower += rollInput * rollInput;
+            const float rollOutput = gyroData[X] - 100 * unittestSine(15, 2000, i);
+            outputPower += rollOutput * rollOutput;
+        }
+    }
+
+    EXPECT_NEAR(rollNoiseHz, gyroDynamicNotchGetCenterHz(X), 8);
+    EXPECT_NEAR(pitchNoiseHz, gyroDynamicNotchGetCenterHz(Y), 8);
+    // noiseless axis gets no notch
+    EXPECT_EQ(0, gyroDynamicNotchGetCenterHz(Z));
+    EXPECT_EQ(gyroDynamicNotchGetCenterHz(X), debug[X]);
+    EXPECT_EQ(gyroDynamicNotchGetCenterHz(Y), debug[Y]);
+
+    // at least 20dB attenuation of the tracked noise
+    EXPECT_LT(outputPower, inputPower / 100);
+}
+
+TEST(GyroAnalyseTest, DynamicNotchFollowsMovingPeak)
+{
+    targetLooptime = 1000;
+    gyroDynamicNotchInit(targetLooptime, 80, 300);
+
+    int32_t gyroData[XYZ_AXIS_COUNT] = { 0, 0, 0 };
+    float phase = 0;
+
+    // motor noise sweeping from 120Hz to 300Hz over 3 seconds, then holding
+    for (int i = 0; i < 4000; i++) {
+        const float frequency = 120 + 180 * MIN(i, 3000) / 3000.0f;
+        phase += 2 * M_PI * frequency / 1000;
+        gyroData[X] = lrintf(500 * sinf(phase));
+        gyroData[Y] = gyroData[Z] = 0;
+        gyroDynamicNotchUpdate(gyroData);
+
+        if (i == 1500) {
+            EXPECT_NEAR(210, gyroDynamicNotchGetCenterHz(X), 20);
+        }
+    }
+
+    EXPECT_NEAR(300, gyroDynamicNotchGetCenterHz(X), 8);
+}
+
+// STUBS
+
+extern "C" {
+uint32_t targetLooptime;
+int16_t debug[DEBUG16_VALUE_COUNT];
+}
@@ -0,0 +1,159 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/axis.h"
+    #include "common/maths.h"
+    #include "common/filter.h"
+
+    #include "drivers/gyro_sync.h"
+
+    #include "sensors/gyronoise.h"
+}
+
+#include "unittest_macros.h"
+#include "unittest_random.h"
+#include "unittest_signal.h"
+#include "gtest/gtest.h"
+
+#define LOOP_HZ     1000
+#define MIN_HZ      30
+#define MAX_HZ      120
+
+static void initDynamicLpf(void)
+{
+    unittestRandomSeed(2463534242U);
+    targetLooptime = 1000000 / LOOP_HZ;
+    gyroDynamicLpfInit(targetLooptime, MIN_HZ, MAX_HZ);
+}
+
+TEST(GyroNoiseTest, QuietGyroKeepsHighestCutoff)
+{
+    initDynamicLpf();
+
+    // fast stick input and a little sensor noise
+    for (int i = 0; i < 3000; i++) {
+        int32_t gyroData[XYZ_AXIS_COUNT];
+        gyroData[X] = lrintf(3000 * unittestSine(5, LOOP_HZ, i) + unittestGaussian(3));
+        gyroData[Y] = lrintf(-2000 * unittestSine(2, LOOP_HZ, i) + unittestGaussian(3));
+        gyroData[Z] = lrintf(unittestGaussian(1));
+        gyroDynamicLpfUpdate(gyroData);
+    }
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        EXPECT_LT(gyroNoiseGetStdDev(axis), GYRO_NOISE_TARGET);
+        EXPECT_EQ(MAX_HZ, gyroDynamicLpfGetCutoffHz(axis));
+    }
+}
+
+TEST(GyroNoiseTest, WhiteNoiseLevelSetsCutoff)
+{
+    initDynamicLpf();
+
+    const float stdDev[XYZ_AXIS_COUNT] = { 20, 40, 12 };
+    for (int i = 0; i < 3000; i++) {
+        int32_t gyroData[XYZ_AXIS_COUNT];
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            gyroData[axis] = lrintf(500 * unittestSine(3, LOOP_HZ, i) + unittestGaussian(stdDev[axis]));
+        }
+        gyroDynamicLpfUpdate(gyroData);
+    }
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        EXPECT_NEAR(stdDev[axis], gyroNoiseGetStdDev(axis), stdDev[axis] * 0.1f);
+    }
+
+    // fc = fs / 2 * (target / sd)^2
+    EXPECT_NEAR(80, gyroDynamicLpfGetCutoffHz(X), GYRO_NOISE_HYSTERESIS_HZ + 8);
+    EXPECT_EQ(MIN_HZ, gyroDynamicLpfGetCutoffHz(Y));
+    EXPECT_EQ(MAX_HZ, gyroDynamicLpfGetCutoffHz(Z));
+}
+
+TEST(GyroNoiseTest, MotorNoiseLowersCutoffAndIsAttenuated)
+{
+    initDynamicLpf();
+
+    float inputPower = 0, outputPower = 0;
+    for (int i = 0; i < 3000; i++) {
+        const float noise = 150 * unittestSine(260, LOOP_HZ, i);
+        int32_t gyroData[XYZ_AXIS_COUNT] = { (int32_t)lrintf(noise + unittestGaussian(2)), 0, 0 };
+        gyroDynamicLpfUpdate(gyroData);
+
+        if (i >= 2000) {
+            inputPower += noise * noise;
+            outputPower += sq(gyroData[X]);
+        }
+    }
+
+    EXPECT_EQ(MIN_HZ, gyroDynamicLpfGetCutoffHz(X));
+    EXPECT_EQ(MAX_HZ, gyroDynamicLpfGetCutoffHz(Y));
+    // 260Hz is three octaves above a 30Hz second order low pass, at least 30dB down
+    EXPECT_LT(outputPower, inputPower / 1000);
+}
+
+TEST(GyroNoiseTest, StationaryNoiseDoesNotHunt)
+{
+    initDynamicLpf();
+
+    int changes = 0;
+    uint8_t previousCutoff = 0;
+    for (int i = 0; i < 10000; i++) {
+        int32_t gyroData[XYZ_AXIS_COUNT] = { (int32_t)lrintf(unittestGaussian(20)), 0, 0 };
+        gyroDynamicLpfUpdate(gyroData);
+
+        if (i >= 2000 && gyroDynamicLpfGetCutoffHz(X) != previousCutoff) {
+            changes++;
+        }
+        previousCutoff = gyroDynamicLpfGetCutoffHz(X);
+    }
+
+    // settling from the first estimates may still move it once
+    EXPECT_LE(changes, 1);
+}
+
+TEST(GyroNoiseTest, CutoffChangeIsCrossFaded)
+{
+    initDynamicLpf();
+
+    // Nyquist rate noise on a constant rate, every cutoff removes it entirely once settled
+    int maxError = 0;
+    for (int i = 0; i < 4000; i++) {
+        const int32_t amplitude = (i < 2000) ? 2 : 40;
+        int32_t gyroData[XYZ_AXIS_COUNT] = { 1000 + ((i & 1) ? amplitude : -amplitude), 0, 0 };
+        gyroDynamicLpfUpdate(gyroData);
+
+        if (i >= 500) {
+            maxError = MAX(maxError, abs(gyroData[X] - 1000));
+        }
+    }
+
+    EXPECT_EQ(MIN_HZ, gyroDynamicLpfGetCutoffHz(X));
+    // Restarting the filter from zero would have dropped the output by 1000, the amplitude step alone leaks a few LSB
+    EXPECT_LE(maxError, 10);
+}
+
+// STUBS
+
+extern "C" {
+uint32_t targetLooptime;
+}
@@ -0,0 +1,271 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/axis.h"
+    #include "common/maths.h"
+
+    #include "drivers/sensor.h"
+    #include "drivers/flash_m25p16.h"
+
+    #include "sensors/sensors.h"
+
+    #include "io/gps.h"
+    #include "io/flashfs.h"
+
+    #include "flight/imu.h"
+    #include "flight/navigation_rewrite.h"
+    #include "flight/navigation_rewrite_private.h"
+
+    #include "config/runtime_config.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+// Small NOR flash: programming can only clear bits, erasing sets a whole sector back to 0xFF
+#define FAKE_FLASH_PAGE_SIZE        256
+#define FAKE_FLASH_SECTOR_SIZE      4096
+#define FAKE_FLASH_SECTORS          16
+#define FAKE_FLASH_SIZE             (FAKE_FLASH_SECTORS * FAKE_FLASH_SECTOR_SIZE)
+#define FAKE_FLASH_ERASE_POLLS      3
+
+#define MISSION_WAYPOINTS           500     // spans every sector of the reserved area
+
+static uint8_t fakeFlash[FAKE_FLASH_SIZE];
+static int fakeFlashBusyPolls;              // the chip reports busy this many more times
+static bool fakeFlashWhileBusy;             // accessed while an erase was in progress
+
+static void resetFakeFlash(void)
+{
+    // let an erase left over by the previous test finish
+    fakeFlashBusyPolls = 0;
+    while (!flashfsIsReady());
+
+    // not erased, everything has to be erased before programming
+    memset(fakeFlash, 0x00, sizeof(fakeFlash));
+    fakeFlashWhileBusy = false;
+    armingFlags = 0;
+}
+
+static bool isFlashErased(uint32_t start, uint32_t end)
+{
+    for (uint32_t address = start; address < end; address++) {
+        if (fakeFlash[address] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void waitForFlash(void)
+{
+    while (!flashfsIsReady());
+}
+
+// what the navigation task does while MSP commands wait for the store
+static void waitForWaypointStore(void)
+{
+    while (isWaypointStoreBusy()) {
+        updateWaypointStore();
+    }
+}
+
+static void testWaypoint(int index, navWaypoint_t *waypoint)
+{
+    memset(waypoint, 0, sizeof(*waypoint));
+    waypoint->action = NAV_WP_ACTION_WAYPOINT;
+    waypoint->lat = 500000000 + index * 37;
+    waypoint->lon = 140000000 - index * 53;
+    waypoint->alt = 5000 + index;
+    waypoint->flag = (index == MISSION_WAYPOINTS - 1) ? NAV_WP_FLAG_LAST : 0;
+}
+
+TEST(IoFlashfsUnittest, TestReservedAreaFollowsVolume)
+{
+    resetFakeFlash();
+    EXPECT_EQ(3 * FAKE_FLASH_SECTOR_SIZE, flashfsGetReservedSize());
+    EXPECT_EQ(FAKE_FLASH_SIZE - flashfsGetReservedSize(), flashfsGetSize());
+}
+
+TEST(IoFlashfsUnittest, TestVolumeEraseDuringReservedErase)
+{
+    resetFakeFlash();
+
+    flashfsEraseReserved();
+    EXPECT_FALSE(flashfsIsReady());
+
+    // MSP_DATAFLASH_ERASE arrives before the reserved area is done
+    flashfsEraseCompletely();
+    waitForFlash();
+
+    EXPECT_TRUE(isFlashErased(0, FAKE_FLASH_SIZE));
+}
+
+TEST(IoFlashfsUnittest, TestReservedEraseDuringVolumeErase)
+{
+    resetFakeFlash();
+
+    flashfsEraseCompletely();
+    EXPECT_FALSE(flashfsIsReady());
+
+    flashfsEraseReserved();
+    waitForFlash();
+
+    EXPECT_TRUE(isFlashErased(0, FAKE_FLASH_SIZE));
+}
+
+TEST(IoFlashfsUnittest, TestVolumeEraseKeepsReservedArea)
+{
+    resetFakeFlash();
+
+    flashfsEraseCompletely();
+    waitForFlash();
+
+    EXPECT_TRUE(isFlashErased(0, flashfsGetSize()));
+    EXPECT_EQ(0, fakeFlash[flashfsGetSize()]);
+}
+
+TEST(IoFlashfsUnittest, TestDataflashEraseDuringMissionUpload)
+{
+    navWaypoint_t waypoint;
+    navWaypoint_t stored;
+
+    resetFakeFlash();
+    loadWaypointList();
+
+    // MSP_SET_WP one waypoint at a time, the first one starts erasing the reserved area
+    for (int i = 0; i < MISSION_WAYPOINTS; i++) {
+        testWaypoint(i, &waypoint);
+        waitForWaypointStore();
+        ASSERT_TRUE(appendMissionWaypoint(i, &waypoint));
+
+        if (i == 0) {
+            EXPECT_TRUE(isWaypointStoreBusy());
+            flashfsEraseCompletely();
+        }
+    }
+
+    waitForWaypointStore();
+    EXPECT_TRUE(isWaypointListValid());
+    EXPECT_FALSE(fakeFlashWhileBusy);
+    EXPECT_TRUE(isFlashErased(0, flashfsGetSize()));
+
+    resetMission();
+    loadWaypointList();
+    EXPECT_EQ(MISSION_WAYPOINTS, getWaypointCount());
+    EXPECT_TRUE(isWaypointListValid());
+
+    for (int i = 0; i < MISSION_WAYPOINTS; i++) {
+        testWaypoint(i, &waypoint);
+        ASSERT_TRUE(readMissionWaypoint(i, &stored));
+        EXPECT_EQ(waypoint.lat, stored.lat);
+        EXPECT_EQ(waypoint.lon, stored.lon);
+        EXPECT_EQ(waypoint.alt, stored.alt);
+        EXPECT_EQ(waypoint.flag, stored.flag);
+    }
+}
+
+// STUBS
+
+extern "C" {
+uint8_t armingFlags;
+navigationPosControl_t posControl;
+
+static flashGeometry_t fakeGeometry = {
+    .sectors = FAKE_FLASH_SECTORS,
+    .pagesPerSector = FAKE_FLASH_SECTOR_SIZE / FAKE_FLASH_PAGE_SIZE,
+    .pageSize = FAKE_FLASH_PAGE_SIZE,
+    .sectorSize = FAKE_FLASH_SECTOR_SIZE,
+    .totalSize = FAKE_FLASH_SIZE
+};
+
+static uint32_t programAddress;
+
+static void programFakeFlash(uint32_t address, const uint8_t *data, int length)
+{
+    if (fakeFlashBusyPolls > 0) {
+        fakeFlashWhileBusy = true;
+    }
+    for (int i = 0; i < length; i++) {
+        fakeFlash[address + i] &= data[i];
+    }
+}
+
+bool m25p16_init() { return true; }
+const flashGeometry_t* m25p16_getGeometry() { return &fakeGeometry; }
+
+bool m25p16_isReady()
+{
+    if (fakeFlashBusyPolls > 0) {
+        fakeFlashBusyPolls--;
+        return false;
+    }
+    return true;
+}
+
+bool m25p16_waitForReady(uint32_t timeoutMillis)
+{
+    UNUSED(timeoutMillis);
+    fakeFlashBusyPolls = 0;
+    return true;
+}
+
+void m25p16_eraseSector(uint32_t address)
+{
+    if (fakeFlashBusyPolls > 0) {
+        fakeFlashWhileBusy = true;
+    }
+    memset(&fakeFlash[address - address % FAKE_FLASH_SECTOR_SIZE], 0xFF, FAKE_FLASH_SECTOR_SIZE);
+    fakeFlashBusyPolls = FAKE_FLASH_ERASE_POLLS;
+}
+
+void m25p16_eraseCompletely()
+{
+    memset(fakeFlash, 0xFF, sizeof(fakeFlash));
+    fakeFlashBusyPolls = FAKE_FLASH_ERASE_POLLS * FAKE_FLASH_SECTORS;
+}
+
+void m25p16_pageProgram(uint32_t address, const uint8_t *data, int length)
+{
+    programFakeFlash(address, data, length);
+}
+
+void m25p16_pageProgramBegin(uint32_t address) { programAddress = address; }
+
+void m25p16_pageProgramContinue(const uint8_t *data, int length)
+{
+    programFakeFlash(programAddress, data, length);
+    programAddress += length;
+}
+
+void m25p16_pageProgramFinish() {}
+
+int m25p16_readBytes(uint32_t address, uint8_t *buffer, int length)
+{
+    if (fakeFlashBusyPolls > 0) {
+        fakeFlashWhileBusy = true;
+    }
+    memcpy(buffer, &fakeFlash[address], length);
+    return length;
+}
+}
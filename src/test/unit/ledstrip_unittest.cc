@@ -421,4 +421,7 @@ int scaleRange(int x, int srcMin, int srcMax, int destMin, int destMax) {
 bool failsafeIsActive() { return false; }
 bool rxIsReceivingSignal() { return true; }
 
+bool isTaskTimeSliceExpired(void) { return false; }
+void taskYield(void) {}
+
 }
@@ -0,0 +1,174 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/utils.h"
+
+    #include "drivers/gyro_sync.h"
+
+    #include "scheduler/scheduler.h"
+
+    #include "config/runtime_config.h"
+
+    #include "flight/looptime_governor.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define BASE_LOOPTIME   1000
+
+static uint32_t simulatedTime;
+
+static void resetGovernor(bool enabled)
+{
+    simulatedTime = 0;
+    schedulerInit();
+    rescheduleTask(TASK_GYROPID, BASE_LOOPTIME);
+    armingFlags = 0;
+    averageSystemLoadPercent = 0;
+    cfTasks[TASK_GYROPID].averageExecutionTime = 300;
+    targetLooptime = BASE_LOOPTIME;
+    looptimeGovernorInit(enabled, BASE_LOOPTIME);
+    looptimeGovernorUpdate(simulatedTime);
+}
+
+// Feed the governor once per loop for the given number of evaluation windows
+static void runGovernor(uint16_t systemLoadPercent, int evaluations)
+{
+    averageSystemLoadPercent = systemLoadPercent;
+    const uint32_t endTime = simulatedTime + evaluations * LOOPTIME_GOVERNOR_EVALUATION_INTERVAL;
+    while (cmp32(simulatedTime, endTime) < 0) {
+        simulatedTime += targetLooptime;
+        looptimeGovernorUpdate(simulatedTime);
+    }
+}
+
+TEST(LooptimeGovernorUnittest, TestDisabledGovernorKeepsLooptime)
+{
+    resetGovernor(false);
+
+    runGovernor(300, 10);
+
+    EXPECT_EQ(1, looptimeGovernorGetDivider());
+    EXPECT_EQ(BASE_LOOPTIME, targetLooptime);
+    EXPECT_EQ(BASE_LOOPTIME, cfTasks[TASK_GYROPID].desiredPeriod);
+}
+
+TEST(LooptimeGovernorUnittest, TestOverloadSlowsDownLoop)
+{
+    resetGovernor(true);
+
+    runGovernor(100, 1);
+    EXPECT_EQ(2, looptimeGovernorGetDivider());
+    EXPECT_EQ(2 * BASE_LOOPTIME, targetLooptime);
+    EXPECT_EQ(2 * BASE_LOOPTIME, cfTasks[TASK_GYROPID].desiredPeriod);
+
+    // divider saturates at the slowest rate
+    runGovernor(300, 20);
+    EXPECT_EQ(8, looptimeGovernorGetDivider());
+    EXPECT_EQ(8 * BASE_LOOPTIME, targetLooptime);
+}
+
+TEST(LooptimeGovernorUnittest, TestQuietSystemSpeedsUpAfterSeveralWindows)
+{
+    resetGovernor(true);
+
+    runGovernor(150, 2);
+    EXPECT_EQ(3, looptimeGovernorGetDivider());
+
+    // moderate load neither speeds up nor slows down
+    runGovernor(LOOPTIME_GOVERNOR_LOAD_LOW, 10);
+    EXPECT_EQ(3, looptimeGovernorGetDivider());
+
+    runGovernor(10, LOOPTIME_GOVERNOR_SPEEDUP_EVALUATIONS - 1);
+    EXPECT_EQ(3, looptimeGovernorGetDivider());
+    runGovernor(10, 1);
+    EXPECT_EQ(2, looptimeGovernorGetDivider());
+    EXPECT_EQ(2 * BASE_LOOPTIME, cfTasks[TASK_GYROPID].desiredPeriod);
+
+    runGovernor(10, LOOPTIME_GOVERNOR_SPEEDUP_EVALUATIONS);
+    EXPECT_EQ(1, looptimeGovernorGetDivider());
+    EXPECT_EQ(BASE_LOOPTIME, targetLooptime);
+}
+
+TEST(LooptimeGovernorUnittest, TestSpeedUpRequiresPidHeadroom)
+{
+    resetGovernor(true);
+
+    runGovernor(150, 1);
+    EXPECT_EQ(2, looptimeGovernorGetDivider());
+
+    // PID loop would use more than LOOPTIME_GOVERNOR_PID_HEADROOM percent of the base looptime
+    cfTasks[TASK_GYROPID].averageExecutionTime = BASE_LOOPTIME * LOOPTIME_GOVERNOR_PID_HEADROOM / 100 + 1;
+    runGovernor(10, 4 * LOOPTIME_GOVERNOR_SPEEDUP_EVALUATIONS);
+    EXPECT_EQ(2, looptimeGovernorGetDivider());
+
+    cfTasks[TASK_GYROPID].averageExecutionTime = BASE_LOOPTIME * LOOPTIME_GOVERNOR_PID_HEADROOM / 100;
+    runGovernor(10, LOOPTIME_GOVERNOR_SPEEDUP_EVALUATIONS);
+    EXPECT_EQ(1, looptimeGovernorGetDivider());
+}
+
+TEST(LooptimeGovernorUnittest, TestLooptimeFrozenWhileArmed)
+{
+    resetGovernor(true);
+
+    ENABLE_ARMING_FLAG(ARMED);
+    runGovernor(300, 10);
+    EXPECT_EQ(1, looptimeGovernorGetDivider());
+    EXPECT_EQ(BASE_LOOPTIME, cfTasks[TASK_GYROPID].desiredPeriod);
+
+    // load measured while armed is discarded, a full window is measured after disarming
+    DISABLE_ARMING_FLAG(ARMED);
+    averageSystemLoadPercent = 0;
+    looptimeGovernorUpdate(simulatedTime);
+    runGovernor(300, 1);
+    EXPECT_EQ(2, looptimeGovernorGetDivider());
+}
+
+// STUBS
+
+extern "C" {
+uint32_t targetLooptime;
+uint8_t armingFlags;
+
+cfTask_t * unittest_scheduler_selectedTask;
+uint8_t unittest_scheduler_selectedTaskDynPrio;
+uint16_t unittest_scheduler_waitingTasks;
+uint32_t unittest_scheduler_timeToNextRealtimeTask;
+bool unittest_outsideRealtimeGuardInterval;
+
+uint32_t micros(void) { return simulatedTime; }
+
+void taskMainPidLoopChecker(void) {}
+void taskHandleSerial(void) {}
+void taskUpdateBeeper(void) {}
+void taskUpdateBattery(void) {}
+bool taskUpdateRxCheck(uint32_t currentDeltaTime) { UNUSED(currentDeltaTime); return false; }
+void taskUpdateRxMain(void) {}
+void taskProcessGPS(void) {}
+void taskUpdateCompass(void) {}
+void taskUpdateBaro(void) {}
+void taskUpdateSonar(void) {}
+void taskUpdateDisplay(void) {}
+void taskTelemetry(void) {}
+void taskLedStrip(void) {}
+}
@@ -21,14 +21,17 @@
 #include <limits.h>
 
 #include <math.h>
+#include <stdio.h>
 
 #define BARO
 
 extern "C" {
+    #include "common/axis.h"
     #include "common/maths.h"
 }
 
 #include "unittest_macros.h"
+#include "unittest_benchmark.h"
 #include "gtest/gtest.h"
 
 TEST(MathsUnittest, TestConstrain)
@@ -148,6 +151,87 @@ TEST(MathsUnittest, TestRotateVectorAroundAxis)
     expectVectorsAreEqual(&vector, &expected_result);
 }
 
+#define TRIG_TEST_POINTS        1000000
+#define TRIG_BENCHMARK_SAMPLES  1000000
+
+// two turns, [-2 * PI; 2 * PI)
+static float benchmarkAngle(int sample)
+{
+    return sample * (4.0f * M_PIf / TRIG_BENCHMARK_SAMPLES) - 2.0f * M_PIf;
+}
+
+static double maxTrigError(const float *sinResult, const float *cosResult)
+{
+    double maxError = 0;
+    for (int i = 0; i < TRIG_BENCHMARK_SAMPLES; i++) {
+        const double x = benchmarkAngle(i);
+        maxError = fmax(maxError, fabs(sinResult[i] - sin(x)));
+        maxError = fmax(maxError, fabs(cosResult[i] - cos(x)));
+    }
+    return maxError;
+}
+
+// Every TRIG_TEST_POINTS-th of a turn over [-2 * PI; 2 * PI], compared to double precision
+TEST(MathsUnittest, TestTableTrigonometryErrorBounds)
+{
+    const trigAccuracy_e tiers[] = { TRIG_ACCURACY_LOW, TRIG_ACCURACY_MEDIUM, TRIG_ACCURACY_HIGH };
+    const double bounds[] = { 3.1e-4, 2.5e-6, 1.5e-7 };
+
+    for (unsigned tier = 0; tier < sizeof(tiers) / sizeof(tiers[0]); tier++) {
+        double maxError = 0;
+        for (int i = -TRIG_TEST_POINTS; i <= TRIG_TEST_POINTS; i++) {
+            const float x = (float)(2 * M_PI * i / TRIG_TEST_POINTS);
+            float sinx, cosx;
+            sincos_table(x, &sinx, &cosx, tiers[tier]);
+            maxError = fmax(maxError, fabs(sinx - sin((double)x)));
+            maxError = fmax(maxError, fabs(cosx - cos((double)x)));
+        }
+        EXPECT_LE(maxError, bounds[tier]);
+    }
+}
+
+TEST(MathsUnittest, TestTableTrigonometrySinCos)
+{
+    float sinx, cosx;
+
+    sincos_approx(0.0f, &sinx, &cosx);
+    EXPECT_EQ(0.0f, sinx);
+    EXPECT_EQ(1.0f, cosx);
+
+    sincos_approx(-3 * M_PIf / 4, &sinx, &cosx);
+    EXPECT_NEAR(-0.707106781f, sinx, 1e-6);
+    EXPECT_NEAR(-0.707106781f, cosx, 1e-6);
+
+    sincos_approx(2 * M_PIf + M_PIf / 2, &sinx, &cosx);
+    EXPECT_NEAR(1.0f, sinx, 1e-6);
+    EXPECT_NEAR(0.0f, cosx, 1e-6);
+
+    const float angles[3] = { 0.1f, -1.2f, 3.0f };
+    float sinAngles[3], cosAngles[3];
+    sincos_approx3(angles, sinAngles, cosAngles);
+    for (int i = 0; i < 3; i++) {
+        sincos_approx(angles[i], &sinx, &cosx);
+        EXPECT_EQ(sinx, sinAngles[i]);
+        EXPECT_EQ(cosx, cosAngles[i]);
+    }
+}
+
+TEST(MathsUnittest, TestBuildRotationMatrixIsOrthonormal)
+{
+    fp_angles_t angles = {.raw={0.3f, -0.7f, 2.5f}};
+    float matrix[3][3];
+
+    buildRotationMatrix(&angles, matrix);
+
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            const float dot = matrix[i][0] * matrix[j][0] + matrix[i][1] * matrix[j][1] + matrix[i][2] * matrix[j][2];
+            EXPECT_NEAR(i == j ? 1.0f : 0.0f, dot, 1e-6);
+        }
+    }
+    EXPECT_NEAR(sinf(-0.7f), matrix[0][Z], 1e-6);
+}
+
 #if defined(FAST_MATH) || defined(VERY_FAST_MATH)
 TEST(MathsUnittest, TestFastTrigonometrySinCos)
 {
@@ -201,12 +285,68 @@ TEST(MathsUnittest, TestFastTrigonometryACos)
     EXPECT_NEAR(acos_approx(-0.707106781f), 3 * M_PIf / 4, 1e-4);
 }
 
+// Documented worst case errors of the polynomial approximations, checked over their whole input range
+TEST(MathsUnittest, TestFastTrigonometryErrorBounds)
+{
+    double sinError = 0;
+    double atan2Error = 0;
+    double acosError = 0;
+
+    for (int i = -TRIG_TEST_POINTS; i <= TRIG_TEST_POINTS; i++) {
+        const float x = (float)(2 * M_PI * i / TRIG_TEST_POINTS);
+        sinError = fmax(sinError, fabs(sin_approx(x) - sin((double)x)));
+        sinError = fmax(sinError, fabs(cos_approx(x) - cos((double)x)));
+
+        const float dy = sinf(x / 2);
+        const float dx = cosf(x / 2);
+        double error = fabs(atan2_approx(dy, dx) - atan2((double)dy, (double)dx));
+        atan2Error = fmax(atan2Error, fmin(error, 2 * M_PI - error));
+
+        const float c = (float)i / TRIG_TEST_POINTS;
+        acosError = fmax(acosError, fabs(acos_approx(c) - acos((double)c)));
+    }
+
+#if defined(FAST_MATH)
+    EXPECT_LE(sinError, 2.6e-7);
+#endif
+    EXPECT_LE(atan2Error, 6.7e-7);
+    EXPECT_LE(acosError, 6.8e-5);
+}
+
+// Reports host timings of a sin/cos pair from the polynomial and from the table, checks that every timed result is
+// within the error bound of its implementation
+TEST(MathsUnittest, BenchmarkSinCosAgainstPolynomial)
+{
+    static float sinResult[TRIG_BENCHMARK_SAMPLES];
+    static float cosResult[TRIG_BENCHMARK_SAMPLES];
+    const trigAccuracy_e tiers[] = { TRIG_ACCURACY_LOW, TRIG_ACCURACY_MEDIUM, TRIG_ACCURACY_HIGH };
+    const char *tierNames[] = { "table_low", "table_medium", "table_high" };
+    const double tableBounds[] = { 3.1e-4, 2.5e-6, 1.5e-7 };
+
+    const double polynomialTime = unittestNanosecondsPerSample(TRIG_BENCHMARK_SAMPLES, [](int i) {
+        const float x = benchmarkAngle(i);
+        sinResult[i] = sin_approx(x);
+        cosResult[i] = cos_approx(x);
+    });
+    unittestReportBenchmark("polynomial", polynomialTime);
+    EXPECT_LE(maxTrigError(sinResult, cosResult), 2.6e-7);
+
+    for (unsigned tier = 0; tier < sizeof(tiers) / sizeof(tiers[0]); tier++) {
+        const trigAccuracy_e accuracy = tiers[tier];
+        const double tableTime = unittestNanosecondsPerSample(TRIG_BENCHMARK_SAMPLES, [accuracy](int i) {
+            sincos_table(benchmarkAngle(i), &sinResult[i], &cosResult[i], accuracy);
+        });
+        unittestReportBenchmark(tierNames[tier], tableTime);
+        EXPECT_LE(maxTrigError(sinResult, cosResult), tableBounds[tier]);
+    }
+}
+
 TEST(MathsUnittest, TestSensorScaleUnitTest)
 {
     sensorCalibrationState_t calState;
     float result[3];
 
-    int16_t samples[6][3] = {
+    int32_t samples[6][3] = {
         {  2896,  2896,      0 },
         { -2897,  2896,      0 },
         {     0,  4096,      0 },
@@ -0,0 +1,417 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/axis.h"
+    #include "common/maths.h"
+
+    #include "drivers/sensor.h"
+    #include "drivers/flash.h"
+
+    #include "sensors/sensors.h"
+
+    #include "io/gps.h"
+
+    #include "flight/imu.h"
+    #include "flight/navigation_rewrite.h"
+    #include "flight/navigation_rewrite_private.h"
+
+    #include "config/runtime_config.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+// Small NOR flash: programming can only clear bits, erasing sets a whole sector back to 0xFF
+#define FAKE_FLASH_PAGE_SIZE    256
+#define FAKE_FLASH_SECTOR_SIZE  4096
+#define FAKE_FLASH_SIZE         (16 * FAKE_FLASH_SECTOR_SIZE)
+#define FAKE_FLASH_RESERVED     (3 * FAKE_FLASH_SECTOR_SIZE)
+
+#define BATCH_SIZE              12
+#define SURVEY_WAYPOINTS        600
+
+static uint8_t fakeFlash[FAKE_FLASH_SIZE];
+static int fakeFlashReads;
+static bool fakeFlashReadFails;
+static bool fakeFlashWhileBusy;   // accessed while an erase was in progress
+static uint32_t fakeFlashReserved;
+static int fakeFlashBusyPolls;     // the chip reports busy this many more times
+
+static uint32_t crc32Reference(const uint8_t *data, uint32_t length)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+static void packTestWaypoint(int index, uint8_t *record)
+{
+    const int32_t lat = 500000000 + index * 37;
+    const int32_t lon = 140000000 - index * 53;
+    const int32_t alt = 5000 + index;
+    const int16_t speed = 300 + index % 7;
+
+    memset(record, 0, NAV_WAYPOINT_RECORD_SIZE);
+    record[0] = NAV_WP_ACTION_WAYPOINT;
+    memcpy(&record[1], &lat, 4);
+    memcpy(&record[5], &lon, 4);
+    memcpy(&record[9], &alt, 4);
+    memcpy(&record[13], &speed, 2);
+}
+
+static uint8_t surveyRecords[SURVEY_WAYPOINTS * NAV_WAYPOINT_RECORD_SIZE];
+
+static void resetFakeFlash(void)
+{
+    // not erased, the store has to erase before programming
+    memset(fakeFlash, 0x00, sizeof(fakeFlash));
+    fakeFlashReads = 0;
+    fakeFlashReadFails = false;
+    fakeFlashWhileBusy = false;
+    fakeFlashReserved = FAKE_FLASH_RESERVED;
+    fakeFlashBusyPolls = 0;
+    armingFlags = 0;
+
+    for (int i = 0; i < SURVEY_WAYPOINTS; i++) {
+        packTestWaypoint(i, &surveyRecords[i * NAV_WAYPOINT_RECORD_SIZE]);
+    }
+
+    loadWaypointList();
+}
+
+// what the navigation task does while MSP commands wait for the store
+static void waitForWaypointStore(void)
+{
+    while (isWaypointStoreBusy()) {
+        updateWaypointStore();
+    }
+}
+
+static bool uploadSurvey(int waypointCount)
+{
+    for (int startIndex = 0; startIndex < waypointCount; startIndex += BATCH_SIZE) {
+        const int count = MIN(BATCH_SIZE, waypointCount - startIndex);
+        waitForWaypointStore();
+        if (!setWaypointRecords(startIndex, count, &surveyRecords[startIndex * NAV_WAYPOINT_RECORD_SIZE])) {
+            return false;
+        }
+    }
+
+    waitForWaypointStore();
+    return finishWaypointUpload(waypointCount, crc32Reference(surveyRecords, waypointCount * NAV_WAYPOINT_RECORD_SIZE));
+}
+
+TEST(NavigationMissionUnittest, TestCrcReference)
+{
+    EXPECT_EQ(0xCBF43926, crc32Reference((const uint8_t *)"123456789", 9));
+}
+
+TEST(NavigationMissionUnittest, TestSurveyUploadSurvivesReboot)
+{
+    resetFakeFlash();
+    EXPECT_EQ(0, getWaypointCount());
+    EXPECT_FALSE(isWaypointListValid());
+
+    EXPECT_TRUE(uploadSurvey(SURVEY_WAYPOINTS));
+    EXPECT_EQ(SURVEY_WAYPOINTS, getWaypointCount());
+    EXPECT_TRUE(isWaypointListValid());
+    EXPECT_FALSE(fakeFlashWhileBusy);
+
+    // the blackbox area in front of the mission is left alone
+    for (int i = 0; i < FAKE_FLASH_SIZE - FAKE_FLASH_RESERVED; i++) {
+        ASSERT_EQ(0, fakeFlash[i]);
+    }
+
+    resetMission();
+    loadWaypointList();
+    EXPECT_EQ(SURVEY_WAYPOINTS, getWaypointCount());
+    EXPECT_TRUE(isWaypointListValid());
+
+    uint8_t records[BATCH_SIZE * NAV_WAYPOINT_RECORD_SIZE];
+    for (int startIndex = 0; startIndex < SURVEY_WAYPOINTS; startIndex += BATCH_SIZE) {
+        getWaypointRecords(startIndex, BATCH_SIZE, records);
+        EXPECT_EQ(0, memcmp(records, &surveyRecords[startIndex * NAV_WAYPOINT_RECORD_SIZE], sizeof(records)));
+    }
+
+    navWaypoint_t waypoint;
+    EXPECT_TRUE(readMissionWaypoint(599, &waypoint));
+    EXPECT_EQ(500000000 + 599 * 37, waypoint.lat);
+    EXPECT_EQ(140000000 - 599 * 53, waypoint.lon);
+    EXPECT_EQ(5000 + 599, waypoint.alt);
+    EXPECT_EQ(300 + 599 % 7, waypoint.p1);
+    EXPECT_FALSE(readMissionWaypoint(600, &waypoint));
+}
+
+TEST(NavigationMissionUnittest, TestWrongCrcIsRejected)
+{
+    resetFakeFlash();
+
+    for (int startIndex = 0; startIndex < 48; startIndex += BATCH_SIZE) {
+        waitForWaypointStore();
+        EXPECT_TRUE(setWaypointRecords(startIndex, BATCH_SIZE, &surveyRecords[startIndex * NAV_WAYPOINT_RECORD_SIZE]));
+    }
+    waitForWaypointStore();
+
+    const uint32_t crc = crc32Reference(surveyRecords, 48 * NAV_WAYPOINT_RECORD_SIZE);
+    EXPECT_FALSE(finishWaypointUpload(48, crc ^ 1));
+    EXPECT_FALSE(finishWaypointUpload(47, crc));
+    EXPECT_FALSE(isWaypointListValid());
+
+    resetMission();
+    loadWaypointList();
+    EXPECT_EQ(0, getWaypointCount());
+}
+
+TEST(NavigationMissionUnittest, TestInvalidBatchesAreRejected)
+{
+    resetFakeFlash();
+
+    // must continue right behind the last waypoint
+    EXPECT_FALSE(setWaypointRecords(12, BATCH_SIZE, surveyRecords));
+    EXPECT_TRUE(setWaypointRecords(0, BATCH_SIZE, surveyRecords));
+    waitForWaypointStore();
+    EXPECT_FALSE(setWaypointRecords(13, BATCH_SIZE, &surveyRecords[13 * NAV_WAYPOINT_RECORD_SIZE]));
+
+    EXPECT_FALSE(setWaypointRecords(NAV_MAX_WAYPOINTS - 1, 2, surveyRecords));
+
+    uint8_t record[NAV_WAYPOINT_RECORD_SIZE];
+    packTestWaypoint(12, record);
+    record[0] = 0x7F;
+    EXPECT_FALSE(setWaypointRecords(12, 1, record));
+
+    ENABLE_ARMING_FLAG(ARMED);
+    EXPECT_FALSE(setWaypointRecords(12, BATCH_SIZE, &surveyRecords[12 * NAV_WAYPOINT_RECORD_SIZE]));
+    EXPECT_FALSE(finishWaypointUpload(12, crc32Reference(surveyRecords, 12 * NAV_WAYPOINT_RECORD_SIZE)));
+    DISABLE_ARMING_FLAG(ARMED);
+
+    EXPECT_EQ(12, getWaypointCount());
+    EXPECT_TRUE(finishWaypointUpload(12, crc32Reference(surveyRecords, 12 * NAV_WAYPOINT_RECORD_SIZE)));
+
+    // a finished mission can only be replaced, not extended
+    EXPECT_FALSE(setWaypointRecords(12, BATCH_SIZE, &surveyRecords[12 * NAV_WAYPOINT_RECORD_SIZE]));
+    EXPECT_TRUE(setWaypointRecords(0, 1, surveyRecords));
+    EXPECT_FALSE(isWaypointListValid());
+}
+
+TEST(NavigationMissionUnittest, TestSingleWaypointUploadFinishesOnLastFlag)
+{
+    resetFakeFlash();
+
+    navWaypoint_t waypoint;
+    memset(&waypoint, 0, sizeof(waypoint));
+    waypoint.action = NAV_WP_ACTION_WAYPOINT;
+
+    for (int i = 0; i < 5; i++) {
+        waypoint.lat = i;
+        waypoint.flag = (i == 4) ? NAV_WP_FLAG_LAST : 0;
+        waitForWaypointStore();
+        EXPECT_TRUE(appendMissionWaypoint(i, &waypoint));
+        waitForWaypointStore();
+        EXPECT_EQ(i == 4, isWaypointListValid());
+    }
+
+    resetMission();
+    loadWaypointList();
+    EXPECT_EQ(5, getWaypointCount());
+    EXPECT_TRUE(isWaypointListValid());
+    EXPECT_EQ(NAV_WP_FLAG_LAST, getMissionWaypoint(4)->flag);
+    EXPECT_EQ(3, getMissionWaypoint(3)->lat);
+}
+
+TEST(NavigationMissionUnittest, TestWindowIsReadAheadOfActiveWaypoint)
+{
+    resetFakeFlash();
+    EXPECT_TRUE(uploadSurvey(SURVEY_WAYPOINTS));
+
+    // nothing is read ahead while the blackbox keeps the flash busy
+    getMissionWaypoint(0);
+    fakeFlashReads = 0;
+    fakeFlashBusyPolls = 3;
+    prefetchMissionWaypoints(7);
+    EXPECT_EQ(0, fakeFlashReads);
+    fakeFlashBusyPolls = 0;
+
+    fakeFlashReads = 0;
+    for (int index = 0; index < SURVEY_WAYPOINTS; index++) {
+        // the next waypoint was read while the previous leg was flown
+        const int readsBefore = fakeFlashReads;
+        const navWaypoint_t *waypoint = getMissionWaypoint(index);
+        if (index > 0) {
+            EXPECT_EQ(readsBefore, fakeFlashReads);
+        }
+        EXPECT_EQ(500000000 + index * 37, waypoint->lat);
+
+        for (int update = 0; update < 10; update++) {
+            prefetchMissionWaypoints(index);
+            EXPECT_EQ(500000000 + index * 37, getMissionWaypoint(index)->lat);
+        }
+    }
+
+    // every waypoint is read about once, not on every navigation update
+    EXPECT_LE(fakeFlashReads, SURVEY_WAYPOINTS + SURVEY_WAYPOINTS / 6);
+}
+
+TEST(NavigationMissionUnittest, TestReadFailureFlysHome)
+{
+    resetFakeFlash();
+    EXPECT_TRUE(uploadSurvey(100));
+
+    EXPECT_EQ(NAV_WP_ACTION_WAYPOINT, getMissionWaypoint(50)->action);
+
+    fakeFlashReadFails = true;
+    const navWaypoint_t *waypoint = getMissionWaypoint(90);
+    EXPECT_EQ(NAV_WP_ACTION_RTH, waypoint->action);
+    EXPECT_EQ(NAV_WP_FLAG_LAST, waypoint->flag);
+}
+
+TEST(NavigationMissionUnittest, TestBusyFlashDoesNotFlyHome)
+{
+    resetFakeFlash();
+    EXPECT_TRUE(uploadSurvey(100));
+
+    EXPECT_EQ(500000000 + 50 * 37, getMissionWaypoint(50)->lat);
+
+    // the blackbox keeps the flash busy: the window is still served, a miss is neither read nor turned into RTH
+    fakeFlashReads = 0;
+    fakeFlashBusyPolls = 1000;
+    EXPECT_EQ(500000000 + 51 * 37, getMissionWaypoint(51)->lat);
+    EXPECT_TRUE(getMissionWaypoint(90) == NULL);
+    EXPECT_EQ(0, fakeFlashReads);
+    EXPECT_FALSE(fakeFlashWhileBusy);
+
+    fakeFlashBusyPolls = 0;
+    const navWaypoint_t *waypoint = getMissionWaypoint(90);
+    ASSERT_TRUE(waypoint != NULL);
+    EXPECT_EQ(NAV_WP_ACTION_WAYPOINT, waypoint->action);
+    EXPECT_EQ(500000000 + 90 * 37, waypoint->lat);
+}
+
+TEST(NavigationMissionUnittest, TestUploadDoesNotWaitForErase)
+{
+    resetFakeFlash();
+    EXPECT_TRUE(uploadSurvey(24));
+
+    // the erase is only started, the first batch waits in RAM until it's done
+    EXPECT_TRUE(setWaypointRecords(0, BATCH_SIZE, surveyRecords));
+    EXPECT_TRUE(isWaypointStoreBusy());
+    EXPECT_FALSE(isWaypointListValid());
+    EXPECT_EQ(0, memcmp(&fakeFlash[FAKE_FLASH_SIZE - FAKE_FLASH_RESERVED], "\xFF\xFF\xFF\xFF", 4));
+
+    EXPECT_FALSE(setWaypointRecords(BATCH_SIZE, BATCH_SIZE, &surveyRecords[BATCH_SIZE * NAV_WAYPOINT_RECORD_SIZE]));
+    EXPECT_FALSE(finishWaypointUpload(BATCH_SIZE, crc32Reference(surveyRecords, BATCH_SIZE * NAV_WAYPOINT_RECORD_SIZE)));
+
+    updateWaypointStore();
+    EXPECT_TRUE(isWaypointStoreBusy());
+
+    waitForWaypointStore();
+    EXPECT_TRUE(finishWaypointUpload(BATCH_SIZE, crc32Reference(surveyRecords, BATCH_SIZE * NAV_WAYPOINT_RECORD_SIZE)));
+
+    // a single waypoint mission is committed once its waypoint is programmed
+    navWaypoint_t waypoint;
+    memset(&waypoint, 0, sizeof(waypoint));
+    waypoint.action = NAV_WP_ACTION_RTH;
+    waypoint.flag = NAV_WP_FLAG_LAST;
+    EXPECT_TRUE(appendMissionWaypoint(0, &waypoint));
+    EXPECT_FALSE(isWaypointListValid());
+    waitForWaypointStore();
+    EXPECT_TRUE(isWaypointListValid());
+    EXPECT_EQ(1, getWaypointCount());
+    EXPECT_FALSE(fakeFlashWhileBusy);
+}
+
+TEST(NavigationMissionUnittest, TestShortMissionInRamWithoutDataflash)
+{
+    resetFakeFlash();
+    fakeFlashReserved = 0;
+    loadWaypointList();
+    fakeFlashReads = 0;
+
+    EXPECT_FALSE(uploadSurvey(NAV_MAX_RAM_WAYPOINTS + 1));
+    EXPECT_TRUE(uploadSurvey(NAV_MAX_RAM_WAYPOINTS));
+    EXPECT_EQ(NAV_MAX_RAM_WAYPOINTS, getWaypointCount());
+    EXPECT_TRUE(isWaypointListValid());
+    EXPECT_EQ(0, fakeFlashReads);
+}
+
+// STUBS
+
+extern "C" {
+uint8_t armingFlags;
+navigationPosControl_t posControl;
+
+static flashGeometry_t fakeGeometry = {
+    .sectors = FAKE_FLASH_SIZE / FAKE_FLASH_SECTOR_SIZE,
+    .pagesPerSector = FAKE_FLASH_SECTOR_SIZE / FAKE_FLASH_PAGE_SIZE,
+    .pageSize = FAKE_FLASH_PAGE_SIZE,
+    .sectorSize = FAKE_FLASH_SECTOR_SIZE,
+    .totalSize = FAKE_FLASH_SIZE
+};
+
+const flashGeometry_t* flashfsGetGeometry() { return &fakeGeometry; }
+uint32_t flashfsGetReservedSize() { return fakeFlashReserved; }
+uint32_t flashfsGetSize() { return FAKE_FLASH_SIZE - fakeFlashReserved; }
+
+bool flashfsIsReady()
+{
+    if (fakeFlashBusyPolls > 0) {
+        fakeFlashBusyPolls--;
+        return false;
+    }
+    return true;
+}
+
+void flashfsEraseReserved()
+{
+    memset(&fakeFlash[FAKE_FLASH_SIZE - fakeFlashReserved], 0xFF, fakeFlashReserved);
+    fakeFlashBusyPolls = 5;
+}
+
+int flashfsWriteReserved(uint32_t offset, const uint8_t *data, unsigned int len)
+{
+    if (fakeFlashBusyPolls > 0) {
+        fakeFlashWhileBusy = true;
+    }
+    for (unsigned i = 0; i < len; i++) {
+        fakeFlash[FAKE_FLASH_SIZE - fakeFlashReserved + offset + i] &= data[i];
+    }
+    return len;
+}
+
+int flashfsReadReserved(uint32_t offset, uint8_t *buffer, unsigned int len)
+{
+    if (fakeFlashReadFails) {
+        return 0;
+    }
+    if (fakeFlashBusyPolls > 0) {
+        fakeFlashWhileBusy = true;
+    }
+    fakeFlashReads++;
+    memcpy(buffer, &fakeFlash[FAKE_FLASH_SIZE - fakeFlashReserved + offset], len);
+    return len;
+}
+}
@@ -0,0 +1,231 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <math.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/axis.h"
+    #include "common/maths.h"
+
+    #include "flight/navigation_rewrite_pos_ekf.h"
+}
+
+#include "unittest_macros.h"
+#include "unittest_random.h"
+#include "gtest/gtest.h"
+
+#define LOOP_RATE_HZ        100
+#define LOOP_DT             (1.0f / LOOP_RATE_HZ)
+#define BARO_DIVIDER        (LOOP_RATE_HZ / 20)
+#define GPS_DIVIDER         (LOOP_RATE_HZ / 5)
+#define GPS_DELAY_LOOPS     (LOOP_RATE_HZ / 5)      // 200ms
+#define BARO_SD             100.0f
+#define GPS_SD              200.0f
+
+static float pos[XYZ_AXIS_COUNT];
+static float vel[XYZ_AXIS_COUNT];
+
+static void resetEstimator(void)
+{
+    unittestRandomSeed(2463534242U);
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        pos[axis] = 0;
+        vel[axis] = 0;
+    }
+    navEkfInit();
+}
+
+TEST(NavigationPosEkfUnittest, TestAccelBiasLearnedFromBaro)
+{
+    resetEstimator();
+
+    // hovering, accelerometer reads 30cm/s^2 too much, baro is noisy
+    for (int i = 0; i < 120 * LOOP_RATE_HZ; i++) {
+        const float accel[XYZ_AXIS_COUNT] = { 0, 0, 30.0f + unittestGaussian(20.0f) };
+        navEkfPredict(pos, vel, accel, LOOP_DT);
+
+        if (i % BARO_DIVIDER == 0) {
+            navEkfFusePosition(pos, vel, Z, 500.0f + unittestGaussian(BARO_SD) - pos[Z], sq(BARO_SD));
+        }
+    }
+
+    const navEkfStatus_t *status = navEkfGetStatus();
+    EXPECT_NEAR(30.0f, status->accelBias[Z], 5.0f);
+    EXPECT_NEAR(500.0f, pos[Z], 50.0f);
+    EXPECT_NEAR(0.0f, vel[Z], 20.0f);
+
+    // estimated error must be smaller than the baro error, but not overconfident
+    EXPECT_LT(status->posStdDev[Z], BARO_SD);
+    EXPECT_GT(status->posStdDev[Z], 5.0f);
+}
+
+// Accelerates along X, GPS reports the position and velocity of GPS_DELAY_LOOPS ago. Returns the largest position error.
+static float runDelayedGps(bool compensateDelay)
+{
+    float truePos[GPS_DELAY_LOOPS + 1] = { 0 };
+    float trueVel[GPS_DELAY_LOOPS + 1] = { 0 };
+    float estPos[GPS_DELAY_LOOPS + 1] = { 0 };
+    float estVel[GPS_DELAY_LOOPS + 1] = { 0 };
+    float maxError = 0;
+
+    resetEstimator();
+
+    for (int i = 0; i < 20 * LOOP_RATE_HZ; i++) {
+        const float trueAccel = (i % (8 * LOOP_RATE_HZ) < 2 * LOOP_RATE_HZ) ? 300.0f : ((i % (8 * LOOP_RATE_HZ) < 4 * LOOP_RATE_HZ) ? -300.0f : 0.0f);
+
+        // history rings, index 0 is the current sample
+        for (int n = GPS_DELAY_LOOPS; n > 0; n--) {
+            truePos[n] = truePos[n - 1];
+            trueVel[n] = trueVel[n - 1];
+            estPos[n] = estPos[n - 1];
+            estVel[n] = estVel[n - 1];
+        }
+        truePos[0] += trueVel[0] * LOOP_DT + trueAccel * 0.5f * sq(LOOP_DT);
+        trueVel[0] += trueAccel * LOOP_DT;
+
+        const float accel[XYZ_AXIS_COUNT] = { trueAccel + unittestGaussian(20.0f), 0, 0 };
+        navEkfPredict(pos, vel, accel, LOOP_DT);
+
+        if (i % GPS_DIVIDER == 0 && i >= GPS_DELAY_LOOPS) {
+            const float gpsPos = truePos[GPS_DELAY_LOOPS] + unittestGaussian(50.0f);
+            const float gpsVel = trueVel[GPS_DELAY_LOOPS] + unittestGaussian(20.0f);
+            const float refPos = compensateDelay ? estPos[GPS_DELAY_LOOPS] : pos[X];
+            const float refVel = compensateDelay ? estVel[GPS_DELAY_LOOPS] : vel[X];
+            navEkfFusePosition(pos, vel, X, gpsPos - refPos, sq(GPS_SD));
+            navEkfFuseVelocity(pos, vel, X, gpsVel - refVel, sq(NAV_EKF_GPS_VEL_NOISE));
+        }
+
+        estPos[0] = pos[X];
+        estVel[0] = vel[X];
+
+        if (i > 5 * LOOP_RATE_HZ) {
+            maxError = MAX(maxError, fabsf(pos[X] - truePos[0]));
+        }
+    }
+
+    return maxError;
+}
+
+TEST(NavigationPosEkfUnittest, TestDelayedGpsCompensation)
+{
+    const float compensatedError = runDelayedGps(true);
+    const float uncompensatedError = runDelayedGps(false);
+
+    EXPECT_LT(compensatedError, 150.0f);
+    EXPECT_LT(compensatedError, uncompensatedError * 0.5f);
+}
+
+static void fuseStillGps(float offset)
+{
+    for (int i = 0; i < GPS_DIVIDER; i++) {
+        const float accel[XYZ_AXIS_COUNT] = { unittestGaussian(10.0f), unittestGaussian(10.0f), 0 };
+        navEkfPredict(pos, vel, accel, LOOP_DT);
+    }
+    navEkfFusePosition(pos, vel, X, offset + unittestGaussian(GPS_SD * 0.3f) - pos[X], sq(GPS_SD));
+    navEkfFuseVelocity(pos, vel, X, unittestGaussian(NAV_EKF_GPS_VEL_NOISE * 0.3f) - vel[X], sq(NAV_EKF_GPS_VEL_NOISE));
+}
+
+TEST(NavigationPosEkfUnittest, TestGpsGlitchRejected)
+{
+    resetEstimator();
+
+    for (int i = 0; i < 100; i++) {
+        fuseStillGps(0);
+    }
+    EXPECT_NEAR(0.0f, pos[X], 150.0f);
+
+    // single 50m jump is rejected
+    const uint16_t rejectedBefore = navEkfGetStatus()->rejectedMeasurements;
+    EXPECT_FALSE(navEkfFusePosition(pos, vel, X, 5000.0f - pos[X], sq(GPS_SD)));
+    EXPECT_EQ(rejectedBefore + 1, navEkfGetStatus()->rejectedMeasurements);
+    EXPECT_NEAR(0.0f, pos[X], 150.0f);
+
+    for (int i = 0; i < 10; i++) {
+        fuseStillGps(0);
+    }
+    EXPECT_NEAR(0.0f, pos[X], 150.0f);
+}
+
+TEST(NavigationPosEkfUnittest, TestPersistentOffsetResetsAxis)
+{
+    resetEstimator();
+
+    for (int i = 0; i < 100; i++) {
+        fuseStillGps(0);
+    }
+
+    // position really moved, after NAV_EKF_REJECT_RESET_COUNT rejections the estimate follows
+    const uint16_t resetsBefore = navEkfGetStatus()->axisResets;
+    for (int i = 0; i < NAV_EKF_REJECT_RESET_COUNT + 20; i++) {
+        fuseStillGps(50000.0f);
+    }
+    EXPECT_EQ(resetsBefore + 1, navEkfGetStatus()->axisResets);
+    EXPECT_NEAR(50000.0f, pos[X], 150.0f);
+}
+
+TEST(NavigationPosEkfUnittest, TestVarianceFollowsAiding)
+{
+    resetEstimator();
+
+    EXPECT_FLOAT_EQ(sq(NAV_EKF_POS_INITIAL_SD), navEkfGetPositionVariance(X));
+
+    for (int i = 0; i < 50; i++) {
+        fuseStillGps(0);
+    }
+    const float aidedVariance = navEkfGetPositionVariance(X);
+    EXPECT_LT(aidedVariance, sq(GPS_SD));
+
+    // GPS lost, variance grows and stops at the limit
+    float previousVariance = aidedVariance;
+    for (int i = 0; i < 600 * LOOP_RATE_HZ; i++) {
+        const float accel[XYZ_AXIS_COUNT] = { 0, 0, 0 };
+        navEkfPredict(pos, vel, accel, LOOP_DT);
+        EXPECT_GE(navEkfGetPositionVariance(X), previousVariance);
+        previousVariance = navEkfGetPositionVariance(X);
+    }
+    EXPECT_FLOAT_EQ(NAV_EKF_POS_VARIANCE_MAX, navEkfGetPositionVariance(X));
+
+    // unaided axis takes the next measurement at once
+    EXPECT_TRUE(navEkfFusePosition(pos, vel, X, 3000.0f - pos[X], sq(GPS_SD)));
+    EXPECT_NEAR(3000.0f, pos[X], 100.0f);
+}
+
+TEST(NavigationPosEkfUnittest, TestCovarianceStaysSymmetricPositive)
+{
+    resetEstimator();
+
+    for (int i = 0; i < 60 * LOOP_RATE_HZ; i++) {
+        const float accel[XYZ_AXIS_COUNT] = { unittestGaussian(50.0f), unittestGaussian(50.0f), unittestGaussian(50.0f) };
+        navEkfPredict(pos, vel, accel, LOOP_DT);
+        if (i % GPS_DIVIDER == 0) {
+            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+                navEkfFusePosition(pos, vel, axis, unittestGaussian(GPS_SD) - pos[axis], sq(GPS_SD));
+                navEkfFuseVelocity(pos, vel, axis, unittestGaussian(NAV_EKF_GPS_VEL_NOISE) - vel[axis], sq(NAV_EKF_GPS_VEL_NOISE));
+            }
+        }
+    }
+
+    const navEkfStatus_t *status = navEkfGetStatus();
+    EXPECT_EQ(0, status->axisResets);
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        EXPECT_TRUE(status->posStdDev[axis] > 0 && status->posStdDev[axis] < GPS_SD);
+        EXPECT_TRUE(status->velStdDev[axis] > 0 && status->velStdDev[axis] < NAV_EKF_GPS_VEL_NOISE);
+    }
+}
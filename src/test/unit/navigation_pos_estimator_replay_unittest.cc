@@ -0,0 +1,626 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Position estimator replay, runs the real navigation_rewrite_pos_estimator.c against a virtual micros()
+ * and feeds it sensor samples read from a CSV stream, faster than real time.
+ *
+ *   POS_ESTIMATOR_REPLAY=flight.csv POS_ESTIMATOR_REPLAY_OUTPUT=estimate.csv ../../obj/test/navigation_pos_estimator_replay_unittest \
+ *       --gtest_also_run_disabled_tests --gtest_filter=*TestReplayFile
+ *
+ * One sample per line, time in us, lines starting with '#' are ignored:
+ *   <time>,I,<acc x>,<acc y>,<acc z>,<roll>,<pitch>,<yaw>     body frame acceleration (cm/s^2, +1G on Z when level) and
+ *                                                             attitude (decidegrees), runs one estimator update
+ *   <time>,B,<altitude>                                       baro altitude (cm)
+ *   <time>,S,<distance>                                       sonar distance (cm), -1 out of range
+ *   <time>,G,<lat>,<lon>,<alt>,<vel N>,<vel E>,<vel D>,<sats>,<eph>,<epv>
+ *                                                             GPS solution, time is the arrival of its first byte,
+ *                                                             deg * 1e7, cm and cm/s
+ *   <time>,A,<armed>                                          arming state, 0 or 1
+ *   <time>,T,<x>,<y>,<z>                                      true position (cm, NEU from the first GPS fix), optional
+ *
+ * The attitude is replayed instead of the gyro, the estimator only sees the IMU through it and the body frame
+ * acceleration. Output has one line per published estimate: time, position, velocity, EPH and EPV.
+ * POS_ESTIMATOR=EKF selects the Kalman filter estimator. With true positions RMS and max errors are reported.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/axis.h"
+    #include "common/maths.h"
+    #include "common/utils.h"
+
+    #include "drivers/sensor.h"
+
+    #include "sensors/sensors.h"
+    #include "sensors/barometer.h"
+    #include "sensors/sonar.h"
+
+    #include "io/gps.h"
+
+    #include "flight/imu.h"
+    #include "flight/navigation_rewrite.h"
+    #include "flight/navigation_rewrite_private.h"
+
+    #include "config/runtime_config.h"
+}
+
+#include "unittest_macros.h"
+#include "unittest_random.h"
+#include "gtest/gtest.h"
+
+typedef struct {
+    uint32_t updates;
+    uint32_t publishedEstimates;
+    uint32_t truthSamples;
+    double horizontalErrorSquareSum;
+    double verticalErrorSquareSum;
+    float maxHorizontalError;
+    float maxVerticalError;
+    bool isPositionValid;
+    bool isAltitudeValid;
+    float eph;
+    float epv;
+    double updateTimeNs;                // host time spent in updatePositionEstimator()
+} replayResult_t;
+
+// Virtual sensors read by the estimator through the stubs below
+static uint32_t currentTimeUs;
+static uint32_t replayStartTimeUs;      // replay times are relative to this, micros() never goes back between replays
+static uint32_t enabledSensors;
+static int32_t baroAltitude;
+static int32_t sonarDistance;
+static float rMat[3][3];
+
+// Estimate published by the estimator
+static struct {
+    bool updated;
+    bool isPositionValid;
+    bool isAltitudeValid;
+    float pos[XYZ_AXIS_COUNT];
+    float vel[XYZ_AXIS_COUNT];
+} published;
+
+static float truePos[XYZ_AXIS_COUNT];
+static bool hasTruth;
+
+static navConfig_t navConfig;
+
+// Defaults of config.c
+static void resetReplay(navPosEstimator_e estimator)
+{
+    memset(&navConfig, 0, sizeof(navConfig));
+    navConfig.inav.gps_min_sats = 6;
+    navConfig.inav.gps_delay_ms = 100;
+    navConfig.inav.accz_unarmed_cal = 1;
+    navConfig.inav.use_gps_velned = 1;         // G lines carry the receiver velocity
+    navConfig.inav.estimator = estimator;
+    navConfig.inav.w_z_baro_p = 0.35f;
+    navConfig.inav.w_z_gps_p = 0.2f;
+    navConfig.inav.w_z_gps_v = 0.2f;
+    navConfig.inav.w_xy_gps_p = 1.0f;
+    navConfig.inav.w_xy_gps_v = 2.0f;
+    navConfig.inav.w_z_res_v = 0.5f;
+    navConfig.inav.w_xy_res_v = 0.5f;
+    navConfig.inav.w_acc_bias = 0.01f;
+    navConfig.inav.max_eph_epv = 1000.0f;
+    navConfig.inav.baro_epv = 100.0f;
+
+    memset(&posControl, 0, sizeof(posControl));
+    posControl.navConfig = &navConfig;
+
+    memset(&gpsSol, 0, sizeof(gpsSol));
+    memset(&published, 0, sizeof(published));
+    replayStartTimeUs = currentTimeUs + 1000000;
+    currentTimeUs = replayStartTimeUs;
+    enabledSensors = SENSOR_ACC;
+    baroAltitude = 0;
+    sonarDistance = -1;
+    armingFlags = 0;
+    stateFlags = 0;
+    hasTruth = false;
+
+    initializePositionEstimator();
+}
+
+// Same rotation matrix as imuComputeQuaternionFromRPY() and imuComputeRotationMatrix() in imu.c
+static void setAttitude(int16_t roll, int16_t pitch, int16_t yaw)
+{
+    attitude.values.roll = roll;
+    attitude.values.pitch = pitch;
+    attitude.values.yaw = yaw;
+
+    const float cosRoll = cosf(DECIDEGREES_TO_RADIANS(roll) * 0.5f);
+    const float sinRoll = sinf(DECIDEGREES_TO_RADIANS(roll) * 0.5f);
+    const float cosPitch = cosf(DECIDEGREES_TO_RADIANS(pitch) * 0.5f);
+    const float sinPitch = sinf(DECIDEGREES_TO_RADIANS(pitch) * 0.5f);
+    const float cosYaw = cosf(DECIDEGREES_TO_RADIANS(-yaw) * 0.5f);
+    const float sinYaw = sinf(DECIDEGREES_TO_RADIANS(-yaw) * 0.5f);
+
+    const float q0 = cosRoll * cosPitch * cosYaw + sinRoll * sinPitch * sinYaw;
+    const float q1 = sinRoll * cosPitch * cosYaw - cosRoll * sinPitch * sinYaw;
+    const float q2 = cosRoll * sinPitch * cosYaw + sinRoll * cosPitch * sinYaw;
+    const float q3 = cosRoll * cosPitch * sinYaw - sinRoll * sinPitch * cosYaw;
+
+    rMat[0][0] = 1.0f - 2.0f * q2 * q2 - 2.0f * q3 * q3;
+    rMat[0][1] = 2.0f * (q1 * q2 - q0 * q3);
+    rMat[0][2] = 2.0f * (q1 * q3 + q0 * q2);
+    rMat[1][0] = 2.0f * (q1 * q2 + q0 * q3);
+    rMat[1][1] = 1.0f - 2.0f * q1 * q1 - 2.0f * q3 * q3;
+    rMat[1][2] = 2.0f * (q2 * q3 - q0 * q1);
+    rMat[2][0] = 2.0f * (q1 * q3 - q0 * q2);
+    rMat[2][1] = 2.0f * (q2 * q3 + q0 * q1);
+    rMat[2][2] = 1.0f - 2.0f * q1 * q1 - 2.0f * q2 * q2;
+}
+
+static double elapsedNs(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+static void replaySample(char *line, FILE *output, replayResult_t *result)
+{
+    char *type = strchr(line, ',');
+    if (line[0] == '#' || type == NULL) {
+        return;
+    }
+
+    currentTimeUs = replayStartTimeUs + strtoul(line, NULL, 10);
+    double values[10] = { 0 };      // double keeps the 1e-7 degree resolution of coordinates
+    int count = 0;
+    for (char *token = strchr(type + 1, ','); token != NULL && count < 10; token = strchr(token + 1, ',')) {
+        values[count++] = strtod(token + 1, NULL);
+    }
+
+    switch (type[1]) {
+    case 'I': {
+        imuAccelInBodyFrame.V.X = values[0];
+        imuAccelInBodyFrame.V.Y = values[1];
+        imuAccelInBodyFrame.V.Z = values[2];
+        setAttitude(values[3], values[4], values[5]);
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        updatePositionEstimator();
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        result->updateTimeNs += elapsedNs(&start, &end);
+        result->updates++;
+
+        if (published.updated) {
+            published.updated = false;
+            result->publishedEstimates++;
+            result->isPositionValid = published.isPositionValid;
+            result->isAltitudeValid = published.isAltitudeValid;
+            result->eph = getPositionEstimateEPH();
+            result->epv = getPositionEstimateEPV();
+
+            if (hasTruth && published.isPositionValid && published.isAltitudeValid) {
+                const float horizontalError = sqrtf(sq(published.pos[X] - truePos[X]) + sq(published.pos[Y] - truePos[Y]));
+                const float verticalError = fabsf(published.pos[Z] - truePos[Z]);
+                result->truthSamples++;
+                result->horizontalErrorSquareSum += sq(horizontalError);
+                result->verticalErrorSquareSum += sq(verticalError);
+                result->maxHorizontalError = MAX(result->maxHorizontalError, horizontalError);
+                result->maxVerticalError = MAX(result->maxVerticalError, verticalError);
+            }
+
+            if (output) {
+                fprintf(output, "%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n", currentTimeUs - replayStartTimeUs,
+                    published.pos[X], published.pos[Y], published.pos[Z], published.vel[X], published.vel[Y], published.vel[Z],
+                    result->eph, result->epv);
+            }
+        }
+        break;
+    }
+    case 'B':
+        enabledSensors |= SENSOR_BARO;
+        baroAltitude = values[0];
+        break;
+    case 'S':
+        enabledSensors |= SENSOR_SONAR;
+        sonarDistance = values[0];
+        break;
+    case 'G':
+        enabledSensors |= SENSOR_GPS;
+        gpsSol.llh.lat = values[0];
+        gpsSol.llh.lon = values[1];
+        gpsSol.llh.alt = values[2];
+        gpsSol.velNED[X] = values[3];
+        gpsSol.velNED[Y] = values[4];
+        gpsSol.velNED[Z] = values[5];
+        gpsSol.numSat = values[6];
+        gpsSol.eph = values[7];
+        gpsSol.epv = values[8];
+        gpsSol.fixType = GPS_FIX_3D;
+        gpsSol.flags.validVelNE = 1;
+        gpsSol.flags.validVelD = 1;
+        gpsSol.flags.validEPE = 1;
+        gpsSol.arrivalTime = currentTimeUs;
+        ENABLE_STATE(GPS_FIX);
+        onNewGPSData();
+        break;
+    case 'A':
+        if (values[0] > 0) {
+            ENABLE_ARMING_FLAG(ARMED);
+        }
+        else {
+            DISABLE_ARMING_FLAG(ARMED);
+        }
+        break;
+    case 'T':
+        hasTruth = true;
+        truePos[X] = values[0];
+        truePos[Y] = values[1];
+        truePos[Z] = values[2];
+        break;
+    }
+}
+
+static replayResult_t replay(FILE *input, FILE *output)
+{
+    replayResult_t result;
+    char line[256];
+
+    memset(&result, 0, sizeof(result));
+    while (fgets(line, sizeof(line), input)) {
+        replaySample(line, output, &result);
+    }
+
+    return result;
+}
+
+static void printResult(const char *name, const replayResult_t *result)
+{
+    printf("\n%s: %u updates, %.0fns per update\n", name, result->updates, result->updateTimeNs / MAX(result->updates, 1U));
+    printf("final EPH %.0fcm EPV %.0fcm, position %s, altitude %s\n", result->eph, result->epv,
+        result->isPositionValid ? "valid" : "invalid", result->isAltitudeValid ? "valid" : "invalid");
+    if (result->truthSamples) {
+        printf("horizontal error RMS %.0fcm max %.0fcm, vertical error RMS %.0fcm max %.0fcm\n",
+            sqrt(result->horizontalErrorSquareSum / result->truthSamples), result->maxHorizontalError,
+            sqrt(result->verticalErrorSquareSum / result->truthSamples), result->maxVerticalError);
+    }
+}
+
+/*
+ * Synthetic flight for the regression tests: 500Hz IMU, 20Hz baro, 5Hz GPS arriving gpsDelayMs after it measured.
+ * Disarmed for 5s, then flies north and back along a sine, velocity amplitude flightSpeed, climbing to 10m.
+ */
+#define FLIGHT_LOOP_HZ      500
+#define FLIGHT_BARO_HZ      20
+#define FLIGHT_GPS_HZ       5
+#define FLIGHT_ORIGIN_LAT   509102311
+#define FLIGHT_ORIGIN_LON   -15349744
+
+typedef struct {
+    float pos[XYZ_AXIS_COUNT];
+    float vel[XYZ_AXIS_COUNT];
+    float acc[XYZ_AXIS_COUNT];
+} flightState_t;
+
+static void flightStateAt(float t, float flightSpeed, flightState_t *state)
+{
+    const float w = 2 * M_PIf / 20.0f;      // 20s period
+    const float flying = (t > 5.0f) ? 1.0f : 0.0f;
+    const float tf = t - 5.0f;
+
+    memset(state, 0, sizeof(*state));
+    state->pos[X] = flying * flightSpeed / w * (1.0f - cosf(w * tf));
+    state->vel[X] = flying * flightSpeed * sinf(w * tf);
+    state->acc[X] = flying * flightSpeed * w * cosf(w * tf);
+    state->pos[Z] = flying * 500.0f * (1.0f - cosf(0.5f * w * tf));
+    state->vel[Z] = flying * 500.0f * 0.5f * w * sinf(0.5f * w * tf);
+    state->acc[Z] = flying * 500.0f * sq(0.5f * w) * cosf(0.5f * w * tf);
+}
+
+static FILE *writeFlight(float duration, float flightSpeed, uint32_t gpsDelayMs, float gpsOutageStart)
+{
+    FILE *file = tmpfile();
+    flightState_t state;
+    const float cmPerLat = 1.113195f;       // DISTANCE_BETWEEN_TWO_LONGITUDE_POINTS_AT_EQUATOR
+    const float cmPerLon = cmPerLat * cosf(FLIGHT_ORIGIN_LAT / 1e7f * M_PIf / 180.0f);
+
+    unittestRandomSeed(1);
+    fprintf(file, "# synthetic flight\n");
+
+    for (int i = 0; i < duration * FLIGHT_LOOP_HZ; i++) {
+        const uint32_t timeUs = 1000 + i * (1000000 / FLIGHT_LOOP_HZ);
+        const float t = timeUs * 1e-6f;
+
+        if (i == 5 * FLIGHT_LOOP_HZ) {
+            fprintf(file, "%u,A,1\n", timeUs);
+        }
+
+        if (i % (FLIGHT_LOOP_HZ / FLIGHT_GPS_HZ) == 0 && t > 1.0f && t < gpsOutageStart) {
+            flightStateAt(t - gpsDelayMs * 1e-3f, flightSpeed, &state);
+            fprintf(file, "%u,G,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", timeUs,
+                (int)lrint(FLIGHT_ORIGIN_LAT + (double)(state.pos[X] + unittestGaussian(50.0f)) / cmPerLat),
+                (int)lrint(FLIGHT_ORIGIN_LON + (double)(state.pos[Y] + unittestGaussian(50.0f)) / cmPerLon),
+                (int)lrintf(state.pos[Z] + unittestGaussian(100.0f)),
+                (int)lrintf(state.vel[X] + unittestGaussian(10.0f)), (int)lrintf(state.vel[Y] + unittestGaussian(10.0f)), (int)lrintf(-state.vel[Z] + unittestGaussian(10.0f)),
+                10, 150, 300);
+        }
+
+        flightStateAt(t, flightSpeed, &state);
+
+        if (i % (FLIGHT_LOOP_HZ / FLIGHT_BARO_HZ) == 0) {
+            fprintf(file, "%u,B,%d\n", timeUs, (int)lrintf(state.pos[Z] + unittestGaussian(30.0f)));
+        }
+
+        // level, facing north, body X forward, Y right, Z down with +1G on Z: NEU X and Z map to body X and Z, Y is flipped
+        fprintf(file, "%u,T,%.1f,%.1f,%.1f\n", timeUs, state.pos[X], state.pos[Y], state.pos[Z]);
+        fprintf(file, "%u,I,%.1f,%.1f,%.1f,0,0,0\n", timeUs,
+            state.acc[X] + unittestGaussian(30.0f), -(state.acc[Y] + unittestGaussian(30.0f)), GRAVITY_CMSS + state.acc[Z] + unittestGaussian(30.0f));
+    }
+
+    rewind(file);
+    return file;
+}
+
+static replayResult_t replayFlight(navPosEstimator_e estimator, float duration, float flightSpeed, uint32_t gpsDelayMs, uint32_t assumedGpsDelayMs, float gpsOutageStart)
+{
+    FILE *file = writeFlight(duration, flightSpeed, gpsDelayMs, gpsOutageStart);
+    resetReplay(estimator);
+    navConfig.inav.gps_delay_ms = assumedGpsDelayMs;
+
+    const replayResult_t result = replay(file, NULL);
+    fclose(file);
+    return result;
+}
+
+static float horizontalErrorRms(const replayResult_t *result)
+{
+    return sqrt(result->horizontalErrorSquareSum / MAX(result->truthSamples, 1U));
+}
+
+static float verticalErrorRms(const replayResult_t *result)
+{
+    return sqrt(result->verticalErrorSquareSum / MAX(result->truthSamples, 1U));
+}
+
+TEST(PositionEstimatorReplayTest, TestFlightAccuracy)
+{
+    const navPosEstimator_e estimators[] = { NAV_POS_ESTIMATOR_COMPLEMENTARY, NAV_POS_ESTIMATOR_EKF };
+
+    for (unsigned n = 0; n < ARRAYLEN(estimators); n++) {
+        const replayResult_t result = replayFlight(estimators[n], 60, 500, 200, 200, 1e6f);
+        printResult(estimators[n] == NAV_POS_ESTIMATOR_EKF ? "EKF" : "COMPLEMENTARY", &result);
+
+        EXPECT_EQ(60U * FLIGHT_LOOP_HZ, result.updates);
+        EXPECT_GT(result.truthSamples, 2000U);
+        EXPECT_TRUE(result.isPositionValid);
+        EXPECT_TRUE(result.isAltitudeValid);
+        EXPECT_LT(horizontalErrorRms(&result), 100.0f);
+        EXPECT_LT(verticalErrorRms(&result), 50.0f);
+    }
+}
+
+TEST(PositionEstimatorReplayTest, TestGpsDelayCompensated)
+{
+    const navPosEstimator_e estimators[] = { NAV_POS_ESTIMATOR_COMPLEMENTARY, NAV_POS_ESTIMATOR_EKF };
+
+    for (unsigned n = 0; n < ARRAYLEN(estimators); n++) {
+        const replayResult_t compensated = replayFlight(estimators[n], 60, 1000, 300, 300, 1e6f);
+        const replayResult_t uncompensated = replayFlight(estimators[n], 60, 1000, 300, 0, 1e6f);
+
+        EXPECT_LT(horizontalErrorRms(&compensated), horizontalErrorRms(&uncompensated));
+    }
+}
+
+TEST(PositionEstimatorReplayTest, TestGpsOutage)
+{
+    const navPosEstimator_e estimators[] = { NAV_POS_ESTIMATOR_COMPLEMENTARY, NAV_POS_ESTIMATOR_EKF };
+
+    for (unsigned n = 0; n < ARRAYLEN(estimators); n++) {
+        const replayResult_t result = replayFlight(estimators[n], 60, 500, 200, 200, 30.0f);
+
+        // position is given up, baro keeps the altitude
+        EXPECT_FALSE(result.isPositionValid);
+        EXPECT_GE(result.eph, navConfig.inav.max_eph_epv);
+        EXPECT_TRUE(result.isAltitudeValid);
+        EXPECT_LT(result.epv, navConfig.inav.max_eph_epv);
+    }
+}
+
+/*
+ * GPS glitch detection, fixes of a hovering aircraft fed at FLIGHT_GPS_HZ. The gate is INAV_GPS_GLITCH_RADIUS (2.5m)
+ * plus the median prediction error of recent good fixes, plus 0.2m for the 10m/s/s allowed over one update.
+ */
+static uint32_t glitchTestTimeUs;
+
+// Returns true if the fix, north cm away from the origin, was taken for a glitch
+static bool replayHoverFix(float north)
+{
+    const float cmPerLat = 1.113195f;       // DISTANCE_BETWEEN_TWO_LONGITUDE_POINTS_AT_EQUATOR
+    replayResult_t result;
+    char line[128];
+
+    memset(&result, 0, sizeof(result));
+    glitchTestTimeUs += 1000000 / FLIGHT_GPS_HZ;
+    snprintf(line, sizeof(line), "%u,G,%d,%d,0,0,0,0,10,150,300\n", glitchTestTimeUs,
+        (int)lrint(FLIGHT_ORIGIN_LAT + north / cmPerLat), FLIGHT_ORIGIN_LON);
+    replaySample(line, NULL, &result);
+
+    return isGPSGlitchDetected();
+}
+
+// Settles the typical prediction error at zero, the detector keeps its state between replays
+static void startGlitchTest(void)
+{
+    resetReplay(NAV_POS_ESTIMATOR_COMPLEMENTARY);
+    glitchTestTimeUs = 0;
+
+    for (int i = 0; i < 20; i++) {
+        EXPECT_FALSE(replayHoverFix(0));
+    }
+}
+
+TEST(PositionEstimatorReplayTest, TestGpsGlitchSingleJump)
+{
+    startGlitchTest();
+
+    EXPECT_TRUE(replayHoverFix(500));
+    EXPECT_FALSE(replayHoverFix(0));
+    EXPECT_FALSE(replayHoverFix(200));
+}
+
+TEST(PositionEstimatorReplayTest, TestGpsGlitchTrainDoesNotWidenGate)
+{
+    startGlitchTest();
+
+    // shorter than the time the allowed acceleration needs to cover the jump
+    for (int i = 0; i < 4; i++) {
+        EXPECT_TRUE(replayHoverFix(1000));
+    }
+    EXPECT_FALSE(replayHoverFix(0));
+
+    // rejected fixes don't enter the typical error, a jump the settled gate rejects is still rejected
+    EXPECT_TRUE(replayHoverFix(400));
+    EXPECT_FALSE(replayHoverFix(0));
+
+    for (int i = 0; i < 4; i++) {
+        EXPECT_TRUE(replayHoverFix(1000));
+    }
+    EXPECT_FALSE(replayHoverFix(0));
+    EXPECT_TRUE(replayHoverFix(400));
+}
+
+TEST(PositionEstimatorReplayTest, TestGpsGlitchNoisierFixesAccepted)
+{
+    startGlitchTest();
+
+    // fixes alternate around the origin, the jump between them grows to 4.8m, well beyond the settled gate
+    int glitches = 0;
+    for (int i = 0; i <= 200; i++) {
+        const float noise = 240.0f * i / 200;
+        glitches += replayHoverFix((i % 2) ? noise : -noise);
+    }
+    EXPECT_EQ(0, glitches);
+
+    // and the gate settles back once the noise is gone
+    for (int i = 0; i < 20; i++) {
+        EXPECT_FALSE(replayHoverFix(0));
+    }
+    EXPECT_TRUE(replayHoverFix(400));
+}
+
+// Replay tool rather than a test, disabled so that it only runs when asked for, see the top of this file
+TEST(PositionEstimatorReplayTest, DISABLED_TestReplayFile)
+{
+    const char *fileName = getenv("POS_ESTIMATOR_REPLAY");
+    ASSERT_TRUE(fileName != NULL) << "POS_ESTIMATOR_REPLAY is not set";
+
+    FILE *input = fopen(fileName, "r");
+    ASSERT_TRUE(input != NULL);
+
+    const char *outputName = getenv("POS_ESTIMATOR_REPLAY_OUTPUT");
+    FILE *output = outputName ? fopen(outputName, "w") : NULL;
+
+    const char *estimatorName = getenv("POS_ESTIMATOR");
+    resetReplay((estimatorName && strcmp(estimatorName, "EKF") == 0) ? NAV_POS_ESTIMATOR_EKF : NAV_POS_ESTIMATOR_COMPLEMENTARY);
+
+    const replayResult_t result = replay(input, output);
+    printResult(fileName, &result);
+
+    fclose(input);
+    if (output) {
+        fclose(output);
+    }
+}
+
+// STUBS
+
+extern "C" {
+uint8_t armingFlags;
+uint8_t stateFlags;
+attitudeEulerAngles_t attitude;
+t_fp_vector imuAccelInBodyFrame;
+gpsSolutionData_t gpsSol;
+navigationPosControl_t posControl;
+uint32_t targetLooptime;
+
+uint32_t micros(void) { return currentTimeUs; }
+bool sensors(uint32_t mask) { return (enabledSensors & mask) == mask; }
+
+bool isImuReady(void) { return true; }
+void imuGetAverageAccelInBodyFrame(t_fp_vector * accel) { *accel = imuAccelInBodyFrame; }
+void imuResetAverageAccelInBodyFrame(void) {}
+bool isImuHeadingValid(void) { return true; }
+float calculateCosTiltAngle(void) { return rMat[2][2]; }
+
+void imuTransformVectorBodyToEarth(t_fp_vector * v)
+{
+    const float x = rMat[0][0] * v->V.X + rMat[0][1] * v->V.Y + rMat[0][2] * v->V.Z;
+    const float y = rMat[1][0] * v->V.X + rMat[1][1] * v->V.Y + rMat[1][2] * v->V.Z;
+    const float z = rMat[2][0] * v->V.X + rMat[2][1] * v->V.Y + rMat[2][2] * v->V.Z;
+
+    v->V.X = x;
+    v->V.Y = -y;
+    v->V.Z = z;
+}
+
+void imuTransformVectorEarthToBody(t_fp_vector * v)
+{
+    v->V.Y = -v->V.Y;
+
+    const float x = rMat[0][0] * v->V.X + rMat[1][0] * v->V.Y + rMat[2][0] * v->V.Z;
+    const float y = rMat[0][1] * v->V.X + rMat[1][1] * v->V.Y + rMat[2][1] * v->V.Z;
+    const float z = rMat[0][2] * v->V.X + rMat[1][2] * v->V.Y + rMat[2][2] * v->V.Z;
+
+    v->V.X = x;
+    v->V.Y = y;
+    v->V.Z = z;
+}
+
+bool isBaroCalibrationComplete(void) { return true; }
+int32_t baroCalculateAltitude(void) { return baroAltitude; }
+int32_t sonarRead(void) { return sonarDistance; }
+int32_t sonarCalculateAltitude(int32_t distance, float cosTiltAngle) { UNUSED(cosTiltAngle); return distance; }
+
+void updateActualHeading(int32_t newHeading) { UNUSED(newHeading); }
+
+void updateActualHorizontalPositionAndVelocity(bool hasValidSensor, float newX, float newY, float newVelX, float newVelY)
+{
+    published.updated = true;
+    published.isPositionValid = hasValidSensor;
+    published.pos[X] = newX;
+    published.pos[Y] = newY;
+    published.vel[X] = newVelX;
+    published.vel[Y] = newVelY;
+}
+
+void updateActualAltitudeAndClimbRate(bool hasValidSensor, float newAltitude, float newVelocity)
+{
+    published.isAltitudeValid = hasValidSensor;
+    published.pos[Z] = newAltitude;
+    published.vel[Z] = newVelocity;
+}
+
+void updateActualSurfaceDistance(bool hasValidSensor, float surfaceDistance, float surfaceVelocity)
+{
+    UNUSED(hasValidSensor);
+    UNUSED(surfaceDistance);
+    UNUSED(surfaceVelocity);
+}
+}
@@ -24,6 +24,13 @@
 #define TELEMETRY
 #define LED_STRIP
 #define USE_SERVOS
+#define USE_GYRO_DYNAMIC_NOTCH
+#define USE_GYRO_DYNAMIC_LPF
+#define USE_IMU_EKF
+#define USE_LOOPTIME_GOVERNOR
+#define USE_NAV_EKF
+#define USE_NAV_MISSION_STORE
+#define NAV_MISSION_STORE_SIZE (12 * 1024)
 
 #define SERIAL_PORT_COUNT 4
 
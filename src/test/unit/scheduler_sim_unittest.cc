@@ -0,0 +1,410 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Scheduler simulator, runs the real scheduler.c and scheduler_tasks.c against a virtual micros().
+ *
+ * Each task invocation advances virtual time by an execution time drawn from a log2 histogram in the
+ * layout reported by MSP_TASK_STATS, so distributions captured in flight can be replayed:
+ *
+ *   SCHEDULER_SIM_PROFILE=capture.txt ../../obj/test/scheduler_sim_unittest
+ *
+ * with one line per task: <task name> <execution time bucket counts, bucket 0 first>.
+ * Tasks missing from the file keep the built-in profile.
+ *
+ * Guard interval constants of scheduler.c can be changed for a comparison run:
+ *
+ *   make clean && make ../../obj/test/scheduler_sim_unittest SCHEDULER_SIM_FLAGS=-DREALTIME_GUARD_INTERVAL_MAX=150
+ *
+ * The task list is that of a NAV build with SONAR, SCHEDULER_SIM_TASK_FLAGS= simulates a build without them.
+ *
+ * Random numbers come from a fixed seed, the same profile and settings always give the same report.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/maths.h"
+
+    #include "scheduler/scheduler.h"
+}
+
+#include "unittest_macros.h"
+#include "unittest_random.h"
+#include "gtest/gtest.h"
+
+#define SIMULATION_TIME         (10 * 1000000)  // virtual us per run
+#define SIMULATION_WARMUP_TIME  (1 * 1000000)   // statistics are not collected while guard interval and averages settle
+#define SCHEDULER_PASS_TIME     4               // us spent in scheduler() itself on every pass
+#define RX_CHECK_TIME           2               // us spent in taskUpdateRxCheck()
+#define RX_FRAME_PERIOD         9000            // SBUS frame period
+#define TASK_STARVATION_PERIODS 4               // task is starving if it was not run for this many periods
+
+// Built-in profile, execution time bucket counts of a F3 board at 1kHz looptime with NAV, GPS, MAG, BARO, SONAR and
+// telemetry. Rows have the same conditions as cfTaskId_e, C++ only accepts them complete and in enum order.
+static const uint16_t defaultExecutionTimeProfile[TASK_COUNT][TASK_HISTOGRAM_BUCKET_COUNT] = {
+    //                      0    1    2    3    4    5    6    7    8    9   10   11   12   13   14   15
+    [TASK_SYSTEM] =         { 0,   0,   0,  90,  10,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 },
+    [TASK_GYROPID] =        { 0,   0,   0,   0,   0,   0,   0,   0,  15,  85,   0,   0,   0,   0,   0,   0 },
+    [TASK_SERIAL] =         { 0,   0,   0,  60,  25,  10,   3,   1,   1,   0,   0,   0,   0,   0,   0,   0 },
+    [TASK_BEEPER] =         { 0,  50,  50,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 },
+    [TASK_BATTERY] =        { 0,   0,   0,  20,  70,  10,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 },
+    [TASK_RX] =             { 0,   0,   0,   0,   0,  10,  70,  20,   0,   0,   0,   0,   0,   0,   0,   0 },
+#ifdef NAV
+    [TASK_POS_ESTIMATOR] =  { 0,   0,   0,   0,   0,   0,  20,  60,  20,   0,   0,   0,   0,   0,   0,   0 },
+    [TASK_NAV] =            { 0,   0,   0,   0,   0,  30,  40,  25,   5,   0,   0,   0,   0,   0,   0,   0 },
+#endif
+#ifdef GPS
+    [TASK_GPS] =            { 0,   0,   0,   0,  40,  40,  15,   4,   1,   0,   0,   0,   0,   0,   0,   0 },
+#endif
+#ifdef MAG
+    [TASK_COMPASS] =        { 0,   0,   0,   0,   0,   0,   0,  10,  90,   0,   0,   0,   0,   0,   0,   0 },
+#endif
+#ifdef BARO
+    [TASK_BARO] =           { 0,   0,   0,   0,   0,   0,  30,  60,  10,   0,   0,   0,   0,   0,   0,   0 },
+#endif
+#ifdef SONAR
+    [TASK_SONAR] =          { 0,   0,   0,   0,  30,  60,  10,   0,   0,   0,   0,   0,   0,   0,   0,   0 },
+#endif
+#ifdef DISPLAY
+    [TASK_DISPLAY] =        { 0,   0,   0,   0,   0,   0,   0,   0,   0,  70,  30,   0,   0,   0,   0,   0 },
+#endif
+#ifdef TELEMETRY
+    [TASK_TELEMETRY] =      { 0,   0,   0,  50,  40,  10,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0 },
+#endif
+#ifdef LED_STRIP
+    [TASK_LEDSTRIP] =       { 0,   0,   0,   0,   0,   0,  60,  40,   0,   0,   0,   0,   0,   0,   0,   0 },
+#endif
+};
+
+static uint16_t executionTimeProfile[TASK_COUNT][TASK_HISTOGRAM_BUCKET_COUNT];
+
+typedef struct {
+    uint32_t runs;
+    uint32_t lastStartedAt;
+    uint32_t maxGap;                // longest time between two starts, in us
+    uint32_t starvations;           // gaps of more than TASK_STARVATION_PERIODS periods
+} taskSimulationStats_t;
+
+typedef struct {
+    schedulerPolicy_e policy;
+    bool rxSignaled;                // RX interrupt signals TASK_RX on frame completion
+
+    taskSimulationStats_t task[TASK_COUNT];
+
+    uint32_t gyroCycles;
+    uint32_t gyroMissedCycles;
+    double gyroPeriodMean;
+    double gyroPeriodStdDev;
+    uint32_t gyroPeriodMaxDeviation;
+
+    uint32_t rxFrameLatencyMax;
+
+    uint32_t systemLoadSamples;
+    uint32_t systemLoadSum;
+    uint16_t systemLoadMax;
+} simulationResult_t;
+
+static uint32_t simulatedTime;
+static simulationResult_t *result;
+static bool collectingStats;
+
+static double gyroPeriodSum;
+static double gyroPeriodSquareSum;
+
+static uint32_t nextRxFrameAt;
+static uint32_t rxFrameReceivedAt;
+static bool rxFramePending;
+
+static uint32_t sampleExecutionTime(cfTaskId_e taskId)
+{
+    const uint16_t *bucket = executionTimeProfile[taskId];
+    uint32_t sampleCount = 0;
+    for (int ii = 0; ii < TASK_HISTOGRAM_BUCKET_COUNT; ii++) {
+        sampleCount += bucket[ii];
+    }
+    if (sampleCount == 0) {
+        return 0;
+    }
+
+    uint32_t sample = unittestRandom() % sampleCount;
+    for (int ii = 0; ii < TASK_HISTOGRAM_BUCKET_COUNT; ii++) {
+        if (sample < bucket[ii]) {
+            if (ii == 0) {
+                return 0;
+            }
+            // uniform within [2^(ii-1), 2^ii)
+            const uint32_t lowerBound = 1 << (ii - 1);
+            return lowerBound + unittestRandom() % lowerBound;
+        }
+        sample -= bucket[ii];
+    }
+    return 0;
+}
+
+static void updateRxFrame(void)
+{
+    if ((int32_t)(simulatedTime - nextRxFrameAt) >= 0) {
+        if (!rxFramePending) {
+            rxFrameReceivedAt = nextRxFrameAt;
+        }
+        rxFramePending = true;
+        nextRxFrameAt += RX_FRAME_PERIOD;
+        if (result->rxSignaled) {
+            signalTask(TASK_RX);
+        }
+    }
+}
+
+static void recordTaskStart(cfTaskId_e taskId, uint32_t startedAt)
+{
+    taskSimulationStats_t *stats = &result->task[taskId];
+
+    if (collectingStats && stats->runs > 0) {
+        const uint32_t gap = startedAt - stats->lastStartedAt;
+        const uint32_t period = (taskId == TASK_RX) ? RX_FRAME_PERIOD : cfTasks[taskId].desiredPeriod;
+        stats->maxGap = MAX(stats->maxGap, gap);
+        if (gap > TASK_STARVATION_PERIODS * period) {
+            stats->starvations++;
+        }
+
+        if (taskId == TASK_GYROPID) {
+            result->gyroCycles++;
+            gyroPeriodSum += gap;
+            gyroPeriodSquareSum += (double)gap * gap;
+            const uint32_t deviation = (gap > period) ? gap - period : period - gap;
+            result->gyroPeriodMaxDeviation = MAX(result->gyroPeriodMaxDeviation, deviation);
+            result->gyroMissedCycles += (gap + period / 2) / period - 1;
+        }
+    }
+    if (collectingStats) {
+        stats->runs++;
+    }
+    stats->lastStartedAt = startedAt;
+}
+
+static void simulateTask(cfTaskId_e taskId)
+{
+    recordTaskStart(taskId, simulatedTime);
+    simulatedTime += sampleExecutionTime(taskId);
+}
+
+extern "C" {
+    cfTask_t * unittest_scheduler_selectedTask;
+    uint16_t unittest_scheduler_waitingTasks;
+    uint32_t unittest_scheduler_timeToNextRealtimeTask;
+    bool unittest_outsideRealtimeGuardInterval;
+
+    extern void queueClear(void);
+
+    uint32_t micros(void) {return simulatedTime;}
+
+    void taskMainPidLoopChecker(void) {simulateTask(TASK_GYROPID);}
+    void taskHandleSerial(void) {simulateTask(TASK_SERIAL);}
+    void taskUpdateBeeper(void) {simulateTask(TASK_BEEPER);}
+    void taskUpdateBattery(void) {simulateTask(TASK_BATTERY);}
+    bool taskUpdateRxCheck(uint32_t currentDeltaTime)
+    {
+        UNUSED(currentDeltaTime);
+        simulatedTime += RX_CHECK_TIME;
+        updateRxFrame();
+        return rxFramePending;
+    }
+    void taskUpdateRxMain(void)
+    {
+        if (collectingStats) {
+            result->rxFrameLatencyMax = MAX(result->rxFrameLatencyMax, simulatedTime - rxFrameReceivedAt);
+        }
+        rxFramePending = false;
+        simulateTask(TASK_RX);
+    }
+#ifdef NAV
+    void taskUpdatePositionEstimator(void)
+    {
+        simulateTask(TASK_POS_ESTIMATOR);
+        signalTask(TASK_NAV);   // every update publishes a new position while flying
+    }
+    void taskNavigation(void) {simulateTask(TASK_NAV);}
+#endif
+    void taskProcessGPS(void) {simulateTask(TASK_GPS);}
+    void taskUpdateCompass(void) {simulateTask(TASK_COMPASS);}
+    void taskUpdateBaro(void) {simulateTask(TASK_BARO);}
+#ifdef SONAR
+    void taskUpdateSonar(void) {simulateTask(TASK_SONAR);}
+#endif
+    void taskUpdateDisplay(void) {simulateTask(TASK_DISPLAY);}
+    void taskTelemetry(void) {simulateTask(TASK_TELEMETRY);}
+    void taskLedStrip(void) {simulateTask(TASK_LEDSTRIP);}
+}
+
+static void loadExecutionTimeProfile(void)
+{
+    memcpy(executionTimeProfile, defaultExecutionTimeProfile, sizeof(executionTimeProfile));
+
+    const char *fileName = getenv("SCHEDULER_SIM_PROFILE");
+    if (fileName == NULL) {
+        return;
+    }
+    FILE *file = fopen(fileName, "r");
+    ASSERT_TRUE(file != NULL) << "can't open " << fileName;
+
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        char *token = strtok(line, " \t\r\n");
+        if (token == NULL || token[0] == '#') {
+            continue;
+        }
+        int taskId;
+        for (taskId = 0; taskId < TASK_COUNT; taskId++) {
+            if (strcmp(token, cfTasks[taskId].taskName) == 0) {
+                break;
+            }
+        }
+        if (taskId == TASK_COUNT) {
+            printf("ignoring unknown task %s\n", token);
+            continue;
+        }
+        memset(executionTimeProfile[taskId], 0, sizeof(executionTimeProfile[taskId]));
+        for (int ii = 0; ii < TASK_HISTOGRAM_BUCKET_COUNT && (token = strtok(NULL, " \t\r\n")) != NULL; ii++) {
+            executionTimeProfile[taskId][ii] = atoi(token);
+        }
+    }
+    fclose(file);
+}
+
+static void runSimulation(simulationResult_t *simulationResult)
+{
+    result = simulationResult;
+    unittestRandomSeed(0x2545f491);
+    simulatedTime = 0;
+    collectingStats = false;
+    gyroPeriodSum = 0;
+    gyroPeriodSquareSum = 0;
+    nextRxFrameAt = RX_FRAME_PERIOD;
+    rxFramePending = false;
+
+    queueClear();
+    schedulerSetPolicy(result->policy);
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        cfTasks[taskId].lastExecutedAt = 0;
+        cfTasks[taskId].lastSignaledAt = 0;
+        cfTasks[taskId].dynamicPriority = 0;
+        cfTasks[taskId].averageExecutionTime = 0;
+        setTaskEnabled(static_cast<cfTaskId_e>(taskId), true);
+    }
+
+    while (simulatedTime < SIMULATION_WARMUP_TIME + SIMULATION_TIME) {
+        collectingStats = simulatedTime >= SIMULATION_WARMUP_TIME;
+
+        updateRxFrame();
+        scheduler();
+        simulatedTime += SCHEDULER_PASS_TIME;
+
+        // taskSystem() is the real one, it takes no virtual time
+        if (unittest_scheduler_selectedTask == &cfTasks[TASK_SYSTEM]) {
+            recordTaskStart(TASK_SYSTEM, cfTasks[TASK_SYSTEM].lastExecutedAt);
+        }
+        if (collectingStats && unittest_scheduler_selectedTask == &cfTasks[TASK_SYSTEM]) {
+            result->systemLoadSamples++;
+            result->systemLoadSum += averageSystemLoadPercent;
+            result->systemLoadMax = MAX(result->systemLoadMax, averageSystemLoadPercent);
+        }
+    }
+
+    if (result->gyroCycles > 0) {
+        result->gyroPeriodMean = gyroPeriodSum / result->gyroCycles;
+        result->gyroPeriodStdDev = sqrt(MAX(0.0, gyroPeriodSquareSum / result->gyroCycles - result->gyroPeriodMean * result->gyroPeriodMean));
+    }
+
+    schedulerSetPolicy(SCHEDULER_POLICY_DYNAMIC_PRIORITY);
+}
+
+static void printSimulationResult(const char *name, const simulationResult_t *simulationResult)
+{
+    printf("\n%s, policy %s, RX %s\n", name,
+        simulationResult->policy == SCHEDULER_POLICY_EDF ? "EDF" : "DYNAMIC",
+        simulationResult->rxSignaled ? "signaled" : "polled");
+    printf("gyro period mean %.1fus, jitter %.1fus, max deviation %uus, missed cycles %u of %u\n",
+        simulationResult->gyroPeriodMean, simulationResult->gyroPeriodStdDev,
+        simulationResult->gyroPeriodMaxDeviation, simulationResult->gyroMissedCycles, simulationResult->gyroCycles);
+    printf("RX max frame latency %uus, system load avg %u%% max %u%%\n",
+        simulationResult->rxFrameLatencyMax,
+        simulationResult->systemLoadSamples ? simulationResult->systemLoadSum / simulationResult->systemLoadSamples : 0,
+        simulationResult->systemLoadMax);
+    printf("Task          runs  max gap/us  starved\n");
+    for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+        const taskSimulationStats_t *stats = &simulationResult->task[taskId];
+        printf("%-10s %7u  %10u  %7u\n", cfTasks[taskId].taskName, stats->runs, stats->maxGap, stats->starvations);
+    }
+}
+
+static void compareSchedulingPolicies(const char *name, simulationResult_t results[SCHEDULER_POLICY_EDF + 1])
+{
+    for (int policy = SCHEDULER_POLICY_DYNAMIC_PRIORITY; policy <= SCHEDULER_POLICY_EDF; policy++) {
+        memset(&results[policy], 0, sizeof(results[policy]));
+        results[policy].policy = static_cast<schedulerPolicy_e>(policy);
+        results[policy].rxSignaled = true;
+        runSimulation(&results[policy]);
+        printSimulationResult(name, &results[policy]);
+    }
+}
+
+TEST(SchedulerSimulation, ReplayExecutionTimeProfile)
+{
+    loadExecutionTimeProfile();
+
+    simulationResult_t results[SCHEDULER_POLICY_EDF + 1];
+    compareSchedulingPolicies("replayed profile", results);
+
+    for (int policy = SCHEDULER_POLICY_DYNAMIC_PRIORITY; policy <= SCHEDULER_POLICY_EDF; policy++) {
+        // gyro loop must keep its rate whatever the other tasks do
+        EXPECT_NEAR(cfTasks[TASK_GYROPID].desiredPeriod, results[policy].gyroPeriodMean, cfTasks[TASK_GYROPID].desiredPeriod / 20);
+        EXPECT_LT(results[policy].gyroMissedCycles, results[policy].gyroCycles / 100);
+        EXPECT_GT(results[policy].systemLoadSamples, 0u);
+    }
+}
+
+TEST(SchedulerSimulation, HeavyNonRealtimeLoad)
+{
+    // busy MSP link and a slow display leave little room between gyro loops
+    memcpy(executionTimeProfile, defaultExecutionTimeProfile, sizeof(executionTimeProfile));
+    const uint16_t busySerial[TASK_HISTOGRAM_BUCKET_COUNT] = { 0, 0, 0, 0, 0, 0, 20, 40, 40, 0, 0, 0, 0, 0, 0, 0 };
+    const uint16_t slowDisplay[TASK_HISTOGRAM_BUCKET_COUNT] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 50, 50, 0, 0, 0, 0 };
+    memcpy(executionTimeProfile[TASK_SERIAL], busySerial, sizeof(busySerial));
+    memcpy(executionTimeProfile[TASK_DISPLAY], slowDisplay, sizeof(slowDisplay));
+
+    simulationResult_t results[SCHEDULER_POLICY_EDF + 1];
+    compareSchedulingPolicies("heavy profile", results);
+
+    for (int policy = SCHEDULER_POLICY_DYNAMIC_PRIORITY; policy <= SCHEDULER_POLICY_EDF; policy++) {
+        EXPECT_LT(results[policy].gyroMissedCycles, results[policy].gyroCycles / 100);
+        for (int taskId = 0; taskId < TASK_COUNT; taskId++) {
+            EXPECT_GT(results[policy].task[taskId].runs, 0u);
+            EXPECT_EQ(0u, results[policy].task[taskId].starvations);
+        }
+    }
+}
+
+// STUBS
+extern "C" {
+}
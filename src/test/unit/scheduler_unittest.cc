@@ -19,15 +19,16 @@
 
 extern "C" {
     #include "platform.h"
-    #include "scheduler.h"
+    #include "scheduler/scheduler.h"
 }
 
 #include "unittest_macros.h"
 #include "gtest/gtest.h"
+
+#define REALTIME_GUARD_INTERVAL_MIN 10
 enum {
     systemTime = 10,
     pidLoopCheckerTime = 650,
-    updateAccelerometerTime = 192,
     handleSerialTime = 30,
     updateBeeperTime = 1,
     updateBatteryTime = 1,
@@ -44,6 +45,36 @@ enum {
     transponderTime = 10
 };
 
+// set up micros() to simulate time
+static uint32_t simulatedTime = 0;
+
+// deadline miss accounting, a task misses a deadline for every desiredPeriod it is started late
+static uint32_t taskExtraTime[TASK_COUNT];
+static uint32_t taskStartedAt[TASK_COUNT];
+static uint32_t deadlineMisses[TASK_COUNT];
+
+static uint32_t missedDeadlines(cfTaskId_e taskId, uint32_t now)
+{
+    const uint32_t period = cfTasks[taskId].desiredPeriod;
+    const uint32_t sinceLastStart = now - taskStartedAt[taskId];
+    return (sinceLastStart > 2 * period) ? (sinceLastStart - 1) / period - 1 : 0;
+}
+
+// resumable task simulation, task yields at the end of its slice
+static bool taskYields[TASK_COUNT];
+static bool taskTimeSliceExpired[TASK_COUNT];
+
+static void simulateTask(cfTaskId_e taskId, uint32_t executionTime)
+{
+    deadlineMisses[taskId] += missedDeadlines(taskId, simulatedTime);
+    taskStartedAt[taskId] = simulatedTime;
+    simulatedTime += executionTime + taskExtraTime[taskId];
+    taskTimeSliceExpired[taskId] = isTaskTimeSliceExpired();
+    if (taskYields[taskId]) {
+        taskYield();
+    }
+}
+
 extern "C" {
     cfTask_t * unittest_scheduler_selectedTask;
     uint8_t unittest_scheduler_selectedTaskDynPrio;
@@ -51,26 +82,21 @@ extern "C" {
     uint32_t unittest_scheduler_timeToNextRealtimeTask;
     bool unittest_outsideRealtimeGuardInterval;
 
-// set up micros() to simulate time
-    uint32_t simulatedTime = 0;
     uint32_t micros(void) {return simulatedTime;}
 // set up tasks to take a simulated representative time to execute
-    void taskMainPidLoopChecker(void) {simulatedTime+=pidLoopCheckerTime;}
-    void taskUpdateAccelerometer(void) {simulatedTime+=updateAccelerometerTime;}
-    void taskHandleSerial(void) {simulatedTime+=handleSerialTime;}
-    void taskUpdateBeeper(void) {simulatedTime+=updateBeeperTime;}
-    void taskUpdateBattery(void) {simulatedTime+=updateBatteryTime;}
+    void taskMainPidLoopChecker(void) {simulateTask(TASK_GYROPID, pidLoopCheckerTime);}
+    void taskHandleSerial(void) {simulateTask(TASK_SERIAL, handleSerialTime);}
+    void taskUpdateBeeper(void) {simulateTask(TASK_BEEPER, updateBeeperTime);}
+    void taskUpdateBattery(void) {simulateTask(TASK_BATTERY, updateBatteryTime);}
     bool taskUpdateRxCheck(uint32_t currentDeltaTime) {UNUSED(currentDeltaTime);simulatedTime+=updateRxCheckTime;return false;}
-    void taskUpdateRxMain(void) {simulatedTime+=updateRxMainTime;}
-    void taskProcessGPS(void) {simulatedTime+=processGPSTime;}
-    void taskUpdateCompass(void) {simulatedTime+=updateCompassTime;}
-    void taskUpdateBaro(void) {simulatedTime+=updateBaroTime;}
+    void taskUpdateRxMain(void) {simulateTask(TASK_RX, updateRxMainTime);}
+    void taskProcessGPS(void) {simulateTask(TASK_GPS, processGPSTime);}
+    void taskUpdateCompass(void) {simulateTask(TASK_COMPASS, updateCompassTime);}
+    void taskUpdateBaro(void) {simulateTask(TASK_BARO, updateBaroTime);}
     void taskUpdateSonar(void) {simulatedTime+=updateSonarTime;}
-    void taskCalculateAltitude(void) {simulatedTime+=calculateAltitudeTime;}
-    void taskUpdateDisplay(void) {simulatedTime+=updateDisplayTime;}
-    void taskTelemetry(void) {simulatedTime+=telemetryTime;}
-    void taskLedStrip(void) {simulatedTime+=ledStripTime;}
-    void taskTransponder(void) {simulatedTime+=transponderTime;}
+    void taskUpdateDisplay(void) {simulateTask(TASK_DISPLAY, updateDisplayTime);}
+    void taskTelemetry(void) {simulateTask(TASK_TELEMETRY, telemetryTime);}
+    void taskLedStrip(void) {simulateTask(TASK_LEDSTRIP, ledStripTime);}
 
     extern cfTask_t* taskQueueArray[];
 
@@ -85,11 +111,11 @@ extern "C" {
 
 TEST(SchedulerUnittest, TestPriorites)
 {
-    EXPECT_EQ(14, TASK_COUNT);
+    EXPECT_EQ(12, TASK_COUNT);
           // if any of these fail then task priorities have changed and ordering in TestQueue needs to be re-checked
     EXPECT_EQ(TASK_PRIORITY_HIGH, cfTasks[TASK_SYSTEM].staticPriority);
     EXPECT_EQ(TASK_PRIORITY_REALTIME, cfTasks[TASK_GYROPID].staticPriority);
-    EXPECT_EQ(TASK_PRIORITY_MEDIUM, cfTasks[TASK_ACCEL].staticPriority);
+    EXPECT_EQ(TASK_PRIORITY_MEDIUM, cfTasks[TASK_BEEPER].staticPriority);
     EXPECT_EQ(TASK_PRIORITY_LOW, cfTasks[TASK_SERIAL].staticPriority);
     EXPECT_EQ(TASK_PRIORITY_MEDIUM, cfTasks[TASK_BATTERY].staticPriority);
 }
@@ -229,7 +255,9 @@ TEST(SchedulerUnittest, TestQueueArray)
     EXPECT_EQ(false, taskInfo.isEnabled);
     setTaskEnabled(static_cast<cfTaskId_e>(TASK_COUNT - 1), true);
     EXPECT_EQ(TASK_COUNT, queueSize());
-    EXPECT_EQ(lastTaskPrev, taskQueueArray[TASK_COUNT - 1]);
+    // last two tasks share TASK_PRIORITY_IDLE, so they stay in the order they were added
+    EXPECT_EQ(lastTaskPrev, taskQueueArray[TASK_COUNT - 2]);
+    EXPECT_EQ(&cfTasks[TASK_COUNT - 1], taskQueueArray[TASK_COUNT - 1]);
     EXPECT_EQ(NULL, taskQueueArray[TASK_COUNT]); // check no buffer overrun
     EXPECT_EQ(deadBeefPtr, taskQueueArray[TASK_COUNT + 1]);
 
@@ -240,7 +268,7 @@ TEST(SchedulerUnittest, TestQueueArray)
     EXPECT_EQ(NULL, taskQueueArray[TASK_COUNT]);
     EXPECT_EQ(deadBeefPtr, taskQueueArray[TASK_COUNT + 1]);
 
-    setTaskEnabled(TASK_ACCEL, false);
+    setTaskEnabled(TASK_BEEPER, false);
     EXPECT_EQ(TASK_COUNT - 2, queueSize());
     EXPECT_EQ(NULL, taskQueueArray[TASK_COUNT - 2]);
     EXPECT_EQ(NULL, taskQueueArray[TASK_COUNT - 1]);
@@ -295,19 +323,19 @@ TEST(SchedulerUnittest, TestSingleTask)
 
 TEST(SchedulerUnittest, TestTwoTasks)
 {
-    // disable all tasks except TASK_GYROPID  and TASK_ACCEL
+    // disable all tasks except TASK_GYROPID  and TASK_BEEPER
     for (int taskId=0; taskId < TASK_COUNT; ++taskId) {
         setTaskEnabled(static_cast<cfTaskId_e>(taskId), false);
     }
-    setTaskEnabled(TASK_ACCEL, true);
+    setTaskEnabled(TASK_BEEPER, true);
     setTaskEnabled(TASK_GYROPID, true);
 
-    // set it up so that TASK_ACCEL ran just before TASK_GYROPID
+    // set it up so that TASK_BEEPER ran just before TASK_GYROPID
     static const uint32_t startTime = 4000;
     simulatedTime = startTime;
     cfTasks[TASK_GYROPID].lastExecutedAt = simulatedTime;
-    cfTasks[TASK_ACCEL].lastExecutedAt = cfTasks[TASK_GYROPID].lastExecutedAt - updateAccelerometerTime;
-    EXPECT_EQ(0, cfTasks[TASK_ACCEL].taskAgeCycles);
+    cfTasks[TASK_BEEPER].lastExecutedAt = cfTasks[TASK_GYROPID].lastExecutedAt - updateBeeperTime;
+    EXPECT_EQ(0, cfTasks[TASK_BEEPER].taskAgeCycles);
     // run the scheduler
     scheduler();
     // no tasks should have run, since neither task's desired time has elapsed
@@ -315,7 +343,7 @@ TEST(SchedulerUnittest, TestTwoTasks)
 
     // NOTE:
     // TASK_GYROPID desiredPeriod is  1000 microseconds
-    // TASK_ACCEL   desiredPeriod is 10000 microseconds
+    // TASK_BEEPER  desiredPeriod is 10000 microseconds
     // 500 microseconds later
     simulatedTime += 500;
     // no tasks should run, since neither task's desired time has elapsed
@@ -340,13 +368,13 @@ TEST(SchedulerUnittest, TestTwoTasks)
     EXPECT_EQ(static_cast<cfTask_t*>(0), unittest_scheduler_selectedTask);
     EXPECT_EQ(0, unittest_scheduler_waitingTasks);
 
-    simulatedTime = startTime + 10500; // TASK_GYROPID and TASK_ACCEL desiredPeriods have elapsed
+    simulatedTime = startTime + 10500; // TASK_GYROPID and TASK_BEEPER desiredPeriods have elapsed
     // of the two TASK_GYROPID should run first
     scheduler();
     EXPECT_EQ(&cfTasks[TASK_GYROPID], unittest_scheduler_selectedTask);
-    // and finally TASK_ACCEL should now run
+    // and finally TASK_BEEPER should now run
     scheduler();
-    EXPECT_EQ(&cfTasks[TASK_ACCEL], unittest_scheduler_selectedTask);
+    EXPECT_EQ(&cfTasks[TASK_BEEPER], unittest_scheduler_selectedTask);
 }
 
 TEST(SchedulerUnittest, TestRealTimeGuardInNoTaskRun)
@@ -399,6 +427,305 @@ TEST(SchedulerUnittest, TestRealTimeGuardOutTaskRun)
     EXPECT_EQ(200000, cfTasks[TASK_GYROPID].lastExecutedAt);
 }
 
+TEST(SchedulerUnittest, TestEdfEarliestDeadlineFirst)
+{
+    // disable all tasks except TASK_GYROPID, TASK_SERIAL and TASK_BEEPER
+    for (int taskId=0; taskId < TASK_COUNT; ++taskId) {
+        setTaskEnabled(static_cast<cfTaskId_e>(taskId), false);
+    }
+    setTaskEnabled(TASK_GYROPID, true);
+    setTaskEnabled(TASK_SERIAL, true);
+    setTaskEnabled(TASK_BEEPER, true);
+    schedulerSetPolicy(SCHEDULER_POLICY_EDF);
+
+    // TASK_SERIAL has lower static priority than TASK_BEEPER but was released earlier
+    simulatedTime = 300000;
+    cfTasks[TASK_GYROPID].lastExecutedAt = simulatedTime;
+    cfTasks[TASK_SERIAL].lastExecutedAt = simulatedTime - 15000;
+    cfTasks[TASK_BEEPER].lastExecutedAt = simulatedTime - 12000;
+
+    scheduler();
+    EXPECT_EQ(&cfTasks[TASK_SERIAL], unittest_scheduler_selectedTask);
+    EXPECT_EQ(2, unittest_scheduler_waitingTasks);
+    scheduler();
+    EXPECT_EQ(&cfTasks[TASK_BEEPER], unittest_scheduler_selectedTask);
+    EXPECT_EQ(1, unittest_scheduler_waitingTasks);
+    scheduler();
+    EXPECT_EQ(static_cast<cfTask_t*>(0), unittest_scheduler_selectedTask);
+
+    // realtime task is dispatched as soon as it is due
+    simulatedTime = cfTasks[TASK_GYROPID].lastExecutedAt + 1000;
+    scheduler();
+    EXPECT_EQ(&cfTasks[TASK_GYROPID], unittest_scheduler_selectedTask);
+
+    // a shorter relative deadline moves a task ahead
+    simulatedTime = 320000;
+    cfTasks[TASK_GYROPID].lastExecutedAt = simulatedTime;
+    cfTasks[TASK_SERIAL].lastExecutedAt = simulatedTime - 10000;
+    cfTasks[TASK_BEEPER].lastExecutedAt = simulatedTime - 10000;
+    cfTasks[TASK_BEEPER].relativeDeadline = 2000;
+    setTaskEnabled(TASK_BEEPER, false);
+    setTaskEnabled(TASK_BEEPER, true);
+    scheduler();
+    EXPECT_EQ(&cfTasks[TASK_BEEPER], unittest_scheduler_selectedTask);
+    cfTasks[TASK_BEEPER].relativeDeadline = 0;
+
+    // a pending task is released at its new period after being rescheduled
+    simulatedTime = 340000;
+    cfTasks[TASK_GYROPID].lastExecutedAt = simulatedTime;
+    cfTasks[TASK_SERIAL].lastExecutedAt = simulatedTime;
+    cfTasks[TASK_BEEPER].lastExecutedAt = simulatedTime;
+    setTaskEnabled(TASK_BEEPER, false);
+    setTaskEnabled(TASK_BEEPER, true);
+    scheduler();
+    EXPECT_EQ(static_cast<cfTask_t*>(0), unittest_scheduler_selectedTask);
+    const uint32_t serialPeriod = cfTasks[TASK_SERIAL].desiredPeriod;
+    rescheduleTask(TASK_SERIAL, 2000);
+    simulatedTime += 2000;
+    cfTasks[TASK_GYROPID].lastExecutedAt = simulatedTime;
+    scheduler();
+    EXPECT_EQ(&cfTasks[TASK_SERIAL], unittest_scheduler_selectedTask);
+    rescheduleTask(TASK_SERIAL, serialPeriod);
+
+    schedulerSetPolicy(SCHEDULER_POLICY_DYNAMIC_PRIORITY);
+}
+
+TEST(SchedulerUnittest, TestSignaledTaskRunsFirst)
+{
+    // disable all tasks except TASK_GYROPID, TASK_SERIAL and TASK_BEEPER
+    for (int taskId=0; taskId < TASK_COUNT; ++taskId) {
+        setTaskEnabled(static_cast<cfTaskId_e>(taskId), false);
+    }
+    setTaskEnabled(TASK_GYROPID, true);
+    setTaskEnabled(TASK_SERIAL, true);
+    setTaskEnabled(TASK_BEEPER, true);
+
+    for (int policy = SCHEDULER_POLICY_DYNAMIC_PRIORITY; policy <= SCHEDULER_POLICY_EDF; policy++) {
+        schedulerSetPolicy(static_cast<schedulerPolicy_e>(policy));
+
+        simulatedTime = 400000 + policy * 100000;
+        cfTasks[TASK_GYROPID].lastExecutedAt = simulatedTime;
+        cfTasks[TASK_SERIAL].lastExecutedAt = simulatedTime - 1000;
+        cfTasks[TASK_BEEPER].lastExecutedAt = simulatedTime - 1000;
+        setTaskEnabled(TASK_BEEPER, false);
+        setTaskEnabled(TASK_BEEPER, true);
+
+        // neither task is due yet
+        scheduler();
+        EXPECT_EQ(static_cast<cfTask_t*>(0), unittest_scheduler_selectedTask);
+
+        // signal releases TASK_SERIAL before its period has elapsed
+        signalTask(TASK_SERIAL);
+        scheduler();
+        EXPECT_EQ(&cfTasks[TASK_SERIAL], unittest_scheduler_selectedTask);
+        EXPECT_EQ(simulatedTime - handleSerialTime, cfTasks[TASK_SERIAL].lastSignaledAt);
+
+        // signal is consumed when the task runs
+        scheduler();
+        EXPECT_EQ(static_cast<cfTask_t*>(0), unittest_scheduler_selectedTask);
+
+        // signaled TASK_SERIAL goes ahead of TASK_BEEPER, which has higher priority and an earlier deadline
+        simulatedTime = cfTasks[TASK_BEEPER].lastExecutedAt + 10000;
+        cfTasks[TASK_GYROPID].lastExecutedAt = simulatedTime;
+        signalTask(TASK_SERIAL);
+        scheduler();
+        EXPECT_EQ(&cfTasks[TASK_SERIAL], unittest_scheduler_selectedTask);
+        scheduler();
+        EXPECT_EQ(&cfTasks[TASK_BEEPER], unittest_scheduler_selectedTask);
+
+        // signaled task still respects realtime guard interval
+        simulatedTime = cfTasks[TASK_GYROPID].lastExecutedAt + 1000 - REALTIME_GUARD_INTERVAL_MIN;
+        signalTask(TASK_SERIAL);
+        scheduler();
+        EXPECT_EQ(static_cast<cfTask_t*>(0), unittest_scheduler_selectedTask);
+        simulatedTime += REALTIME_GUARD_INTERVAL_MIN;
+        scheduler();
+        EXPECT_EQ(&cfTasks[TASK_GYROPID], unittest_scheduler_selectedTask);
+        scheduler();
+        EXPECT_EQ(&cfTasks[TASK_SERIAL], unittest_scheduler_selectedTask);
+    }
+
+    schedulerSetPolicy(SCHEDULER_POLICY_DYNAMIC_PRIORITY);
+}
+
+static uint32_t runSyntheticOverload(schedulerPolicy_e policy, uint32_t *gyroMisses)
+{
+    queueClear();
+    schedulerSetPolicy(policy);
+    simulatedTime = 1000000;
+    for (int taskId = 0; taskId < TASK_COUNT; ++taskId) {
+        cfTasks[taskId].lastExecutedAt = simulatedTime;
+        cfTasks[taskId].dynamicPriority = 0;
+        taskStartedAt[taskId] = simulatedTime;
+        deadlineMisses[taskId] = 0;
+        taskExtraTime[taskId] = 0;
+        setTaskEnabled(static_cast<cfTaskId_e>(taskId), true);
+    }
+
+    // only one non-realtime task fits between two gyro loop invocations, ask for more than that
+    taskExtraTime[TASK_SERIAL] = 250;
+    taskExtraTime[TASK_BEEPER] = 150;
+    taskExtraTime[TASK_BATTERY] = 200;
+    taskExtraTime[TASK_GPS] = 250;
+    taskExtraTime[TASK_TELEMETRY] = 200;
+    taskExtraTime[TASK_LEDSTRIP] = 250;
+    rescheduleTask(TASK_SERIAL, 2000);
+
+    const uint32_t endTime = simulatedTime + 2000000;
+    while (simulatedTime < endTime) {
+        scheduler();
+        if (unittest_scheduler_selectedTask == NULL) {
+            simulatedTime += 5;
+        }
+    }
+
+    uint32_t misses = 0;
+    for (int taskId = 0; taskId < TASK_COUNT; ++taskId) {
+        // tasks that were never started by the end of the run are starving
+        deadlineMisses[taskId] += missedDeadlines(static_cast<cfTaskId_e>(taskId), simulatedTime);
+        taskExtraTime[taskId] = 0;
+        if (taskId != TASK_GYROPID && taskId != TASK_SYSTEM && taskId != TASK_RX) {
+            misses += deadlineMisses[taskId];
+        }
+    }
+    *gyroMisses = deadlineMisses[TASK_GYROPID];
+
+    rescheduleTask(TASK_SERIAL, 1000000 / 100);
+    schedulerSetPolicy(SCHEDULER_POLICY_DYNAMIC_PRIORITY);
+    return misses;
+}
+
+TEST(SchedulerUnittest, TestEdfDeadlineMissesUnderOverload)
+{
+    uint32_t dynamicGyroMisses;
+    uint32_t edfGyroMisses;
+    const uint32_t dynamicMisses = runSyntheticOverload(SCHEDULER_POLICY_DYNAMIC_PRIORITY, &dynamicGyroMisses);
+    const uint32_t edfMisses = runSyntheticOverload(SCHEDULER_POLICY_EDF, &edfGyroMisses);
+    printf("deadline misses: dynamic %u (gyro %u), edf %u (gyro %u)\n", dynamicMisses, dynamicGyroMisses, edfMisses, edfGyroMisses);
+
+    EXPECT_GT(dynamicMisses, 0u);
+    EXPECT_LT(edfMisses, dynamicMisses);
+    EXPECT_EQ(0u, edfGyroMisses);
+    EXPECT_LE(edfGyroMisses, dynamicGyroMisses);
+}
+
+TEST(SchedulerUnittest, TestTaskHistogramPercentile)
+{
+    taskHistogram_t histogram;
+    memset(&histogram, 0, sizeof(histogram));
+    EXPECT_EQ(0u, taskHistogramPercentile(&histogram, 50));
+
+    histogram.bucket[4] = 90;   // 8..15us
+    histogram.bucket[8] = 9;    // 128..255us
+    histogram.bucket[11] = 1;   // 1024..2047us
+    EXPECT_EQ(12u, taskHistogramPercentile(&histogram, 50));
+    EXPECT_EQ(199u, taskHistogramPercentile(&histogram, 95));
+    EXPECT_EQ(256u, taskHistogramPercentile(&histogram, 99));
+    EXPECT_EQ(2048u, taskHistogramPercentile(&histogram, 100));
+
+    // open ended last bucket reports its lower bound
+    histogram.bucket[TASK_HISTOGRAM_BUCKET_COUNT - 1] = 100;
+    EXPECT_EQ(1u << (TASK_HISTOGRAM_BUCKET_COUNT - 2), taskHistogramPercentile(&histogram, 99));
+}
+
+TEST(SchedulerUnittest, TestTaskHistogramRecording)
+{
+    for (int taskId=0; taskId < TASK_COUNT; ++taskId) {
+        setTaskEnabled(static_cast<cfTaskId_e>(taskId), false);
+    }
+    setTaskEnabled(TASK_GYROPID, true);
+    setTaskEnabled(TASK_SERIAL, true);
+    memset(cfTasks[TASK_SERIAL].histogram, 0, sizeof(cfTasks[TASK_SERIAL].histogram));
+
+    // TASK_SERIAL is started 300us after its period elapsed and runs for handleSerialTime
+    simulatedTime = 700000;
+    cfTasks[TASK_GYROPID].lastExecutedAt = simulatedTime;
+    cfTasks[TASK_SERIAL].lastExecutedAt = simulatedTime - cfTasks[TASK_SERIAL].desiredPeriod - 300;
+    scheduler();
+    EXPECT_EQ(&cfTasks[TASK_SERIAL], unittest_scheduler_selectedTask);
+
+    const taskHistogram_t *execution = getTaskHistogram(TASK_SERIAL, TASK_HISTOGRAM_EXECUTION_TIME);
+    const taskHistogram_t *latency = getTaskHistogram(TASK_SERIAL, TASK_HISTOGRAM_START_LATENCY);
+    EXPECT_EQ(1, execution->bucket[5]);     // 16..31us
+    EXPECT_EQ(1, latency->bucket[9]);       // 256..511us
+
+    // signaled task latency is measured from the signal, here it waits for TASK_GYROPID
+    simulatedTime = cfTasks[TASK_SERIAL].lastExecutedAt + 200;
+    cfTasks[TASK_GYROPID].lastExecutedAt = simulatedTime - 1000 + REALTIME_GUARD_INTERVAL_MIN;
+    signalTask(TASK_SERIAL);
+    scheduler();
+    EXPECT_EQ(static_cast<cfTask_t*>(0), unittest_scheduler_selectedTask);
+    simulatedTime += REALTIME_GUARD_INTERVAL_MIN;
+    scheduler();
+    EXPECT_EQ(&cfTasks[TASK_GYROPID], unittest_scheduler_selectedTask);
+    scheduler();
+    EXPECT_EQ(&cfTasks[TASK_SERIAL], unittest_scheduler_selectedTask);
+    EXPECT_EQ(2, execution->bucket[5]);
+    EXPECT_EQ(1, latency->bucket[10]);      // 512..1023us, guard interval plus pidLoopCheckerTime
+}
+
+TEST(SchedulerUnittest, TestYieldedTaskResumes)
+{
+    for (int taskId=0; taskId < TASK_COUNT; ++taskId) {
+        setTaskEnabled(static_cast<cfTaskId_e>(taskId), false);
+    }
+    setTaskEnabled(TASK_GYROPID, true);
+    setTaskEnabled(TASK_SERIAL, true);
+    setTaskEnabled(TASK_BEEPER, true);
+
+    for (int policy = SCHEDULER_POLICY_DYNAMIC_PRIORITY; policy <= SCHEDULER_POLICY_EDF; policy++) {
+        schedulerSetPolicy(static_cast<schedulerPolicy_e>(policy));
+
+        simulatedTime = 800000 + policy * 100000;
+        cfTasks[TASK_GYROPID].lastExecutedAt = simulatedTime;
+        cfTasks[TASK_SERIAL].lastExecutedAt = simulatedTime;
+        cfTasks[TASK_BEEPER].lastExecutedAt = simulatedTime - cfTasks[TASK_BEEPER].desiredPeriod;
+        setTaskEnabled(TASK_BEEPER, false);
+        setTaskEnabled(TASK_BEEPER, true);
+
+        // slice is capped at TASK_TIME_SLICE_MAX
+        taskYields[TASK_BEEPER] = true;
+        taskExtraTime[TASK_BEEPER] = TASK_TIME_SLICE_MAX - updateBeeperTime - 1;
+        scheduler();
+        EXPECT_EQ(&cfTasks[TASK_BEEPER], unittest_scheduler_selectedTask);
+        EXPECT_FALSE(taskTimeSliceExpired[TASK_BEEPER]);
+
+        // yielded task is resumed before its period has elapsed
+        taskExtraTime[TASK_BEEPER] = TASK_TIME_SLICE_MAX;
+        scheduler();
+        EXPECT_EQ(&cfTasks[TASK_BEEPER], unittest_scheduler_selectedTask);
+        EXPECT_TRUE(taskTimeSliceExpired[TASK_BEEPER]);
+
+        // yielded task respects realtime guard interval
+        simulatedTime = cfTasks[TASK_GYROPID].lastExecutedAt + 1000 - REALTIME_GUARD_INTERVAL_MIN;
+        scheduler();
+        EXPECT_EQ(static_cast<cfTask_t*>(0), unittest_scheduler_selectedTask);
+        simulatedTime += REALTIME_GUARD_INTERVAL_MIN;
+        scheduler();
+        EXPECT_EQ(&cfTasks[TASK_GYROPID], unittest_scheduler_selectedTask);
+        taskExtraTime[TASK_BEEPER] = 0;
+        scheduler();
+        EXPECT_EQ(&cfTasks[TASK_BEEPER], unittest_scheduler_selectedTask);
+        EXPECT_FALSE(taskTimeSliceExpired[TASK_BEEPER]);
+
+        // yield doesn't take precedence over a signaled task
+        signalTask(TASK_SERIAL);
+        scheduler();
+        EXPECT_EQ(&cfTasks[TASK_SERIAL], unittest_scheduler_selectedTask);
+        scheduler();
+        EXPECT_EQ(&cfTasks[TASK_BEEPER], unittest_scheduler_selectedTask);
+
+        // task is done once it stops yielding
+        taskYields[TASK_BEEPER] = false;
+        scheduler();
+        EXPECT_EQ(&cfTasks[TASK_BEEPER], unittest_scheduler_selectedTask);
+        scheduler();
+        EXPECT_EQ(static_cast<cfTask_t*>(0), unittest_scheduler_selectedTask);
+    }
+
+    schedulerSetPolicy(SCHEDULER_POLICY_DYNAMIC_PRIORITY);
+}
+
 // STUBS
 extern "C" {
 }
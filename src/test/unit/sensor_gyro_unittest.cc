@@ -0,0 +1,192 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/axis.h"
+    #include "common/maths.h"
+
+    #include "drivers/sensor.h"
+    #include "drivers/accgyro.h"
+    #include "drivers/gyro_sync.h"
+
+    #include "io/beeper.h"
+
+    #include "sensors/sensors.h"
+    #include "sensors/boardalignment.h"
+    #include "sensors/gyro.h"
+}
+
+#include "unittest_macros.h"
+#include "unittest_random.h"
+#include "gtest/gtest.h"
+
+static float fakeGyroBias[XYZ_AXIS_COUNT];
+static float fakeGyroNoise;
+static uint32_t fakeMillis;
+static int beeperCalls;
+
+static bool fakeGyroRead(int16_t *gyroData)
+{
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        gyroData[axis] = lrintf(fakeGyroBias[axis] + unittestGaussian(fakeGyroNoise));
+    }
+    return true;
+}
+
+static gyroConfig_t testGyroConfig;
+
+static void startCalibration(float noise, uint16_t minCycles)
+{
+    unittestRandomSeed(2463534242U);
+    fakeGyroBias[X] = 30;
+    fakeGyroBias[Y] = -12;
+    fakeGyroBias[Z] = 5;
+    fakeGyroNoise = noise;
+    fakeMillis = 0;
+    beeperCalls = 0;
+    targetLooptime = 0;
+
+    memset(&testGyroConfig, 0, sizeof(testGyroConfig));
+    testGyroConfig.gyroMovementCalibrationThreshold = 32;
+    testGyroConfig.gyroCalibrationMinCycles = minCycles;
+    useGyroConfig(&testGyroConfig, 0);
+
+    gyro.read = fakeGyroRead;
+    gyroSetCalibrationCycles(CALIBRATING_GYRO_CYCLES);
+}
+
+// runs gyro updates 1ms apart until calibration completes, returns the number of updates
+static int runCalibration(int maxUpdates)
+{
+    int updates = 0;
+    while (!isGyroCalibrationComplete() && updates < maxUpdates) {
+        gyroUpdate();
+        fakeMillis++;
+        updates++;
+    }
+    return updates;
+}
+
+TEST(SensorGyroTest, StillGyroFinishesAtMinimumCycles)
+{
+    startCalibration(2, 200);
+
+    EXPECT_EQ(200, runCalibration(5000));
+
+    const gyroCalibrationStatus_t *status = gyroGetCalibrationStatus();
+    EXPECT_EQ(200, status->sampleCount);
+    EXPECT_EQ(199, status->durationMs);
+    EXPECT_EQ(0, status->restartCount);
+    EXPECT_EQ(1, beeperCalls);
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        EXPECT_NEAR(fakeGyroBias[axis], status->zero[axis], 1);
+        EXPECT_NEAR(2, status->noiseStdDev[axis], 0.3f);
+    }
+
+    // zero is applied to the following readings
+    gyroUpdate();
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        EXPECT_NEAR(0, gyroADC[axis], 10);
+    }
+}
+
+TEST(SensorGyroTest, NoisyGyroAveragesUntilZeroIsKnown)
+{
+    // the zero is known to 0.25 LSB after (5 / 0.25)^2 = 400 samples
+    startCalibration(5, 50);
+
+    const int updates = runCalibration(5000);
+    EXPECT_GT(updates, 300);
+    EXPECT_LT(updates, 550);
+
+    const gyroCalibrationStatus_t *status = gyroGetCalibrationStatus();
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        EXPECT_NEAR(fakeGyroBias[axis], status->zero[axis], 1);
+    }
+}
+
+TEST(SensorGyroTest, VibratingGyroUsesAllCycles)
+{
+    startCalibration(20, 200);
+
+    EXPECT_EQ(CALIBRATING_GYRO_CYCLES, runCalibration(5000));
+    EXPECT_EQ(CALIBRATING_GYRO_CYCLES, gyroGetCalibrationStatus()->sampleCount);
+    EXPECT_NEAR(20, gyroGetCalibrationStatus()->noiseStdDev[X], 2);
+}
+
+TEST(SensorGyroTest, LowPassFilterDoesNotShortenCalibration)
+{
+    // same noisy gyro, with a 20Hz low pass at 1kHz the filtered samples vary far less but are correlated
+    startCalibration(5, 50);
+    useGyroConfig(&testGyroConfig, 20);
+    targetLooptime = 1000;
+
+    // recalibration from the sticks, the filter has settled
+    gyroSetCalibrationCycles(0);
+    for (int i = 0; i < 500; i++) {
+        gyroUpdate();
+    }
+    gyroSetCalibrationCycles(CALIBRATING_GYRO_CYCLES);
+
+    const int updates = runCalibration(5000);
+    EXPECT_GT(updates, 300);
+    EXPECT_LT(updates, 550);
+
+    const gyroCalibrationStatus_t *status = gyroGetCalibrationStatus();
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        EXPECT_NEAR(fakeGyroBias[axis], status->zero[axis], 1);
+        EXPECT_NEAR(5, status->noiseStdDev[axis], 0.5f);
+    }
+}
+
+TEST(SensorGyroTest, MovedCraftRestartsCalibration)
+{
+    startCalibration(50, 200);
+
+    runCalibration(1000);
+    EXPECT_FALSE(isGyroCalibrationComplete());
+    EXPECT_GE(gyroGetCalibrationStatus()->restartCount, 4);
+
+    // craft put down, calibration time includes the restarts
+    fakeGyroNoise = 2;
+    runCalibration(5000);
+    EXPECT_TRUE(isGyroCalibrationComplete());
+    EXPECT_GE(gyroGetCalibrationStatus()->durationMs, 1000);
+    EXPECT_EQ(1, beeperCalls);
+}
+
+// STUBS
+
+extern "C" {
+uint32_t targetLooptime = 0;
+
+uint32_t millis(void) { return fakeMillis; }
+void beeper(beeperMode_e mode) { UNUSED(mode); beeperCalls++; }
+void alignSensors(sensorIndex_e sensor, int32_t *vec) { UNUSED(sensor); UNUSED(vec); }
+
+void gyroDynamicNotchInit(uint32_t looptime, uint16_t minHz, uint16_t q) { UNUSED(looptime); UNUSED(minHz); UNUSED(q); }
+void gyroDynamicNotchUpdate(int32_t *gyroData) { UNUSED(gyroData); }
+void gyroDynamicLpfInit(uint32_t looptime, uint8_t minHz, uint8_t maxHz) { UNUSED(looptime); UNUSED(minHz); UNUSED(maxHz); }
+void gyroDynamicLpfUpdate(int32_t *gyroData) { UNUSED(gyroData); }
+}
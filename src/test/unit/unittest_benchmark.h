@@ -0,0 +1,46 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <chrono>
+
+#include "gtest/gtest.h"
+
+// Host timings, only comparable between runs of the same build on the same machine
+
+// Calls body(i) for every i in [0; samples) and returns the mean time of one call in ns
+template <typename Body>
+static double unittestNanosecondsPerSample(int samples, Body body)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < samples; i++) {
+        body(i);
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / samples;
+}
+
+// Prints a timing and records it as a property of the running test, so that it also ends up in --gtest_output=xml
+static inline void unittestReportBenchmark(const char *name, double nanoseconds)
+{
+    char value[32];
+    snprintf(value, sizeof(value), "%.1f", nanoseconds);
+    ::testing::Test::RecordProperty(name, value);
+    printf("%s: %s ns/sample\n", name, value);
+}
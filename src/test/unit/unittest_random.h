@@ -0,0 +1,48 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+// Deterministic pseudo random numbers, the same seed always gives the same sequence
+static uint32_t unittestRandomState = 2463534242U;
+
+static inline void unittestRandomSeed(uint32_t seed)
+{
+    unittestRandomState = seed;
+}
+
+// xorshift32
+static inline uint32_t unittestRandom(void)
+{
+    unittestRandomState ^= unittestRandomState << 13;
+    unittestRandomState ^= unittestRandomState >> 17;
+    unittestRandomState ^= unittestRandomState << 5;
+    return unittestRandomState;
+}
+
+// gaussian noise, Box-Muller on two uniforms in (0, 1]
+static inline float unittestGaussian(float stdDev)
+{
+    float u[2];
+    for (int i = 0; i < 2; i++) {
+        u[i] = (unittestRandom() + 1.0f) / 4294967296.0f;
+    }
+    return stdDev * sqrtf(-2 * logf(u[0])) * cosf(2 * M_PI * u[1]);
+}